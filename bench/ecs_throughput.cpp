@@ -0,0 +1,128 @@
+// Measures the World's throughput for the operations the simulation
+// does in bulk: creating entities, iterating them serially and on the job
+// system, adding and removing a component and destroying them.
+// Iteration is compared with the same data as an array of structs.
+//
+// Usage: ecs_throughput [entities] [worker threads]
+
+#include "ecs/world.h"
+#include "jobs/job_system.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static constexpr int REPEATS = 5;
+static constexpr size_t CHUNK_GRAIN = 8;
+
+struct Position {
+  float x, y, z;
+};
+
+struct Velocity {
+  float x, y;
+};
+
+struct Health {
+  float value;
+};
+
+// What an object per entity would carry around
+struct Object {
+  Position pos;
+  Velocity vel;
+  Health health;
+  float size[2];
+  uint32_t color;
+  uint32_t flags[4];
+};
+
+template <class Fn>
+static double timeMs(Fn &&fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+template <class Fn>
+static double bestMs(Fn &&fn) {
+  double best = 1e30;
+  for (int r = 0; r < REPEATS; ++r) {
+    best = std::min(best, timeMs(fn));
+  }
+  return best;
+}
+
+static void report(const char *what, size_t count, double ms) {
+  printf("%-18s %10.3fms %8.2f ns/entity %8.2f M/s\n", what, ms, ms * 1e6 / count, count / ms / 1e3);
+}
+
+int main(int argc, char **argv) {
+  size_t count = 1'000'000;
+  uint32_t workers = 0;
+  if (argc > 1) count = static_cast<size_t>(std::atoll(argv[1]));
+  if (argc > 2) workers = static_cast<uint32_t>(std::atoi(argv[2]));
+
+  initJobSystem(workers);
+  printf("%zu entities, %u workers\n", count, getJobSystem().numWorkers());
+
+  World world;
+  std::vector<Entity> entities;
+  entities.reserve(count);
+
+  report("create", count, timeMs([&] {
+    for (size_t i = 0; i < count; ++i) {
+      entities.push_back(world.create(Position{ float(i), 0.f, 0.f }, Velocity{ 1.f, 2.f }));
+    }
+  }));
+
+  float dt = 1.f / 60.f;
+  auto integrate = [dt](uint32_t n, const Entity*, Position *pos, const Velocity *vel) {
+    for (uint32_t i = 0; i < n; ++i) {
+      pos[i].x += vel[i].x * dt;
+      pos[i].y += vel[i].y * dt;
+    }
+  };
+
+  report("iterate", count, bestMs([&] {
+    world.eachChunk<Position, const Velocity>(integrate);
+  }));
+
+  report("iterate parallel", count, bestMs([&] {
+    world.parallelEach<Position, const Velocity>(CHUNK_GRAIN, integrate);
+  }));
+
+  {
+    std::vector<Object> objects(count);
+    report("iterate AoS", count, bestMs([&] {
+      for (Object &obj : objects) {
+        obj.pos.x += obj.vel.x * dt;
+        obj.pos.y += obj.vel.y * dt;
+      }
+    }));
+  }
+
+  report("add component", count, timeMs([&] {
+    for (Entity e : entities) {
+      world.add(e, Health{ 100.f });
+    }
+  }));
+
+  report("remove component", count, timeMs([&] {
+    for (Entity e : entities) {
+      world.remove<Health>(e);
+    }
+  }));
+
+  report("destroy", count, timeMs([&] {
+    for (Entity e : entities) {
+      world.destroy(e);
+    }
+  }));
+
+  deinitJobSystem();
+
+  return world.size() == 0 ? 0 : 1;
+}
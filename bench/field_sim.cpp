@@ -0,0 +1,138 @@
+// Compares the CPU and GPU backends of the reaction-diffusion field in
+// cells updated per second, and checks that the GPU matches the CPU
+// after the same number of steps. Needs a GPU.
+//
+// Usage: field_sim <config> [size] [steps]
+
+#include "config/config.h"
+#include "defines.h"
+#include "jobs/job_system.h"
+#include "render/gpu.h"
+#include "render/gpu_field.h"
+#include "sim/field.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <SDL3/SDL.h>
+
+// Steps compared between the backends. Small enough that the float
+// differences between the two don't grow into different patterns.
+static constexpr int VALIDATE_STEPS = 64;
+
+// Cells per second
+static double measureCPU(glm::ivec2 size, int steps) {
+  Field field;
+  field.init(size);
+  FieldConstData params = makeFieldConstData(size);
+
+  Uint64 start = SDL_GetTicksNS();
+  field.step(params, steps);
+  Uint64 elapsed = SDL_GetTicksNS() - start;
+
+  return double(size.x) * size.y * steps / (double(elapsed) / SDL_NS_PER_SECOND);
+}
+
+// Steps on the GPU in one command buffer and waits for it.
+static bool stepGPU(GPUContext &gpu, GPUField &field, int steps) {
+  SDL_GPUCommandBuffer *cmdBuf = nullptr;
+  SDL_CHECK((cmdBuf = SDL_AcquireGPUCommandBuffer(gpu.device)));
+  if (!field.step(cmdBuf, steps)) {
+    SDL_CancelGPUCommandBuffer(cmdBuf);
+    return false;
+  }
+
+  SDL_GPUFence *fence = nullptr;
+  SDL_CHECK((fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdBuf)));
+  bool res = SDL_WaitForGPUFences(gpu.device, true, &fence, 1);
+  SDL_ReleaseGPUFence(gpu.device, fence);
+
+  return res;
+}
+
+// Cells per second, including the submit
+static double measureGPU(GPUContext &gpu, glm::ivec2 size, int steps) {
+  GPUField field;
+  if (!field.init(&gpu, size, true) || !stepGPU(gpu, field, 1)) {
+    return -1.;
+  }
+
+  Uint64 start = SDL_GetTicksNS();
+  if (!stepGPU(gpu, field, steps)) {
+    return -1.;
+  }
+  Uint64 elapsed = SDL_GetTicksNS() - start;
+  field.deinit();
+
+  return double(size.x) * size.y * steps / (double(elapsed) / SDL_NS_PER_SECOND);
+}
+
+// Largest difference of any cell, negative on failure
+static float validate(GPUContext &gpu, glm::ivec2 size) {
+  Field cpu;
+  cpu.init(size);
+  cpu.step(makeFieldConstData(size), VALIDATE_STEPS);
+
+  GPUField field;
+  std::vector<glm::vec2> gpuCells;
+  if (!field.init(&gpu, size, true) || !stepGPU(gpu, field, VALIDATE_STEPS) || !field.download(gpuCells)) {
+    return -1.f;
+  }
+  field.deinit();
+
+  float maxDiff = 0.f;
+  const std::vector<glm::vec2> &cpuCells = cpu.getCells();
+  for (size_t i = 0; i < cpuCells.size(); ++i) {
+    maxDiff = std::max({ maxDiff, std::abs(cpuCells[i].x - gpuCells[i].x), std::abs(cpuCells[i].y - gpuCells[i].y) });
+  }
+
+  return maxDiff;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printf("Usage: %s <config> [size] [steps]\n", argv[0]);
+    return 1;
+  }
+
+  int side = argc > 2 ? std::atoi(argv[2]) : 1024;
+  int steps = argc > 3 ? std::atoi(argv[3]) : 200;
+  glm::ivec2 size = { side, side };
+
+  initConfig();
+  if (!getConfig().parse(argv[1])) {
+    return 1;
+  }
+  initJobSystem(getConfig().workerCount);
+
+  SDL_CHECK_RET(SDL_Init(SDL_INIT_VIDEO), 1);
+
+  int res = 1;
+  {
+    GPUContext gpu;
+    if (gpu.init(getConfig())) {
+      double cpuRate = measureCPU(size, steps);
+      double gpuRate = measureGPU(gpu, size, steps);
+      float maxDiff = validate(gpu, size);
+
+      printf("%dx%d cells, %d steps, %u workers\n", size.x, size.y, steps, getJobSystem().numWorkers());
+      printf("cpu: %.1f Mcells/s\n", cpuRate / 1e6);
+      if (gpuRate > 0.) {
+        printf("gpu: %.1f Mcells/s (%.1fx)\n", gpuRate / 1e6, gpuRate / cpuRate);
+      }
+      if (maxDiff >= 0.f) {
+        printf("max difference after %d steps: %g\n", VALIDATE_STEPS, maxDiff);
+      }
+      res = gpuRate > 0. && maxDiff >= 0.f ? 0 : 1;
+    }
+  }
+
+  deinitJobSystem();
+  SDL_Quit();
+  deinitConfig();
+
+  return res;
+}
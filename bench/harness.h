@@ -0,0 +1,180 @@
+#pragma once
+
+// A small harness for the microbenchmarks: warms up, times a number of
+// repetitions, summarizes them and writes the results as JSON.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <SDL3/SDL.h>
+
+// Passed to a benchmark's repetition, whatever runs while it's paused
+// isn't counted, e.g. waiting for the GPU.
+class BenchTimer {
+private:
+  Uint64 pausedAt = 0;
+  Uint64 pausedNS = 0;
+
+public:
+  void pause() {
+    pausedAt = SDL_GetTicksNS();
+  }
+
+  void resume() {
+    pausedNS += SDL_GetTicksNS() - pausedAt;
+    pausedAt = 0;
+  }
+
+  Uint64 getPausedNS() const { return pausedNS; }
+};
+
+struct BenchResult {
+  std::string name;
+  int reps = 0;
+  // Operations and bytes per repetition, the per operation times and the
+  // throughput are derived from them.
+  uint64_t items = 1;
+  uint64_t bytes = 0;
+
+  // Per repetition
+  double minNS = 0.;
+  double medianNS = 0.;
+  double meanNS = 0.;
+  double p90NS = 0.;
+  double maxNS = 0.;
+  double stddevNS = 0.;
+};
+
+class BenchHarness {
+private:
+  int warmup = 3;
+  int reps = 20;
+  std::string filter;
+
+  std::vector<BenchResult> results;
+  bool failed = false;
+
+public:
+  BenchHarness(int warmup, int reps, std::string filter)
+    : warmup(warmup), reps(std::max(reps, 1)), filter(std::move(filter)) {}
+
+  bool selected(const std::string &name) const {
+    return filter.empty() || name.find(filter) != std::string::npos;
+  }
+
+  // Runs fn(BenchTimer&) warmup + reps times, fn returns false on failure.
+  // items and bytes are what one repetition processes.
+  template <class Fn>
+  bool run(const std::string &name, uint64_t items, uint64_t bytes, Fn &&fn);
+
+  bool anyFailed() const { return failed; }
+
+  void print() const;
+  bool writeJson(const std::string &path, const std::string &context) const;
+};
+
+template <class Fn>
+bool BenchHarness::run(const std::string &name, uint64_t items, uint64_t bytes, Fn &&fn) {
+  if (!selected(name)) {
+    return true;
+  }
+
+  for (int i = 0; i < warmup; ++i) {
+    BenchTimer timer;
+    if (!fn(timer)) {
+      printf("%s failed\n", name.c_str());
+      failed = true;
+      return false;
+    }
+  }
+
+  std::vector<double> times(reps);
+  for (int i = 0; i < reps; ++i) {
+    BenchTimer timer;
+    Uint64 start = SDL_GetTicksNS();
+    if (!fn(timer)) {
+      printf("%s failed\n", name.c_str());
+      failed = true;
+      return false;
+    }
+    times[i] = double(SDL_GetTicksNS() - start - timer.getPausedNS());
+  }
+
+  std::sort(times.begin(), times.end());
+  BenchResult res = {
+    .name = name,
+    .reps = reps,
+    .items = std::max<uint64_t>(items, 1),
+    .bytes = bytes,
+    .minNS = times.front(),
+    .medianNS = times[times.size() / 2],
+    .p90NS = times[std::min(times.size() - 1, times.size() * 9 / 10)],
+    .maxNS = times.back(),
+  };
+  for (double t : times) {
+    res.meanNS += t / reps;
+  }
+  for (double t : times) {
+    res.stddevNS += (t - res.meanNS) * (t - res.meanNS) / reps;
+  }
+  res.stddevNS = std::sqrt(res.stddevNS);
+
+  results.push_back(res);
+  return true;
+}
+
+inline void BenchHarness::print() const {
+  printf("%-36s %12s %12s %12s %10s %12s\n", "benchmark", "median", "min", "p90", "stddev", "per op");
+  for (const BenchResult &res : results) {
+    printf(
+      "%-36s %10.3fus %10.3fus %10.3fus %9.1f%% %10.1fns",
+      res.name.c_str(),
+      res.medianNS / 1e3,
+      res.minNS / 1e3,
+      res.p90NS / 1e3,
+      res.meanNS > 0. ? res.stddevNS / res.meanNS * 100. : 0.,
+      res.medianNS / res.items
+    );
+    if (res.bytes > 0) {
+      printf(" %9.1f MB/s", double(res.bytes) / (1024. * 1024.) / (res.medianNS / 1e9));
+    }
+    printf("\n");
+  }
+}
+
+// context is a JSON object describing the machine and the run
+inline bool BenchHarness::writeJson(const std::string &path, const std::string &context) const {
+  FILE *file = fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    printf("Failed to create %s\n", path.c_str());
+    return false;
+  }
+
+  fprintf(file, "{\n  \"context\": %s,\n  \"benchmarks\": [\n", context.c_str());
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchResult &res = results[i];
+    fprintf(
+      file,
+      "    { \"name\": \"%s\", \"reps\": %d, \"items\": %llu, \"bytes\": %llu,"
+      " \"min_ns\": %.1f, \"median_ns\": %.1f, \"mean_ns\": %.1f, \"p90_ns\": %.1f,"
+      " \"max_ns\": %.1f, \"stddev_ns\": %.1f }%s\n",
+      res.name.c_str(),
+      res.reps,
+      static_cast<unsigned long long>(res.items),
+      static_cast<unsigned long long>(res.bytes),
+      res.minNS,
+      res.medianNS,
+      res.meanNS,
+      res.p90NS,
+      res.maxNS,
+      res.stddevNS,
+      i + 1 < results.size() ? "," : ""
+    );
+  }
+  fprintf(file, "  ]\n}\n");
+
+  return fclose(file) == 0;
+}
@@ -0,0 +1,86 @@
+// Measures integrate at every SIMD level the CPU supports, on one thread
+// and spread over the job system, in agents updated per second per core.
+//
+// Usage: integrate_throughput [agents] [worker threads]
+
+#include "jobs/job_system.h"
+#include "sim/integrate.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "magic_enum/magic_enum.hpp"
+
+static constexpr int STEPS = 100;
+static constexpr size_t GRAIN = 16 * 1024;
+
+struct Agents {
+  std::vector<glm::vec2> pos;
+  std::vector<glm::vec2> vel;
+  std::vector<glm::vec2> accel;
+
+  explicit Agents(size_t count) : pos(count), vel(count), accel(count) {
+    for (size_t i = 0; i < count; ++i) {
+      pos[i] = { float(i % 1024), float(i / 1024 % 1024) };
+      vel[i] = { float(i % 7) - 3.f, float(i % 5) - 2.f };
+      accel[i] = { 0.f, 9.8f };
+    }
+  }
+};
+
+// Agent updates per second
+template <class Fn>
+static double measure(size_t count, Fn &&fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (int s = 0; s < STEPS; ++s) {
+    fn();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return double(count) * STEPS / std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char **argv) {
+  size_t count = 1'000'000;
+  uint32_t workers = 0;
+  if (argc > 1) count = static_cast<size_t>(std::atoll(argv[1]));
+  if (argc > 2) workers = static_cast<uint32_t>(std::atoi(argv[2]));
+
+  initJobSystem(workers);
+  uint32_t threads = getJobSystem().numWorkers() + 1;
+  glm::vec2 bounds = { 1024.f, 1024.f };
+  float dt = 1.f / 60.f;
+
+  printf("%zu agents, %u threads, best level %s\n", count, threads, magic_enum::enum_name(getSimdLevel()).data());
+  printf("%8s %16s %16s %16s\n", "level", "1 thread M/s", "all M/s", "per core M/s");
+
+  for (auto level : magic_enum::enum_values<SimdLevel>()) {
+    if (level > getSimdLevel()) {
+      continue;
+    }
+
+    Agents agents(count);
+    double single = measure(count, [&] {
+      integrate(agents.pos.data(), agents.vel.data(), agents.accel.data(), count, dt, bounds, level);
+    });
+    double parallel = measure(count, [&] {
+      getJobSystem().parallelFor(0, count, GRAIN, [&](size_t begin, size_t end) {
+        integrate(&agents.pos[begin], &agents.vel[begin], &agents.accel[begin], end - begin, dt, bounds, level);
+      });
+    });
+
+    printf(
+      "%8s %16.1f %16.1f %16.1f\n",
+      magic_enum::enum_name(level).data(),
+      single / 1e6,
+      parallel / 1e6,
+      parallel / threads / 1e6
+    );
+  }
+
+  deinitJobSystem();
+
+  return 0;
+}
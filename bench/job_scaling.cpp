@@ -0,0 +1,80 @@
+// Measures how JobSystem::parallelFor scales from 1 to N threads
+// on a synthetic, compute bound workload.
+//
+// Usage: job_scaling [max threads] [elements] [grain]
+
+#include "jobs/job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static constexpr int REPEATS = 5;
+
+// Some math per element so the work dominates the scheduling.
+static float work(float x) {
+  for (int i = 0; i < 64; ++i) {
+    x = std::sqrt(x * x + 1.f) * std::sin(x);
+  }
+  return x;
+}
+
+int main(int argc, char **argv) {
+  uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+  size_t elements = 1 << 20;
+  size_t grain = 1024;
+  if (argc > 1) maxThreads = static_cast<uint32_t>(std::atoi(argv[1]));
+  if (argc > 2) elements = static_cast<size_t>(std::atoll(argv[2]));
+  if (argc > 3) grain = static_cast<size_t>(std::atoll(argv[3]));
+
+  std::vector<float> data(elements);
+  for (size_t i = 0; i < elements; ++i) {
+    data[i] = float(i % 1000) * 0.001f;
+  }
+
+  printf("elements %zu grain %zu\n", elements, grain);
+  printf("%8s %12s %8s %11s\n", "threads", "ms", "speedup", "efficiency");
+
+  double baseMs = 0.;
+  for (uint32_t threads = 1; threads <= maxThreads; ++threads) {
+    // The calling thread runs jobs too while it waits.
+    // The single threaded baseline doesn't go through the scheduler at all.
+    JobSystem jobs;
+    if (threads > 1) {
+      jobs.init(threads - 1);
+    }
+
+    std::vector<float> out(elements);
+    double bestMs = 1e30;
+    for (int r = 0; r < REPEATS; ++r) {
+      auto start = std::chrono::steady_clock::now();
+
+      if (threads == 1) {
+        for (size_t i = 0; i < elements; ++i) {
+          out[i] = work(data[i]);
+        }
+      } else {
+        jobs.parallelFor(0, elements, grain, [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            out[i] = work(data[i]);
+          }
+        });
+      }
+
+      auto end = std::chrono::steady_clock::now();
+      bestMs = std::min(bestMs, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    if (threads == 1) {
+      baseMs = bestMs;
+    }
+
+    double speedup = baseMs / bestMs;
+    printf("%8u %12.3f %8.2f %10.0f%%\n", threads, bestMs, speedup, speedup / threads * 100.);
+  }
+
+  return 0;
+}
@@ -0,0 +1,403 @@
+// Microbenchmarks of the engine's hot spots: tokenizing and parsing the
+// config, laying out the perf HUD, uploads of buffers and textures of
+// several sizes, packing and defragmenting the texture atlas, shader cache
+// lookups and the cost of a render pass' bind and draw calls. The GPU
+// ones are skipped if there is no GPU. They run on a headless Vulkan
+// device just as well, e.g. lavapipe with SDL_VIDEO_DRIVER=offscreen,
+// SDL_GPU_DRIVER=vulkan and VK_ICD_FILENAMES pointing at lvp_icd.*.json.
+//
+// Usage: bench <config> [--reps N] [--warmup N] [--filter substring] [--json file]
+
+#include "harness.h"
+
+#include "config/config.h"
+#include "config/parser.h"
+#include "defines.h"
+#include "jobs/job_system.h"
+#include "mapped_file.h"
+#include "render/gpu.h"
+#include "render/perf_hud.h"
+#include "render/renderer.h"
+#include "render/shader.h"
+#include "render/texture_atlas.h"
+#include "gpu_shared/cpu_gpu_shared.h"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <SDL3/SDL.h>
+
+// Draws per repetition of the pass benchmarks
+static constexpr uint32_t PASS_DRAWS = 1000;
+static constexpr int PASS_TARGET_SIZE = 256;
+static constexpr int ATLAS_IMAGES = 1000;
+static constexpr int ATLAS_PAGE_SIZE = 1024;
+static constexpr int ATLAS_MAX_PAGES = 8;
+
+static void benchConfig(BenchHarness &harness, const std::string &path) {
+  MappedFile file;
+  if (!file.open(path)) {
+    printf("Failed to open %s\n", path.c_str());
+    return;
+  }
+
+  std::string_view text = file.text();
+  uint64_t records = 0;
+  size_t cursor = 0;
+  TextRecord record;
+  while (nextRecord(text, cursor, record)) {
+    ++records;
+  }
+
+  harness.run("config/tokenize", records, text.size(), [text](BenchTimer&) {
+    size_t cursor = 0;
+    TextRecord record;
+    uint64_t count = 0;
+    while (nextRecord(text, cursor, record)) {
+      ++count;
+    }
+    return count > 0;
+  });
+
+  harness.run("config/parse", records, text.size(), [&path](BenchTimer&) {
+    Config cfg;
+    return cfg.parse(path);
+  });
+}
+
+static void benchHud(BenchHarness &harness) {
+  PerfHud hud;
+  std::vector<RecordTiming> steps(4);
+  steps[0].step = "screen";
+  steps[1].step = "cull";
+  steps[2].step = "scene";
+  steps[3].step = "post";
+  for (int i = 0; i < PerfHud::GRAPH_FRAMES; ++i) {
+    hud.addFrame({ .frameMs = 16.7, .gpuWaitMs = 1., .uploadBytes = 4096, .draws = 8, .binds = 8 }, steps);
+  }
+
+  uint64_t quads = hud.build().size();
+  harness.run("hud/build", quads, 0, [&hud](BenchTimer&) {
+    return !hud.build().empty();
+  });
+}
+
+static void benchUploads(BenchHarness &harness, GPUContext &gpu) {
+  GPUBuffer buffer;
+  for (size_t kb : { 4, 64, 1024, 16384 }) {
+    std::vector<uint8_t> data(kb * 1024, 0xab);
+    harness.run("upload/buffer " + std::to_string(kb) + "KB", 1, data.size(), [&](BenchTimer &timer) {
+      auto fence = gpu.uploadAsync(UploadBuffer<uint8_t>{ data, &buffer, BufferType::STORAGE });
+      if (!fence.has_value()) {
+        return false;
+      }
+
+      timer.pause();
+      bool res = gpu.wait(*fence);
+      timer.resume();
+
+      return res;
+    });
+  }
+  buffer.deinit();
+
+  GPUTexture texture;
+  for (int side : { 64, 512, 2048 }) {
+    SDL_Surface *surface = SDL_CreateSurface(side, side, SDL_PIXELFORMAT_RGBA32);
+    if (surface == nullptr) {
+      continue;
+    }
+
+    uint64_t bytes = uint64_t(surface->pitch) * surface->h;
+    harness.run("upload/texture " + std::to_string(side) + "px", 1, bytes, [&](BenchTimer &timer) {
+      auto fence = gpu.uploadAsync(UploadTexture{
+        .name = "bench",
+        .surface = &surface,
+        .result = &texture,
+        .usage = TextureType::SAMPLER,
+      });
+      if (!fence.has_value()) {
+        return false;
+      }
+
+      timer.pause();
+      bool res = gpu.wait(*fence);
+      timer.resume();
+
+      return res;
+    });
+
+    SDL_DestroySurface(surface);
+  }
+  texture.deinit();
+}
+
+static void benchAtlas(BenchHarness &harness, GPUContext &gpu) {
+  // Sprite sized images, the same every run
+  std::vector<SDL_Surface*> surfaces;
+  uint32_t seed = 1;
+  auto random = [&seed](int max) {
+    seed = seed * 1664525u + 1013904223u;
+    return static_cast<int>((seed >> 16) % max);
+  };
+  for (int i = 0; i < ATLAS_IMAGES; ++i) {
+    SDL_Surface *surface = SDL_CreateSurface(8 + random(57), 8 + random(57), SDL_PIXELFORMAT_RGBA32);
+    if (surface == nullptr) {
+      break;
+    }
+    surfaces.push_back(surface);
+  }
+
+  TextureAtlas atlas;
+  auto fill = [&](bool fragment) {
+    if (!atlas.init(&gpu, ATLAS_PAGE_SIZE, ATLAS_MAX_PAGES, 1, "bench")) {
+      return false;
+    }
+
+    std::vector<AtlasHandle> handles;
+    for (SDL_Surface *surface : surfaces) {
+      auto handle = atlas.add(surface);
+      if (!handle.has_value()) {
+        return false;
+      }
+      handles.push_back(*handle);
+    }
+
+    // Every other image removed leaves holes all over the shelves.
+    if (fragment) {
+      for (size_t i = 0; i < handles.size(); i += 2) {
+        atlas.remove(handles[i]);
+      }
+    }
+
+    return atlas.flush();
+  };
+
+  if (surfaces.size() == ATLAS_IMAGES) {
+    harness.run("atlas/add", ATLAS_IMAGES, 0, [&](BenchTimer &timer) {
+      timer.pause();
+      bool res = atlas.init(&gpu, ATLAS_PAGE_SIZE, ATLAS_MAX_PAGES, 1, "bench");
+      timer.resume();
+
+      for (size_t i = 0; i < surfaces.size() && res; ++i) {
+        res = atlas.add(surfaces[i]).has_value();
+      }
+
+      timer.pause();
+      res = res && atlas.flush();
+      timer.resume();
+
+      return res;
+    });
+
+    // The repack and recording the copies, not the copies themselves.
+    harness.run("atlas/defragment", ATLAS_IMAGES / 2, 0, [&](BenchTimer &timer) {
+      timer.pause();
+      bool res = fill(true);
+      timer.resume();
+
+      res = res && atlas.defragment();
+
+      timer.pause();
+      res = res && atlas.flush();
+      timer.resume();
+
+      return res;
+    });
+
+    if (harness.selected("atlas/defragment") && fill(true)) {
+      AtlasStats before = atlas.stats();
+      if (atlas.defragment()) {
+        AtlasStats after = atlas.stats();
+        printf(
+          "atlas: %u images, %u pages at %.1f%% occupancy, %.1f%% fragmentation, "
+          "defragmented %u pages at %.1f%% occupancy, %.1f%% fragmentation\n",
+          before.entries,
+          before.pages,
+          before.occupancy() * 100.f,
+          before.fragmentation() * 100.f,
+          after.pages,
+          after.occupancy() * 100.f,
+          after.fragmentation() * 100.f
+        );
+      }
+    }
+  } else {
+    printf("Failed to set up the atlas benchmarks\n");
+  }
+
+  atlas.deinit();
+  for (SDL_Surface *surface : surfaces) {
+    SDL_DestroySurface(surface);
+  }
+}
+
+static void benchShaderCache(BenchHarness &harness, GPUContext &gpu) {
+  const Config &cfg = getConfig();
+  auto input = std::filesystem::path(cfg.shadersInputDir) / "screen.vert.hlsl";
+
+  // The warmup compiles it if needed, the repetitions only hit the cache.
+  harness.run("shader/cache hit", 1, 0, [&](BenchTimer &timer) {
+    SDL_GPUShader *shader = createShader(gpu.device, input, cfg.shadersOutputDir, {}, 0, 0);
+    if (shader == nullptr) {
+      return false;
+    }
+
+    timer.pause();
+    SDL_ReleaseGPUShader(gpu.device, shader);
+    timer.resume();
+
+    return true;
+  });
+}
+
+static void benchPass(BenchHarness &harness, GPUContext &gpu) {
+  if (!harness.selected("pass/")) {
+    return;
+  }
+
+  Renderer::RenderPass pass;
+  GPUBuffer indexBuffer;
+  GPUTexture texture;
+  SDL_GPUSampler *sampler = nullptr;
+
+  std::vector<Uint16> indices = { 0, 1, 2 };
+  SDL_GPUSamplerCreateInfo samplerInfo = {};
+  bool ok =
+    pass.init(gpu.device, gpu.window, {
+      .shaderName = "post",
+      .target = Renderer::PassTarget::OWN,
+      .targetW = PASS_TARGET_SIZE,
+      .targetH = PASS_TARGET_SIZE,
+      .targetFormat = SDL_PIXELFORMAT_RGBA32,
+      .numTextures = 1,
+    }) &&
+    gpu.upload(UploadBuffer<Uint16>{ indices, &indexBuffer, BufferType::INDEX }) &&
+    texture.init(gpu.device, 64, 64, SDL_PIXELFORMAT_RGBA32, TextureType::SAMPLER, "bench") &&
+    (sampler = SDL_CreateGPUSampler(gpu.device, &samplerInfo)) != nullptr;
+
+  // Records PASS_DRAWS draws into one pass, binding before each of them
+  // or only once. Submitting and waiting for the GPU isn't counted.
+  auto record = [&](BenchTimer &timer, bool bindEach) {
+    SDL_GPUCommandBuffer *cmdBuf = SDL_AcquireGPUCommandBuffer(gpu.device);
+    if (cmdBuf == nullptr) {
+      return false;
+    }
+
+    ShaderConstData data = {};
+    SDL_PushGPUVertexUniformData(cmdBuf, 0, &data, sizeof(data));
+    SDL_PushGPUFragmentUniformData(cmdBuf, 0, &data, sizeof(data));
+
+    if (!pass.begin(cmdBuf)) {
+      SDL_CancelGPUCommandBuffer(cmdBuf);
+      return false;
+    }
+    for (uint32_t i = 0; i < PASS_DRAWS; ++i) {
+      if (bindEach || i == 0) {
+        pass.bind({ texture.get() }, {}, {}, {}, indexBuffer.get(), sampler);
+      }
+      pass.exec(3, 1);
+    }
+    pass.end();
+
+    timer.pause();
+    SDL_GPUFence *fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdBuf);
+    bool res = fence != nullptr && SDL_WaitForGPUFences(gpu.device, true, &fence, 1);
+    if (fence != nullptr) {
+      SDL_ReleaseGPUFence(gpu.device, fence);
+    }
+    timer.resume();
+
+    return res;
+  };
+
+  if (ok) {
+    harness.run("pass/exec", PASS_DRAWS, 0, [&](BenchTimer &timer) {
+      return record(timer, false);
+    });
+    harness.run("pass/bind+exec", PASS_DRAWS, 0, [&](BenchTimer &timer) {
+      return record(timer, true);
+    });
+  } else {
+    printf("Failed to set up the pass benchmarks\n");
+  }
+
+  if (sampler != nullptr) {
+    SDL_ReleaseGPUSampler(gpu.device, sampler);
+  }
+  texture.deinit();
+  indexBuffer.deinit();
+  pass.deinit();
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printf("Usage: %s <config> [--reps N] [--warmup N] [--filter substring] [--json file]\n", argv[0]);
+    return 1;
+  }
+
+  std::string cfgPath = argv[1];
+  int reps = 50;
+  int warmup = 5;
+  std::string filter, jsonPath;
+  for (int i = 2; i + 1 < argc; i += 2) {
+    std::string_view arg = argv[i];
+    if (arg == "--reps") {
+      reps = std::atoi(argv[i + 1]);
+    } else if (arg == "--warmup") {
+      warmup = std::atoi(argv[i + 1]);
+    } else if (arg == "--filter") {
+      filter = argv[i + 1];
+    } else if (arg == "--json") {
+      jsonPath = argv[i + 1];
+    } else {
+      printf("Unknown argument %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  initConfig();
+  if (!getConfig().parse(cfgPath)) {
+    return 1;
+  }
+  initJobSystem(getConfig().workerCount);
+
+  SDL_CHECK_RET(SDL_Init(SDL_INIT_VIDEO), 1);
+
+  BenchHarness harness(warmup, reps, filter);
+  benchConfig(harness, cfgPath);
+  benchHud(harness);
+
+  std::string driver = "none";
+  {
+    GPUContext gpu;
+    if (gpu.init(getConfig())) {
+      driver = SDL_GetGPUDeviceDriver(gpu.device);
+      benchUploads(harness, gpu);
+      benchAtlas(harness, gpu);
+      benchShaderCache(harness, gpu);
+      benchPass(harness, gpu);
+    } else {
+      printf("No GPU, skipping the GPU benchmarks\n");
+    }
+  }
+
+  harness.print();
+
+  bool res = !harness.anyFailed();
+  if (!jsonPath.empty()) {
+    std::string context =
+      "{ \"gpu_driver\": \"" + driver + "\"" +
+      ", \"workers\": " + std::to_string(getJobSystem().numWorkers()) +
+      ", \"reps\": " + std::to_string(reps) +
+      ", \"warmup\": " + std::to_string(warmup) + " }";
+    res = harness.writeJson(jsonPath, context) && res;
+  }
+
+  deinitJobSystem();
+  SDL_Quit();
+  deinitConfig();
+
+  return res ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+// Compares recording a pass heavy frame on one thread against recording
+// it on the job system with CommandRecorder. Needs a GPU.
+//
+// Usage: parallel_recording <config> [passes] [draws per pass] [frames]
+
+#include "config/config.h"
+#include "defines.h"
+#include "jobs/job_system.h"
+#include "render/command_recorder.h"
+#include "render/gpu.h"
+#include "render/shader.h"
+#include "gpu_shared/cpu_gpu_shared.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <SDL3/SDL.h>
+
+static constexpr int TARGET_SIZE = 256;
+
+static SDL_GPUGraphicsPipeline *createPipeline(GPUContext &gpu) {
+  const Config &cfg = getConfig();
+  auto shadersInputDir = std::filesystem::path(cfg.shadersInputDir);
+
+  SDL_GPUShader *vertex = createShader(gpu.device, shadersInputDir / "screen.vert.hlsl", cfg.shadersOutputDir, {}, 0, 0);
+  SDL_GPUShader *fragment = createShader(gpu.device, shadersInputDir / "screen.frag.hlsl", cfg.shadersOutputDir, {}, 0, 0);
+  if (vertex == nullptr || fragment == nullptr) {
+    return nullptr;
+  }
+
+  SDL_GPUColorTargetDescription targetDesc = {
+    .format = GPUTexture::getGPUTextureFormat(SDL_PIXELFORMAT_RGBA32),
+  };
+  SDL_GPUGraphicsPipelineCreateInfo info = {
+    .vertex_shader = vertex,
+    .fragment_shader = fragment,
+    .primitive_type = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST,
+    .target_info = {
+      .color_target_descriptions = &targetDesc,
+      .num_color_targets = 1,
+    },
+  };
+  SDL_GPUGraphicsPipeline *pipeline = SDL_CreateGPUGraphicsPipeline(gpu.device, &info);
+
+  SDL_ReleaseGPUShader(gpu.device, vertex);
+  SDL_ReleaseGPUShader(gpu.device, fragment);
+
+  SDL_CHECK_RET(pipeline != nullptr, nullptr);
+
+  return pipeline;
+}
+
+// Average milliseconds to record and submit one frame
+static double measure(
+  GPUContext &gpu,
+  CommandRecorder &recorder,
+  SDL_GPUGraphicsPipeline *pipeline,
+  std::vector<GPUTexture> &targets,
+  int drawsPerPass,
+  int frames,
+  bool parallel
+) {
+  Uint64 total = 0;
+
+  for (int frame = 0; frame < frames; ++frame) {
+    for (size_t p = 0; p < targets.size(); ++p) {
+      recorder.add("pass" + std::to_string(p), [&, p](SDL_GPUCommandBuffer *cmdBuf) {
+        SDL_GPUColorTargetInfo colorTarget = {
+          .texture = targets[p].get(),
+          .load_op = SDL_GPU_LOADOP_CLEAR,
+          .store_op = SDL_GPU_STOREOP_STORE,
+        };
+        SDL_GPURenderPass *pass = nullptr;
+        SDL_CHECK((pass = SDL_BeginGPURenderPass(cmdBuf, &colorTarget, 1, nullptr)));
+        SDL_BindGPUGraphicsPipeline(pass, pipeline);
+
+        // New uniforms for every draw, like per object data would be.
+        ShaderConstData data = {};
+        for (int d = 0; d < drawsPerPass; ++d) {
+          data.time = float(d);
+          SDL_PushGPUVertexUniformData(cmdBuf, 0, &data, sizeof(data));
+          SDL_PushGPUFragmentUniformData(cmdBuf, 0, &data, sizeof(data));
+          SDL_DrawGPUPrimitives(pass, 3, 1, 0, 0);
+        }
+
+        SDL_EndGPURenderPass(pass);
+        return true;
+      });
+    }
+
+    Uint64 start = SDL_GetTicksNS();
+    if (!recorder.run(parallel)) {
+      return -1.;
+    }
+    total += SDL_GetTicksNS() - start;
+
+    // Don't let the GPU fall behind and throttle the CPU side.
+    auto fences = recorder.getFences();
+    SDL_WaitForGPUFences(gpu.device, true, fences.data(), static_cast<Uint32>(fences.size()));
+    for (SDL_GPUFence *fence : fences) {
+      SDL_ReleaseGPUFence(gpu.device, fence);
+    }
+  }
+
+  return double(total) / frames / SDL_NS_PER_MS;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printf("Usage: %s <config> [passes] [draws per pass] [frames]\n", argv[0]);
+    return 1;
+  }
+
+  int passes = argc > 2 ? std::atoi(argv[2]) : 16;
+  int drawsPerPass = argc > 3 ? std::atoi(argv[3]) : 2000;
+  int frames = argc > 4 ? std::atoi(argv[4]) : 100;
+
+  initConfig();
+  if (!getConfig().parse(argv[1])) {
+    return 1;
+  }
+  initJobSystem(getConfig().workerCount);
+
+  SDL_CHECK_RET(SDL_Init(SDL_INIT_VIDEO), 1);
+
+  int res = 1;
+  {
+    GPUContext gpu;
+    CommandRecorder recorder;
+    std::vector<GPUTexture> targets(passes);
+    SDL_GPUGraphicsPipeline *pipeline = nullptr;
+
+    if (gpu.init(getConfig()) && (pipeline = createPipeline(gpu)) != nullptr) {
+      bool ok = true;
+      for (int p = 0; p < passes && ok; ++p) {
+        ok = targets[p].init(
+          gpu.device,
+          TARGET_SIZE,
+          TARGET_SIZE,
+          SDL_PIXELFORMAT_RGBA32,
+          TextureType::TARGET,
+          "target" + std::to_string(p)
+        );
+      }
+      recorder.init(gpu.device);
+
+      if (ok) {
+        // Warm up the command buffer pools of all threads.
+        measure(gpu, recorder, pipeline, targets, drawsPerPass, 5, true);
+
+        double serialMs = measure(gpu, recorder, pipeline, targets, drawsPerPass, frames, false);
+        double parallelMs = measure(gpu, recorder, pipeline, targets, drawsPerPass, frames, true);
+
+        printf(
+          "%d passes x %d draws, %u workers\n",
+          passes,
+          drawsPerPass,
+          getJobSystem().numWorkers()
+        );
+        printf("serial:   %.3fms/frame\n", serialMs);
+        printf("parallel: %.3fms/frame (%.2fx)\n", parallelMs, serialMs / parallelMs);
+        res = 0;
+      }
+
+      SDL_ReleaseGPUGraphicsPipeline(gpu.device, pipeline);
+    }
+
+    for (auto &target : targets) {
+      target.deinit();
+    }
+  }
+
+  deinitJobSystem();
+  SDL_Quit();
+  deinitConfig();
+
+  return res;
+}
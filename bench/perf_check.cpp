@@ -0,0 +1,364 @@
+// Performance regression gate: runs the app on every scenario config in
+// <perf dir>/scenarios for a fixed number of frames (see PerfRun) and
+// compares the frame time percentiles, the startup time and the peak
+// memory with the baselines in <perf dir>/baselines. Fails if a metric
+// grew past its tolerance in <perf dir>/tolerances.cfg. Scenarios without
+// a baseline are skipped with a warning, but it fails if none could be
+// compared unless --allow-missing is given.
+// The baselines only mean something on the machine and the GPU driver
+// they were recorded on, so they are kept per reference driver in
+// <perf dir>/baselines/<name>, lavapipe by default - --update records
+// them from the current tree.
+// The perf-check target runs it headless with SDL_VIDEO_DRIVER=offscreen,
+// on lavapipe if PERF_CHECK_VK_ICD is set, see CMakeLists.txt.
+//
+// Usage: perf_check <app> <perf dir> [--frames N] [--filter substring]
+//   [--baselines name] [--update] [--allow-missing]
+
+#include "config/parser.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Lower is better for all of them
+static constexpr const char *METRICS[] = {
+  "startup_ms",
+  "frame_ms_avg",
+  "frame_ms_p50",
+  "frame_ms_p95",
+  "frame_ms_p99",
+  "frame_ms_max",
+  "peak_mb",
+};
+
+// As PerfRun::DEFAULT_FRAMES
+static constexpr uint32_t DEFAULT_FRAMES = 600;
+static constexpr const char *DEFAULT_BASELINES = "lavapipe";
+
+struct Tolerance {
+  // Of the baseline, e.g. 0.1 lets a metric grow by 10%
+  double relative = 0.;
+  // The metric has to grow by more than this too, so that tiny values
+  // don't fail on noise.
+  double absolute = 0.;
+};
+
+// "metric relative [absolute]" records, "scenario.metric ..." overrides
+// the metric's tolerance for one scenario.
+using Tolerances = std::map<std::string, Tolerance, std::less<>>;
+
+// The reports and the baselines are flat JSON objects of numbers and
+// strings, the values are kept as text.
+using Report = std::map<std::string, std::string, std::less<>>;
+
+static bool readText(const fs::path &path, std::string &text) {
+  std::ifstream ifs(path, std::ios::binary);
+  if (!ifs.is_open()) {
+    return false;
+  }
+
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  text = ss.str();
+  return true;
+}
+
+static bool readTolerances(const fs::path &path, Tolerances &tolerances) {
+  std::string text;
+  if (!readText(path, text)) {
+    printf("Failed to open %s\n", path.string().c_str());
+    return false;
+  }
+
+  size_t cursor = 0;
+  TextRecord record;
+  while (nextRecord(text, cursor, record)) {
+    Tolerance tolerance;
+    if (
+      !parseValue(record, tolerance.relative) ||
+      (record.numArgs > 1 && !parseArg(record.args[1], tolerance.absolute))
+    ) {
+      printf("PERF: invalid tolerance at %s:%zu\n", path.string().c_str(), lineOf(text, record.offset));
+      return false;
+    }
+    tolerances[std::string(record.key)] = tolerance;
+  }
+
+  return true;
+}
+
+static bool readReport(const fs::path &path, Report &report) {
+  std::string text;
+  if (!readText(path, text)) {
+    return false;
+  }
+
+  auto skipSpace = [&text](size_t &i) {
+    while (i < text.size() && std::strchr(" \t\r\n", text[i]) != nullptr) {
+      ++i;
+    }
+  };
+  auto readString = [&text](size_t &i, std::string &str) {
+    size_t end = text.find('"', i + 1);
+    if (end == std::string::npos) {
+      return false;
+    }
+    str = text.substr(i + 1, end - i - 1);
+    i = end + 1;
+    return true;
+  };
+
+  size_t i = text.find('{');
+  if (i == std::string::npos) {
+    return false;
+  }
+  ++i;
+
+  while (true) {
+    skipSpace(i);
+    if (i >= text.size()) {
+      return false;
+    }
+    if (text[i] == '}') {
+      return true;
+    }
+
+    std::string key, value;
+    if (text[i] != '"' || !readString(i, key)) {
+      return false;
+    }
+    skipSpace(i);
+    if (i >= text.size() || text[i] != ':') {
+      return false;
+    }
+    ++i;
+    skipSpace(i);
+
+    if (i < text.size() && text[i] == '"') {
+      if (!readString(i, value)) {
+        return false;
+      }
+    } else {
+      size_t end = text.find_first_of(",} \t\r\n", i);
+      if (end == std::string::npos) {
+        return false;
+      }
+      value = text.substr(i, end - i);
+      i = end;
+    }
+    report[key] = value;
+
+    skipSpace(i);
+    if (i < text.size() && text[i] == ',') {
+      ++i;
+    }
+  }
+}
+
+static std::string valueOf(const Report &report, std::string_view key) {
+  auto it = report.find(key);
+  return it != report.end() ? it->second : "?";
+}
+
+static const Tolerance *findTolerance(const Tolerances &tolerances, const std::string &scenario, const std::string &metric) {
+  if (auto it = tolerances.find(scenario + "." + metric); it != tolerances.end()) {
+    return &it->second;
+  }
+  if (auto it = tolerances.find(metric); it != tolerances.end()) {
+    return &it->second;
+  }
+  return nullptr;
+}
+
+// Prints a table of the metrics, returns how many regressed.
+static int compare(const std::string &scenario, const Report &baseline, const Report &current, const Tolerances &tolerances) {
+  printf(
+    "PERF: %s, %s frames on %s (baseline %s frames on %s)\n",
+    scenario.c_str(),
+    valueOf(current, "frames").c_str(),
+    valueOf(current, "gpu_driver").c_str(),
+    valueOf(baseline, "frames").c_str(),
+    valueOf(baseline, "gpu_driver").c_str()
+  );
+  if (valueOf(current, "frames") != valueOf(baseline, "frames") || valueOf(current, "gpu_driver") != valueOf(baseline, "gpu_driver")) {
+    printf("PERF:   the runs differ, the comparison is rough\n");
+  }
+  printf("PERF:   %-14s %12s %12s %9s %9s\n", "metric", "baseline", "current", "change", "limit");
+
+  int regressions = 0;
+  for (const char *metric : METRICS) {
+    auto base = baseline.find(metric);
+    auto curr = current.find(metric);
+    if (base == baseline.end() || curr == current.end()) {
+      printf("PERF:   %-14s missing\n", metric);
+      continue;
+    }
+
+    double baseVal = std::strtod(base->second.c_str(), nullptr);
+    double currVal = std::strtod(curr->second.c_str(), nullptr);
+    double change = baseVal > 0. ? (currVal - baseVal) / baseVal : 0.;
+
+    const Tolerance *tolerance = findTolerance(tolerances, scenario, metric);
+    const char *verdict = "";
+    char limit[16] = "-";
+    if (tolerance != nullptr) {
+      snprintf(limit, sizeof(limit), "%+.1f%%", tolerance->relative * 100.);
+
+      bool regressed = change > tolerance->relative && currVal - baseVal > tolerance->absolute;
+      bool improved = change < -tolerance->relative && baseVal - currVal > tolerance->absolute;
+      verdict = regressed ? "  REGRESSED" : improved ? "  improved" : "";
+      regressions += regressed ? 1 : 0;
+    }
+
+    printf(
+      "PERF:   %-14s %12.3f %12.3f %+8.1f%% %9s%s\n",
+      metric,
+      baseVal,
+      currVal,
+      change * 100.,
+      limit,
+      verdict
+    );
+  }
+
+  return regressions;
+}
+
+static std::string quote(const fs::path &path) {
+  return "\"" + path.string() + "\"";
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    printf(
+      "Usage: %s <app> <perf dir> [--frames N] [--filter substring] [--baselines name] [--update] [--allow-missing]\n",
+      argv[0]
+    );
+    return 1;
+  }
+
+  fs::path app = argv[1];
+  fs::path perfDir = argv[2];
+  uint32_t frames = DEFAULT_FRAMES;
+  std::string filter;
+  std::string baselines = DEFAULT_BASELINES;
+  bool update = false;
+  bool allowMissing = false;
+  for (int i = 3; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg == "--update") {
+      update = true;
+    } else if (arg == "--allow-missing") {
+      allowMissing = true;
+    } else if (arg == "--baselines" && i + 1 < argc) {
+      baselines = argv[++i];
+    } else if (arg == "--frames" && i + 1 < argc) {
+      frames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--filter" && i + 1 < argc) {
+      filter = argv[++i];
+    } else {
+      printf("Unknown argument %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  Tolerances tolerances;
+  if (!readTolerances(perfDir / "tolerances.cfg", tolerances)) {
+    return 1;
+  }
+
+  std::vector<fs::path> scenarios;
+  std::error_code ec;
+  for (const auto &entry : fs::directory_iterator(perfDir / "scenarios", ec)) {
+    std::string name = entry.path().stem().string();
+    if (entry.path().extension() == ".cfg" && (filter.empty() || name.find(filter) != std::string::npos)) {
+      scenarios.push_back(entry.path());
+    }
+  }
+  std::sort(scenarios.begin(), scenarios.end());
+  if (scenarios.empty()) {
+    printf("PERF: no scenarios in %s\n", (perfDir / "scenarios").string().c_str());
+    return 1;
+  }
+
+  fs::path baselineDir = perfDir / "baselines" / baselines;
+  if (update && !fs::create_directories(baselineDir, ec) && ec) {
+    printf("PERF: failed to create %s\n", baselineDir.string().c_str());
+    return 1;
+  }
+
+  int failed = 0;
+  int skipped = 0;
+  int compared = 0;
+  int regressions = 0;
+  for (const fs::path &scenario : scenarios) {
+    std::string name = scenario.stem().string();
+    fs::path reportPath = fs::temp_directory_path(ec) / ("perf_" + name + ".json");
+    fs::remove(reportPath, ec);
+
+    printf("PERF: running %s\n", name.c_str());
+    fflush(stdout);
+
+    std::string cmd =
+      quote(app) + " " + quote(scenario) +
+      " --perf " + quote(reportPath) +
+      " --frames " + std::to_string(frames);
+    Report current;
+    if (std::system(cmd.c_str()) != 0 || !readReport(reportPath, current)) {
+      printf("PERF: %s failed to run\n", name.c_str());
+      ++failed;
+      continue;
+    }
+
+    fs::path baselinePath = baselineDir / (name + ".json");
+    if (update) {
+      if (!fs::copy_file(reportPath, baselinePath, fs::copy_options::overwrite_existing, ec)) {
+        printf("PERF: failed to write %s\n", baselinePath.string().c_str());
+        ++failed;
+        continue;
+      }
+      printf("PERF: recorded %s\n", baselinePath.string().c_str());
+      continue;
+    }
+
+    Report baseline;
+    if (!readReport(baselinePath, baseline)) {
+      printf("PERF: warning: no baseline %s, skipped - record one with --update\n", baselinePath.string().c_str());
+      ++skipped;
+      continue;
+    }
+
+    int res = compare(name, baseline, current, tolerances);
+    ++compared;
+    regressions += res;
+    failed += res > 0 ? 1 : 0;
+  }
+
+  // A check that compared nothing would pass whatever the tree does.
+  if (!update && compared == 0 && failed == 0 && !allowMissing) {
+    printf(
+      "PERF: no %s baselines in %s to compare with, record them with --update or pass --allow-missing\n",
+      baselines.c_str(),
+      baselineDir.string().c_str()
+    );
+    return 1;
+  }
+
+  if (failed == 0) {
+    printf("PERF: %zu scenarios passed, %d skipped\n", scenarios.size() - skipped, skipped);
+    return 0;
+  }
+
+  printf("PERF: %d of %zu scenarios failed, %d skipped, %d metrics regressed\n", failed, scenarios.size(), skipped, regressions);
+  return 1;
+}
@@ -0,0 +1,214 @@
+// Parses a generated scene file the way Config::parse used to (getline,
+// a token vector per line and a chain of key compares) and with the
+// mapped parser, on one thread and in blocks on the job system, then
+// loads it into a GameState end to end.
+//
+// Usage: scene_parse <scene file> [MB]
+// The file is generated first unless it's already at least that large.
+
+#include "game_state.h"
+#include "jobs/job_system.h"
+#include "mapped_file.h"
+#include "scene.h"
+
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <SDL3/SDL.h>
+
+static constexpr size_t WRITE_BUFFER = 1 << 20;
+
+static bool generate(const std::string &path, size_t bytes) {
+  FILE *file = fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    printf("Failed to create %s\n", path.c_str());
+    return false;
+  }
+
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> pos(0.f, 16384.f);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  std::uniform_real_distribution<float> size(16.f, 128.f);
+  std::uniform_real_distribution<float> vel(-64.f, 64.f);
+
+  std::vector<char> buffer(WRITE_BUFFER + 256);
+  size_t used = 0;
+  size_t written = 0;
+  auto put = [&](std::string_view str) {
+    std::memcpy(buffer.data() + used, str.data(), str.size());
+    used += str.size();
+  };
+  auto num = [&](float value) {
+    auto res = std::to_chars(buffer.data() + used, buffer.data() + buffer.size(), value, std::chars_format::fixed, 2);
+    used = res.ptr - buffer.data();
+    buffer[used++] = ' ';
+  };
+
+  put("# generated by scene_parse\nworld_size 16384 16384\ncamera 0 0\n");
+  while (written + used < bytes) {
+    put("sprite ");
+    num(pos(rng));
+    num(pos(rng));
+    num(unit(rng));
+    num(size(rng));
+    num(size(rng));
+    num(vel(rng));
+    num(vel(rng));
+    char color[16];
+    snprintf(color, sizeof(color), "%08x\n", static_cast<uint32_t>(rng()) | 0xffu);
+    put(color);
+
+    if (used >= WRITE_BUFFER) {
+      written += fwrite(buffer.data(), 1, used, file);
+      used = 0;
+    }
+  }
+  written += fwrite(buffer.data(), 1, used, file);
+
+  return fclose(file) == 0 && written >= bytes;
+}
+
+// The old line parser, kept here as the baseline
+static size_t parseGetline(const std::string &path, SceneBlock &block) {
+  std::ifstream ifs(path);
+  std::string line;
+  size_t records = 0;
+  while (std::getline(ifs, line)) {
+    if (line.empty() || line.starts_with("#")) {
+      continue;
+    }
+
+    std::vector<std::string_view> toks;
+    std::string_view str = line;
+    size_t i = 0;
+    while (i < str.size()) {
+      size_t start = i;
+      while (i < str.size() && str[i] != ' ') {
+        ++i;
+      }
+      if (i > start) {
+        toks.push_back(str.substr(start, i - start));
+      }
+      while (i < str.size() && str[i] == ' ') {
+        ++i;
+      }
+    }
+    ++records;
+
+    TextRecord record;
+    record.key = toks[0];
+    record.numArgs = static_cast<uint32_t>(std::min<size_t>(toks.size() - 1, MAX_RECORD_ARGS));
+    std::copy_n(toks.begin() + 1, record.numArgs, record.args.begin());
+
+    glm::vec2 vec;
+    if (toks[0] == "world_size") {
+      parseValue(record, vec);
+      block.worldSize = vec;
+    } else if (toks[0] == "camera") {
+      parseValue(record, vec);
+      block.camera = vec;
+    } else if (toks[0] == "sprite") {
+      float v[7];
+      for (int a = 0; a < 7; ++a) {
+        std::from_chars(record.args[a].data(), record.args[a].data() + record.args[a].size(), v[a]);
+      }
+      block.positions.push_back({ { v[0], v[1] } });
+      block.depths.push_back({ v[2] });
+      block.sizes.push_back({ { v[3], v[4] } });
+      block.velocities.push_back({ { v[5], v[6] } });
+      uint32_t color = 0;
+      std::from_chars(record.args[7].data(), record.args[7].data() + record.args[7].size(), color, 16);
+      block.colors.push_back({ color });
+    }
+  }
+
+  return records;
+}
+
+static void report(const char *name, size_t bytes, uint64_t records, Uint64 ns) {
+  double s = double(ns) / SDL_NS_PER_SECOND;
+  printf(
+    "%-16s %8.1fms %8.1f MB/s %8.2f Mrecords/s\n",
+    name,
+    double(ns) / SDL_NS_PER_MS,
+    double(bytes) / (1024. * 1024.) / s,
+    double(records) / 1e6 / s
+  );
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printf("Usage: %s <scene file> [MB]\n", argv[0]);
+    return 1;
+  }
+
+  std::string path = argv[1];
+  size_t megabytes = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 500;
+  size_t bytes = megabytes * 1024 * 1024;
+
+  std::error_code ec;
+  if (std::filesystem::file_size(path, ec) < bytes || ec) {
+    printf("Generating %zuMB into %s\n", megabytes, path.c_str());
+    if (!generate(path, bytes)) {
+      return 1;
+    }
+  }
+
+  initJobSystem(0);
+
+  size_t fileBytes = std::filesystem::file_size(path);
+
+  // Warms the page cache for all of them
+  Uint64 start = SDL_GetTicksNS();
+  SceneBlock baseline;
+  size_t baselineRecords = parseGetline(path, baseline);
+  report("getline", fileBytes, baselineRecords, SDL_GetTicksNS() - start);
+
+  MappedFile file;
+  if (!file.open(path)) {
+    printf("Failed to map %s\n", path.c_str());
+    return 1;
+  }
+
+  std::vector<SceneBlock> blocks;
+  start = SDL_GetTicksNS();
+  ParseResult single = parseScene(file.text(), file.size(), blocks);
+  report("mapped", fileBytes, single.records, SDL_GetTicksNS() - start);
+
+  start = SDL_GetTicksNS();
+  ParseResult parallel = parseScene(file.text(), SCENE_BLOCK_BYTES, blocks);
+  report("mapped, blocks", fileBytes, parallel.records, SDL_GetTicksNS() - start);
+
+  GameState state;
+  start = SDL_GetTicksNS();
+  bool loaded = loadScene(path, state);
+  report("loadScene", fileBytes, parallel.records, SDL_GetTicksNS() - start);
+
+  printf(
+    "%zu blocks on %u workers, %zu sprites\n",
+    blocks.size(),
+    getJobSystem().numWorkers(),
+    state.world.size()
+  );
+
+  bool res = loaded &&
+    single.records == baselineRecords &&
+    parallel.records == baselineRecords &&
+    single.firstError == SIZE_MAX &&
+    parallel.firstError == SIZE_MAX &&
+    state.world.size() == baseline.positions.size();
+  if (!res) {
+    printf("The parsers disagree\n");
+  }
+
+  deinitJobSystem();
+
+  return res ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+// Measures SpatialGrid build and query cost from 10k to 2M agents at a
+// constant density, against brute force queries at the smaller sizes.
+//
+// Usage: spatial_grid [worker threads] [queries]
+
+#include "jobs/job_system.h"
+#include "sim/spatial_grid.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+static constexpr int REPEATS = 5;
+// Agents per cell on average
+static constexpr float DENSITY = 4.f;
+static constexpr float CELL_SIZE = 32.f;
+static constexpr float RADIUS = 32.f;
+static constexpr size_t K = 8;
+// Brute force is skipped above this
+static constexpr size_t MAX_BRUTE_FORCE = 100'000;
+
+template <class Fn>
+static double bestMs(Fn &&fn) {
+  double best = 1e30;
+  for (int r = 0; r < REPEATS; ++r) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+  }
+  return best;
+}
+
+int main(int argc, char **argv) {
+  uint32_t workers = 0;
+  size_t numQueries = 10'000;
+  if (argc > 1) workers = static_cast<uint32_t>(std::atoi(argv[1]));
+  if (argc > 2) numQueries = static_cast<size_t>(std::atoll(argv[2]));
+
+  initJobSystem(workers);
+  printf("%u threads, %zu queries, radius %.0f, k %zu\n", getJobSystem().numWorkers() + 1, numQueries, RADIUS, K);
+  printf(
+    "%8s %10s %14s %12s %14s %16s\n",
+    "agents", "build ms", "radius ns/q", "neighbors", "nearest ns/q", "brute ns/q"
+  );
+
+  std::mt19937 rng(42);
+  for (size_t count : { 10'000, 100'000, 500'000, 1'000'000, 2'000'000 }) {
+    float side = std::sqrt(count / DENSITY) * CELL_SIZE;
+    std::uniform_real_distribution<float> coord(0.f, side);
+
+    std::vector<glm::vec2> points(count);
+    for (glm::vec2 &p : points) {
+      p = { coord(rng), coord(rng) };
+    }
+    std::vector<glm::vec2> queries(numQueries);
+    for (glm::vec2 &q : queries) {
+      q = { coord(rng), coord(rng) };
+    }
+
+    SpatialGrid grid;
+    double buildMs = bestMs([&] {
+      grid.build(points.data(), count, { 0.f, 0.f }, { side, side }, CELL_SIZE);
+    });
+
+    size_t neighbors = 0;
+    double radiusMs = bestMs([&] {
+      neighbors = 0;
+      for (glm::vec2 q : queries) {
+        grid.forEachInRadius(q, RADIUS, [&](uint32_t, glm::vec2) { ++neighbors; });
+      }
+    });
+
+    std::vector<uint32_t> nearest;
+    double nearestMs = bestMs([&] {
+      for (glm::vec2 q : queries) {
+        grid.queryNearest(q, K, nearest);
+      }
+    });
+
+    double bruteNs = 0.;
+    if (count <= MAX_BRUTE_FORCE) {
+      size_t found = 0;
+      double bruteMs = bestMs([&] {
+        found = 0;
+        for (glm::vec2 q : queries) {
+          for (glm::vec2 p : points) {
+            glm::vec2 d = p - q;
+            found += glm::dot(d, d) <= RADIUS * RADIUS;
+          }
+        }
+      });
+      bruteNs = bruteMs * 1e6 / numQueries;
+      // Keeps the loop from being optimized out
+      if (found == 0) {
+        bruteNs = -1.;
+      }
+    }
+
+    printf(
+      "%8zu %10.3f %14.1f %12.2f %14.1f %16.1f\n",
+      count,
+      buildMs,
+      radiusMs * 1e6 / numQueries,
+      double(neighbors) / numQueries,
+      nearestMs * 1e6 / numQueries,
+      bruteNs
+    );
+  }
+
+  deinitJobSystem();
+
+  return 0;
+}
@@ -0,0 +1,137 @@
+// Streams chunks around a focus that sweeps over a large world, without
+// drawing them, and reports the streamer's load latency, evictions,
+// cancellations and hitches. Every frame also sleeps for a fixed time
+// standing in for the rest of the frame. Needs a GPU for the uploads.
+//
+// Usage: world_streaming <config> [frames] [speed in pixels per frame]
+
+#include "config/config.h"
+#include "defines.h"
+#include "jobs/job_system.h"
+#include "render/gpu.h"
+#include "render/world_streamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include <SDL3/SDL.h>
+
+// The rest of a frame
+static constexpr Uint64 FRAME_NS = 4 * SDL_NS_PER_MS;
+// Used if the config doesn't enable streaming
+static constexpr float DEFAULT_CHUNK_SIZE = 512.f;
+static constexpr float WORLD_CHUNKS = 256.f;
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printf("Usage: %s <config> [frames] [speed]\n", argv[0]);
+    return 1;
+  }
+
+  int frames = argc > 2 ? std::atoi(argv[2]) : 1000;
+  float speed = argc > 3 ? float(std::atof(argv[3])) : 64.f;
+
+  initConfig();
+  if (!getConfig().parse(argv[1])) {
+    return 1;
+  }
+  const Config &cfg = getConfig();
+  initJobSystem(cfg.workerCount);
+
+  SDL_CHECK_RET(SDL_Init(SDL_INIT_VIDEO), 1);
+
+  float chunkSize = cfg.streamChunkSize > 0 ? float(cfg.streamChunkSize) : DEFAULT_CHUNK_SIZE;
+  StreamParams params = {
+    .chunkSize = chunkSize,
+    .worldSize = glm::vec2(chunkSize * WORLD_CHUNKS),
+    .spritesPerChunk = cfg.streamSpritesPerChunk,
+    .seed = cfg.worldSeed,
+    .radius = cfg.streamRadius,
+    .memoryBytes = uint64_t(cfg.streamMemoryMB) * 1024 * 1024,
+    .maxLoads = cfg.streamMaxLoads,
+    .maxUploads = cfg.streamUploadsPerFrame,
+    .framesInFlight = 1,
+  };
+
+  int res = 1;
+  {
+    GPUContext gpu;
+    WorldStreamer streamer;
+    if (gpu.init(cfg) && streamer.init(&gpu, params)) {
+      res = 0;
+
+      // A circle around the middle of the world, so the focus keeps
+      // coming back to chunks that may still be cached.
+      glm::vec2 center = params.worldSize * 0.5f;
+      float circleRadius = params.worldSize.x * 0.25f;
+      StreamStats total;
+      double latencyMs = 0.;
+      uint32_t maxResident = 0;
+
+      Uint64 start = SDL_GetTicksNS();
+      for (int i = 0; i < frames; ++i) {
+        float angle = i * speed / circleRadius;
+        glm::vec2 focus = center + circleRadius * glm::vec2(std::cos(angle), std::sin(angle));
+        if (!streamer.update(focus)) {
+          res = 1;
+          break;
+        }
+        SDL_DelayNS(FRAME_NS);
+
+        // Fold the stats over the run
+        if (i % 100 == 99 || i == frames - 1) {
+          StreamStats stats = streamer.collectStats();
+          latencyMs += stats.avgLatencyMs * stats.loaded;
+          maxResident = std::max(maxResident, stats.resident);
+          total.loaded += stats.loaded;
+          total.evicted += stats.evicted;
+          total.cancelled += stats.cancelled;
+          total.frames += stats.frames;
+          total.hitchFrames += stats.hitchFrames;
+          total.uploadHitchFrames += stats.uploadHitchFrames;
+          total.maxLatencyMs = std::max(total.maxLatencyMs, stats.maxLatencyMs);
+          total.maxUpdateMs = std::max(total.maxUpdateMs, stats.maxUpdateMs);
+        }
+      }
+      double elapsedMs = double(SDL_GetTicksNS() - start) / SDL_NS_PER_MS;
+
+      printf(
+        "%d frames in %.1fms, %.0fpx chunks of %u sprites, radius %.1f, cap %uMB, %u workers\n",
+        frames,
+        elapsedMs,
+        chunkSize,
+        params.spritesPerChunk,
+        params.radius,
+        cfg.streamMemoryMB,
+        getJobSystem().numWorkers()
+      );
+      printf(
+        "chunks: %" SDL_PRIu64 " loaded %" SDL_PRIu64 " evicted %" SDL_PRIu64 " cancelled, at most %u resident\n",
+        total.loaded,
+        total.evicted,
+        total.cancelled,
+        maxResident
+      );
+      printf(
+        "latency: avg %.3fms max %.3fms, update max %.3fms\n",
+        total.loaded > 0 ? latencyMs / total.loaded : 0.,
+        total.maxLatencyMs,
+        total.maxUpdateMs
+      );
+      printf(
+        "hitches: %" SDL_PRIu64 "/%" SDL_PRIu64 " frames, %" SDL_PRIu64 " while uploading\n",
+        total.hitchFrames,
+        total.frames,
+        total.uploadHitchFrames
+      );
+    }
+  }
+
+  deinitJobSystem();
+  SDL_Quit();
+  deinitConfig();
+
+  return res;
+}
@@ -4,25 +4,81 @@
 
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
 #define uint uint32_t
 #define uint2 glm::uvec2
+#define float4 glm::vec4
 #define float3 glm::vec3
 #define float2 glm::vec2
 
 #endif
 
+#define CULL_GROUP_SIZE 64
+// Threads per side of a field step group
+#define FIELD_GROUP_SIZE 8
+
 struct ShaderConstData {
   float2 windowSize;
+  // Top-left corner of the view in world pixels
+  float2 viewPos;
   float time;
   float delta;
+  // Interpolation factor between the previous and the current tick
+  float alpha;
+};
+
+struct SpriteInstance {
+  // xy - center in pixels, z - depth in [0, 1], 0 is nearest
+  float3 pos;
+  // RGBA8, R in the lowest byte
+  uint color;
+  float2 size;
+  // xy at the previous tick, interpolated towards pos.xy
+  float2 prevPos;
+};
+
+struct CullConstData {
+  // Inward facing planes - ax + by + cz + d >= 0 is inside
+  float4 planes[6];
+  uint count;
+  float alpha;
+  uint _pad0;
+  uint _pad1;
+  uint _pad2;
+};
+
+// Gray-Scott reaction-diffusion, see sim/field.h
+struct FieldConstData {
+  // Cells per row and column
+  uint2 size;
+  float feed;
+  float kill;
+  float diffuseU;
+  float diffuseV;
+  // Per step
+  float dt;
+  uint _pad0;
+};
 
-  uint debug;
+// A glyph or a solid rectangle of the perf HUD, see render/perf_hud.h
+struct HudQuad {
+  // Top-left corner and size in pixels
+  float2 pos;
+  float2 size;
+  // (u0, v0, u1, v1) rectangle in the font texture
+  float4 uv;
+  // RGBA8, R in the lowest byte
+  uint color;
+  uint _pad0;
+  uint _pad1;
+  uint _pad2;
 };
 
 #ifndef __HLSL__
 
 #undef uint
 #undef uint2
+#undef float4
 #undef float2
 #undef float3
 
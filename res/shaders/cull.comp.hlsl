@@ -0,0 +1,62 @@
+#include "gpu_shared/cpu_gpu_shared.h"
+
+StructuredBuffer<SpriteInstance> sprites : register(t0, space0);
+
+RWStructuredBuffer<SpriteInstance> visible : register(u0, space1);
+// SDL_GPUIndexedIndirectDrawCommand, [1] is num_instances
+RWStructuredBuffer<uint> drawArgs : register(u1, space1);
+
+ConstantBuffer<CullConstData> cullData : register(b0, space2);
+
+groupshared uint scan[CULL_GROUP_SIZE];
+groupshared uint groupBase;
+
+bool isVisible(SpriteInstance sprite) {
+  float3 extents = float3(sprite.size * 0.5f, 0.f);
+  float3 pos = float3(lerp(sprite.prevPos, sprite.pos.xy, cullData.alpha), sprite.pos.z);
+
+  for (uint i = 0; i < 6; ++i) {
+    float4 plane = cullData.planes[i];
+    float radius = dot(extents, abs(plane.xyz));
+    if (dot(plane.xyz, pos) + plane.w + radius < 0.f) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+[numthreads(CULL_GROUP_SIZE, 1, 1)]
+void main(uint3 id : SV_DispatchThreadID, uint3 localId : SV_GroupThreadID) {
+  uint idx = id.x;
+  uint lid = localId.x;
+
+  bool vis = false;
+  SpriteInstance sprite = (SpriteInstance)0;
+  if (idx < cullData.count) {
+    sprite = sprites[idx];
+    vis = isVisible(sprite);
+  }
+
+  // Inclusive scan of the visibility so the group keeps its instances
+  // in their original (front-to-back) order.
+  scan[lid] = vis ? 1 : 0;
+  GroupMemoryBarrierWithGroupSync();
+
+  for (uint offset = 1; offset < CULL_GROUP_SIZE; offset <<= 1) {
+    uint val = lid >= offset ? scan[lid - offset] : 0;
+    GroupMemoryBarrierWithGroupSync();
+    scan[lid] += val;
+    GroupMemoryBarrierWithGroupSync();
+  }
+
+  // One atomic per group to reserve its range in the visible list
+  if (lid == CULL_GROUP_SIZE - 1) {
+    InterlockedAdd(drawArgs[1], scan[lid], groupBase);
+  }
+  GroupMemoryBarrierWithGroupSync();
+
+  if (vis) {
+    visible[groupBase + scan[lid] - 1] = sprite;
+  }
+}
@@ -0,0 +1,36 @@
+#include "gpu_shared/cpu_gpu_shared.h"
+
+// One reaction-diffusion step from cells to next.
+// MUST match Field::step on the CPU.
+
+StructuredBuffer<float2> cells : register(t0, space0);
+
+RWStructuredBuffer<float2> next : register(u0, space1);
+
+ConstantBuffer<FieldConstData> field : register(b0, space2);
+
+float2 cellAt(int2 p) {
+  // Wraps around the edges
+  uint2 q = uint2((p + int2(field.size)) % int2(field.size));
+  return cells[q.y * field.size.x + q.x];
+}
+
+[numthreads(FIELD_GROUP_SIZE, FIELD_GROUP_SIZE, 1)]
+void main(uint3 id : SV_DispatchThreadID) {
+  if (id.x >= field.size.x || id.y >= field.size.y) {
+    return;
+  }
+
+  int2 p = int2(id.xy);
+  float2 c = cellAt(p);
+  float2 lap = cellAt(p + int2(-1, 0)) + cellAt(p + int2(1, 0)) +
+    cellAt(p + int2(0, -1)) + cellAt(p + int2(0, 1)) - 4.f * c;
+
+  float uvv = c.x * c.y * c.y;
+  float2 d = float2(
+    field.diffuseU * lap.x - uvv + field.feed * (1.f - c.x),
+    field.diffuseV * lap.y + uvv - (field.feed + field.kill) * c.y
+  );
+
+  next[id.y * field.size.x + id.x] = saturate(c + d * field.dt);
+}
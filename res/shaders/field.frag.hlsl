@@ -0,0 +1,25 @@
+#include "gpu_shared/cpu_gpu_shared.h"
+
+// Draws the simulation buffer straight, stretched over the target.
+
+StructuredBuffer<float2> cells : register(t0, space2);
+
+ConstantBuffer<FieldConstData> field : register(b0, space3);
+
+struct PSInput {
+  float2 uv : TEXCOORD0;
+};
+
+float4 main(PSInput IN) : SV_TARGET {
+  uint2 p = min(uint2(IN.uv * float2(field.size)), field.size - 1);
+  float v = cells[p.y * field.size.x + p.x].y;
+
+  // Dark blue where there is no V, through teal to white
+  float3 low = float3(0.02f, 0.03f, 0.12f);
+  float3 mid = float3(0.1f, 0.6f, 0.7f);
+  float3 high = float3(1.f, 1.f, 1.f);
+  float t = saturate(v * 3.f);
+  float3 color = t < 0.5f ? lerp(low, mid, t * 2.f) : lerp(mid, high, t * 2.f - 1.f);
+
+  return float4(color, 1.f);
+}
@@ -0,0 +1 @@
+#include "shaders/screen_tri.hlsli"
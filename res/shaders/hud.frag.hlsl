@@ -0,0 +1,17 @@
+#include "gpu_shared/cpu_gpu_shared.h"
+
+Texture2D<float4> font : register(t0, space2);
+SamplerState pointSampler : register(s0, space2);
+
+struct PSInput {
+  float2 uv : TEXCOORD0;
+  float4 color : TEXCOORD1;
+};
+
+float4 main(PSInput IN) : SV_TARGET {
+  // The font is white, only its alpha matters
+  float4 color = float4(IN.color.rgb, IN.color.a * font.Sample(pointSampler, IN.uv).a);
+
+  // Swizzled like post2, it's drawn over its output
+  return color.bgra;
+}
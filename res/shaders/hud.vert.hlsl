@@ -0,0 +1,31 @@
+#include "gpu_shared/cpu_gpu_shared.h"
+
+StructuredBuffer<HudQuad> quads : register(t0, space0);
+ConstantBuffer<ShaderConstData> renderData : register(b0, space1);
+
+struct VSOutput {
+	float2 uv : TEXCOORD0;
+	float4 color : TEXCOORD1;
+	float4 position : SV_Position;
+};
+
+// Expects the quad index buffer - 0 1 2 2 1 3
+VSOutput main(in uint vertID : SV_VertexID, in uint instID : SV_InstanceID) {
+	HudQuad quad = quads[instID];
+
+	float2 corner = float2(vertID & 1, (vertID >> 1) & 1);
+	float2 pixel = quad.pos + corner * quad.size;
+	float2 ndc = pixel / renderData.windowSize * 2.f - 1.f;
+
+	VSOutput result;
+	result.uv = lerp(quad.uv.xy, quad.uv.zw, corner);
+	result.color = float4(
+		quad.color & 0xff,
+		(quad.color >> 8) & 0xff,
+		(quad.color >> 16) & 0xff,
+		(quad.color >> 24) & 0xff
+	) / 255.f;
+	result.position = float4(ndc.x, -ndc.y, 0.f, 1.f);
+
+	return result;
+}
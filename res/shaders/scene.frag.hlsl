@@ -0,0 +1,30 @@
+#include "gpu_shared/cpu_gpu_shared.h"
+
+// Variants:
+//   DEPTH_ONLY - pre-pass, there is no color target bound.
+//   OVERDRAW   - blended additively, so every shaded fragment adds one
+//                to R (the exact count read back by the renderer) and
+//                the G channel saturates after 16 layers for the heatmap.
+
+#if defined(DEPTH_ONLY)
+
+void main() {
+}
+
+#elif defined(OVERDRAW)
+
+float4 main() : SV_TARGET {
+  return float4(1.f, 16.f, 0.f, 1.f) / 255.f;
+}
+
+#else
+
+struct PSInput {
+  float4 color : TEXCOORD0;
+};
+
+float4 main(PSInput IN) : SV_TARGET {
+  return IN.color;
+}
+
+#endif
@@ -0,0 +1 @@
+#include "shaders/sprite.hlsli"
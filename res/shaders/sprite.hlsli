@@ -0,0 +1,39 @@
+#include "gpu_shared/cpu_gpu_shared.h"
+
+StructuredBuffer<SpriteInstance> sprites : register(t0, space0);
+ConstantBuffer<ShaderConstData> renderData : register(b0, space1);
+
+// DEPTH_ONLY and OVERDRAW variants don't need the color.
+#if !defined(DEPTH_ONLY) && !defined(OVERDRAW)
+#define SPRITE_COLOR
+#endif
+
+struct VSOutput {
+#ifdef SPRITE_COLOR
+	float4 color : TEXCOORD0;
+#endif
+	float4 position : SV_Position;
+};
+
+// Expects the quad index buffer - 0 1 2 2 1 3
+VSOutput main(in uint vertID : SV_VertexID, in uint instID : SV_InstanceID) {
+	SpriteInstance sprite = sprites[instID];
+
+	float2 pos = lerp(sprite.prevPos, sprite.pos.xy, renderData.alpha);
+	float2 corner = float2(vertID & 1, (vertID >> 1) & 1) - 0.5f;
+	float2 pixel = pos - renderData.viewPos + corner * sprite.size;
+	float2 ndc = pixel / renderData.windowSize * 2.f - 1.f;
+
+	VSOutput result;
+#ifdef SPRITE_COLOR
+	result.color = float4(
+		sprite.color & 0xff,
+		(sprite.color >> 8) & 0xff,
+		(sprite.color >> 16) & 0xff,
+		(sprite.color >> 24) & 0xff
+	) / 255.f;
+#endif
+	result.position = float4(ndc.x, -ndc.y, sprite.pos.z, 1.f);
+
+	return result;
+}
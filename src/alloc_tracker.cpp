@@ -0,0 +1,369 @@
+#include "alloc_tracker.h"
+
+#include "log.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+#ifdef TRACK_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(__linux__) || defined(__APPLE__)
+#define ALLOC_SITES 1
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#endif
+
+namespace {
+
+constexpr int MAX_SCOPES = 64;
+constexpr size_t MAX_SITES = 4096;
+constexpr int STACK_DEPTH = 8;
+// operator new, the rest of the tracker is inlined into it
+constexpr int SKIP_FRAMES = 1;
+
+#ifdef __GNUC__
+#define ALLOC_INLINE [[gnu::always_inline]] inline
+#else
+#define ALLOC_INLINE inline
+#endif
+
+struct ScopeSlot {
+  std::atomic<const char*> name = nullptr;
+  std::atomic<uint64_t> count = 0;
+  std::atomic<uint64_t> bytes = 0;
+};
+
+struct SiteSlot {
+  // Hash of the stack, zero while the slot is free
+  std::atomic<uint64_t> key = 0;
+  // Set once frames are written
+  std::atomic<bool> ready = false;
+  void *frames[STACK_DEPTH] = {};
+  int depth = 0;
+  std::atomic<uint64_t> count = 0;
+  std::atomic<uint64_t> bytes = 0;
+};
+
+std::atomic<uint64_t> totalCount = 0;
+std::atomic<uint64_t> totalBytes = 0;
+
+ScopeSlot scopes[MAX_SCOPES];
+SiteSlot sites[MAX_SITES];
+
+thread_local AllocCounts threadCounts;
+thread_local int currentScope = -1;
+thread_local bool captureSites = false;
+// Set while the tracker itself allocates
+thread_local bool inTracker = false;
+
+#ifdef ALLOC_SITES
+
+ALLOC_INLINE void recordSite(size_t size) {
+  void *frames[STACK_DEPTH + SKIP_FRAMES];
+  int depth = backtrace(frames, STACK_DEPTH + SKIP_FRAMES) - SKIP_FRAMES;
+  if (depth <= 0) {
+    return;
+  }
+
+  // FNV-1a over the return addresses
+  uint64_t key = 14695981039346656037ull;
+  for (int i = 0; i < depth; ++i) {
+    key = (key ^ reinterpret_cast<uintptr_t>(frames[SKIP_FRAMES + i])) * 1099511628211ull;
+  }
+  key = key != 0 ? key : 1;
+
+  for (size_t i = 0; i < MAX_SITES; ++i) {
+    SiteSlot &slot = sites[(key + i) % MAX_SITES];
+
+    uint64_t expected = 0;
+    if (slot.key.compare_exchange_strong(expected, key, std::memory_order_acq_rel)) {
+      std::copy_n(frames + SKIP_FRAMES, depth, slot.frames);
+      slot.depth = depth;
+      slot.ready.store(true, std::memory_order_release);
+    } else if (expected != key) {
+      continue;
+    }
+
+    slot.count.fetch_add(1, std::memory_order_relaxed);
+    slot.bytes.fetch_add(size, std::memory_order_relaxed);
+    return;
+  }
+}
+
+std::string symbolize(void *address) {
+  Dl_info info;
+  if (dladdr(address, &info) == 0 || info.dli_sname == nullptr) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%p", address);
+    return buf;
+  }
+
+  int status = 0;
+  char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+  std::string res = status == 0 && demangled != nullptr ? demangled : info.dli_sname;
+  std::free(demangled);
+
+  char offset[32];
+  snprintf(offset, sizeof(offset), "+0x%zx", size_t(static_cast<char*>(address) - static_cast<char*>(info.dli_saddr)));
+  return res + offset;
+}
+
+#endif // ALLOC_SITES
+
+ALLOC_INLINE void count(size_t size) {
+  totalCount.fetch_add(1, std::memory_order_relaxed);
+  totalBytes.fetch_add(size, std::memory_order_relaxed);
+  ++threadCounts.count;
+  threadCounts.bytes += size;
+
+  if (currentScope >= 0) {
+    scopes[currentScope].count.fetch_add(1, std::memory_order_relaxed);
+    scopes[currentScope].bytes.fetch_add(size, std::memory_order_relaxed);
+  }
+
+#ifdef ALLOC_SITES
+  if (captureSites && !inTracker) {
+    inTracker = true;
+    recordSite(size);
+    inTracker = false;
+  }
+#endif
+}
+
+ALLOC_INLINE void *allocate(size_t size, bool nothrow) {
+  count(size);
+
+  void *ptr = std::malloc(size > 0 ? size : 1);
+  if (ptr == nullptr && !nothrow) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+ALLOC_INLINE void *allocateAligned(size_t size, std::align_val_t align, bool nothrow) {
+  count(size);
+
+  auto alignment = static_cast<size_t>(align);
+#ifdef _WIN32
+  void *ptr = _aligned_malloc(size > 0 ? size : 1, alignment);
+#else
+  // aligned_alloc wants a multiple of the alignment
+  void *ptr = std::aligned_alloc(alignment, std::max((size + alignment - 1) / alignment, size_t(1)) * alignment);
+#endif
+  if (ptr == nullptr && !nothrow) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void freeAligned(void *ptr) {
+#ifdef _WIN32
+  _aligned_free(ptr);
+#else
+  std::free(ptr);
+#endif
+}
+
+}
+
+void *operator new(size_t size) { return allocate(size, false); }
+void *operator new[](size_t size) { return allocate(size, false); }
+void *operator new(size_t size, const std::nothrow_t&) noexcept { return allocate(size, true); }
+void *operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate(size, true); }
+void *operator new(size_t size, std::align_val_t align) { return allocateAligned(size, align, false); }
+void *operator new[](size_t size, std::align_val_t align) { return allocateAligned(size, align, false); }
+void *operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return allocateAligned(size, align, true); }
+void *operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return allocateAligned(size, align, true); }
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept { freeAligned(ptr); }
+void operator delete[](void *ptr, std::align_val_t) noexcept { freeAligned(ptr); }
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept { freeAligned(ptr); }
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept { freeAligned(ptr); }
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t&) noexcept { freeAligned(ptr); }
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t&) noexcept { freeAligned(ptr); }
+
+AllocScope::AllocScope(const char *name) : prev(currentScope) {
+  for (int i = 0; i < MAX_SCOPES; ++i) {
+    const char *expected = nullptr;
+    if (
+      scopes[i].name.compare_exchange_strong(expected, name, std::memory_order_acq_rel) ||
+      expected == name
+    ) {
+      currentScope = i;
+      return;
+    }
+  }
+
+  // Out of slots, the allocations stay with the enclosing scope.
+}
+
+AllocScope::~AllocScope() {
+  currentScope = prev;
+}
+
+AllocCounts getThreadAllocs() {
+  return threadCounts;
+}
+
+AllocCounts getTotalAllocs() {
+  return { totalCount.load(std::memory_order_relaxed), totalBytes.load(std::memory_order_relaxed) };
+}
+
+std::vector<std::pair<const char*, AllocCounts>> collectAllocScopes() {
+  std::vector<std::pair<const char*, AllocCounts>> res;
+  for (ScopeSlot &scope : scopes) {
+    const char *name = scope.name.load(std::memory_order_acquire);
+    if (name == nullptr) {
+      break;
+    }
+
+    res.push_back({ name, {
+      scope.count.exchange(0, std::memory_order_relaxed),
+      scope.bytes.exchange(0, std::memory_order_relaxed),
+    }});
+  }
+
+  return res;
+}
+
+void setAllocSiteCapture(bool enabled) {
+  captureSites = enabled;
+}
+
+std::vector<AllocSite> collectAllocSites(size_t max) {
+  std::vector<AllocSite> res;
+  inTracker = true;
+
+#ifdef ALLOC_SITES
+  struct Counted {
+    SiteSlot *slot;
+    AllocCounts counts;
+  };
+  std::vector<Counted> counted;
+  for (SiteSlot &slot : sites) {
+    if (!slot.ready.load(std::memory_order_acquire)) {
+      continue;
+    }
+
+    AllocCounts counts = {
+      slot.count.exchange(0, std::memory_order_relaxed),
+      slot.bytes.exchange(0, std::memory_order_relaxed),
+    };
+    if (counts.count > 0) {
+      counted.push_back({ &slot, counts });
+    }
+  }
+
+  std::sort(counted.begin(), counted.end(), [](const Counted &a, const Counted &b) {
+    return a.counts.count > b.counts.count;
+  });
+  counted.resize(std::min(counted.size(), max));
+
+  for (const Counted &site : counted) {
+    AllocSite &out = res.emplace_back();
+    out.counts = site.counts;
+    for (int i = 0; i < site.slot->depth; ++i) {
+      out.frames.push_back(symbolize(site.slot->frames[i]));
+    }
+  }
+#endif
+
+  inTracker = false;
+  return res;
+}
+
+#endif // TRACK_ALLOCATIONS
+
+// Sites printed when a frame allocates after the warmup
+static constexpr size_t TOP_SITES = 8;
+
+void FrameAllocs::init(uint32_t checkAfter) {
+  this->checkAfter = checkAfter;
+  frame = 0;
+  mainThread = {};
+  allStart = getTotalAllocs();
+  frames = 0;
+  framesAllocating = 0;
+
+  setAllocSiteCapture(false);
+}
+
+void FrameAllocs::beginFrame() {
+  // Only the steady state's call stacks are of interest
+  if (checkAfter > 0 && frame == checkAfter) {
+    collectAllocSites(0);
+    setAllocSiteCapture(true);
+  }
+
+  frameStart = getThreadAllocs();
+}
+
+bool FrameAllocs::endFrame() {
+  AllocCounts allocs = getThreadAllocs() - frameStart;
+  mainThread.count += allocs.count;
+  mainThread.bytes += allocs.bytes;
+  ++frames;
+  framesAllocating += allocs.count > 0 ? 1 : 0;
+
+  uint64_t index = frame++;
+  if (checkAfter == 0 || index < checkAfter || allocs.count == 0) {
+    return true;
+  }
+
+  LOG_ERROR(
+    "ALLOC: frame %" PRIu64 " allocated %" PRIu64 " times (%" PRIu64 " bytes) after a warmup of %u frames\n",
+    index,
+    allocs.count,
+    allocs.bytes,
+    checkAfter
+  );
+  for (const AllocSite &site : collectAllocSites(TOP_SITES)) {
+    LOG_ERROR("ALLOC: %" PRIu64 " times (%" PRIu64 " bytes) at\n", site.counts.count, site.counts.bytes);
+    for (const std::string &fn : site.frames) {
+      LOG_ERROR("ALLOC:   %s\n", fn.c_str());
+    }
+  }
+
+  return false;
+}
+
+void FrameAllocs::report() {
+  if (!ALLOC_TRACKING || frames == 0) {
+    return;
+  }
+
+  AllocCounts total = getTotalAllocs();
+  AllocCounts all = total - allStart;
+  allStart = total;
+
+  LOG_INFO(
+    "ALLOC: main %.1f (%.1fKB) per frame, %" PRIu64 "/%" PRIu64 " frames allocating, all threads %.1f (%.1fKB) per frame\n",
+    double(mainThread.count) / frames,
+    double(mainThread.bytes) / 1024. / frames,
+    framesAllocating,
+    frames,
+    double(all.count) / frames,
+    double(all.bytes) / 1024. / frames
+  );
+  for (const auto &[name, counts] : collectAllocScopes()) {
+    if (counts.count > 0) {
+      LOG_INFO("ALLOC: scope %s %.1f (%.1fKB) per frame\n", name, double(counts.count) / frames, double(counts.bytes) / 1024. / frames);
+    }
+  }
+
+  mainThread = {};
+  frames = 0;
+  framesAllocating = 0;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Heap allocation counting, for finding what allocates in a frame. Only
+// builds with TRACK_ALLOCATIONS (see the CMake option) replace the global
+// operator new and delete, the others count nothing and everything here
+// does nothing. Allocations that don't go through operator new, e.g.
+// SDL's and the drivers', aren't seen.
+
+struct AllocCounts {
+  uint64_t count = 0;
+  uint64_t bytes = 0;
+
+  AllocCounts operator-(const AllocCounts &other) const {
+    return { count - other.count, bytes - other.bytes };
+  }
+};
+
+struct AllocSite {
+  // Symbolized call stack, innermost first
+  std::vector<std::string> frames;
+  AllocCounts counts;
+};
+
+#ifdef TRACK_ALLOCATIONS
+
+inline constexpr bool ALLOC_TRACKING = true;
+
+// Attributes the calling thread's allocations to name while alive.
+// name must outlive the program, i.e. be a literal.
+class AllocScope {
+private:
+  int prev;
+
+public:
+  explicit AllocScope(const char *name);
+  ~AllocScope();
+
+  AllocScope(const AllocScope&) = delete;
+  AllocScope &operator=(const AllocScope&) = delete;
+};
+
+#define ALLOC_SCOPE_CONCAT_(a, b) a##b
+#define ALLOC_SCOPE_CONCAT(a, b) ALLOC_SCOPE_CONCAT_(a, b)
+#define ALLOC_SCOPE(name) AllocScope ALLOC_SCOPE_CONCAT(allocScope, __LINE__)(name)
+
+// Since the start, of the calling thread and of all of them
+AllocCounts getThreadAllocs();
+AllocCounts getTotalAllocs();
+
+// Counts of every scope since the last call
+std::vector<std::pair<const char*, AllocCounts>> collectAllocScopes();
+
+// Capturing the call stacks is slow, so it's off until enabled.
+void setAllocSiteCapture(bool enabled);
+// The sites with the most allocations since the last call, at most max
+std::vector<AllocSite> collectAllocSites(size_t max);
+
+#else
+
+inline constexpr bool ALLOC_TRACKING = false;
+
+#define ALLOC_SCOPE(name)
+
+inline AllocCounts getThreadAllocs() { return {}; }
+inline AllocCounts getTotalAllocs() { return {}; }
+inline std::vector<std::pair<const char*, AllocCounts>> collectAllocScopes() { return {}; }
+inline void setAllocSiteCapture(bool) {}
+inline std::vector<AllocSite> collectAllocSites(size_t) { return {}; }
+
+#endif // TRACK_ALLOCATIONS
+
+// Counts the allocations the main thread makes per frame and checks that
+// there are none once the app has warmed up, see Config::allocCheckAfter.
+class FrameAllocs {
+private:
+  uint32_t checkAfter = 0;
+  uint64_t frame = 0;
+  AllocCounts frameStart;
+
+  // Since the last report
+  AllocCounts mainThread;
+  AllocCounts allStart;
+  uint64_t frames = 0;
+  uint64_t framesAllocating = 0;
+
+public:
+  // Zero checkAfter disables the check.
+  void init(uint32_t checkAfter);
+
+  void beginFrame();
+  // Returns false if the frame allocated after the warmup, the top
+  // allocation sites are printed then.
+  bool endFrame();
+
+  // Prints the averages and the scopes since the last call
+  void report();
+};
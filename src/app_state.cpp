@@ -1,21 +1,72 @@
 #include "app_state.h"
 
 #include "defines.h"
+#include "jobs/job_system.h"
 #include "gpu_shared/cpu_gpu_shared.h"
 
+#include <cstdlib>
+
 SDL_AppResult AppState::init(int argc, char **argv) {
   deinit();
 
+  Uint64 startNS = SDL_GetTicksNS();
+
   if (argc < 2) {
-    printf("Invalid number of cmd args!\n");
+    LOG_ERROR("Invalid number of cmd args!\n");
     return SDL_APP_FAILURE;
   }
 
   std::string cfgPath = argv[1];
   if (!getConfig().parse(cfgPath)) {
-    printf("Failed to initialize config!\n");
+    LOG_ERROR("Failed to initialize config!\n");
+    return SDL_APP_FAILURE;
+  }
+  setLogLevel(getConfig().logLevel);
+
+  std::string recordPath, replayPath, restoreDir, perfPath;
+  uint32_t perfFrames = PerfRun::DEFAULT_FRAMES;
+  for (int i = 2; i < argc; i += 2) {
+    std::string_view arg = argv[i];
+    if (i + 1 == argc) {
+      LOG_ERROR("Missing value for argument %s\n", argv[i]);
+      return SDL_APP_FAILURE;
+    }
+
+    if (arg == "--record") {
+      recordPath = argv[i + 1];
+    } else if (arg == "--replay") {
+      replayPath = argv[i + 1];
+    } else if (arg == "--timings") {
+      timingsPath = argv[i + 1];
+    } else if (arg == "--restore") {
+      restoreDir = argv[i + 1];
+    } else if (arg == "--perf") {
+      perfPath = argv[i + 1];
+    } else if (arg == "--frames") {
+      perfFrames = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+    } else {
+      LOG_ERROR("Unknown argument %s\n", argv[i]);
+      return SDL_APP_FAILURE;
+    }
+  }
+
+  if (!replayPath.empty() && !replay.init(replayPath)) {
     return SDL_APP_FAILURE;
   }
+  if (!recordPath.empty() && !recorder.init(recordPath)) {
+    return SDL_APP_FAILURE;
+  }
+  if (!perfPath.empty()) {
+    if (replay.replaying()) {
+      LOG_ERROR("--perf and --replay can't be combined!\n");
+      return SDL_APP_FAILURE;
+    }
+    if (!perfRun.init(perfPath, perfFrames, startNS)) {
+      return SDL_APP_FAILURE;
+    }
+  }
+
+  initJobSystem(getConfig().workerCount);
 
   SDL_CHECK_APP(SDL_SetAppMetadata(PROJECT_NAME, "1.0.0", PROJECT_NAME));
 
@@ -29,9 +80,45 @@ SDL_AppResult AppState::init(int argc, char **argv) {
     return SDL_APP_FAILURE;
   }
 
-  gameState.generate(getConfig());
+  // Replays run as fast as possible, not at the display's rate.
+  if (fixedWorkload()) {
+    for (auto mode : { SDL_GPU_PRESENTMODE_IMMEDIATE, SDL_GPU_PRESENTMODE_MAILBOX }) {
+      if (SDL_WindowSupportsGPUPresentMode(gpuCtx.device, gpuCtx.window, mode)) {
+        SDL_CHECK_APP(SDL_SetGPUSwapchainParameters(gpuCtx.device, gpuCtx.window, SDL_GPU_SWAPCHAINCOMPOSITION_SDR, mode));
+        break;
+      }
+    }
+  }
 
-  lastStep = SDL_GetTicks();
+  if (restoreDir.empty()) {
+    gameState.generate(getConfig());
+  } else if (!loadSnapshot(restoreDir, getConfig(), gameState)) {
+    return SDL_APP_FAILURE;
+  }
+  renderData.init(gpuCtx, gameState);
+
+  if (fixedWorkload()) {
+    simThread.startLockstep(&gameState, getConfig().tickRate);
+  } else {
+    if (!snapshotWriter.init(getConfig().snapshotDir, getConfig().snapshotInterval)) {
+      return SDL_APP_FAILURE;
+    }
+    simThread.setSnapshotWriter(&snapshotWriter);
+    if (!simThread.start(&gameState, getConfig().tickRate)) {
+      return SDL_APP_FAILURE;
+    }
+  }
+
+  frameLimiter.init(fixedWorkload() ? 0 : getConfig().frameRateLimit);
+  getJobSystem().setActiveWorkers(getConfig().workerCount);
+
+  if (getConfig().configHotReload && !configReloader.start(cfgPath)) {
+    return SDL_APP_FAILURE;
+  }
+
+  frameAllocs.init(getConfig().allocCheckAfter);
+
+  lastStep = SDL_GetTicksNS();
 
   return SDL_APP_CONTINUE;
 }
@@ -39,19 +126,127 @@ SDL_AppResult AppState::init(int argc, char **argv) {
 void AppState::deinit() {
   DEBUG_PRINT("DEINIT: %s\n", "AppState");
 
+  configReloader.stop();
+  simThread.stop();
+  snapshotWriter.deinit();
+  recorder.deinit();
+
   renderData.deinit();
 
   renderer.deinit();
 
   gpuCtx.deinit();
 
+  deinitJobSystem();
+
   SDL_Quit();
 }
 
-bool AppState::update() {
-  gameState.update(dt);
+SDL_AppResult AppState::handleEvent(const SDL_Event &event) {
+  switch (event.type) {
+  case SDL_EVENT_QUIT:
+    DEBUG_PRINT("SDL_EVENT_QUIT\n");
+    return SDL_APP_SUCCESS;
+
+  case SDL_EVENT_KEY_DOWN:
+    if (event.key.key == SDLK_F3 && !event.key.repeat) {
+      renderer.toggleHud();
+    }
+    break;
+
+  default:
+    break;
+  }
 
-  return true;
+  return SDL_APP_CONTINUE;
+}
+
+SDL_AppResult AppState::applyConfigChanges() {
+  if (!configReloader.enabled() || configReloader.apply(frameIndex).empty()) {
+    return SDL_APP_CONTINUE;
+  }
+
+  const Config &cfg = getConfig();
+
+  setLogLevel(cfg.logLevel);
+
+  if (!fixedWorkload()) {
+    frameLimiter.init(cfg.frameRateLimit);
+  }
+
+  uint32_t workers = getJobSystem().setActiveWorkers(cfg.workerCount);
+  if (cfg.workerCount > workers) {
+    LOG_WARN("CFG: only %u workers were started, the rest needs a restart\n", workers);
+  }
+
+  if (!renderer.applyConfig(cfg)) {
+    return SDL_APP_FAILURE;
+  }
+
+  return SDL_APP_CONTINUE;
+}
+
+SDL_AppResult AppState::update() {
+  SimThread::Frame frame;
+
+  if (replay.replaying()) {
+    replayEvents.clear();
+    auto logged = replay.next(replayEvents);
+    for (const SDL_Event &event : replayEvents) {
+      if (auto res = handleEvent(event); res != SDL_APP_CONTINUE) {
+        logged = std::nullopt;
+        break;
+      }
+    }
+    if (!logged.has_value()) {
+      replay.report(timingsPath);
+      return SDL_APP_SUCCESS;
+    }
+
+    currentFrame = *logged;
+    frame = simThread.stepTo(currentFrame.tick, currentFrame.alpha);
+  } else if (perfRun.running()) {
+    auto tick = perfRun.next();
+    if (!tick.has_value()) {
+      return perfRun.report(SDL_GetGPUDeviceDriver(gpuCtx.device)) ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+    }
+
+    currentFrame = {
+      .tick = *tick,
+      .alpha = 0.f,
+      .dtNS = SDL_NS_PER_SECOND / getConfig().tickRate,
+    };
+    frame = simThread.stepTo(currentFrame.tick, currentFrame.alpha);
+  } else {
+    frame = simThread.acquire();
+    currentFrame.tick = frame.curr->tick;
+    currentFrame.alpha = frame.alpha;
+  }
+
+  if (frame.fresh) {
+    renderData.update(frame.prev->state, frame.curr->state);
+  }
+  renderData.setAlpha(frame.alpha);
+
+  return SDL_APP_CONTINUE;
+}
+
+Uint64 AppState::finishFrame(Uint64 frameNS) {
+  if (replay.replaying()) {
+    replay.addFrameTime(double(frameNS) / SDL_NS_PER_MS);
+    return currentFrame.dtNS;
+  }
+  if (perfRun.running()) {
+    perfRun.addFrameTime(double(frameNS) / SDL_NS_PER_MS);
+    return currentFrame.dtNS;
+  }
+
+  if (recorder.recording()) {
+    currentFrame.dtNS = frameNS;
+    recorder.frame(currentFrame);
+  }
+
+  return frameNS;
 }
 
 ShaderConstData AppState::getShaderConstData() {
@@ -59,14 +254,10 @@ ShaderConstData AppState::getShaderConstData() {
 
   return ShaderConstData {
     .windowSize = windowSz,
+    .viewPos = renderData.viewPos,
     .time = static_cast<float>(elapsedTime),
     .delta = static_cast<float>(dt),
-
-#ifdef __DEBUG
-    .debug = true,
-#else
-    .debug = false,
-#endif // __DEBUG
+    .alpha = renderData.alpha,
   };
 }
 
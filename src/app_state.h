@@ -1,7 +1,14 @@
 #pragma once
 
+#include "alloc_tracker.h"
+#include "frame_limiter.h"
 #include "game_state.h"
+#include "perf_run.h"
+#include "replay.h"
+#include "snapshot.h"
+#include "sim_thread.h"
 #include "config/config.h"
+#include "config/config_reload.h"
 #include "gpu_shared/cpu_gpu_shared.h"
 #include "render/gpu.h"
 #include "render/renderer.h"
@@ -13,13 +20,35 @@ struct AppState {
   Renderer renderer;
   RenderData renderData;
 
+  // Owned by simThread once the app is initialized.
   GameState gameState;
+  SimThread simThread;
+  SnapshotWriter snapshotWriter;
+
+  FrameLimiter frameLimiter;
+  ConfigReloader configReloader;
+  FrameAllocs frameAllocs;
+
+  // --restore <dir> starts from the newest snapshot in dir
+  // --record <file> / --replay <file> [--timings <csv>]
+  InputRecorder recorder;
+  InputReplay replay;
+  std::string timingsPath;
+  // The replayed frame's events, kept so the vector isn't reallocated
+  // every frame.
+  std::vector<SDL_Event> replayEvents;
+  // --perf <report.json> [--frames N]
+  PerfRun perfRun;
+  // Tick and alpha of the frame being drawn, and its dt once it's done
+  ReplayFrame currentFrame;
 
   double dt = 0;
   double elapsedTime = 0;
   Uint64 lastStep = 0;
   Uint64 frameCount = 0;
   Uint64 measurementTime = 0;
+  // Frames since the start
+  Uint64 frameIndex = 0;
 
   ~AppState() {
     deinit();
@@ -28,7 +57,20 @@ struct AppState {
   SDL_AppResult init(int argc, char **argv);
   void deinit();
 
-  bool update();
+  SDL_AppResult handleEvent(const SDL_Event &event);
+
+  // Applies the config file's changes if it's watched, between frames.
+  SDL_AppResult applyConfigChanges();
+
+  // Replays and perf runs step the simulation in lockstep and draw as
+  // fast as they can.
+  bool fixedWorkload() const { return replay.replaying() || perfRun.running(); }
+
+  // Picks the simulation state to draw, from the sim thread, the replay
+  // or the perf run.
+  SDL_AppResult update();
+  // Records or replays the frame's duration, returns the one to use as dt.
+  Uint64 finishFrame(Uint64 frameNS);
 
   ShaderConstData getShaderConstData();
 };
@@ -1,197 +1,141 @@
 #include "config.h"
 
 #include "defines.h"
+#include "mapped_file.h"
+#include "parser.h"
 
 #include "magic_enum/magic_enum.hpp"
 
-#include <charconv>
+#include <cinttypes>
 #include <filesystem>
-#include <fstream>
+#include <mutex>
+#include <type_traits>
 
-using Tokens = std::vector<std::string_view>;
+namespace {
 
-Tokens tokenize(std::string_view str) {
-  Tokens result;
-
-  size_t start = 0;
-  size_t i = 0;
-  while (i < str.size()) {
-    while (i < str.size() && str[i] != ' ' && str[i] != '\n') {
-      ++i;
-    }
-
-    if (i - start > 0)
-      result.push_back(str.substr(start, i - start));
-
-    while (i < str.size() && (str[i] == ' ' || str[i] == '\n')) {
-      ++i;
-    }
-    start = i;
-  }
-  if (i - start > 0)
-    result.push_back(str.substr(start, i - start));
-
-  return result;
+template <auto Member>
+bool parseField(Config &cfg, const TextRecord &record) {
+  return parseValue(record, cfg.*Member);
 }
 
-#define PARSE_COMMON(sz) \
-do { \
-  if (toks[0] != name) return false; \
-  assert(toks.size() >= (sz)); \
-} while (false)
-
-template <class T>
-bool parseNumericImpl(Tokens &toks, int off, T &val) {
-#if defined(__APPLE__) && defined(__clang__)
-    // Apple clang does not support from_chars for float...
-    char *str_end = nullptr;
-    T val_ = std::strtof(toks[off].data(), &str_end);
-    if (val_ == 0 && str_end == toks[off].data()) {
-      return false;
-    }
-    if (val_ == HUGE_VALF) {
-      return false;
-    }
-
-    val = val_;
-    return true;
-#else
-  T val_;
-  std::from_chars_result res;
-  res = std::from_chars(
-    toks[off].data(),
-    toks[off].data() + toks[off].size(),
-    val_
-  );
-
-  if (res.ec != std::errc()) {
+// Relative to the config's directory
+template <auto Member>
+bool parsePath(Config &cfg, const TextRecord &record) {
+  if (record.numArgs < 1) {
     return false;
   }
 
-  val = val_;
+  cfg.*Member = (cfg.dir / record.args[0]).string();
   return true;
-#endif
 }
 
-template <class T>
-bool parseNumeric(Tokens &toks, std::string_view name, T &val) {
-  PARSE_COMMON(2);
-  return parseNumericImpl(toks, 1, val);
-}
-
-bool parseStringImpl(Tokens &toks, int off, std::string &val) {
-  val = toks[1];
-  return true;
-}
-
-bool parseString(Tokens &toks, std::string_view name, std::string &val) {
-  PARSE_COMMON(2);
-  return parseStringImpl(toks, 1, val);
-}
+constexpr auto CONFIG_SCHEMA = makeSchema<Config>({
+  { "window_width", parseField<&Config::windowW> },
+  { "window_height", parseField<&Config::windowH> },
+  { "shader_input", parsePath<&Config::shadersInputDir> },
+  { "shader_output", parsePath<&Config::shadersOutputDir> },
+  { "shader_hot_reload", parseField<&Config::shaderHotReload> },
+  { "depth_prepass", parseField<&Config::depthPrepass> },
+  { "sort_opaque", parseField<&Config::sortOpaque> },
+  { "overdraw_debug", parseField<&Config::overdrawDebug> },
+  { "gpu_culling", parseField<&Config::gpuCulling> },
+  { "worker_count", parseField<&Config::workerCount> },
+  { "tick_rate", parseField<&Config::tickRate> },
+  { "parallel_recording", parseField<&Config::parallelRecording> },
+  { "frame_rate_limit", parseField<&Config::frameRateLimit> },
+  { "frames_in_flight", parseField<&Config::framesInFlight> },
+  { "config_hot_reload", parseField<&Config::configHotReload> },
+  { "alloc_check_after", parseField<&Config::allocCheckAfter> },
+  { "perf_hud", parseField<&Config::perfHud> },
+  { "log_level", parseField<&Config::logLevel> },
+  { "sprite_count", parseField<&Config::spriteCount> },
+  { "world_size", parseField<&Config::worldSize> },
+  { "world_seed", parseField<&Config::worldSeed> },
+  { "world_cache", parsePath<&Config::worldCacheDir> },
+  { "scene_file", parsePath<&Config::sceneFile> },
+  { "snapshot_dir", parsePath<&Config::snapshotDir> },
+  { "snapshot_interval", parseField<&Config::snapshotInterval> },
+  { "field_size", parseField<&Config::fieldSize> },
+  { "field_backend", parseField<&Config::fieldBackend> },
+  { "field_steps_per_tick", parseField<&Config::fieldStepsPerTick> },
+  { "stream_chunk_size", parseField<&Config::streamChunkSize> },
+  { "stream_sprites_per_chunk", parseField<&Config::streamSpritesPerChunk> },
+  { "stream_radius", parseField<&Config::streamRadius> },
+  { "stream_memory_mb", parseField<&Config::streamMemoryMB> },
+  { "stream_max_loads", parseField<&Config::streamMaxLoads> },
+  { "stream_uploads_per_frame", parseField<&Config::streamUploadsPerFrame> },
+  { "vec2i", parseField<&Config::vec2i> },
+  { "vec3i", parseField<&Config::vec3i> },
+  { "vec2f", parseField<&Config::vec2f> },
+  { "vec3f", parseField<&Config::vec3f> },
+  { "str", parseField<&Config::str> },
+  { "e", parseField<&Config::e> },
+});
+
+struct HotKnob {
+  std::string_view key;
+  // Returns whether the value differed
+  bool (*apply)(Config &dst, const Config &src, ConfigChange &change);
+};
 
 template <class T>
-bool parseEnumImpl(Tokens &toks, int off, T &val) {
-  auto val_opt = magic_enum::enum_cast<T>(toks[off]);
-  if (!val_opt) {
-    return false;
+std::string knobString(const T &val) {
+  if constexpr (std::is_enum_v<T>) {
+    return std::string(magic_enum::enum_name(val));
+  } else {
+    return std::to_string(val);
   }
-
-  val = *val_opt;
-  return true;
 }
 
-template <class T>
-bool parseEnum(Tokens &toks, std::string_view name, T &val) {
-  PARSE_COMMON(2);
-  return parseEnumImpl(toks, 1, val);
-}
-
-template <int N, class T>
-requires AnyOfConcept<T, int, float>
-bool parseVecImpl(Tokens &toks, int off, glm::vec<N, T> &res) {
-  glm::vec<N, T> res_;
-
-  for (int i = 0; i < N; ++i) {
-    if (!parseNumericImpl(toks, off + i, res_[i])) {
-      return false;
-    }
+template <auto Member>
+bool applyKnob(Config &dst, const Config &src, ConfigChange &change) {
+  if (dst.*Member == src.*Member) {
+    return false;
   }
 
-  res = res_;
+  change.from = knobString(dst.*Member);
+  change.to = knobString(src.*Member);
+  dst.*Member = src.*Member;
   return true;
 }
 
-template <int N, class T>
-requires AnyOfConcept<T, int, float>
-bool parseVec(Tokens &toks, std::string_view name, glm::vec<N, T> &res) {
-  PARSE_COMMON(1 + N);
-  return parseVecImpl(toks, 1, res);
-}
+// Whatever is read every frame or can be changed between frames.
+// The rest needs a restart.
+constexpr HotKnob HOT_KNOBS[] = {
+  { "frame_rate_limit", applyKnob<&Config::frameRateLimit> },
+  { "frames_in_flight", applyKnob<&Config::framesInFlight> },
+  { "worker_count", applyKnob<&Config::workerCount> },
+  { "parallel_recording", applyKnob<&Config::parallelRecording> },
+  { "perf_hud", applyKnob<&Config::perfHud> },
+  { "log_level", applyKnob<&Config::logLevel> },
+  { "sort_opaque", applyKnob<&Config::sortOpaque> },
+  { "stream_max_loads", applyKnob<&Config::streamMaxLoads> },
+  { "stream_uploads_per_frame", applyKnob<&Config::streamUploadsPerFrame> },
+};
 
-const auto& parseVec2i = parseVec<2, int>;
-const auto& parseVec3i = parseVec<3, int>;
-const auto& parseVec2f = parseVec<2, float>;
-const auto& parseVec3f = parseVec<3, float>;
+}
 
 bool Config::parse(std::string_view path) {
   std::filesystem::path cfgPath(path);
 
-  std::ifstream ifs(cfgPath.c_str());
-  if (!ifs.is_open()) {
-    fprintf(stderr, "Failed to open config %s\n", path.data());
+  MappedFile file;
+  if (!file.open(cfgPath.string())) {
+    LOG_ERROR("Failed to open config %s\n", path.data());
     return false;
   }
 
-  auto cfgDir = cfgPath.parent_path();
-  dir = cfgDir;
-
-  std::string line;
-  while (std::getline(ifs, line)) {
-    if (line.empty()) {
-      continue;
-    }
-    if (line.starts_with("#")) {
-      continue;
-    }
-    auto p = tokenize(line);
-    // for (auto tok : p) printf("\"%s\" ", std::string{tok}.c_str());
-    // printf("\n");
-
-    if (parseNumeric(p, "window_width", windowW)) {
-      continue;
-    }
-    if (parseNumeric(p, "window_height", windowH)) {
-      continue;
-    }
-    if (parseVec2i(p, "vec2i", vec2i)) {
-      continue;
-    }
-    if (parseVec3i(p, "vec3i", vec3i)) {
-      continue;
-    }
-    if (parseVec2f(p, "vec2f", vec2f)) {
-      continue;
-    }
-    if (parseVec3f(p, "vec3f", vec3f)) {
-      continue;
-    }
-    if (p[0] == "shader_input") {
-      assert(p.size() >= 2);
-      shadersInputDir = cfgDir / p[1];
-      continue;
-    }
-    if (p[0] == "shader_output") {
-      assert(p.size() >= 2);
-      shadersOutputDir = cfgDir / p[1];
-      continue;
-    }
-
-    if (parseString(p, "str", str)) {
-      continue;
-    }
-    if (parseEnum(p, "e", e)) {
-      continue;
-    }
+  // The paths are relative to it
+  dir = cfgPath.parent_path();
+
+  ParseResult res = parseRecords(file.text(), CONFIG_SCHEMA, *this);
+  if (res.firstError != SIZE_MAX) {
+    LOG_WARN(
+      "CFG: skipped %" PRIu64 " unknown and %" PRIu64 " invalid entries, the first at %s:%zu\n",
+      res.unknown,
+      res.invalid,
+      cfgPath.string().c_str(),
+      lineOf(file.text(), res.firstError)
+    );
   }
 
   DEBUG_PRINT(
@@ -207,11 +151,22 @@ bool Config::parse(std::string_view path) {
   return true;
 }
 
-Config *cfg = nullptr;
+void applyHotKnobs(Config &dst, const Config &src, std::vector<ConfigChange> &changes) {
+  for (const HotKnob &knob : HOT_KNOBS) {
+    ConfigChange change = { .key = knob.key };
+    if (knob.apply(dst, src, change)) {
+      changes.push_back(std::move(change));
+    }
+  }
+}
+
+// Only written by the main thread, the others read it under the mutex
+std::shared_ptr<Config> cfg;
+std::mutex cfgMutex;
 
 void initConfig() {
   deinitConfig();
-  cfg = new Config;
+  setConfig(std::make_shared<Config>());
 }
 
 Config &getConfig() {
@@ -219,7 +174,17 @@ Config &getConfig() {
   return *cfg;
 }
 
+std::shared_ptr<const Config> getConfigSnapshot() {
+  std::lock_guard lock(cfgMutex);
+  assert(cfg != nullptr);
+  return cfg;
+}
+
+void setConfig(std::shared_ptr<Config> next) {
+  std::lock_guard lock(cfgMutex);
+  cfg = std::move(next);
+}
+
 void deinitConfig() {
-  if (cfg == nullptr) return;
-  delete cfg;
+  setConfig(nullptr);
 }
@@ -1,8 +1,12 @@
 #pragma once
 
+#include "log.h"
+
 #include <filesystem>
+#include <memory>
 #include <optional>
 #include <string>
+#include <vector>
 
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
@@ -12,12 +16,90 @@ enum class EnumType {
   SND,
 };
 
+// Where the reaction-diffusion field is simulated, see sim/field.h
+enum class FieldBackend {
+  // On the job system as part of GameState::update. Slow, but it is
+  // the reference the GPU is validated against.
+  CPU,
+  // In a compute shader by the renderer, the state never leaves the GPU.
+  GPU,
+};
+
 struct Config {
   std::filesystem::path dir;
   std::string shadersInputDir;
   std::string shadersOutputDir;
   uint windowW, windowH;
 
+  // Recompile shaders and swap their pipelines when their sources change.
+  bool shaderHotReload = false;
+
+  // Render the opaque sprites' depth before shading them.
+  bool depthPrepass = false;
+  // Sort opaque sprites front-to-back so early-Z rejects hidden ones.
+  bool sortOpaque = true;
+  // Replace the scene with an overdraw heatmap and report shaded layers.
+  bool overdrawDebug = false;
+  // Cull sprites in a compute shader and draw them indirectly.
+  bool gpuCulling = false;
+  // Job system worker threads. Zero means one per core but the main one.
+  uint workerCount = 0;
+  // Fixed simulation ticks per second.
+  uint tickRate = 60;
+  // Record the render passes on the job system.
+  bool parallelRecording = false;
+  // Cap on rendered frames per second. Zero means uncapped.
+  uint frameRateLimit = 0;
+  // Frames the CPU may record ahead of the GPU, 1 up to
+  // Renderer::FRAMES_IN_FLIGHT. Fewer means less latency.
+  uint framesInFlight = 2;
+  // Watch this file and apply the hot-reloadable settings to the
+  // running app, see config/config_reload.h
+  bool configHotReload = false;
+  // Fail on the first frame after this many that allocates on the main
+  // thread, printing where it did. Zero disables the check. Only builds
+  // with TRACK_ALLOCATIONS count allocations, see alloc_tracker.h
+  uint allocCheckAfter = 0;
+  // Overlay with the frame times and the renderer's counters, F3
+  // toggles it too.
+  bool perfHud = false;
+  // Messages below it aren't logged. The ones below LOG_MIN_LEVEL are
+  // compiled out, see log.h
+  LogLevel logLevel = static_cast<LogLevel>(LOG_MIN_LEVEL);
+  // Number of demo sprites generated by GameState.
+  uint spriteCount = 0;
+  // Size of the area the sprites are spread over. Zero means the window.
+  glm::ivec2 worldSize = { 0, 0 };
+  // Seed of the sprite generation
+  uint worldSeed = 1;
+  // Generated worlds are cached here and loaded on the next run with
+  // the same parameters. Empty means no cache.
+  std::string worldCacheDir;
+  // Sprites are loaded from this scene file instead of being generated,
+  // see scene.h. Empty means none.
+  std::string sceneFile;
+  // Checkpoints of the GameState are written here, see snapshot.h
+  std::string snapshotDir;
+  // Ticks between checkpoints. Zero means none.
+  uint snapshotInterval = 0;
+  // Cells of the reaction-diffusion field drawn behind the sprites.
+  // Zero means no field.
+  glm::ivec2 fieldSize = { 0, 0 };
+  FieldBackend fieldBackend = FieldBackend::GPU;
+  // Field steps per simulation tick
+  uint fieldStepsPerTick = 4;
+  // Side of the world chunks whose scenery is streamed in around the
+  // view, see render/world_streamer.h. Zero means no streaming.
+  uint streamChunkSize = 0;
+  uint streamSpritesPerChunk = 1024;
+  // In chunks, from the center of the view
+  float streamRadius = 4.f;
+  // Cap on the resident chunks' render data
+  uint streamMemoryMB = 64;
+  // Chunks generated at a time and uploaded per frame
+  uint streamMaxLoads = 4;
+  uint streamUploadsPerFrame = 2;
+
   glm::ivec2 vec2i;
   glm::ivec3 vec3i;
   glm::vec2 vec2f;
@@ -26,8 +108,36 @@ struct Config {
   EnumType e;
 
   bool parse(std::string_view path);
+
+  // Shaders include files relative to the parent of shader_input, e.g.
+  // "shaders/sprite.hlsli" and "gpu_shared/cpu_gpu_shared.h", wherever
+  // the config file is.
+  std::filesystem::path shadersIncludeDir() const {
+    auto input = std::filesystem::path(shadersInputDir).lexically_normal();
+    if (!input.has_filename()) {
+      input = input.parent_path();
+    }
+    return input.has_parent_path() ? input.parent_path() : ".";
+  }
+
+  bool operator==(const Config&) const = default;
 };
 
+struct ConfigChange {
+  std::string_view key;
+  std::string from;
+  std::string to;
+};
+
+// Copies the settings that can change while the app runs from src into
+// dst, adding the ones that differed to changes.
+void applyHotKnobs(Config &dst, const Config &src, std::vector<ConfigChange> &changes);
+
+// The config of the current frame. Only the main thread may use it,
+// the others take a snapshot as it may be replaced between frames.
 Config &getConfig();
+std::shared_ptr<const Config> getConfigSnapshot();
+// Replaces the current config, only between frames on the main thread.
+void setConfig(std::shared_ptr<Config> cfg);
 void initConfig();
 void deinitConfig();
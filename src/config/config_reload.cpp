@@ -0,0 +1,77 @@
+#include "config_reload.h"
+
+#include "defines.h"
+
+bool ConfigReloader::start(const std::string &path) {
+  stop();
+
+  this->path = std::filesystem::absolute(path);
+
+  // Editors save by writing a new file and renaming it over the old one,
+  // so watch the directory rather than the file.
+  return watcher.start(
+    { this->path.parent_path() },
+    { this->path.extension().string() },
+    [this](const std::vector<std::filesystem::path> &files) {
+      for (const auto &file : files) {
+        if (file.filename() == this->path.filename()) {
+          reload();
+          break;
+        }
+      }
+    }
+  );
+}
+
+void ConfigReloader::stop() {
+  watcher.stop();
+  path.clear();
+
+  std::lock_guard lock(mutex);
+  pending = nullptr;
+}
+
+void ConfigReloader::reload() {
+  auto cfg = std::make_unique<Config>();
+  if (!cfg->parse(path.string())) {
+    return;
+  }
+
+  std::lock_guard lock(mutex);
+  pending = std::move(cfg);
+}
+
+std::vector<ConfigChange> ConfigReloader::apply(Uint64 frame) {
+  std::vector<ConfigChange> changes;
+
+  std::unique_ptr<Config> parsed;
+  {
+    std::lock_guard lock(mutex);
+    parsed = std::move(pending);
+  }
+  if (parsed == nullptr) {
+    return changes;
+  }
+
+  auto next = std::make_shared<Config>(getConfig());
+  applyHotKnobs(*next, *parsed, changes);
+
+  for (const ConfigChange &change : changes) {
+    LOG_INFO(
+      "CFG: frame %" SDL_PRIu64 ": %s %s -> %s\n",
+      frame,
+      change.key,
+      change.from.c_str(),
+      change.to.c_str()
+    );
+  }
+  if (*next != *parsed) {
+    LOG_WARN("CFG: %s has changes that need a restart\n", path.string().c_str());
+  }
+
+  if (!changes.empty()) {
+    setConfig(std::move(next));
+  }
+
+  return changes;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "config.h"
+#include "file_watcher.h"
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <SDL3/SDL.h>
+
+// Watches the config file and applies the settings marked as
+// hot-reloadable in config.cpp to the running app. The file is parsed on
+// the watcher thread, the new settings only take effect between frames:
+// apply publishes a copy of the current config with them changed, so a
+// frame never sees a mix of the old and the new ones.
+class ConfigReloader {
+private:
+  std::filesystem::path path;
+  FileWatcher watcher;
+
+  std::mutex mutex;
+  // The newest parse of the file, guarded by mutex
+  std::unique_ptr<Config> pending;
+
+public:
+  bool start(const std::string &path);
+  void stop();
+
+  bool enabled() const { return !path.empty(); }
+
+  // Called between frames on the main thread. Swaps in the new config
+  // if any of the hot-reloadable settings changed and logs them with
+  // the frame they take effect on. Returns the changes.
+  std::vector<ConfigChange> apply(Uint64 frame);
+
+private:
+  // Called on the watcher thread
+  void reload();
+};
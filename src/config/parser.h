@@ -0,0 +1,455 @@
+#pragma once
+
+#include "defines.h"
+#include "jobs/job_system.h"
+
+#include "magic_enum/magic_enum.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+// Line based text of "key arg arg ..." records, the format of the config
+// and of scene files. Arguments are separated by spaces or tabs, blank
+// lines and lines starting with # are skipped.
+// Parsing works on the text in place - a file is mapped rather than read,
+// a record is a set of views into it and the key is looked up in a
+// perfect hash table built at compile time from a Schema.
+
+static constexpr uint32_t MAX_RECORD_ARGS = 15;
+
+struct TextRecord {
+  std::string_view key;
+  // Arguments past MAX_RECORD_ARGS are dropped.
+  std::array<std::string_view, MAX_RECORD_ARGS> args;
+  uint32_t numArgs = 0;
+  // Of the start of the line in the text
+  size_t offset = 0;
+};
+
+namespace detail {
+
+enum CharClass : uint8_t {
+  TOKEN,
+  SPACE,
+  NEWLINE,
+};
+
+constexpr std::array<CharClass, 256> makeCharClasses() {
+  std::array<CharClass, 256> classes = {};
+  classes[' '] = SPACE;
+  classes['\t'] = SPACE;
+  classes['\r'] = SPACE;
+  classes['\n'] = NEWLINE;
+  return classes;
+}
+
+inline constexpr std::array<CharClass, 256> CHAR_CLASSES = makeCharClasses();
+
+inline CharClass charClass(char c) {
+  return CHAR_CLASSES[static_cast<uint8_t>(c)];
+}
+
+}
+
+// Tokenizes the record starting at or after cursor and moves cursor past
+// it. Returns false at the end of the text.
+inline bool nextRecord(std::string_view text, size_t &cursor, TextRecord &record) {
+  using namespace detail;
+
+  const char *begin = text.data();
+  const char *end = begin + text.size();
+  const char *p = begin + cursor;
+
+  uint32_t numTokens = 0;
+  const char *lineStart = p;
+  while (p < end) {
+    CharClass cls = charClass(*p);
+    if (cls == SPACE) {
+      ++p;
+      continue;
+    }
+    if (cls == NEWLINE) {
+      ++p;
+      if (numTokens > 0) {
+        break;
+      }
+      lineStart = p;
+      continue;
+    }
+
+    if (numTokens == 0 && *p == '#') {
+      const char *lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+      p = lineEnd != nullptr ? lineEnd : end;
+      continue;
+    }
+
+    const char *tokenStart = p;
+    while (p < end && charClass(*p) == TOKEN) {
+      ++p;
+    }
+
+    std::string_view token(tokenStart, p - tokenStart);
+    if (numTokens == 0) {
+      record.key = token;
+      record.offset = lineStart - begin;
+    } else if (numTokens <= MAX_RECORD_ARGS) {
+      record.args[numTokens - 1] = token;
+    }
+    ++numTokens;
+  }
+
+  cursor = p - begin;
+  if (numTokens == 0) {
+    return false;
+  }
+
+  record.numArgs = std::min(numTokens - 1, MAX_RECORD_ARGS);
+  return true;
+}
+
+// 1-based line of the given offset, for error messages
+inline size_t lineOf(std::string_view text, size_t offset) {
+  return std::count(text.begin(), text.begin() + std::min(offset, text.size()), '\n') + 1;
+}
+
+// Clinger's fast path: if the digits fit the mantissa, the decimal and
+// the power of ten are both exact, so one division rounds correctly.
+// Returns false for anything else, e.g. exponents or too many digits.
+template <class T>
+requires std::is_floating_point_v<T>
+bool parseFloatFast(std::string_view token, T &val) {
+  static constexpr uint64_t MAX_MANTISSA = uint64_t(1) << std::numeric_limits<T>::digits;
+  static constexpr T POW10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+  };
+  // Largest power of ten that is exact
+  static constexpr int MAX_EXP = std::is_same_v<T, float> ? 10 : 22;
+
+  size_t i = 0;
+  bool negative = !token.empty() && token[0] == '-';
+  i += negative ? 1 : 0;
+
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int fraction = -1;
+  for (; i < token.size(); ++i) {
+    char c = token[i];
+    if (c == '.' && fraction < 0) {
+      fraction = 0;
+      continue;
+    }
+    if (c < '0' || c > '9') {
+      return false;
+    }
+
+    mantissa = mantissa * 10 + (c - '0');
+    ++digits;
+    fraction += fraction >= 0 ? 1 : 0;
+    if (mantissa >= MAX_MANTISSA) {
+      return false;
+    }
+  }
+
+  int exp = std::max(fraction, 0);
+  if (digits == 0 || exp > MAX_EXP) {
+    return false;
+  }
+
+  T res = static_cast<T>(mantissa) / POW10[exp];
+  val = negative ? -res : res;
+  return true;
+}
+
+template <class T>
+requires std::is_arithmetic_v<T> && (!std::is_same_v<T, bool>)
+bool parseArg(std::string_view token, T &val) {
+  if constexpr (std::is_floating_point_v<T>) {
+    if (parseFloatFast(token, val)) {
+      return true;
+    }
+  }
+
+  T val_;
+#if defined(__APPLE__) && defined(__clang__)
+  if constexpr (std::is_floating_point_v<T>) {
+    // Apple clang does not support from_chars for float...
+    // The token isn't null terminated, a mapped file may end right after it.
+    std::string str(token);
+    char *str_end = nullptr;
+    val_ = static_cast<T>(std::strtod(str.c_str(), &str_end));
+    if (str_end != str.c_str() + str.size() || val_ == HUGE_VAL) {
+      return false;
+    }
+  } else
+#endif
+  {
+    auto res = std::from_chars(token.data(), token.data() + token.size(), val_);
+    if (res.ec != std::errc() || res.ptr != token.data() + token.size()) {
+      return false;
+    }
+  }
+
+  val = val_;
+  return true;
+}
+
+inline bool parseArg(std::string_view token, bool &val) {
+  if (token == "1" || token == "true") {
+    val = true;
+    return true;
+  }
+  if (token == "0" || token == "false") {
+    val = false;
+    return true;
+  }
+
+  return false;
+}
+
+template <class T>
+requires std::is_enum_v<T>
+bool parseArg(std::string_view token, T &val) {
+  auto val_opt = magic_enum::enum_cast<T>(token);
+  if (!val_opt) {
+    return false;
+  }
+
+  val = *val_opt;
+  return true;
+}
+
+inline bool parseArg(std::string_view token, std::string &val) {
+  val = token;
+  return true;
+}
+
+// Parses the record's arguments into val, a vector takes one per component.
+template <class T>
+bool parseValue(const TextRecord &record, T &val) {
+  return record.numArgs >= 1 && parseArg(record.args[0], val);
+}
+
+template <int N, class T>
+bool parseValue(const TextRecord &record, glm::vec<N, T> &val) {
+  if (record.numArgs < N) {
+    return false;
+  }
+
+  glm::vec<N, T> val_;
+  for (int i = 0; i < N; ++i) {
+    if (!parseArg(record.args[i], val_[i])) {
+      return false;
+    }
+  }
+
+  val = val_;
+  return true;
+}
+
+// Perfect hash over a fixed set of keys, built at compile time by
+// searching for a seed that maps every key to a slot of its own.
+template <size_t N>
+class PerfectHash {
+public:
+  // Sparse enough that a seed is found after a few tries
+  static constexpr size_t TABLE_SIZE = std::bit_ceil(N * 4);
+  static constexpr uint8_t EMPTY = 0xff;
+  static_assert(N < EMPTY);
+
+private:
+  std::array<std::string_view, N> keys = {};
+  std::array<uint8_t, TABLE_SIZE> slots = {};
+  uint32_t seed = 0;
+
+public:
+  constexpr PerfectHash(const std::array<std::string_view, N> &keys) : keys(keys) {
+    for (size_t i = 0; i < N; ++i) {
+      for (size_t j = i + 1; j < N; ++j) {
+        if (keys[i] == keys[j]) {
+          throw "duplicate key";
+        }
+      }
+    }
+
+    for (seed = 1; !tryBuild(); ++seed) {
+      if (seed == 1 << 16) {
+        throw "no seed found";
+      }
+    }
+  }
+
+  // FNV-1a
+  static constexpr uint32_t hash(std::string_view key, uint32_t seed) {
+    uint32_t h = 0x811c9dc5u ^ seed;
+    for (char c : key) {
+      h = (h ^ static_cast<uint8_t>(c)) * 0x01000193u;
+    }
+    return h ^ (h >> 15);
+  }
+
+  // Index of the key in the keys the table was built from, -1 if it
+  // isn't one of them.
+  constexpr int find(std::string_view key) const {
+    uint8_t idx = slots[hash(key, seed) & (TABLE_SIZE - 1)];
+    return idx != EMPTY && keys[idx] == key ? idx : -1;
+  }
+
+private:
+  constexpr bool tryBuild() {
+    slots.fill(EMPTY);
+    for (size_t i = 0; i < N; ++i) {
+      uint8_t &slot = slots[hash(keys[i], seed) & (TABLE_SIZE - 1)];
+      if (slot != EMPTY) {
+        return false;
+      }
+      slot = static_cast<uint8_t>(i);
+    }
+    return true;
+  }
+};
+
+template <class T>
+struct SchemaEntry {
+  std::string_view key;
+  // Fails if the record's arguments are invalid
+  bool (*parse)(T &target, const TextRecord &record) = nullptr;
+};
+
+// The records a target understands, see makeSchema.
+template <class T, size_t N>
+class Schema {
+private:
+  std::array<SchemaEntry<T>, N> entries;
+  PerfectHash<N> table;
+
+  static constexpr std::array<std::string_view, N> keysOf(const std::array<SchemaEntry<T>, N> &entries) {
+    std::array<std::string_view, N> keys;
+    for (size_t i = 0; i < N; ++i) {
+      keys[i] = entries[i].key;
+    }
+    return keys;
+  }
+
+public:
+  constexpr Schema(const std::array<SchemaEntry<T>, N> &entries) : entries(entries), table(keysOf(entries)) {}
+
+  constexpr const SchemaEntry<T> *find(std::string_view key) const {
+    int idx = table.find(key);
+    return idx >= 0 ? &entries[idx] : nullptr;
+  }
+
+  constexpr const std::array<SchemaEntry<T>, N> &getEntries() const { return entries; }
+};
+
+// static constexpr auto SCHEMA = makeSchema<Target>({
+//   { "key", [](Target &target, const TextRecord &record) { ... } },
+// });
+// Fails to compile if two entries have the same key.
+template <class T, size_t N>
+constexpr Schema<T, N> makeSchema(const SchemaEntry<T> (&entries)[N]) {
+  std::array<SchemaEntry<T>, N> arr;
+  for (size_t i = 0; i < N; ++i) {
+    arr[i] = entries[i];
+  }
+  return Schema<T, N>(arr);
+}
+
+struct ParseResult {
+  uint64_t records = 0;
+  // Records whose key isn't in the schema
+  uint64_t unknown = 0;
+  // Records the schema failed to parse
+  uint64_t invalid = 0;
+  // Offset of the first unknown or invalid record, SIZE_MAX if none
+  size_t firstError = SIZE_MAX;
+
+  void add(const ParseResult &other) {
+    records += other.records;
+    unknown += other.unknown;
+    invalid += other.invalid;
+    firstError = std::min(firstError, other.firstError);
+  }
+};
+
+// Parses every record of text into target.
+template <class T, size_t N>
+ParseResult parseRecords(std::string_view text, const Schema<T, N> &schema, T &target) {
+  ParseResult res;
+  TextRecord record;
+  size_t cursor = 0;
+  while (nextRecord(text, cursor, record)) {
+    ++res.records;
+
+    const SchemaEntry<T> *entry = schema.find(record.key);
+    bool known = entry != nullptr;
+    if (known && entry->parse(target, record)) {
+      continue;
+    }
+
+    ++(known ? res.invalid : res.unknown);
+    res.firstError = std::min(res.firstError, record.offset);
+  }
+
+  return res;
+}
+
+// Splits text at line ends into blocks of about blockBytes and parses
+// them on the job system, the records of the i-th block into blocks[i].
+// Merging the blocks, in order, is up to the caller. Blocks doesn't
+// have to be empty, its targets are reset.
+template <class T, size_t N>
+ParseResult parseBlocks(
+  std::string_view text,
+  const Schema<T, N> &schema,
+  size_t blockBytes,
+  std::vector<T> &blocks
+) {
+  std::vector<size_t> bounds = { 0 };
+  blockBytes = std::max<size_t>(blockBytes, 1);
+  while (bounds.back() < text.size()) {
+    size_t end = std::min(bounds.back() + blockBytes, text.size());
+    if (size_t newline = text.find('\n', end - 1); newline != std::string_view::npos) {
+      end = newline + 1;
+    } else {
+      end = text.size();
+    }
+    bounds.push_back(end);
+  }
+
+  size_t numBlocks = bounds.size() - 1;
+  blocks.resize(numBlocks);
+  std::vector<ParseResult> results(numBlocks);
+
+  getJobSystem().parallelFor(0, numBlocks, 1, [&](size_t begin, size_t end) {
+    for (size_t b = begin; b < end; ++b) {
+      blocks[b] = T{};
+      std::string_view block = text.substr(bounds[b], bounds[b + 1] - bounds[b]);
+      results[b] = parseRecords(block, schema, blocks[b]);
+      if (results[b].firstError != SIZE_MAX) {
+        results[b].firstError += bounds[b];
+      }
+    }
+  });
+
+  ParseResult res;
+  for (const ParseResult &result : results) {
+    res.add(result);
+  }
+
+  return res;
+}
@@ -4,19 +4,29 @@
 #include <concepts>
 #include <cstdio>
 #include <filesystem>
-#include <source_location>
+
+#include "log.h"
 
 #define PROJECT_NAME "Prj"
 
+// The file name of a path, e.g. __FILE__'s
+consteval const char *fileNameOf(const char *path) {
+  const char *name = path;
+  for (const char *p = path; *p != '\0'; ++p) {
+    if (*p == '/' || *p == '\\') {
+      name = p + 1;
+    }
+  }
+  return name;
+}
+
 #define SDL_CHECK_RET(expr, ret) \
 do { \
   if (!(expr)) { \
-    auto loc = std::source_location::current(); \
-    auto p = std::filesystem::path(loc.file_name()); \
-    printf("Expression %s failed at %s:%d with error: %s\n", \
+    LOG_ERROR("Expression %s failed at %s:%d with error: %s\n", \
       #expr, \
-      p.filename().c_str(), \
-      loc.line(), \
+      fileNameOf(__FILE__), \
+      __LINE__, \
       SDL_GetError() \
     ); \
     return (ret); \
@@ -34,7 +44,7 @@ do { \
   Uint64 start = SDL_GetTicks(); \
   (expr); \
   Uint64 end = SDL_GetTicks(); \
-  printf("%s: %llums\n", what, end - start); \
+  LOG_INFO("%s: %llums\n", what, end - start); \
 } while (false)
 
 #define SDL_MEASURE_RET(expr, what) \
@@ -42,7 +52,7 @@ do { \
     Uint64 start = SDL_GetTicks(); \
     auto res = expr; \
     Uint64 end = SDL_GetTicks(); \
-    printf("%s: %llums\n", what, end - start); \
+    LOG_INFO("%s: %llums\n", what, end - start); \
     return res; \
   } ()
 
@@ -54,13 +64,10 @@ do { \
 
 #endif // SHOW_MEASURE
 
-#ifdef __DEBUG
+// Compiled out with LOG_MIN_LEVEL above DEBUG, as it is without __DEBUG
+#define DEBUG_PRINT(...) LOG_DEBUG(__VA_ARGS__)
 
-#define DEBUG_PRINT(format, ...) \
-do { \
-  printf(format, __VA_ARGS__); \
-} \
-while (false)
+#ifdef __DEBUG
 
 #define TODO() \
 do { \
@@ -72,7 +79,6 @@ do { \
 
 #else
 
-#define DEBUG_PRINT(...) (void)0
 #define UNREACHABLE() (void)0
 #define TODO() do {\
   return {}; \
@@ -0,0 +1,334 @@
+#include "world.h"
+
+#include <atomic>
+#include <bit>
+#include <mutex>
+#include <new>
+
+namespace {
+
+// Fixed size so that readers never see it reallocate under them.
+ComponentInfo componentInfos[MAX_COMPONENTS];
+std::atomic<ComponentId> numComponents = 0;
+std::mutex registerMutex;
+
+size_t alignUp(size_t value, size_t align) {
+  return (value + align - 1) / align * align;
+}
+
+std::byte *allocChunk() {
+  return static_cast<std::byte*>(::operator new[](World::CHUNK_BYTES, std::align_val_t(COLUMN_ALIGN)));
+}
+
+}
+
+ComponentId registerComponent(size_t size, size_t align) {
+  std::lock_guard lock(registerMutex);
+
+  ComponentId id = numComponents.load();
+  assert(id < MAX_COMPONENTS);
+  componentInfos[id] = { .size = size, .align = align };
+  numComponents.store(id + 1);
+
+  return id;
+}
+
+const ComponentInfo &getComponentInfo(ComponentId id) {
+  assert(id < numComponents.load());
+  return componentInfos[id];
+}
+
+void World::ChunkDeleter::operator()(std::byte *data) const {
+  ::operator delete[](data, std::align_val_t(COLUMN_ALIGN));
+}
+
+World::Chunk::Chunk() : data(allocChunk()) {}
+
+World::Chunk::Chunk(const Chunk &other) : Chunk() {
+  *this = other;
+}
+
+World::Chunk &World::Chunk::operator=(const Chunk &other) {
+  if (this == &other) {
+    return *this;
+  }
+
+  if (data == nullptr) {
+    data.reset(allocChunk());
+  }
+  std::memcpy(data.get(), other.data.get(), CHUNK_BYTES);
+  count = other.count;
+
+  return *this;
+}
+
+void World::clear() {
+  for (Archetype &arch : archetypes) {
+    arch.chunks.clear();
+    arch.count = 0;
+  }
+
+  // The records stay so that handles to the destroyed entities don't
+  // come alive again when their indices are reused.
+  freeIndices.clear();
+  for (size_t i = records.size(); i-- > 0;) {
+    Record &record = records[i];
+    if (record.archetype != NONE) {
+      record.archetype = NONE;
+      ++record.generation;
+    }
+    freeIndices.push_back(static_cast<uint32_t>(i));
+  }
+  numAlive = 0;
+}
+
+World::ChunkLayout World::chunkLayout(ComponentMask mask, std::initializer_list<ComponentId> ids) {
+  const Archetype &arch = archetypes[getArchetype(mask)];
+
+  ChunkLayout layout = { .capacity = arch.capacity };
+  for (ComponentId id : ids) {
+    layout.offsets.push_back(arch.offsets[arch.columns[id]]);
+  }
+
+  return layout;
+}
+
+std::vector<World::ChunkImage> World::chunkImages(ComponentMask mask) const {
+  std::vector<ChunkImage> images;
+
+  auto it = archetypeLookup.find(mask);
+  if (it == archetypeLookup.end()) {
+    return images;
+  }
+
+  for (const Chunk &chunk : archetypes[it->second].chunks) {
+    images.push_back({ chunk.data.get(), chunk.count });
+  }
+
+  return images;
+}
+
+void World::loadChunkImages(ComponentMask mask, const std::vector<ChunkImage> &images) {
+  clear();
+
+  uint32_t archIdx = getArchetype(mask);
+  Archetype &arch = archetypes[archIdx];
+  arch.chunks.resize(images.size());
+
+  for (size_t c = 0; c < images.size(); ++c) {
+    assert(images[c].count <= arch.capacity);
+
+    Chunk &chunk = arch.chunks[c];
+    std::memcpy(chunk.data.get(), images[c].data, CHUNK_BYTES);
+    chunk.count = images[c].count;
+    arch.count += chunk.count;
+
+    const Entity *entities = arch.entities(chunk);
+    for (uint32_t row = 0; row < chunk.count; ++row) {
+      Entity entity = entities[row];
+      if (entity.index >= records.size()) {
+        records.resize(entity.index + 1);
+      }
+      records[entity.index] = {
+        .generation = entity.generation,
+        .archetype = archIdx,
+        .chunk = static_cast<uint32_t>(c),
+        .row = row,
+      };
+    }
+  }
+  numAlive = arch.count;
+
+  // Holes in the indices, highest first so the lowest is reused first.
+  // The image doesn't have their generations, bumped past the ones
+  // handed out for them before.
+  freeIndices.clear();
+  for (size_t i = records.size(); i-- > 0;) {
+    if (records[i].archetype == NONE) {
+      ++records[i].generation;
+      freeIndices.push_back(static_cast<uint32_t>(i));
+    }
+  }
+}
+
+void World::destroy(Entity entity) {
+  if (!alive(entity)) {
+    return;
+  }
+
+  Record &record = records[entity.index];
+  freeRow(record.archetype, record.chunk, record.row);
+
+  record.archetype = NONE;
+  ++record.generation;
+  freeIndices.push_back(entity.index);
+  --numAlive;
+}
+
+uint32_t World::getArchetype(ComponentMask mask) {
+  if (auto it = archetypeLookup.find(mask); it != archetypeLookup.end()) {
+    return it->second;
+  }
+
+  Archetype arch;
+  arch.mask = mask;
+  std::memset(arch.columns, NO_COLUMN, sizeof(arch.columns));
+  for (ComponentMask bits = mask; bits != 0; bits &= bits - 1) {
+    ComponentId id = static_cast<ComponentId>(std::countr_zero(bits));
+    arch.columns[id] = static_cast<uint8_t>(arch.components.size());
+    arch.components.push_back(id);
+  }
+
+  // Lay the columns out for as many rows as fit, then back off until
+  // the alignment padding fits too.
+  size_t rowSize = sizeof(Entity);
+  for (ComponentId id : arch.components) {
+    rowSize += getComponentInfo(id).size;
+  }
+
+  for (size_t capacity = CHUNK_BYTES / rowSize; capacity > 0; --capacity) {
+    size_t offset = capacity * sizeof(Entity);
+    arch.offsets.clear();
+    for (ComponentId id : arch.components) {
+      const ComponentInfo &info = getComponentInfo(id);
+      offset = alignUp(offset, COLUMN_ALIGN);
+      arch.offsets.push_back(static_cast<uint32_t>(offset));
+      offset += capacity * info.size;
+    }
+
+    if (offset <= CHUNK_BYTES) {
+      arch.capacity = static_cast<uint32_t>(capacity);
+      break;
+    }
+  }
+  assert(arch.capacity > 0);
+
+  uint32_t idx = static_cast<uint32_t>(archetypes.size());
+  archetypes.push_back(std::move(arch));
+  archetypeLookup[mask] = idx;
+
+  return idx;
+}
+
+uint32_t World::getEdge(uint32_t archIdx, ComponentId id, bool add) {
+  auto &edges = add ? archetypes[archIdx].addEdges : archetypes[archIdx].removeEdges;
+  if (auto it = edges.find(id); it != edges.end()) {
+    return it->second;
+  }
+
+  ComponentMask bit = ComponentMask(1) << id;
+  ComponentMask mask = add ? archetypes[archIdx].mask | bit : archetypes[archIdx].mask & ~bit;
+  uint32_t dst = getArchetype(mask);
+
+  // getArchetype may have moved the archetypes.
+  auto &dstEdges = add ? archetypes[archIdx].addEdges : archetypes[archIdx].removeEdges;
+  dstEdges[id] = dst;
+
+  return dst;
+}
+
+const std::vector<uint32_t> &World::match(ComponentMask mask) const {
+  Query *query = nullptr;
+  for (Query &q : queries) {
+    if (q.mask == mask) {
+      query = &q;
+      break;
+    }
+  }
+  if (query == nullptr) {
+    query = &queries.emplace_back(Query{ .mask = mask });
+  }
+
+  for (; query->seen < archetypes.size(); ++query->seen) {
+    if ((archetypes[query->seen].mask & mask) == mask) {
+      query->archetypes.push_back(query->seen);
+    }
+  }
+
+  return query->archetypes;
+}
+
+Entity World::allocEntity() {
+  uint32_t index;
+  if (!freeIndices.empty()) {
+    index = freeIndices.back();
+    freeIndices.pop_back();
+  } else {
+    index = static_cast<uint32_t>(records.size());
+    records.emplace_back();
+  }
+
+  ++numAlive;
+  return Entity{ .index = index, .generation = records[index].generation };
+}
+
+void World::allocRow(uint32_t archIdx, Entity entity, Record &record) {
+  Archetype &arch = archetypes[archIdx];
+  if (arch.chunks.empty() || arch.chunks.back().count == arch.capacity) {
+    arch.chunks.emplace_back();
+  }
+
+  Chunk &chunk = arch.chunks.back();
+  record.chunk = static_cast<uint32_t>(arch.chunks.size() - 1);
+  record.row = chunk.count++;
+  ++arch.count;
+
+  arch.entities(chunk)[record.row] = entity;
+}
+
+void World::freeRow(uint32_t archIdx, uint32_t chunkIdx, uint32_t row) {
+  Archetype &arch = archetypes[archIdx];
+  Chunk &last = arch.chunks.back();
+  uint32_t lastChunkIdx = static_cast<uint32_t>(arch.chunks.size() - 1);
+  uint32_t lastRow = last.count - 1;
+
+  if (chunkIdx != lastChunkIdx || row != lastRow) {
+    Chunk &chunk = arch.chunks[chunkIdx];
+    Entity moved = arch.entities(last)[lastRow];
+    arch.entities(chunk)[row] = moved;
+    for (ComponentId id : arch.components) {
+      size_t size = getComponentInfo(id).size;
+      std::memcpy(
+        static_cast<std::byte*>(arch.column(chunk, id)) + row * size,
+        static_cast<std::byte*>(arch.column(last, id)) + lastRow * size,
+        size
+      );
+    }
+
+    records[moved.index].chunk = chunkIdx;
+    records[moved.index].row = row;
+  }
+
+  --last.count;
+  --arch.count;
+  if (last.count == 0) {
+    arch.chunks.pop_back();
+  }
+}
+
+void World::move(Entity entity, uint32_t dstIdx) {
+  Record &record = records[entity.index];
+  uint32_t srcIdx = record.archetype;
+  uint32_t srcChunk = record.chunk;
+  uint32_t srcRow = record.row;
+
+  allocRow(dstIdx, entity, record);
+  record.archetype = dstIdx;
+
+  const Archetype &src = archetypes[srcIdx];
+  const Archetype &dst = archetypes[dstIdx];
+  for (ComponentId id : src.components) {
+    if ((dst.mask & (ComponentMask(1) << id)) == 0) {
+      continue;
+    }
+
+    size_t size = getComponentInfo(id).size;
+    std::memcpy(
+      static_cast<std::byte*>(dst.column(dst.chunks[record.chunk], id)) + record.row * size,
+      static_cast<std::byte*>(src.column(src.chunks[srcChunk], id)) + srcRow * size,
+      size
+    );
+  }
+
+  freeRow(srcIdx, srcChunk, srcRow);
+}
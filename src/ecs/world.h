@@ -0,0 +1,374 @@
+#pragma once
+
+#include "jobs/job_system.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Archetype based entity-component storage.
+// Entities with the same set of components share an archetype, which
+// stores them in fixed size chunks, one array per component (SoA).
+// Only the last chunk of an archetype may be partly filled, so iterating
+// a query is a linear walk over dense arrays.
+//
+// Components must be trivially copyable, they are moved around with memcpy.
+// Every column starts at a cache line, so SIMD code can stream over it.
+// Structural changes (create, destroy, add, remove) are not thread-safe,
+// iterating with parallelEach is as long as fn only touches its own chunk.
+
+using ComponentId = uint32_t;
+using ComponentMask = uint64_t;
+
+static constexpr ComponentId MAX_COMPONENTS = 64;
+static constexpr size_t COLUMN_ALIGN = 64;
+
+struct Entity {
+  uint32_t index = ~0u;
+  // Bumped when the index is reused, so stale handles don't alias new entities
+  uint32_t generation = 0;
+
+  bool operator==(const Entity &other) const = default;
+};
+
+struct ComponentInfo {
+  size_t size = 0;
+  size_t align = 0;
+};
+
+// Ids are assigned on first use and are the same for all worlds.
+ComponentId registerComponent(size_t size, size_t align);
+const ComponentInfo &getComponentInfo(ComponentId id);
+
+template <class T>
+ComponentId componentId() {
+  if constexpr (std::is_const_v<T>) {
+    return componentId<std::remove_const_t<T>>();
+  } else {
+    static_assert(std::is_trivially_copyable_v<T>, "Components are moved with memcpy");
+    static_assert(alignof(T) <= COLUMN_ALIGN, "Columns are only COLUMN_ALIGN aligned");
+
+    static const ComponentId id = registerComponent(sizeof(T), alignof(T));
+    return id;
+  }
+}
+
+template <class... Ts>
+ComponentMask componentMask() {
+  return ((ComponentMask(1) << componentId<Ts>()) | ... | ComponentMask(0));
+}
+
+class World {
+public:
+  // Bytes per chunk, the number of entities in it depends on the archetype.
+  static constexpr size_t CHUNK_BYTES = 16 * 1024;
+
+private:
+  static constexpr uint32_t NONE = ~0u;
+  static constexpr uint8_t NO_COLUMN = 0xff;
+
+  struct ChunkDeleter {
+    void operator()(std::byte *data) const;
+  };
+
+  struct Chunk {
+    std::unique_ptr<std::byte[], ChunkDeleter> data;
+    uint32_t count = 0;
+
+    Chunk();
+    Chunk(const Chunk &other);
+    Chunk(Chunk &&other) = default;
+    // Reuses the allocation, which keeps copying a world into an older
+    // copy of itself allocation free.
+    Chunk &operator=(const Chunk &other);
+    Chunk &operator=(Chunk &&other) = default;
+  };
+
+  struct Archetype {
+    ComponentMask mask = 0;
+    // Ascending
+    std::vector<ComponentId> components;
+    // Where each column starts in a chunk, the entities are at offset 0
+    std::vector<uint32_t> offsets;
+    uint8_t columns[MAX_COMPONENTS];
+    uint32_t capacity = 0;
+
+    std::vector<Chunk> chunks;
+    uint32_t count = 0;
+
+    // Archetypes one component away, filled on demand
+    std::unordered_map<ComponentId, uint32_t> addEdges;
+    std::unordered_map<ComponentId, uint32_t> removeEdges;
+
+    template <class T>
+    T *column(const Chunk &chunk) const {
+      uint8_t col = columns[componentId<T>()];
+      assert(col != NO_COLUMN);
+      return reinterpret_cast<T*>(chunk.data.get() + offsets[col]);
+    }
+
+    void *column(const Chunk &chunk, ComponentId id) const {
+      return chunk.data.get() + offsets[columns[id]];
+    }
+
+    Entity *entities(const Chunk &chunk) const {
+      return reinterpret_cast<Entity*>(chunk.data.get());
+    }
+  };
+
+  struct Record {
+    uint32_t generation = 0;
+    uint32_t archetype = NONE;
+    uint32_t chunk = 0;
+    uint32_t row = 0;
+  };
+
+  // Archetypes matching a mask. Updated lazily with the archetypes created
+  // since the query was last used.
+  struct Query {
+    ComponentMask mask = 0;
+    std::vector<uint32_t> archetypes;
+    uint32_t seen = 0;
+  };
+
+  std::vector<Archetype> archetypes;
+  std::unordered_map<ComponentMask, uint32_t> archetypeLookup;
+
+  std::vector<Record> records;
+  std::vector<uint32_t> freeIndices;
+  size_t numAlive = 0;
+
+  mutable std::vector<Query> queries;
+
+public:
+  // Number of live entities
+  size_t size() const { return numAlive; }
+
+  // Destroys all entities but keeps the archetypes and their queries.
+  void clear();
+
+  template <class... Ts>
+  Entity create(const Ts &...values) {
+    uint32_t archIdx = getArchetype(componentMask<Ts...>());
+    Entity entity = allocEntity();
+    Record &record = records[entity.index];
+    record.archetype = archIdx;
+    allocRow(archIdx, entity, record);
+
+    Archetype &arch = archetypes[archIdx];
+    const Chunk &chunk = arch.chunks[record.chunk];
+    ((arch.column<Ts>(chunk)[record.row] = values), ...);
+
+    return entity;
+  }
+
+  // Creates count entities with the same values, a chunk at a time.
+  template <class... Ts>
+  void createMany(size_t count, const Ts &...values) {
+    uint32_t archIdx = getArchetype(componentMask<Ts...>());
+    Archetype &arch = archetypes[archIdx];
+    records.reserve(records.size() + count);
+
+    while (count > 0) {
+      if (arch.chunks.empty() || arch.chunks.back().count == arch.capacity) {
+        arch.chunks.emplace_back();
+      }
+
+      Chunk &chunk = arch.chunks.back();
+      auto chunkIdx = static_cast<uint32_t>(arch.chunks.size() - 1);
+      auto n = static_cast<uint32_t>(std::min<size_t>(count, arch.capacity - chunk.count));
+      Entity *entities = arch.entities(chunk);
+      for (uint32_t row = chunk.count; row < chunk.count + n; ++row) {
+        Entity entity = allocEntity();
+        Record &record = records[entity.index];
+        record.archetype = archIdx;
+        record.chunk = chunkIdx;
+        record.row = row;
+        entities[row] = entity;
+      }
+      (std::fill_n(arch.column<Ts>(chunk) + chunk.count, n, values), ...);
+
+      chunk.count += n;
+      arch.count += n;
+      count -= n;
+    }
+  }
+
+  void destroy(Entity entity);
+
+  bool alive(Entity entity) const {
+    return entity.index < records.size() &&
+      records[entity.index].generation == entity.generation &&
+      records[entity.index].archetype != NONE;
+  }
+
+  template <class T>
+  bool has(Entity entity) const {
+    return alive(entity) && (archetypes[records[entity.index].archetype].mask & componentMask<T>()) != 0;
+  }
+
+  // nullptr if the entity is dead or doesn't have T
+  template <class T>
+  T *get(Entity entity) {
+    return const_cast<T*>(std::as_const(*this).get<T>(entity));
+  }
+
+  template <class T>
+  const T *get(Entity entity) const {
+    if (!has<T>(entity)) {
+      return nullptr;
+    }
+
+    const Record &record = records[entity.index];
+    const Archetype &arch = archetypes[record.archetype];
+    return &arch.column<T>(arch.chunks[record.chunk])[record.row];
+  }
+
+  // Sets the component if the entity already has it.
+  template <class T>
+  void add(Entity entity, const T &value) {
+    assert(alive(entity));
+
+    if (T *existing = get<T>(entity)) {
+      *existing = value;
+      return;
+    }
+
+    ComponentId id = componentId<T>();
+    uint32_t dst = getEdge(records[entity.index].archetype, id, true);
+    move(entity, dst);
+
+    const Record &record = records[entity.index];
+    Archetype &arch = archetypes[dst];
+    arch.column<T>(arch.chunks[record.chunk])[record.row] = value;
+  }
+
+  template <class T>
+  void remove(Entity entity) {
+    if (!has<T>(entity)) {
+      return;
+    }
+
+    uint32_t dst = getEdge(records[entity.index].archetype, componentId<T>(), false);
+    move(entity, dst);
+  }
+
+  // Calls fn(count, entities, Ts*...) for each chunk with all of Ts.
+  // Request const components when only reading them.
+  template <class... Ts, class Fn>
+  void eachChunk(Fn &&fn) {
+    for (uint32_t archIdx : match(componentMask<Ts...>())) {
+      Archetype &arch = archetypes[archIdx];
+      for (Chunk &chunk : arch.chunks) {
+        fn(chunk.count, const_cast<const Entity*>(arch.entities(chunk)), arch.column<Ts>(chunk)...);
+      }
+    }
+  }
+
+  template <class... Ts, class Fn>
+  void eachChunk(Fn &&fn) const {
+    static_assert((std::is_const_v<Ts> && ...), "Only const components of a const World");
+    const_cast<World*>(this)->eachChunk<Ts...>(std::forward<Fn>(fn));
+  }
+
+  // Calls fn(Ts&...) for each entity with all of Ts.
+  template <class... Ts, class Fn>
+  void each(Fn &&fn) {
+    eachChunk<Ts...>([&fn](uint32_t count, const Entity*, Ts *...columns) {
+      for (uint32_t i = 0; i < count; ++i) {
+        fn(columns[i]...);
+      }
+    });
+  }
+
+  template <class... Ts, class Fn>
+  void each(Fn &&fn) const {
+    static_assert((std::is_const_v<Ts> && ...), "Only const components of a const World");
+    const_cast<World*>(this)->each<Ts...>(std::forward<Fn>(fn));
+  }
+
+  // eachChunk on the job system, grain is in chunks. Blocks until done.
+  template <class... Ts, class Fn>
+  void parallelEach(size_t grain, Fn &&fn) {
+    struct Item {
+      Archetype *arch;
+      Chunk *chunk;
+    };
+    std::vector<Item> items;
+    for (uint32_t archIdx : match(componentMask<Ts...>())) {
+      Archetype &arch = archetypes[archIdx];
+      for (Chunk &chunk : arch.chunks) {
+        items.push_back({ &arch, &chunk });
+      }
+    }
+
+    getJobSystem().parallelFor(0, items.size(), grain, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        const Item &item = items[i];
+        fn(
+          item.chunk->count,
+          const_cast<const Entity*>(item.arch->entities(*item.chunk)),
+          item.arch->template column<Ts>(*item.chunk)...
+        );
+      }
+    });
+  }
+
+  // Serialization. A chunk image is CHUNK_BYTES with the entities at
+  // offset 0 and every column at its offset in the ChunkLayout, exactly
+  // how the chunks are laid out in memory. The layout only depends on
+  // the components, so images can be saved and loaded as they are.
+  struct ChunkImage {
+    const std::byte *data = nullptr;
+    uint32_t count = 0;
+  };
+
+  struct ChunkLayout {
+    uint32_t capacity = 0;
+    // Column offsets in the order the components were requested
+    std::vector<uint32_t> offsets;
+  };
+
+  template <class... Ts>
+  ChunkLayout chunkLayout() {
+    return chunkLayout(componentMask<Ts...>(), { componentId<Ts>()... });
+  }
+
+  // Chunks of the archetype with exactly Ts, valid until the next
+  // structural change.
+  template <class... Ts>
+  std::vector<ChunkImage> chunkImages() const {
+    return chunkImages(componentMask<Ts...>());
+  }
+
+  // Replaces every entity with the ones in the images, which must follow
+  // chunkLayout<Ts...>(). The entities keep their handles.
+  template <class... Ts>
+  void loadChunkImages(const std::vector<ChunkImage> &images) {
+    loadChunkImages(componentMask<Ts...>(), images);
+  }
+
+private:
+  ChunkLayout chunkLayout(ComponentMask mask, std::initializer_list<ComponentId> ids);
+  std::vector<ChunkImage> chunkImages(ComponentMask mask) const;
+  void loadChunkImages(ComponentMask mask, const std::vector<ChunkImage> &images);
+
+  uint32_t getArchetype(ComponentMask mask);
+  uint32_t getEdge(uint32_t archIdx, ComponentId id, bool add);
+  const std::vector<uint32_t> &match(ComponentMask mask) const;
+
+  Entity allocEntity();
+  void allocRow(uint32_t archIdx, Entity entity, Record &record);
+  // Swaps the last entity of the archetype into the row.
+  void freeRow(uint32_t archIdx, uint32_t chunk, uint32_t row);
+  // Moves the entity to another archetype, copying the common components.
+  void move(Entity entity, uint32_t dstIdx);
+};
@@ -0,0 +1,162 @@
+#include "file_watcher.h"
+
+#include "defines.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace std::chrono_literals;
+
+// Editors tend to save a file in several steps,
+// so collect everything that happens in this window into one batch.
+static constexpr auto DEBOUNCE = 50ms;
+static constexpr auto POLL_INTERVAL = 100ms;
+
+bool FileWatcher::start(
+  std::vector<std::filesystem::path> dirs,
+  std::vector<std::string> extensions,
+  Callback callback
+) {
+  stop();
+
+  this->dirs = std::move(dirs);
+  this->extensions = std::move(extensions);
+  this->callback = std::move(callback);
+
+  running = true;
+  thread = std::thread(&FileWatcher::run, this);
+
+  return true;
+}
+
+void FileWatcher::stop() {
+  running = false;
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
+
+bool FileWatcher::isWatched(const std::filesystem::path &file) const {
+  auto ext = file.extension().string();
+  return std::find(extensions.begin(), extensions.end(), ext) != extensions.end();
+}
+
+#ifdef __linux__
+
+void FileWatcher::run() {
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0) {
+    LOG_ERROR("inotify_init1 failed: %s\n", std::strerror(errno));
+    return;
+  }
+
+  std::unordered_map<int, std::filesystem::path> watches;
+  for (const auto &dir : dirs) {
+    int wd = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (wd < 0) {
+      LOG_ERROR("Failed to watch %s\n", dir.c_str());
+      continue;
+    }
+    watches[wd] = dir;
+  }
+
+  // Drains all queued events, returns false if there were none
+  std::vector<std::filesystem::path> changed;
+  auto readEvents = [&]() {
+    alignas(inotify_event) char buf[4096];
+    bool any = false;
+
+    ssize_t len;
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+      for (char *ptr = buf; ptr < buf + len;) {
+        auto *event = reinterpret_cast<inotify_event*>(ptr);
+        ptr += sizeof(inotify_event) + event->len;
+
+        if (event->len == 0 || !watches.contains(event->wd)) {
+          continue;
+        }
+
+        auto file = watches[event->wd] / event->name;
+        if (!isWatched(file)) {
+          continue;
+        }
+
+        if (std::find(changed.begin(), changed.end(), file) == changed.end()) {
+          changed.push_back(file);
+        }
+        any = true;
+      }
+    }
+
+    return any;
+  };
+
+  pollfd pfd = { .fd = fd, .events = POLLIN };
+  while (running) {
+    int res = poll(&pfd, 1, static_cast<int>(POLL_INTERVAL.count()));
+    if (res <= 0 || !readEvents()) {
+      continue;
+    }
+
+    while (running && poll(&pfd, 1, static_cast<int>(DEBOUNCE.count())) > 0) {
+      readEvents();
+    }
+
+    if (!changed.empty()) {
+      callback(changed);
+      changed.clear();
+    }
+  }
+
+  close(fd);
+}
+
+#else
+
+void FileWatcher::run() {
+  auto scan = [this](bool report) {
+    std::vector<std::filesystem::path> changed;
+
+    for (const auto &dir : dirs) {
+      std::error_code ec;
+      for (const auto &entry : std::filesystem::directory_iterator(dir, ec)) {
+        if (!entry.is_regular_file() || !isWatched(entry.path())) {
+          continue;
+        }
+
+        auto writeTime = entry.last_write_time(ec);
+        auto &known = writeTimes[entry.path().string()];
+        if (known != writeTime) {
+          known = writeTime;
+          if (report) {
+            changed.push_back(entry.path());
+          }
+        }
+      }
+    }
+
+    return changed;
+  };
+
+  scan(false);
+  while (running) {
+    std::this_thread::sleep_for(POLL_INTERVAL);
+
+    auto changed = scan(true);
+    if (!changed.empty()) {
+      std::this_thread::sleep_for(DEBOUNCE);
+      scan(false);
+      callback(changed);
+    }
+  }
+}
+
+#endif // __linux__
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Watches directories (not recursively) for modified files on a
+// background thread. Uses inotify on Linux and polls the files'
+// write times everywhere else.
+class FileWatcher {
+public:
+  // Called on the watcher thread with every batch of modified files.
+  using Callback = std::function<void(const std::vector<std::filesystem::path>&)>;
+
+private:
+  std::vector<std::filesystem::path> dirs;
+  std::vector<std::string> extensions;
+  Callback callback;
+
+  std::thread thread;
+  std::atomic<bool> running = false;
+
+#ifndef __linux__
+  std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes;
+#endif
+
+public:
+  ~FileWatcher() {
+    stop();
+  }
+
+  // Only files with one of the given extensions are reported.
+  bool start(
+    std::vector<std::filesystem::path> dirs,
+    std::vector<std::string> extensions,
+    Callback callback
+  );
+  void stop();
+
+private:
+  void run();
+  bool isWatched(const std::filesystem::path &file) const;
+};
@@ -0,0 +1,81 @@
+#include "frame_limiter.h"
+
+#include <algorithm>
+
+// Bounds of the part of the budget left to the spin loop
+static constexpr Uint64 MIN_SPIN_MARGIN_NS = 200'000;
+static constexpr Uint64 MAX_SPIN_MARGIN_NS = 4'000'000;
+
+void FrameLimiter::init(Uint32 targetRate) {
+  periodNS = targetRate > 0 ? SDL_NS_PER_SECOND / targetRate : 0;
+  spinMarginNS = 1'000'000;
+  deadline = SDL_GetTicksNS() + periodNS;
+
+  statsStart = SDL_GetTicksNS();
+  frames = 0;
+  jitterNS = 0;
+  maxJitterNS = 0;
+  sleptNS = 0;
+  spunNS = 0;
+}
+
+void FrameLimiter::wait() {
+  ++frames;
+  if (!enabled()) {
+    return;
+  }
+
+  Uint64 now = SDL_GetTicksNS();
+  if (now + spinMarginNS < deadline) {
+    Uint64 request = deadline - spinMarginNS - now;
+    SDL_DelayNS(request);
+
+    Uint64 woke = SDL_GetTicksNS();
+    sleptNS += woke - now;
+
+    // Grow right away when the OS oversleeps, shrink slowly otherwise.
+    Uint64 overshoot = woke - now > request ? woke - now - request : 0;
+    spinMarginNS = std::max(spinMarginNS - spinMarginNS / 64, overshoot + overshoot / 4);
+    spinMarginNS = std::clamp(spinMarginNS, MIN_SPIN_MARGIN_NS, MAX_SPIN_MARGIN_NS);
+    now = woke;
+  }
+
+  Uint64 spinStart = now;
+  while (now < deadline) {
+    now = SDL_GetTicksNS();
+  }
+  spunNS += now - spinStart;
+
+  Uint64 jitter = now - deadline;
+  jitterNS += jitter;
+  maxJitterNS = std::max(maxJitterNS, jitter);
+
+  // A frame that ran over its budget pushes the next deadlines back
+  // instead of starting a burst of short frames to catch up.
+  deadline += periodNS;
+  if (deadline <= now) {
+    deadline = now + periodNS;
+  }
+}
+
+FrameLimiterStats FrameLimiter::collectStats() {
+  FrameLimiterStats stats;
+
+  Uint64 now = SDL_GetTicksNS();
+  if (frames > 0 && now > statsStart) {
+    stats.fps = double(frames) * SDL_NS_PER_SECOND / double(now - statsStart);
+    stats.jitterMs = double(jitterNS) / frames / SDL_NS_PER_MS;
+    stats.sleepMs = double(sleptNS) / frames / SDL_NS_PER_MS;
+    stats.spinMs = double(spunNS) / frames / SDL_NS_PER_MS;
+  }
+  stats.maxJitterMs = double(maxJitterNS) / SDL_NS_PER_MS;
+
+  statsStart = now;
+  frames = 0;
+  jitterNS = 0;
+  maxJitterNS = 0;
+  sleptNS = 0;
+  spunNS = 0;
+
+  return stats;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+struct FrameLimiterStats {
+  // Averages since the last FrameLimiter::collectStats
+  double fps = 0.;
+  // How far from its deadline a frame was released
+  double jitterMs = 0.;
+  double maxJitterMs = 0.;
+  // Time per frame given back to the OS and time burnt busy-waiting
+  double sleepMs = 0.;
+  double spinMs = 0.;
+};
+
+// Caps the frame rate by waiting until the next frame's deadline.
+// OS sleeps routinely overshoot by a millisecond or more, so it sleeps
+// only until a safety margin before the deadline and spins the rest.
+// The margin follows the worst overshoot seen recently, which keeps the
+// spinning short on systems with a fine-grained scheduler.
+class FrameLimiter {
+private:
+  Uint64 periodNS = 0;
+  Uint64 deadline = 0;
+  Uint64 spinMarginNS = 0;
+
+  // Stats since the last collectStats
+  Uint64 statsStart = 0;
+  Uint64 frames = 0;
+  Uint64 jitterNS = 0;
+  Uint64 maxJitterNS = 0;
+  Uint64 sleptNS = 0;
+  Uint64 spunNS = 0;
+
+public:
+  // Zero disables the limiter.
+  void init(Uint32 targetRate);
+
+  bool enabled() const { return periodNS > 0; }
+
+  // Blocks until the current frame's deadline.
+  void wait();
+
+  FrameLimiterStats collectStats();
+};
@@ -1,10 +1,250 @@
 #include "game_state.h"
 
 #include "config/config.h"
+#include "defines.h"
+#include "scene.h"
+#include "sim/integrate.h"
+
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <type_traits>
+
+#include <SDL3/SDL.h>
+
+// Chunks per job, a few thousand sprites
+static constexpr size_t CHUNK_GRAIN = 8;
+
+// Bump whenever generateSprites or the components change,
+// it invalidates every cached world.
+static constexpr uint32_t GENERATOR_VERSION = 1;
+static constexpr uint32_t CACHE_MAGIC = 0x444c5257; // "WRLD"
+
+// The cache is the header followed by the columns of all sprites, one
+// component after the other, so it doesn't depend on the chunk size.
+struct WorldCacheHeader {
+  uint32_t magic = 0;
+  uint32_t version = 0;
+  uint64_t key = 0;
+  uint64_t count = 0;
+};
+
+// FNV-1a
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+  auto bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+template <class... Ts>
+static size_t spriteBytes() {
+  return (sizeof(Ts) + ...);
+}
 
 void GameState::update(double deltaTime) {
+  float dt = static_cast<float>(deltaTime);
+
+  world.parallelEach<Position, Velocity>(CHUNK_GRAIN, [this, dt](uint32_t count, const Entity*, Position *positions, Velocity *velocities) {
+    static_assert(sizeof(Position) == sizeof(glm::vec2) && sizeof(Velocity) == sizeof(glm::vec2));
+    integrate(&positions->value, &velocities->value, nullptr, count, dt, worldSize);
+  });
+
+  // Fixed steps per tick rather than per second, the field is in lockstep
+  // with the ticks whatever backend runs it.
+  field.step(fieldParams, fieldSteps);
+
+  ++tick;
 }
 
 void GameState::generate(const Config &cfg) {
+  glm::vec2 area = { float(cfg.worldSize.x), float(cfg.worldSize.y) };
+  if (cfg.worldSize.x <= 0 || cfg.worldSize.y <= 0) {
+    area = { float(cfg.windowW), float(cfg.windowH) };
+  }
+
+  worldSize = area;
+  tick = 0;
+
+  field.clear();
+  if (cfg.fieldSize.x > 0 && cfg.fieldSize.y > 0 && cfg.fieldBackend == FieldBackend::CPU) {
+    field.init(cfg.fieldSize);
+    fieldParams = makeFieldConstData(cfg.fieldSize);
+    fieldSteps = static_cast<int>(cfg.fieldStepsPerTick);
+  }
+
+  if (!cfg.sceneFile.empty()) {
+    Uint64 start = SDL_GetTicksNS();
+    if (loadScene(cfg.sceneFile, *this)) {
+      LOG_INFO("GEN: loaded %zu sprites from scene %s in %.3fms\n", world.size(), cfg.sceneFile.c_str(), double(SDL_GetTicksNS() - start) / SDL_NS_PER_MS);
+      return;
+    }
+    LOG_WARN("GEN: falling back to generated sprites\n");
+  }
+
+  if (cfg.spriteCount == 0) {
+    world.clear();
+    return;
+  }
+
+  // Everything the sprites depend on
+  uint64_t key = 0xcbf29ce484222325ull;
+  key = hashBytes(key, &GENERATOR_VERSION, sizeof(GENERATOR_VERSION));
+  // The chunks seed the generator
+  key = hashBytes(key, &World::CHUNK_BYTES, sizeof(World::CHUNK_BYTES));
+  key = hashBytes(key, &cfg.worldSeed, sizeof(cfg.worldSeed));
+  key = hashBytes(key, &cfg.spriteCount, sizeof(cfg.spriteCount));
+  key = hashBytes(key, &area, sizeof(area));
+
+  std::string path;
+  if (!cfg.worldCacheDir.empty()) {
+    char name[32];
+    snprintf(name, sizeof(name), "world_%016" SDL_PRIx64 ".bin", key);
+    path = (std::filesystem::path(cfg.worldCacheDir) / name).string();
+  }
+
+  Uint64 start = SDL_GetTicksNS();
+  if (!path.empty() && loadSprites(path, key)) {
+    LOG_INFO("GEN: loaded %zu sprites from %s in %.3fms\n", world.size(), path.c_str(), double(SDL_GetTicksNS() - start) / SDL_NS_PER_MS);
+    return;
+  }
+
+  generateSprites(cfg);
+  LOG_INFO("GEN: generated %zu sprites in %.3fms\n", world.size(), double(SDL_GetTicksNS() - start) / SDL_NS_PER_MS);
+
+  if (!path.empty()) {
+    start = SDL_GetTicksNS();
+    if (SDL_CreateDirectory(cfg.worldCacheDir.c_str()) && saveSprites(path, key)) {
+      LOG_INFO("GEN: cached to %s in %.3fms\n", path.c_str(), double(SDL_GetTicksNS() - start) / SDL_NS_PER_MS);
+    } else {
+      LOG_ERROR("GEN: failed to cache to %s: %s\n", path.c_str(), SDL_GetError());
+    }
+  }
+}
+
+void GameState::generateSprites(const Config &cfg) {
+  glm::vec2 area = worldSize;
+
+  world.clear();
+  world.createMany(cfg.spriteCount, Position{}, Depth{}, Size{}, Velocity{}, Color{});
+
+  // Every chunk has its own generator seeded by its first entity, so the
+  // result doesn't depend on how the chunks are spread over the workers.
+  world.parallelEach<Position, Depth, Size, Velocity, Color>(CHUNK_GRAIN, [&](
+    uint32_t count,
+    const Entity *entities,
+    Position *positions,
+    Depth *depths,
+    Size *sizes,
+    Velocity *velocities,
+    Color *colors
+  ) {
+    std::seed_seq seed = { cfg.worldSeed, cfg.spriteCount, entities[0].index };
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> x(0.f, area.x);
+    std::uniform_real_distribution<float> y(0.f, area.y);
+    std::uniform_real_distribution<float> depth(0.f, 1.f);
+    std::uniform_real_distribution<float> size(16.f, 128.f);
+    std::uniform_real_distribution<float> vel(-64.f, 64.f);
+
+    for (uint32_t i = 0; i < count; ++i) {
+      positions[i].value = { x(rng), y(rng) };
+      depths[i].value = depth(rng);
+      sizes[i].value = { size(rng), size(rng) };
+      velocities[i].value = { vel(rng), vel(rng) };
+      colors[i].value = static_cast<uint32_t>(rng()) | 0xff000000u;
+    }
+  });
+}
+
+bool GameState::loadSprites(const std::string &path, uint64_t key) {
+  size_t size = 0;
+  void *data = SDL_LoadFile(path.c_str(), &size);
+  if (data == nullptr) {
+    return false;
+  }
+
+  WorldCacheHeader header;
+  if (size >= sizeof(header)) {
+    std::memcpy(&header, data, sizeof(header));
+  }
+  if (size < sizeof(header) ||
+    header.magic != CACHE_MAGIC ||
+    header.version != GENERATOR_VERSION ||
+    header.key != key ||
+    size != sizeof(header) + header.count * spriteBytes<Position, Depth, Size, Velocity, Color>()
+  ) {
+    LOG_WARN("GEN: ignoring stale cache %s\n", path.c_str());
+    SDL_free(data);
+    return false;
+  }
+
+  world.clear();
+  world.createMany(header.count, Position{}, Depth{}, Size{}, Velocity{}, Color{});
+
+  // Right after a clear the entities are numbered in creation order,
+  // so an entity's index is its place in the columns.
+  const auto *columns = static_cast<const uint8_t*>(data) + sizeof(header);
+  uint64_t n = header.count;
+  world.parallelEach<Position, Depth, Size, Velocity, Color>(CHUNK_GRAIN, [&](
+    uint32_t count,
+    const Entity *entities,
+    Position *positions,
+    Depth *depths,
+    Size *sizes,
+    Velocity *velocities,
+    Color *colors
+  ) {
+    uint64_t first = entities[0].index;
+    const uint8_t *src = columns;
+    auto read = [&](auto *dst) {
+      using T = std::remove_pointer_t<decltype(dst)>;
+      std::memcpy(dst, src + first * sizeof(T), count * sizeof(T));
+      src += n * sizeof(T);
+    };
+    read(positions);
+    read(depths);
+    read(sizes);
+    read(velocities);
+    read(colors);
+  });
+  SDL_free(data);
+
+  return true;
 }
 
+bool GameState::saveSprites(const std::string &path, uint64_t key) const {
+  WorldCacheHeader header = {
+    .magic = CACHE_MAGIC,
+    .version = GENERATOR_VERSION,
+    .key = key,
+    .count = world.size(),
+  };
+
+  // Written next to the cache and renamed over it once complete, so a
+  // crash never leaves a truncated cache behind.
+  std::string tmpPath = path + ".tmp";
+  SDL_IOStream *file = nullptr;
+  SDL_CHECK((file = SDL_IOFromFile(tmpPath.c_str(), "wb")));
+
+  bool res = SDL_WriteIO(file, &header, sizeof(header)) == sizeof(header);
+  auto write = [&]<class T>() {
+    world.eachChunk<const T>([&](uint32_t count, const Entity*, const T *column) {
+      res = res && SDL_WriteIO(file, column, count * sizeof(T)) == count * sizeof(T);
+    });
+  };
+  write.operator()<Position>();
+  write.operator()<Depth>();
+  write.operator()<Size>();
+  write.operator()<Velocity>();
+  write.operator()<Color>();
+
+  res = SDL_CloseIO(file) && res;
+  if (!res || !SDL_RenamePath(tmpPath.c_str(), path.c_str())) {
+    SDL_RemovePath(tmpPath.c_str());
+    return false;
+  }
+
+  return true;
+}
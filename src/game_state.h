@@ -2,10 +2,68 @@
 
 struct Config;
 
+#include "ecs/world.h"
+#include "sim/field.h"
+
+#include <cstdint>
+#include <string>
+
 #include <glm/vec2.hpp>
 #include "gpu_shared/cpu_gpu_shared.h"
 
+// Sprite components
+
+// Kept apart from the depth so that the motion columns are all float2
+// and integrate can stream over them.
+struct Position {
+  // Center in pixels
+  glm::vec2 value;
+};
+
+struct Depth {
+  // In [0, 1], 0 is nearest
+  float value;
+};
+
+struct Size {
+  glm::vec2 value;
+};
+
+struct Velocity {
+  // Pixels per second
+  glm::vec2 value;
+};
+
+struct Color {
+  // RGBA8, R in the lowest byte
+  uint32_t value;
+};
+
 struct GameState {
+  World world;
+
+  // Sprites bounce off the edges of the world.
+  glm::vec2 worldSize = { 0.f, 0.f };
+
+  // Top-left corner of the view in world pixels
+  glm::vec2 camera = { 0.f, 0.f };
+
+  // Only simulated here with the CPU field backend
+  Field field;
+  FieldConstData fieldParams = {};
+  int fieldSteps = 0;
+
+  // Number of updates since generate
+  uint64_t tick = 0;
+
+  // Loads the sprites from Config::sceneFile if set. Otherwise loads them
+  // from Config::worldCacheDir if they were generated with the same
+  // parameters before, generates and caches them otherwise.
   void generate(const Config& cfg);
   void update(double deltaTime);
+
+private:
+  void generateSprites(const Config &cfg);
+  bool loadSprites(const std::string &path, uint64_t key);
+  bool saveSprites(const std::string &path, uint64_t key) const;
 };
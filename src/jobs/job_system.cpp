@@ -0,0 +1,318 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <cassert>
+#include <optional>
+
+namespace {
+
+// Set for the worker threads only
+thread_local const JobSystem *currentSystem = nullptr;
+thread_local uint32_t currentQueueIdx = 0;
+
+// The external queue of every other thread, handed out as they first
+// push or wait.
+std::atomic<uint32_t> nextExternalQueue = 0;
+thread_local uint32_t externalQueueIdx = nextExternalQueue++ % JobSystem::EXTERNAL_QUEUES;
+
+}
+
+bool JobSystem::init(uint32_t numWorkers) {
+  deinit();
+
+  if (numWorkers == 0) {
+    numWorkers = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+  }
+
+  numQueues = EXTERNAL_QUEUES + numWorkers;
+  queues = std::make_unique<Queue[]>(numQueues);
+
+  running = true;
+  activeWorkers = numWorkers;
+  threads.reserve(numWorkers);
+  for (uint32_t i = 0; i < numWorkers; ++i) {
+    threads.emplace_back(&JobSystem::workerLoop, this, i);
+  }
+
+  return true;
+}
+
+void JobSystem::deinit() {
+  if (!running) {
+    return;
+  }
+
+  {
+    std::lock_guard lock(sleepMutex);
+    running = false;
+  }
+  wake.notify_all();
+  unpark.notify_all();
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+
+  // Whatever is left would never run anyway.
+  queues.reset();
+  numQueues = 0;
+  queued = 0;
+  activeWorkers = 0;
+}
+
+uint32_t JobSystem::setActiveWorkers(uint32_t count) {
+  if (count == 0 || count > numWorkers()) {
+    count = numWorkers();
+  }
+
+  {
+    std::lock_guard lock(sleepMutex);
+    activeWorkers = count;
+  }
+  unpark.notify_all();
+
+  return count;
+}
+
+void JobSystem::run(JobFn fn, JobCounter *counter, JobCounter *after) {
+  assert(running);
+
+  if (counter != nullptr) {
+    counter->pending.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  Job job = { std::move(fn), counter };
+
+  if (after != nullptr) {
+    // finish() takes the continuations under the same lock after
+    // pending drops to zero, so the job can't be missed.
+    std::lock_guard lock(after->mutex);
+    if (!after->done()) {
+      after->continuations.push_back(std::move(job));
+      return;
+    }
+  }
+
+  push(std::move(job));
+}
+
+void JobSystem::wait(JobCounter &counter) {
+  uint32_t queueIdx = currentQueue();
+  uint32_t spins = 0;
+  while (!counter.done()) {
+    if (runOne(queueIdx)) {
+      spins = 0;
+      continue;
+    }
+    if (++spins < WAIT_SPINS) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    // The jobs it waits for are running elsewhere. Woken when a counter
+    // is done or there is a job to run meanwhile, same as in push, either
+    // finish sees waiting or this sees the counter done.
+    std::unique_lock lock(sleepMutex);
+    ++sleeping;
+    ++waiting;
+    wake.wait(lock, [this, &counter] { return counter.done() || queued > 0 || !running; });
+    --waiting;
+    --sleeping;
+    spins = 0;
+  }
+
+  // The last job drops pending under the lock and still holds it,
+  // so make sure it's done with the counter before the caller frees it.
+  std::lock_guard lock(counter.mutex);
+}
+
+void JobSystem::parallelFor(
+  size_t begin,
+  size_t end,
+  size_t grain,
+  const std::function<void(size_t, size_t)> &fn
+) {
+  if (begin >= end) {
+    return;
+  }
+  grain = std::max<size_t>(grain, 1);
+
+  // Not worth the scheduling.
+  if (end - begin <= grain || threads.empty()) {
+    fn(begin, end);
+    return;
+  }
+
+  // Captured by reference so that the jobs fit std::function without allocating
+  struct Range {
+    const std::function<void(size_t, size_t)> &fn;
+    size_t end;
+    size_t grain;
+  } range = { fn, end, grain };
+
+  JobCounter counter;
+  for (size_t chunk = begin; chunk < end; chunk += grain) {
+    run([&range, chunk] { range.fn(chunk, std::min(chunk + range.grain, range.end)); }, &counter);
+  }
+
+  wait(counter);
+}
+
+void JobSystem::Queue::pushBack(Job job) {
+  if (count == jobs.size()) {
+    std::vector<Job> grown(std::max<size_t>(jobs.size() * 2, 16));
+    for (size_t i = 0; i < count; ++i) {
+      grown[i] = std::move(jobs[(head + i) % jobs.size()]);
+    }
+    jobs = std::move(grown);
+    head = 0;
+  }
+
+  jobs[(head + count) % jobs.size()] = std::move(job);
+  ++count;
+}
+
+JobSystem::Job JobSystem::Queue::popBack() {
+  assert(count > 0);
+  --count;
+  return std::move(jobs[(head + count) % jobs.size()]);
+}
+
+JobSystem::Job JobSystem::Queue::popFront() {
+  assert(count > 0);
+  Job job = std::move(jobs[head]);
+  head = (head + 1) % jobs.size();
+  --count;
+  return job;
+}
+
+void JobSystem::workerLoop(uint32_t worker) {
+  uint32_t queueIdx = EXTERNAL_QUEUES + worker;
+  currentSystem = this;
+  currentQueueIdx = queueIdx;
+
+  while (running) {
+    // The jobs left in a parked worker's queue are stolen by the others.
+    if (worker >= activeWorkers) {
+      // It may have taken the wakeup meant for an active worker
+      if (queued > 0) {
+        wake.notify_one();
+      }
+
+      std::unique_lock lock(sleepMutex);
+      unpark.wait(lock, [this, worker] { return worker < activeWorkers || !running; });
+      continue;
+    }
+
+    if (runOne(queueIdx)) {
+      continue;
+    }
+
+    std::unique_lock lock(sleepMutex);
+    ++sleeping;
+    wake.wait(lock, [this] { return queued > 0 || !running; });
+    --sleeping;
+  }
+
+  currentSystem = nullptr;
+}
+
+uint32_t JobSystem::currentQueue() const {
+  return currentSystem == this ? currentQueueIdx : externalQueueIdx;
+}
+
+void JobSystem::push(Job job) {
+  Queue &queue = queues[currentQueue()];
+  {
+    std::lock_guard lock(queue.mutex);
+    queue.pushBack(std::move(job));
+  }
+  ++queued;
+
+  // A worker that is about to sleep increments sleeping before checking
+  // queued, so either it sees the job or we see it.
+  if (sleeping > 0) {
+    { std::lock_guard lock(sleepMutex); }
+    wake.notify_one();
+  }
+}
+
+bool JobSystem::runOne(uint32_t queueIdx) {
+  if (queued == 0) {
+    return false;
+  }
+
+  std::optional<Job> job;
+
+  {
+    Queue &own = queues[queueIdx];
+    std::lock_guard lock(own.mutex);
+    if (!own.empty()) {
+      job = own.popBack();
+    }
+  }
+
+  for (uint32_t i = 1; !job && i < numQueues; ++i) {
+    Queue &victim = queues[(queueIdx + i) % numQueues];
+    std::lock_guard lock(victim.mutex);
+    if (!victim.empty()) {
+      job = victim.popFront();
+    }
+  }
+
+  if (!job) {
+    return false;
+  }
+
+  --queued;
+  job->fn();
+  finish(*job);
+
+  return true;
+}
+
+void JobSystem::finish(Job &job) {
+  JobCounter *counter = job.counter;
+  if (counter == nullptr) {
+    return;
+  }
+
+  std::vector<Job> continuations;
+  {
+    std::lock_guard lock(counter->mutex);
+    if (counter->pending.fetch_sub(1) != 1) {
+      return;
+    }
+    continuations = std::move(counter->continuations);
+    counter->continuations.clear();
+  }
+
+  if (waiting > 0) {
+    { std::lock_guard lock(sleepMutex); }
+    wake.notify_all();
+  }
+
+  for (auto &continuation : continuations) {
+    push(std::move(continuation));
+  }
+}
+
+JobSystem *jobSystem = nullptr;
+
+void initJobSystem(uint32_t numWorkers) {
+  deinitJobSystem();
+  jobSystem = new JobSystem;
+  jobSystem->init(numWorkers);
+}
+
+JobSystem &getJobSystem() {
+  assert(jobSystem != nullptr);
+  return *jobSystem;
+}
+
+void deinitJobSystem() {
+  if (jobSystem == nullptr) return;
+  delete jobSystem;
+  jobSystem = nullptr;
+}
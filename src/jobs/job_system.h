@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using JobFn = std::function<void()>;
+
+class JobSystem;
+
+// Counts the unfinished jobs of a batch. Jobs can be made to wait for a
+// counter, see JobSystem::run. Don't reuse a counter while something may
+// still be waiting for it.
+class JobCounter {
+private:
+  friend class JobSystem;
+
+  struct Job {
+    JobFn fn;
+    JobCounter *counter;
+  };
+
+  std::atomic<uint32_t> pending = 0;
+
+  // Jobs to run once pending reaches zero
+  std::mutex mutex;
+  std::vector<Job> continuations;
+
+public:
+  bool done() const {
+    return pending.load(std::memory_order_acquire) == 0;
+  }
+};
+
+// Work-stealing thread pool. Every worker owns a queue - it pushes and
+// pops its own jobs from the back (LIFO, cache friendly) and steals from
+// the front of the others' when it runs out. Threads that are not
+// workers (render, sim) get queues of their own too, as long as there are
+// at most EXTERNAL_QUEUES of them.
+// Threads that wait for jobs (JobSystem::wait) run jobs meanwhile, and
+// sleep once there are none left to run.
+class JobSystem {
+public:
+  static constexpr uint32_t EXTERNAL_QUEUES = 4;
+  // Jobs a waiting thread looks for before it goes to sleep
+  static constexpr uint32_t WAIT_SPINS = 64;
+
+private:
+  using Job = JobCounter::Job;
+
+  // Ring buffer of jobs. It only grows, so once warmed up pushing and
+  // popping don't allocate (unlike a std::deque).
+  struct Queue {
+    std::mutex mutex;
+    std::vector<Job> jobs;
+    size_t head = 0;
+    size_t count = 0;
+
+    bool empty() const { return count == 0; }
+    void pushBack(Job job);
+    Job popBack();
+    Job popFront();
+  };
+
+  std::vector<std::thread> threads;
+  // [0, EXTERNAL_QUEUES) are for external threads, [EXTERNAL_QUEUES + i]
+  // for worker i
+  std::unique_ptr<Queue[]> queues;
+  uint32_t numQueues = 0;
+
+  std::atomic<bool> running = false;
+  // Jobs sitting in any of the queues
+  std::atomic<uint32_t> queued = 0;
+
+  std::mutex sleepMutex;
+  std::condition_variable wake;
+  std::atomic<uint32_t> sleeping = 0;
+  // Of the sleeping threads, the ones in wait. Woken when a counter is
+  // done.
+  std::atomic<uint32_t> waiting = 0;
+
+  // Workers past this one are parked, see setActiveWorkers
+  std::atomic<uint32_t> activeWorkers = 0;
+  std::condition_variable unpark;
+
+public:
+  ~JobSystem() {
+    deinit();
+  }
+
+  // 0 workers means one per hardware thread except the calling one.
+  bool init(uint32_t numWorkers);
+  void deinit();
+
+  uint32_t numWorkers() const { return static_cast<uint32_t>(threads.size()); }
+  uint32_t numActiveWorkers() const { return activeWorkers; }
+
+  // Parks the workers past the first count until they're made active
+  // again, 0 means all of them. There can't be more than were started.
+  // Returns the number of active workers.
+  uint32_t setActiveWorkers(uint32_t count);
+
+  // Queues fn. counter (if any) is incremented now and decremented when fn
+  // returns. If after is given fn is only queued once after is done.
+  void run(JobFn fn, JobCounter *counter = nullptr, JobCounter *after = nullptr);
+
+  // Runs queued jobs on the calling thread until counter is done.
+  void wait(JobCounter &counter);
+
+  // Splits [begin, end) into chunks of at most grain elements and calls
+  // fn(chunkBegin, chunkEnd) for each of them in parallel. Blocks until
+  // all chunks are done.
+  void parallelFor(
+    size_t begin,
+    size_t end,
+    size_t grain,
+    const std::function<void(size_t, size_t)> &fn
+  );
+
+private:
+  void workerLoop(uint32_t worker);
+
+  uint32_t currentQueue() const;
+  void push(Job job);
+  // Pops a job from the given queue or steals one from the others
+  // and runs it. Returns false if there was nothing to run.
+  bool runOne(uint32_t queueIdx);
+  void finish(Job &job);
+};
+
+JobSystem &getJobSystem();
+void initJobSystem(uint32_t numWorkers);
+void deinitJobSystem();
@@ -0,0 +1,551 @@
+#include "log.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <SDL3/SDL.h>
+
+namespace {
+
+using detail::LogArg;
+using detail::LogArgs;
+
+// Per thread
+constexpr size_t BUFFER_SIZE = 64 * 1024;
+constexpr auto FLUSH_INTERVAL = std::chrono::milliseconds(10);
+
+// A message in a ring buffer, followed by its LogArgs
+struct Record {
+  uint32_t size = 0;
+  uint32_t suppressed = 0;
+  Uint64 timeNS = 0;
+  const char *format = nullptr;
+};
+
+// Single producer, the thread that owns it, single consumer, the logger
+// thread. Records are contiguous in the stream of bytes, which wraps
+// around the end of data.
+class RingBuffer {
+private:
+  char data[BUFFER_SIZE];
+  // Positions in the stream, only ever growing
+  std::atomic<uint64_t> head = 0;
+  std::atomic<uint64_t> tail = 0;
+
+public:
+  // Messages that didn't fit since the last read
+  std::atomic<uint64_t> dropped = 0;
+  // Set when the owning thread exits, the logger thread drains it and
+  // hands it to the next new thread.
+  std::atomic<bool> retired = false;
+
+  bool push(const Record &record, const LogArgs &args) {
+    uint64_t h = head.load(std::memory_order_relaxed);
+    if (BUFFER_SIZE - (h - tail.load(std::memory_order_acquire)) < record.size) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    write(h, &record, sizeof(record));
+    write(h + sizeof(record), args.data, args.size);
+    head.store(h + record.size, std::memory_order_release);
+    return true;
+  }
+
+  // Appends the records to out, each record's offset in out to offsets.
+  void popAll(std::vector<char> &out, std::vector<size_t> &offsets) {
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    uint64_t h = head.load(std::memory_order_acquire);
+    while (t < h) {
+      Record record;
+      read(t, &record, sizeof(record));
+
+      offsets.push_back(out.size());
+      out.resize(out.size() + record.size);
+      read(t, out.data() + offsets.back(), record.size);
+      t += record.size;
+    }
+    tail.store(t, std::memory_order_release);
+  }
+
+private:
+  void write(uint64_t pos, const void *src, size_t size) {
+    size_t offset = pos % BUFFER_SIZE;
+    size_t first = std::min(size, BUFFER_SIZE - offset);
+    std::memcpy(data + offset, src, first);
+    std::memcpy(data, static_cast<const char*>(src) + first, size - first);
+  }
+
+  void read(uint64_t pos, void *dst, size_t size) const {
+    size_t offset = pos % BUFFER_SIZE;
+    size_t first = std::min(size, BUFFER_SIZE - offset);
+    std::memcpy(dst, data + offset, first);
+    std::memcpy(static_cast<char*>(dst) + first, data, size - first);
+  }
+};
+
+struct Arg {
+  LogArg type = LogArg::SIGNED;
+  uint8_t bytes = 0;
+  int64_t i = 0;
+  uint64_t u = 0;
+  double d = 0.;
+  const void *p = nullptr;
+  const char *str = "";
+};
+
+// Walks a record's arguments
+class ArgReader {
+private:
+  const char *data;
+  const char *end;
+
+public:
+  ArgReader(const char *data, size_t size) : data(data), end(data + size) {}
+
+  bool next(Arg &arg) {
+    if (end - data < 1) {
+      return false;
+    }
+
+    arg.type = static_cast<LogArg>(*data);
+    if (arg.type == LogArg::STRING) {
+      uint16_t len = 0;
+      if (end - data < 4) {
+        return false;
+      }
+      std::memcpy(&len, data + 1, sizeof(len));
+      arg.str = data + 3;
+      data += 4 + len;
+      return data <= end;
+    }
+
+    arg.bytes = static_cast<uint8_t>(data[1]);
+    const char *val = data + 2;
+    switch (arg.type) {
+    case LogArg::SIGNED:
+      std::memcpy(&arg.i, val, sizeof(arg.i));
+      data = val + sizeof(arg.i);
+      break;
+    case LogArg::UNSIGNED:
+      std::memcpy(&arg.u, val, sizeof(arg.u));
+      data = val + sizeof(arg.u);
+      break;
+    case LogArg::DOUBLE:
+      std::memcpy(&arg.d, val, sizeof(arg.d));
+      data = val + sizeof(arg.d);
+      break;
+    case LogArg::POINTER:
+      std::memcpy(&arg.p, val, sizeof(arg.p));
+      data = val + sizeof(arg.p);
+      break;
+    default:
+      return false;
+    }
+
+    return data <= end;
+  }
+};
+
+int64_t asSigned(const Arg &arg) {
+  switch (arg.type) {
+  case LogArg::SIGNED: return arg.i;
+  case LogArg::UNSIGNED: return static_cast<int64_t>(arg.u);
+  case LogArg::DOUBLE: return static_cast<int64_t>(arg.d);
+  case LogArg::POINTER: return static_cast<int64_t>(reinterpret_cast<uintptr_t>(arg.p));
+  default: return 0;
+  }
+}
+
+uint64_t asUnsigned(const Arg &arg) {
+  // A negative int printed with %x is 32 bits wide, as with printf
+  if (arg.type == LogArg::SIGNED && arg.bytes < sizeof(uint64_t)) {
+    return static_cast<uint64_t>(arg.i) & ((uint64_t(1) << (arg.bytes * 8)) - 1);
+  }
+  return static_cast<uint64_t>(asSigned(arg));
+}
+
+double asDouble(const Arg &arg) {
+  switch (arg.type) {
+  case LogArg::DOUBLE: return arg.d;
+  case LogArg::UNSIGNED: return static_cast<double>(arg.u);
+  default: return static_cast<double>(asSigned(arg));
+  }
+}
+
+// printf of the record's format and arguments. Every conversion is
+// formatted on its own, with the length modifier of the type the
+// argument was logged as.
+void formatRecord(const char *record, std::string &out) {
+  Record header;
+  std::memcpy(&header, record, sizeof(header));
+  ArgReader reader(record + sizeof(header), header.size - sizeof(header));
+
+  const char *p = header.format;
+  while (*p != '\0') {
+    const char *percent = std::strchr(p, '%');
+    if (percent == nullptr) {
+      out.append(p);
+      break;
+    }
+    out.append(p, percent);
+    p = percent + 1;
+
+    if (*p == '%') {
+      out += '%';
+      ++p;
+      continue;
+    }
+
+    // %[flags][width][.precision][length]conversion, the spec is rebuilt
+    // without the length. What doesn't fit is dropped, 4 bytes are left
+    // for the length, the conversion and the zero.
+    char spec[32] = "%";
+    size_t specLen = 1;
+    auto copySpec = [&](size_t n) {
+      size_t copied = std::min(n, sizeof(spec) - 4 - specLen);
+      std::memcpy(spec + specLen, p, copied);
+      specLen += copied;
+      p += n;
+    };
+
+    int stars[2];
+    int numStars = 0;
+    auto star = [&] {
+      Arg arg;
+      stars[numStars++] = reader.next(arg) ? static_cast<int>(asSigned(arg)) : 0;
+      if (specLen < sizeof(spec) - 4) {
+        spec[specLen++] = '*';
+      }
+      ++p;
+    };
+
+    copySpec(std::strspn(p, "-+ #0"));
+    if (*p == '*') {
+      star();
+    } else {
+      copySpec(std::strspn(p, "0123456789"));
+    }
+    if (*p == '.') {
+      copySpec(1);
+      if (*p == '*') {
+        star();
+      } else {
+        copySpec(std::strspn(p, "0123456789"));
+      }
+    }
+    p += std::strspn(p, "hljztL");
+
+    char conv = *p;
+    if (conv == '\0') {
+      break;
+    }
+    ++p;
+
+    Arg arg;
+    if (!reader.next(arg)) {
+      out.append("(missing)");
+      continue;
+    }
+
+    char buf[LOG_MAX_STRING + 64];
+    auto print = [&](const char *length, auto val) {
+      std::strcpy(spec + specLen, length);
+      size_t len = std::strlen(spec);
+      spec[len] = conv;
+      spec[len + 1] = '\0';
+
+      int n = 0;
+      if (numStars == 0) {
+        n = snprintf(buf, sizeof(buf), spec, val);
+      } else if (numStars == 1) {
+        n = snprintf(buf, sizeof(buf), spec, stars[0], val);
+      } else {
+        n = snprintf(buf, sizeof(buf), spec, stars[0], stars[1], val);
+      }
+      if (n > 0) {
+        out.append(buf, std::min(size_t(n), sizeof(buf) - 1));
+      }
+    };
+
+    switch (conv) {
+    case 'd':
+    case 'i':
+      print("ll", static_cast<long long>(asSigned(arg)));
+      break;
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+      print("ll", static_cast<unsigned long long>(asUnsigned(arg)));
+      break;
+    case 'c':
+      print("", static_cast<int>(asSigned(arg)));
+      break;
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      print("", asDouble(arg));
+      break;
+    case 's':
+      print("", arg.type == LogArg::STRING ? arg.str : "(?)");
+      break;
+    case 'p':
+      print("", arg.type == LogArg::POINTER ? arg.p : reinterpret_cast<const void*>(uintptr_t(asUnsigned(arg))));
+      break;
+    default:
+      // Including %n
+      out.append("(?)");
+      break;
+    }
+  }
+
+  if (header.suppressed == 0) {
+    return;
+  }
+
+  // Before the line break, if it has one
+  bool newline = !out.empty() && out.back() == '\n';
+  if (newline) {
+    out.pop_back();
+  }
+  char buf[64];
+  snprintf(buf, sizeof(buf), " (%u more suppressed)", header.suppressed);
+  out.append(buf);
+  if (newline) {
+    out += '\n';
+  }
+}
+
+void writeOut(const std::string &text) {
+  fwrite(text.data(), 1, text.size(), stdout);
+  fflush(stdout);
+}
+
+class Logger {
+private:
+  std::mutex buffersMutex;
+  std::vector<std::unique_ptr<RingBuffer>> buffers;
+  // Retired and drained, reused before new ones are allocated
+  std::vector<std::unique_ptr<RingBuffer>> spareBuffers;
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable wake;
+  // Guarded by mutex
+  bool quit = false;
+
+  // The logger thread's, reused between flushes
+  std::vector<char> records;
+  std::vector<size_t> offsets;
+  std::string text;
+
+public:
+  // Bumped by every init and deinit so that threads drop the buffers of a
+  // previous logger
+  static inline std::atomic<uint32_t> generation = 0;
+
+  void start() {
+    quit = false;
+    thread = std::thread(&Logger::run, this);
+  }
+
+  void stop() {
+    {
+      std::lock_guard lock(mutex);
+      quit = true;
+    }
+    wake.notify_one();
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+
+  void notify() {
+    wake.notify_one();
+  }
+
+  RingBuffer *addBuffer() {
+    std::lock_guard lock(buffersMutex);
+    if (spareBuffers.empty()) {
+      return buffers.emplace_back(std::make_unique<RingBuffer>()).get();
+    }
+
+    RingBuffer *buffer = buffers.emplace_back(std::move(spareBuffers.back())).get();
+    spareBuffers.pop_back();
+    buffer->retired.store(false, std::memory_order_relaxed);
+    return buffer;
+  }
+
+private:
+  void run() {
+    bool done = false;
+    while (!done) {
+      {
+        std::unique_lock lock(mutex);
+        wake.wait_for(lock, FLUSH_INTERVAL, [this] { return quit; });
+        done = quit;
+      }
+      flush();
+    }
+  }
+
+  void flush() {
+    records.clear();
+    offsets.clear();
+    text.clear();
+
+    uint64_t dropped = 0;
+    {
+      std::lock_guard lock(buffersMutex);
+      for (size_t i = 0; i < buffers.size();) {
+        RingBuffer &buffer = *buffers[i];
+        // Checked first, the thread's last records are in by then.
+        bool retired = buffer.retired.load(std::memory_order_acquire);
+        buffer.popAll(records, offsets);
+        dropped += buffer.dropped.exchange(0, std::memory_order_relaxed);
+
+        if (retired) {
+          spareBuffers.push_back(std::move(buffers[i]));
+          buffers[i] = std::move(buffers.back());
+          buffers.pop_back();
+        } else {
+          ++i;
+        }
+      }
+    }
+
+    // Merges the threads' records, a thread's are in order already.
+    // std::sort as stable_sort allocates.
+    auto timeOf = [this](size_t offset) {
+      Record record;
+      std::memcpy(&record, records.data() + offset, sizeof(record));
+      return record.timeNS;
+    };
+    std::sort(offsets.begin(), offsets.end(), [&timeOf](size_t a, size_t b) {
+      Uint64 timeA = timeOf(a);
+      Uint64 timeB = timeOf(b);
+      return timeA != timeB ? timeA < timeB : a < b;
+    });
+
+    for (size_t offset : offsets) {
+      formatRecord(records.data() + offset, text);
+    }
+    if (dropped > 0) {
+      char buf[64];
+      snprintf(buf, sizeof(buf), "LOG: dropped %" SDL_PRIu64 " messages\n", dropped);
+      text.append(buf);
+    }
+
+    if (!text.empty()) {
+      writeOut(text);
+    }
+  }
+};
+
+std::unique_ptr<Logger> logger;
+std::atomic<bool> running = false;
+
+// Retires the thread's buffer when it exits
+struct ThreadBuffer {
+  RingBuffer *buffer = nullptr;
+  uint32_t generation = 0;
+
+  ~ThreadBuffer() {
+    if (buffer != nullptr && generation == Logger::generation.load(std::memory_order_acquire)) {
+      buffer->retired.store(true, std::memory_order_release);
+    }
+  }
+};
+
+thread_local ThreadBuffer threadBuffer;
+
+}
+
+namespace detail {
+
+bool logRateLimit(LogSite &site) {
+  Uint64 now = SDL_GetTicksNS();
+  uint64_t start = site.windowStartNS.load(std::memory_order_relaxed);
+  if (
+    now - start >= SDL_NS_PER_SECOND &&
+    site.windowStartNS.compare_exchange_strong(start, now, std::memory_order_relaxed)
+  ) {
+    site.count.store(0, std::memory_order_relaxed);
+  }
+
+  if (site.count.fetch_add(1, std::memory_order_relaxed) < LOG_SITE_LIMIT) {
+    return true;
+  }
+
+  site.suppressed.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+void logSubmit(LogSite &site, const LogArgs &args) {
+  Record record = {
+    .size = static_cast<uint32_t>(sizeof(Record) + args.size),
+    .suppressed = site.suppressed.exchange(0, std::memory_order_relaxed),
+    .timeNS = SDL_GetTicksNS(),
+    .format = site.format,
+  };
+
+  if (!running.load(std::memory_order_acquire)) {
+    char data[sizeof(Record) + LOG_MAX_ARGS_SIZE];
+    std::memcpy(data, &record, sizeof(record));
+    std::memcpy(data + sizeof(record), args.data, args.size);
+
+    std::string text;
+    formatRecord(data, text);
+    writeOut(text);
+    return;
+  }
+
+  uint32_t generation = Logger::generation.load(std::memory_order_acquire);
+  if (threadBuffer.buffer == nullptr || threadBuffer.generation != generation) {
+    // Once per thread
+    threadBuffer.buffer = logger->addBuffer();
+    threadBuffer.generation = generation;
+  }
+
+  threadBuffer.buffer->push(record, args);
+  if (site.level >= LogLevel::WARN) {
+    logger->notify();
+  }
+}
+
+}
+
+void initLog() {
+  deinitLog();
+
+  logger = std::make_unique<Logger>();
+  Logger::generation.fetch_add(1, std::memory_order_release);
+  logger->start();
+  running.store(true, std::memory_order_release);
+}
+
+void deinitLog() {
+  if (logger == nullptr) {
+    return;
+  }
+
+  running.store(false, std::memory_order_release);
+  Logger::generation.fetch_add(1, std::memory_order_release);
+  logger->stop();
+  logger = nullptr;
+}
+
+void setLogLevel(LogLevel level) {
+  detail::logLevel.store(level, std::memory_order_relaxed);
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Asynchronous logging. A call copies the pointer to its format string
+// and its arguments into the calling thread's ring buffer, the logger's
+// thread formats them printf-style and writes them to stdout, in the
+// order they were logged. A call never blocks: if the buffer is full the
+// message is dropped and counted. Every call site logs at most
+// LOG_SITE_LIMIT messages a second, the next one after that tells how
+// many were suppressed.
+// Before initLog and after deinitLog the messages are written right away.
+//
+// The format has to be a string literal. Numbers and pointers are copied
+// as they are, C strings, std::string and std::string_view up to
+// LOG_MAX_STRING bytes - the length modifiers in the format don't matter,
+// the arguments' types are kept. Levels below LOG_MIN_LEVEL (see the
+// CMake option) are compiled out along with their arguments, the rest
+// are filtered at runtime, see setLogLevel.
+
+enum class LogLevel : uint8_t {
+  TRACE,
+  DEBUG,
+  INFO,
+  WARN,
+  ERROR,
+};
+
+// A LogLevel's value, it has to work in #if
+#ifndef LOG_MIN_LEVEL
+#ifdef __DEBUG
+#define LOG_MIN_LEVEL 1
+#else
+#define LOG_MIN_LEVEL 2
+#endif
+#endif
+
+inline constexpr uint32_t LOG_SITE_LIMIT = 100;
+inline constexpr size_t LOG_MAX_STRING = 256;
+// Of a message's arguments, the ones that don't fit are dropped.
+inline constexpr size_t LOG_MAX_ARGS_SIZE = 1024;
+
+// Every LOG_* call has one
+struct LogSite {
+  const char *format = nullptr;
+  LogLevel level = LogLevel::INFO;
+
+  // The rate limit's current one second window
+  std::atomic<uint64_t> windowStartNS = 0;
+  std::atomic<uint32_t> count = 0;
+  std::atomic<uint32_t> suppressed = 0;
+};
+
+namespace detail {
+
+enum class LogArg : uint8_t {
+  SIGNED,
+  UNSIGNED,
+  DOUBLE,
+  STRING,
+  POINTER,
+};
+
+inline std::atomic<LogLevel> logLevel = static_cast<LogLevel>(LOG_MIN_LEVEL);
+
+// The arguments of one message: a LogArg, then an integer's size and its
+// value widened to 64 bits, a double, a pointer, or a string's 16-bit
+// length and its characters followed by a zero.
+struct LogArgs {
+  char data[LOG_MAX_ARGS_SIZE];
+  size_t size = 0;
+
+  template <class T>
+  void value(LogArg type, T val, uint8_t bytes = sizeof(T)) {
+    size_t need = 2 + sizeof(T);
+    if (size + need > sizeof(data)) {
+      size = sizeof(data);
+      return;
+    }
+
+    data[size] = static_cast<char>(type);
+    data[size + 1] = static_cast<char>(bytes);
+    std::memcpy(data + size + 2, &val, sizeof(T));
+    size += need;
+  }
+
+  void string(std::string_view str) {
+    if (size + 4 > sizeof(data)) {
+      size = sizeof(data);
+      return;
+    }
+
+    auto len = static_cast<uint16_t>(std::min({ str.size(), LOG_MAX_STRING, sizeof(data) - size - 4 }));
+    data[size] = static_cast<char>(LogArg::STRING);
+    std::memcpy(data + size + 1, &len, sizeof(len));
+    std::memcpy(data + size + 3, str.data(), len);
+    data[size + 3 + len] = '\0';
+    size += 4 + len;
+  }
+};
+
+template <class T>
+void addLogArg(LogArgs &args, const T &arg) {
+  using U = std::decay_t<T>;
+
+  if constexpr (std::is_same_v<U, char*> || std::is_same_v<U, const char*>) {
+    args.string(arg != nullptr ? std::string_view(arg) : std::string_view("(null)"));
+  } else if constexpr (std::is_same_v<U, std::string> || std::is_same_v<U, std::string_view>) {
+    args.string(arg);
+  } else if constexpr (std::is_pointer_v<U> || std::is_null_pointer_v<U>) {
+    args.value(LogArg::POINTER, static_cast<const void*>(arg));
+  } else if constexpr (std::is_enum_v<U>) {
+    addLogArg(args, static_cast<std::underlying_type_t<U>>(arg));
+  } else if constexpr (std::is_floating_point_v<U>) {
+    args.value(LogArg::DOUBLE, static_cast<double>(arg));
+  } else if constexpr (std::is_integral_v<U>) {
+    // The size printf would see, after the promotions
+    using Promoted = decltype(+arg);
+    if constexpr (std::is_signed_v<Promoted>) {
+      args.value(LogArg::SIGNED, static_cast<int64_t>(arg), sizeof(Promoted));
+    } else {
+      args.value(LogArg::UNSIGNED, static_cast<uint64_t>(arg), sizeof(Promoted));
+    }
+  } else {
+    static_assert(sizeof(U) == 0, "Not a printf argument");
+  }
+}
+
+// Counts against the site's rate limit, false if it's over it.
+bool logRateLimit(LogSite &site);
+void logSubmit(LogSite &site, const LogArgs &args);
+
+}
+
+void initLog();
+// Writes out the messages that are still buffered. The other threads
+// must have stopped logging, and not exit meanwhile.
+void deinitLog();
+
+void setLogLevel(LogLevel level);
+
+inline bool logEnabled(LogSite &site) {
+  return site.level >= detail::logLevel.load(std::memory_order_relaxed) && detail::logRateLimit(site);
+}
+
+template <class... Args>
+void logWrite(LogSite &site, const Args&... args) {
+  detail::LogArgs packed;
+  (detail::addLogArg(packed, args), ...);
+  detail::logSubmit(site, packed);
+}
+
+// The "" only compiles with a literal format.
+#define LOG_AT(level, format, ...) \
+do { \
+  static LogSite logSite_ = { "" format, level }; \
+  if (logEnabled(logSite_)) { \
+    logWrite(logSite_ __VA_OPT__(,) __VA_ARGS__); \
+  } \
+} while (false)
+
+#if LOG_MIN_LEVEL <= 0
+#define LOG_TRACE(...) LOG_AT(LogLevel::TRACE, __VA_ARGS__)
+#else
+#define LOG_TRACE(...) (void)0
+#endif
+
+#if LOG_MIN_LEVEL <= 1
+#define LOG_DEBUG(...) LOG_AT(LogLevel::DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) (void)0
+#endif
+
+#if LOG_MIN_LEVEL <= 2
+#define LOG_INFO(...) LOG_AT(LogLevel::INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) (void)0
+#endif
+
+#if LOG_MIN_LEVEL <= 3
+#define LOG_WARN(...) LOG_AT(LogLevel::WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) (void)0
+#endif
+
+#define LOG_ERROR(...) LOG_AT(LogLevel::ERROR, __VA_ARGS__)
@@ -7,6 +7,8 @@
 #include "defines.h"
 
 SDL_AppResult SDL_AppInit(void **as, int argc, char *argv[]) {
+  initLog();
+
   DEBUG_PRINT("CWD: %s\n", std::filesystem::current_path().c_str());
 
   initConfig();
@@ -20,20 +22,121 @@ SDL_AppResult SDL_AppInit(void **as, int argc, char *argv[]) {
 SDL_AppResult SDL_AppIterate(void *appstate) {
   AppState *as = (AppState*)appstate;
 
-  as->update();
+  if (auto res = as->applyConfigChanges(); res != SDL_APP_CONTINUE) {
+    return res;
+  }
+
+  // Reloading the config may allocate, it's not part of the frame.
+  as->frameAllocs.beginFrame();
+
+  // Right before update so the frame starts from the newest snapshot.
+  as->frameLimiter.wait();
 
-  SDL_CHECK_APP(as->renderer.draw(as->getShaderConstData(), as->renderData));
+  if (auto res = as->update(); res != SDL_APP_CONTINUE) {
+    return res;
+  }
+
+  if (auto res = as->renderer.draw(as->getShaderConstData(), as->renderData); res != SDL_APP_CONTINUE) {
+    return res;
+  }
+
+  // The stats below allocate, but only once a second.
+  if (!as->frameAllocs.endFrame()) {
+    return SDL_APP_FAILURE;
+  }
 
   auto last = as->lastStep;
-  as->lastStep = SDL_GetTicks();
+  as->lastStep = SDL_GetTicksNS();
 
   ++as->frameCount;
+  ++as->frameIndex;
   as->measurementTime += as->lastStep - last;
-  as->dt = (as->lastStep - last) / 1000.;
+  as->dt = double(as->finishFrame(as->lastStep - last)) / SDL_NS_PER_SECOND;
   as->elapsedTime += as->dt;
 
-  if (as->measurementTime >= 1000) {
-    printf("FRAME: %f FPS\n", double(as->frameCount * 1000) / as->measurementTime);
+  if (as->measurementTime >= SDL_NS_PER_SECOND) {
+    LOG_INFO("FRAME: %f FPS\n", double(as->frameCount * SDL_NS_PER_SECOND) / as->measurementTime);
+
+    auto pacing = as->frameLimiter.collectStats();
+    if (as->frameLimiter.enabled()) {
+      LOG_INFO(
+        "PACING: %.2f FPS jitter %.3fms (max %.3fms) sleep %.3fms spin %.3fms\n",
+        pacing.fps,
+        pacing.jitterMs,
+        pacing.maxJitterMs,
+        pacing.sleepMs,
+        pacing.spinMs
+      );
+    }
+
+    auto sim = as->simThread.collectStats();
+    LOG_INFO(
+      "SIM: tick %.3fms (max %.3fms) %.2f ticks/frame snapshot latency %.3fms"
+      " dropped %" SDL_PRIu64 " duplicated %" SDL_PRIu64 " uploads %" SDL_PRIu64 "\n",
+      sim.tickMs,
+      sim.maxTickMs,
+      sim.ticksPerFrame,
+      sim.snapshotLatencyMs,
+      sim.droppedSnapshots,
+      sim.duplicatedSnapshots,
+      as->renderer.collectSpriteUploads()
+    );
+
+    if (as->snapshotWriter.enabled()) {
+      auto snapshot = as->snapshotWriter.collectStats();
+      LOG_INFO(
+        "SNAPSHOT: %" SDL_PRIu64 " written (%" SDL_PRIu64 " skipped) %" SDL_PRIu64 "/%" SDL_PRIu64 " chunks"
+        " copy %.3fms write %.3fms\n",
+        snapshot.written,
+        snapshot.skipped,
+        snapshot.chunksWritten,
+        snapshot.chunksTotal,
+        snapshot.copyMs,
+        snapshot.writeMs
+      );
+    }
+
+    if (as->renderer.streaming()) {
+      auto stream = as->renderer.collectStreamStats();
+      LOG_INFO(
+        "STREAM: %u resident (%.1fMB) %u queued %u loading, %" SDL_PRIu64 " loaded %" SDL_PRIu64 " evicted"
+        " %" SDL_PRIu64 " cancelled, latency %.3fms (max %.3fms) update max %.3fms"
+        " hitches %" SDL_PRIu64 "/%" SDL_PRIu64 " (%" SDL_PRIu64 " uploading)\n",
+        stream.resident,
+        double(stream.residentBytes) / (1024. * 1024.),
+        stream.queued,
+        stream.loading,
+        stream.loaded,
+        stream.evicted,
+        stream.cancelled,
+        stream.avgLatencyMs,
+        stream.maxLatencyMs,
+        stream.maxUpdateMs,
+        stream.hitchFrames,
+        stream.frames,
+        stream.uploadHitchFrames
+      );
+    }
+
+    auto record = as->renderer.collectRecordStats();
+    for (const auto &[name, step] : record.steps) {
+      LOG_INFO("RECORD: %s %.3fms (+%.3fms submit)\n", name.c_str(), step.recordMs, step.submitMs);
+    }
+    for (const auto &[thread, ms] : record.threads) {
+      LOG_INFO("RECORD: thread %" SDL_PRIu64 " %.3fms\n", thread, ms);
+    }
+
+    if (getConfig().overdrawDebug) {
+      auto &overdraw = as->renderer.getOverdrawStats();
+      LOG_INFO(
+        "OVERDRAW: shaded %.2f submitted %.2f max %u layers/pixel\n",
+        overdraw.shadedLayers,
+        overdraw.submittedLayers,
+        overdraw.maxLayers
+      );
+    }
+    as->frameAllocs.report();
+
     as->measurementTime = 0;
     as->frameCount = 0;
   }
@@ -44,16 +147,15 @@ SDL_AppResult SDL_AppIterate(void *appstate) {
 SDL_AppResult SDL_AppEvent(void *appstate, SDL_Event *event) {
   auto as = (AppState*)appstate;
 
-  switch (event->type) {
-  case SDL_EVENT_QUIT:
-    DEBUG_PRINT("SDL_EVENT_QUIT %s\n", ""); // TODO: debug_print without args
-    return SDL_APP_SUCCESS;
-
-  default:
-    break;
+  // Replays only take closing the window from the live input.
+  if (as->replay.replaying() && event->type != SDL_EVENT_QUIT) {
+    return SDL_APP_CONTINUE;
+  }
+  if (as->recorder.recording()) {
+    as->recorder.event(*event);
   }
 
-  return SDL_APP_CONTINUE;
+  return as->handleEvent(*event);
 }
 
 void SDL_AppQuit(void *appstate, SDL_AppResult result) {
@@ -63,5 +165,6 @@ void SDL_AppQuit(void *appstate, SDL_AppResult result) {
   }
 
   deinitConfig();
+  deinitLog();
 }
 
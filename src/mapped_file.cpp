@@ -0,0 +1,113 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::open(const std::string &path) {
+  close();
+
+#ifdef _WIN32
+  HANDLE fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (fileHandle == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  file = fileHandle;
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(fileHandle, &fileSize)) {
+    close();
+    return false;
+  }
+  length = static_cast<size_t>(fileSize.QuadPart);
+  if (length == 0) {
+    return true;
+  }
+
+  mapping = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr) {
+    close();
+    return false;
+  }
+  bytes = static_cast<const std::byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    ::close(fd);
+    return false;
+  }
+  length = static_cast<size_t>(info.st_size);
+  if (length == 0) {
+    ::close(fd);
+    return true;
+  }
+
+  void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file alive
+  ::close(fd);
+  if (mapped != MAP_FAILED) {
+    bytes = static_cast<const std::byte*>(mapped);
+  }
+#endif
+
+  if (bytes == nullptr) {
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+  if (bytes != nullptr) {
+    UnmapViewOfFile(bytes);
+  }
+  if (mapping != nullptr) {
+    CloseHandle(mapping);
+  }
+  if (file != nullptr) {
+    CloseHandle(file);
+  }
+#else
+  if (bytes != nullptr) {
+    munmap(const_cast<std::byte*>(bytes), length);
+  }
+#endif
+
+  bytes = nullptr;
+  length = 0;
+  file = nullptr;
+  mapping = nullptr;
+}
+
+bool syncFile(const std::string &path) {
+#ifdef _WIN32
+  HANDLE fileHandle = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (fileHandle == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  bool res = FlushFileBuffers(fileHandle);
+  CloseHandle(fileHandle);
+#else
+  int fd = ::open(path.c_str(), O_WRONLY);
+  if (fd < 0) {
+    return false;
+  }
+  bool res = fsync(fd) == 0;
+  ::close(fd);
+#endif
+
+  return res;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// A file mapped read-only into memory. Pages are read in as they are
+// touched, so opening even a huge file is cheap.
+class MappedFile {
+private:
+  const std::byte *bytes = nullptr;
+  size_t length = 0;
+  // Platform handles of the mapping
+  void *file = nullptr;
+  void *mapping = nullptr;
+
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile &operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+    close();
+  }
+
+  // An empty file opens fine, with no data.
+  bool open(const std::string &path);
+  void close();
+
+  const std::byte *data() const { return bytes; }
+  size_t size() const { return length; }
+
+  std::string_view text() const { return { reinterpret_cast<const char*>(bytes), length }; }
+};
+
+// Waits until what was written to the file is on the disk, fsync or
+// FlushFileBuffers. Writes still buffered by a stream have to be flushed
+// first.
+bool syncFile(const std::string &path);
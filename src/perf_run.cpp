@@ -0,0 +1,93 @@
+#include "perf_run.h"
+
+#include "log.h"
+#include "process_memory.h"
+#include "replay.h"
+
+#include <algorithm>
+#include <cstdio>
+
+bool PerfRun::init(const std::string &reportPath, uint32_t frames, Uint64 startNS) {
+  if (frames == 0) {
+    LOG_ERROR("PERF: needs at least one frame\n");
+    return false;
+  }
+
+  this->reportPath = reportPath;
+  this->frames = frames;
+  warmup = frames / 10;
+  this->startNS = startNS;
+  startupMs = 0.;
+
+  frameMs.clear();
+  frameMs.reserve(frames);
+
+  return true;
+}
+
+std::optional<Uint64> PerfRun::next() const {
+  if (frameMs.size() >= frames) {
+    return std::nullopt;
+  }
+
+  return frameMs.size() + 1;
+}
+
+void PerfRun::addFrameTime(double ms) {
+  if (frameMs.empty()) {
+    startupMs = double(SDL_GetTicksNS() - startNS) / SDL_NS_PER_MS;
+  }
+
+  frameMs.push_back(ms);
+}
+
+bool PerfRun::report(const char *gpuDriver) const {
+  std::vector<double> measured(frameMs.begin() + std::min<size_t>(warmup, frameMs.size()), frameMs.end());
+  FrameTimeStats stats = summarizeFrameTimes(std::move(measured));
+  ProcessMemory memory = getProcessMemory();
+
+  LOG_INFO(
+    "PERF: %zu frames after %u warmup, startup %.3fms p50 %.3fms p95 %.3fms p99 %.3fms max %.3fms\n",
+    stats.frames,
+    warmup,
+    startupMs,
+    stats.p50Ms,
+    stats.p95Ms,
+    stats.p99Ms,
+    stats.maxMs
+  );
+
+  FILE *file = fopen(reportPath.c_str(), "w");
+  if (file == nullptr) {
+    LOG_ERROR("Failed to open %s\n", reportPath.c_str());
+    return false;
+  }
+
+  fprintf(
+    file,
+    "{\n"
+    "  \"gpu_driver\": \"%s\",\n"
+    "  \"frames\": %u,\n"
+    "  \"warmup\": %u,\n"
+    "  \"startup_ms\": %.3f,\n"
+    "  \"frame_ms_avg\": %.3f,\n"
+    "  \"frame_ms_p50\": %.3f,\n"
+    "  \"frame_ms_p95\": %.3f,\n"
+    "  \"frame_ms_p99\": %.3f,\n"
+    "  \"frame_ms_max\": %.3f,\n"
+    "  \"peak_mb\": %.1f\n"
+    "}\n",
+    gpuDriver,
+    frames,
+    warmup,
+    startupMs,
+    stats.avgMs,
+    stats.p50Ms,
+    stats.p95Ms,
+    stats.p99Ms,
+    stats.maxMs,
+    double(memory.peakResident) / (1024. * 1024.)
+  );
+
+  return fclose(file) == 0;
+}
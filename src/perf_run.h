@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <SDL3/SDL.h>
+
+// A fixed workload for the perf check, see bench/perf_check.cpp.
+// --perf <report.json> [--frames N] draws N frames with the simulation
+// in lockstep, one tick per frame, as fast as the GPU presents them.
+// Then it writes the frame time percentiles, the startup time and the
+// peak memory to the report and the app quits.
+class PerfRun {
+public:
+  static constexpr uint32_t DEFAULT_FRAMES = 600;
+
+private:
+  std::string reportPath;
+  uint32_t frames = 0;
+  // Left out of the percentiles, they still create pipelines and fill
+  // the caches.
+  uint32_t warmup = 0;
+  Uint64 startNS = 0;
+  // Until the first frame was drawn
+  double startupMs = 0.;
+
+  std::vector<double> frameMs;
+
+public:
+  // startNS is when the app started initializing.
+  bool init(const std::string &reportPath, uint32_t frames, Uint64 startNS);
+
+  bool running() const { return !reportPath.empty(); }
+
+  // Tick the next frame draws, nothing once all frames ran.
+  std::optional<Uint64> next() const;
+
+  void addFrameTime(double ms);
+
+  // gpuDriver goes into the report, a baseline from another driver
+  // means little.
+  bool report(const char *gpuDriver) const;
+};
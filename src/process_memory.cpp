@@ -0,0 +1,49 @@
+#include "process_memory.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <cinttypes>
+#include <cstdio>
+#endif
+
+ProcessMemory getProcessMemory() {
+  ProcessMemory res;
+
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters = {};
+  if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+    res.resident = counters.WorkingSetSize;
+    res.peakResident = counters.PeakWorkingSetSize;
+  }
+#elif defined(__APPLE__)
+  mach_task_basic_info_data_t info = {};
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) == KERN_SUCCESS) {
+    res.resident = info.resident_size;
+    res.peakResident = info.resident_size_max;
+  }
+#else
+  FILE *file = fopen("/proc/self/status", "r");
+  if (file == nullptr) {
+    return res;
+  }
+
+  char line[256];
+  uint64_t kb = 0;
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    if (sscanf(line, "VmRSS: %" SCNu64, &kb) == 1) {
+      res.resident = kb * 1024;
+    } else if (sscanf(line, "VmHWM: %" SCNu64, &kb) == 1) {
+      res.peakResident = kb * 1024;
+    }
+  }
+  fclose(file);
+#endif
+
+  return res;
+}
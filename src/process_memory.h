@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+struct ProcessMemory {
+  // Bytes of the process' memory in RAM, now and at most so far.
+  // Zero where the platform doesn't tell.
+  uint64_t resident = 0;
+  uint64_t peakResident = 0;
+};
+
+// Asks the OS, so it's not free - don't call it every frame.
+ProcessMemory getProcessMemory();
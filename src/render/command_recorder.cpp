@@ -0,0 +1,88 @@
+#include "command_recorder.h"
+
+#include "defines.h"
+
+#include <thread>
+
+void CommandRecorder::init(SDL_GPUDevice *device) {
+  this->device = device;
+}
+
+void CommandRecorder::add(std::string name, RecordFn fn) {
+  steps.push_back({ std::move(name), std::move(fn) });
+}
+
+bool CommandRecorder::run(bool parallel) {
+  assert(device != nullptr);
+
+  fences.clear();
+  timings.assign(steps.size(), {});
+  nextSubmit = 0;
+  failed = false;
+
+  if (parallel && steps.size() > 1) {
+    JobCounter stepsDone;
+    counter = &stepsDone;
+    spawn(0);
+    getJobSystem().wait(stepsDone);
+    counter = nullptr;
+  } else {
+    for (size_t i = 0; i < steps.size(); ++i) {
+      recordAndSubmit(i);
+    }
+  }
+
+  steps.clear();
+
+  return !failed;
+}
+
+void CommandRecorder::spawn(size_t idx) {
+  getJobSystem().run([this, idx] {
+    if (idx + 1 < steps.size()) {
+      spawn(idx + 1);
+    }
+    recordAndSubmit(idx);
+  }, counter);
+}
+
+void CommandRecorder::recordAndSubmit(size_t idx) {
+  auto &timing = timings[idx];
+  timing.step = steps[idx].name;
+  timing.thread = SDL_GetCurrentThreadID();
+
+  Uint64 start = SDL_GetTicksNS();
+
+  SDL_GPUCommandBuffer *cmdBuf = SDL_AcquireGPUCommandBuffer(device);
+  bool ok = cmdBuf != nullptr && steps[idx].fn(cmdBuf);
+
+  Uint64 recorded = SDL_GetTicksNS();
+
+  // Don't help with other jobs here, they may be the steps after this one.
+  while (nextSubmit.load(std::memory_order_acquire) != idx) {
+    std::this_thread::yield();
+  }
+
+  if (ok) {
+    SDL_GPUFence *fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdBuf);
+    if (fence != nullptr) {
+      fences.push_back(fence);
+    } else {
+      LOG_ERROR("Failed to submit %s: %s\n", steps[idx].name.c_str(), SDL_GetError());
+      failed = true;
+    }
+  } else {
+    if (cmdBuf != nullptr) {
+      SDL_CancelGPUCommandBuffer(cmdBuf);
+    } else {
+      LOG_ERROR("Failed to acquire a command buffer for %s: %s\n", steps[idx].name.c_str(), SDL_GetError());
+    }
+    failed = true;
+  }
+
+  nextSubmit.store(idx + 1, std::memory_order_release);
+
+  Uint64 end = SDL_GetTicksNS();
+  timing.recordMs = double(recorded - start) / SDL_NS_PER_MS;
+  timing.submitMs = double(end - recorded) / SDL_NS_PER_MS;
+}
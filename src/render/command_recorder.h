@@ -0,0 +1,69 @@
+#pragma once
+
+#include "jobs/job_system.h"
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_thread.h>
+
+struct RecordTiming {
+  std::string step;
+  SDL_ThreadID thread = 0;
+  // Time spent recording the step's commands
+  double recordMs = 0.;
+  // Time spent waiting for the previous steps to be submitted, submit included
+  double submitMs = 0.;
+};
+
+// Records a list of steps, each into its own command buffer, and submits
+// them in the order they were added, so that later steps can use what
+// earlier ones rendered.
+// In parallel mode the steps are recorded on the job system. SDL wants
+// a command buffer to be used only by the thread that acquired it, so each
+// step acquires, records and submits on the same worker. A step starts the
+// next one before recording, which keeps all steps it may wait for running.
+class CommandRecorder {
+public:
+  // Returns false if recording failed, the command buffer is then canceled.
+  using RecordFn = std::function<bool(SDL_GPUCommandBuffer*)>;
+
+private:
+  struct Step {
+    std::string name;
+    RecordFn fn;
+  };
+
+  SDL_GPUDevice *device = nullptr;
+  std::vector<Step> steps;
+
+  // Filled by the step holding the submit ticket only
+  std::vector<SDL_GPUFence*> fences;
+  // One per step, each written by its own step
+  std::vector<RecordTiming> timings;
+  std::atomic<size_t> nextSubmit = 0;
+  std::atomic<bool> failed = false;
+  // Of the parallel run(), a member so that the jobs' captures fit
+  // std::function without allocating
+  JobCounter *counter = nullptr;
+
+public:
+  void init(SDL_GPUDevice *device);
+
+  void add(std::string name, RecordFn fn);
+
+  // Records and submits all added steps, then forgets them.
+  // Blocks until everything is submitted.
+  bool run(bool parallel);
+
+  // Fences of the command buffers submitted by the last run()
+  const std::vector<SDL_GPUFence*> &getFences() const { return fences; }
+  const std::vector<RecordTiming> &getTimings() const { return timings; }
+
+private:
+  void spawn(size_t idx);
+  void recordAndSubmit(size_t idx);
+};
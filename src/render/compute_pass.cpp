@@ -0,0 +1,128 @@
+#include "compute_pass.h"
+
+#include "config/config.h"
+#include "defines.h"
+
+bool ComputePass::init(
+  SDL_GPUDevice *device,
+  std::string_view shaderName,
+  const ComputePipelineDesc &desc
+) {
+  deinit();
+
+  this->device = device;
+  this->shaderName = shaderName;
+  this->desc = desc;
+
+  pipeline = createPipeline(false);
+  if (pipeline == nullptr) {
+    deinit();
+    return false;
+  }
+
+  return true;
+}
+
+SDL_GPUComputePipeline *ComputePass::createPipeline(bool forceCompile) const {
+  // Also called on the shader watcher thread
+  auto cfg = getConfigSnapshot();
+  auto shadersInputDir = std::filesystem::path(cfg->shadersInputDir);
+  auto shadersOutputDir = std::filesystem::path(cfg->shadersOutputDir);
+
+  return createComputePipeline(
+    device,
+    (shadersInputDir / shaderName).concat(".comp.hlsl"),
+    shadersOutputDir,
+    desc,
+    forceCompile
+  );
+}
+
+bool ComputePass::dependsOn(const std::filesystem::path &file) const {
+  if (file.extension() == ".hlsl") {
+    return file.filename().string() == shaderName + ".comp.hlsl";
+  }
+
+  // Includes and shared headers - we don't know who includes them.
+  return true;
+}
+
+void ComputePass::deinit() {
+  if (pipeline != nullptr) {
+    SDL_ReleaseGPUComputePipeline(device, pipeline);
+  }
+
+  *this = {};
+}
+
+bool ComputePass::begin(
+  SDL_GPUCommandBuffer *cmdBuf,
+  std::initializer_list<SDL_GPUStorageBufferReadWriteBinding> rwBuffers,
+  std::initializer_list<SDL_GPUStorageTextureReadWriteBinding> rwTextures
+) {
+  assert(computePass == nullptr);
+  assert(rwBuffers.size() == desc.numReadWriteStorageBuffers);
+  assert(rwTextures.size() == desc.numReadWriteStorageTextures);
+
+  SDL_CHECK((computePass = SDL_BeginGPUComputePass(
+    cmdBuf,
+    std::data(rwTextures),
+    static_cast<Uint32>(rwTextures.size()),
+    std::data(rwBuffers),
+    static_cast<Uint32>(rwBuffers.size())
+  )));
+
+  SDL_BindGPUComputePipeline(computePass, pipeline);
+
+  return true;
+}
+
+void ComputePass::bind(
+  std::initializer_list<SDL_GPUBuffer*> storageBuffers,
+  std::initializer_list<SDL_GPUTexture*> storageTextures
+) {
+  assert(computePass != nullptr);
+
+  if (storageTextures.size() > 0) {
+    SDL_BindGPUComputeStorageTextures(
+      computePass,
+      0,
+      std::data(storageTextures),
+      static_cast<Uint32>(storageTextures.size())
+    );
+  }
+
+  if (storageBuffers.size() > 0) {
+    SDL_BindGPUComputeStorageBuffers(
+      computePass,
+      0,
+      std::data(storageBuffers),
+      static_cast<Uint32>(storageBuffers.size())
+    );
+  }
+}
+
+void ComputePass::dispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ) {
+  assert(computePass != nullptr);
+
+  SDL_DispatchGPUCompute(computePass, groupsX, groupsY, groupsZ);
+}
+
+void ComputePass::dispatchThreads(uint32_t x, uint32_t y, uint32_t z) {
+  auto groups = [](uint32_t threads, uint32_t groupSize) {
+    return (threads + groupSize - 1) / groupSize;
+  };
+
+  dispatch(
+    groups(x, desc.threadCountX),
+    groups(y, desc.threadCountY),
+    groups(z, desc.threadCountZ)
+  );
+}
+
+void ComputePass::end() {
+  if (computePass != nullptr) {
+    SDL_EndGPUComputePass(computePass);
+    computePass = nullptr;
+  }
+}
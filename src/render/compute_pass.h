@@ -0,0 +1,58 @@
+#pragma once
+
+#include "render/shader.h"
+
+#include <filesystem>
+#include <initializer_list>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <SDL3/SDL_gpu.h>
+
+struct ComputePass {
+  SDL_GPUDevice *device = nullptr;
+  // Only replaced between frames, see Renderer::swapReloadedPipelines
+  SDL_GPUComputePipeline *pipeline = nullptr;
+  std::string shaderName;
+  ComputePipelineDesc desc;
+
+  SDL_GPUComputePass *computePass = nullptr;
+
+  // Loads shaders_input/<shaderName>.comp.hlsl
+  bool init(
+    SDL_GPUDevice *device,
+    std::string_view shaderName,
+    const ComputePipelineDesc &desc
+  );
+  void deinit();
+
+  // Compiles the shader and creates a new pipeline from desc.
+  // Doesn't touch the current pipeline, so it's safe to call from another thread.
+  SDL_GPUComputePipeline *createPipeline(bool forceCompile) const;
+
+  // Whether the pipeline has to be recreated if the given shader source changes.
+  bool dependsOn(const std::filesystem::path &file) const;
+
+  // Read-write resources are bound when the pass begins.
+  // The bindings are taken as lists so that passing them doesn't allocate.
+  bool begin(
+    SDL_GPUCommandBuffer *cmdBuf,
+    std::initializer_list<SDL_GPUStorageBufferReadWriteBinding> rwBuffers,
+    std::initializer_list<SDL_GPUStorageTextureReadWriteBinding> rwTextures = {}
+  );
+
+  // Read-only resources
+  void bind(
+    std::initializer_list<SDL_GPUBuffer*> storageBuffers,
+    std::initializer_list<SDL_GPUTexture*> storageTextures = {}
+  );
+
+  void dispatch(uint32_t groupsX, uint32_t groupsY = 1, uint32_t groupsZ = 1);
+
+  // Dispatches enough groups to cover the given number of threads.
+  void dispatchThreads(uint32_t x, uint32_t y = 1, uint32_t z = 1);
+
+  void end();
+};
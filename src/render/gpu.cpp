@@ -56,6 +56,16 @@ void GPUContext::deinit() {
   }
 }
 
+std::optional<GPUFence> GPUContext::submit(SDL_GPUCommandBuffer *cmdBuf) {
+  SDL_GPUFence *fence = nullptr;
+  SDL_CHECK_RET(
+    (fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdBuf)),
+    std::nullopt
+  );
+
+  return getTransferFenceHandle(fence, nullptr);
+}
+
 bool GPUContext::wait(GPUFence idx) {
   // TODO: make thread-safe if needed
   assert(idx < fences.size());
@@ -69,15 +79,27 @@ bool GPUContext::wait(GPUFence idx) {
 
   SDL_ReleaseGPUFence(device, fence);
   fences[idx] = nullptr;
-  fenceStore.push(idx);
+  fenceStore.push_back(idx);
 
-  assert(transferBuffers[idx] != nullptr);
-  SDL_ReleaseGPUTransferBuffer(device, transferBuffers[idx]);
-  transferBuffers[idx] = nullptr;
+  // None for submit's fences
+  if (transferBuffers[idx] != nullptr) {
+    SDL_ReleaseGPUTransferBuffer(device, transferBuffers[idx]);
+    transferBuffers[idx] = nullptr;
+  }
 
   return true;
 }
 
+bool GPUContext::done(GPUFence idx) {
+  assert(idx < fences.size());
+
+  if (fences[idx] != nullptr && !SDL_QueryGPUFence(device, fences[idx])) {
+    return false;
+  }
+
+  return wait(idx);
+}
+
 GPUFence GPUContext::getTransferFenceHandle(SDL_GPUFence *fence, SDL_GPUTransferBuffer *transferBuffer) {
   // TODO: Make thread-safe if needed
   if (fenceStore.empty()) {
@@ -86,8 +108,8 @@ GPUFence GPUContext::getTransferFenceHandle(SDL_GPUFence *fence, SDL_GPUTransfer
     return fences.size() - 1;
   }
 
-  auto handle = fenceStore.front();
-  fenceStore.pop();
+  auto handle = fenceStore.back();
+  fenceStore.pop_back();
   fences[handle] = fence;
 
   // reuse the handle for transferBuffers for ease of use
@@ -138,3 +160,41 @@ bool GPUContext::uploadTexture(
   offset += surface->pitch * surface->h;
   return true;
 }
+
+bool GPUContext::uploadTextureRegion(
+  const UploadTextureRegion &tex,
+  SDL_GPUCopyPass *copyPass,
+  SDL_GPUTransferBuffer* transferBuffer,
+  std::size_t &offset
+) {
+  assert(tex.result != nullptr && tex.result->get() != nullptr);
+  assert(tex.surface != nullptr);
+
+  auto surface = tex.surface;
+  assert(tex.pos.x + surface->w <= tex.result->dim().x);
+  assert(tex.pos.y + surface->h <= tex.result->dim().y);
+
+  SDL_GPUTextureTransferInfo tbLocInfo = {
+    .transfer_buffer = transferBuffer,
+    .offset = static_cast<Uint32>(offset),
+    .pixels_per_row = static_cast<Uint32>(surface->w),
+    .rows_per_layer = static_cast<Uint32>(surface->h)
+  };
+  SDL_GPUTextureRegion bufReg = {
+    .texture = tex.result->get(),
+    .x = static_cast<Uint32>(tex.pos.x),
+    .y = static_cast<Uint32>(tex.pos.y),
+    .w = static_cast<Uint32>(surface->w),
+    .h = static_cast<Uint32>(surface->h),
+    .d = 1
+  };
+  SDL_UploadToGPUTexture(
+    copyPass,
+    &tbLocInfo,
+    &bufReg,
+    false
+  );
+
+  offset += surface->pitch * surface->h;
+  return true;
+}
@@ -1,14 +1,15 @@
 #pragma once
 
 #include "defines.h"
+#include "jobs/job_system.h"
 #include "render/gpu_buffer.h"
 #include "render/gpu_texture.h"
 
 #include <array>
 #include <optional>
 #include <string_view>
+#include <utility>
 #include <vector>
-#include <queue>
 
 #include <SDL3/SDL_gpu.h>
 #include <SDL3_image/SDL_image.h>
@@ -52,11 +53,29 @@ struct UploadTexture {
   TextureType usage;
 };
 
+// Pass to GpuContext::upload to upload a surface into a sub-region
+// of an already initialized texture. The texture is NOT recreated.
+// Can be used together with multiple UploadTexture/UploadBuffer<T>
+struct UploadTextureRegion {
+  // Surface to read from. MUST be SDL_PIXELFORMAT_RGBA32.
+  // User is responsible for destroying the surface!
+  SDL_Surface *surface;
+
+  // Pointer to the GPUTexture where to store the result.
+  // MUST NOT be null and MUST already be initialized!
+  GPUTexture *result;
+
+  // Top-left corner of the destination region inside result.
+  glm::ivec2 pos;
+};
+
 class GPUContext {
 private:
   std::vector<SDL_GPUFence*> fences;
   std::vector<SDL_GPUTransferBuffer*> transferBuffers;
-  std::queue<GPUFence> fenceStore;
+  // Free handles, a stack so that reusing them doesn't allocate
+  std::vector<GPUFence> fenceStore;
+  Uint64 uploadedBytes = 0;
 
 public:
   SDL_Window *window = nullptr;
@@ -76,7 +95,17 @@ public:
   template <class ...Buffers>
   bool upload(Buffers...);
 
+  // Submits a command buffer of the caller's, the fence is waited on like
+  // an upload's.
+  std::optional<GPUFence> submit(SDL_GPUCommandBuffer *cmdBuf);
+
   bool wait(GPUFence fence);
+  // Whether the upload is done, in which case it's released like by wait.
+  // Doesn't block.
+  bool done(GPUFence fence);
+
+  // Bytes passed to uploadAsync since the last call
+  Uint64 collectUploadedBytes() { return std::exchange(uploadedBytes, 0); }
 
 private:
   GPUFence getTransferFenceHandle(SDL_GPUFence *fence, SDL_GPUTransferBuffer *transferBuffer);
@@ -88,6 +117,13 @@ private:
     std::size_t &offset
   );
 
+  bool uploadTextureRegion(
+    const UploadTextureRegion &tex,
+    SDL_GPUCopyPass *copyPass,
+    SDL_GPUTransferBuffer* transferBuffer,
+    std::size_t &offset
+  );
+
   template <class T>
   bool uploadBuffer(
     UploadBuffer<T> buf,
@@ -100,7 +136,11 @@ private:
 template <class ...Buffers>
 std::optional<GPUFence> GPUContext::uploadAsync(Buffers ...buffers) {
   auto ensureSurface = [] (auto &buf) -> bool {
-    if constexpr (!std::is_same_v<std::remove_cvref_t<decltype(buf)>, UploadTexture>) {
+    if constexpr (std::is_same_v<std::remove_cvref_t<decltype(buf)>, UploadTextureRegion>) {
+      assert(buf.surface != nullptr);
+      assert(buf.surface->format == SDL_PIXELFORMAT_RGBA32);
+      return true;
+    } else if constexpr (!std::is_same_v<std::remove_cvref_t<decltype(buf)>, UploadTexture>) {
       return true;
     } else {
       auto &tex = buf;
@@ -122,6 +162,29 @@ std::optional<GPUFence> GPUContext::uploadAsync(Buffers ...buffers) {
     }
   };
 
+  // Decode the images on the job system first, whatever fails is
+  // retried and reported below.
+  JobCounter decoded;
+  auto decode = [&decoded] (auto &buf) {
+    if constexpr (std::is_same_v<std::remove_cvref_t<decltype(buf)>, UploadTexture>) {
+      if (*buf.surface != nullptr) {
+        return;
+      }
+
+      getJobSystem().run([&buf] {
+        SDL_Surface *surface = IMG_Load(buf.file.c_str());
+        if (surface != nullptr && surface->format != SDL_PIXELFORMAT_RGBA32) {
+          SDL_Surface *converted = SDL_ConvertSurface(surface, SDL_PIXELFORMAT_RGBA32);
+          SDL_DestroySurface(surface);
+          surface = converted;
+        }
+        *buf.surface = surface;
+      }, &decoded);
+    }
+  };
+  (decode(buffers), ...);
+  getJobSystem().wait(decoded);
+
   // If buffer is texture we want to make sure its image is loaded into an SDL_Surface
   bool res = true;
   ((res = res && ensureSurface(buffers)), ...);
@@ -132,6 +195,8 @@ std::optional<GPUFence> GPUContext::uploadAsync(Buffers ...buffers) {
   auto getBufSize = [](auto &buf) {
     if constexpr (std::is_same_v<std::remove_cvref_t<decltype(buf)>, UploadTexture>) {
       return (*buf.surface)->pitch * (*buf.surface)->h;
+    } else if constexpr (std::is_same_v<std::remove_cvref_t<decltype(buf)>, UploadTextureRegion>) {
+      return buf.surface->pitch * buf.surface->h;
     } else {
       return buf.data.size() * sizeof(buf.data[0]);
     }
@@ -175,6 +240,8 @@ std::optional<GPUFence> GPUContext::uploadAsync(Buffers ...buffers) {
     std::size_t sz = getBufSize(buf);
     if constexpr (std::is_same_v<std::remove_cvref_t<decltype(buf)>, UploadTexture>) {
       memcpy(data, (*buf.surface)->pixels, sz);
+    } else if constexpr (std::is_same_v<std::remove_cvref_t<decltype(buf)>, UploadTextureRegion>) {
+      memcpy(data, buf.surface->pixels, sz);
     } else {
       memcpy(data, buf.data.data(), sz);
     }
@@ -184,6 +251,7 @@ std::optional<GPUFence> GPUContext::uploadAsync(Buffers ...buffers) {
 
   std::size_t offset = 0;
   (setTransferData(buffers, transferData, offset), ...);
+  uploadedBytes += transferBufSz;
 
   SDL_UnmapGPUTransferBuffer(device, transferBuffer);
 
@@ -209,6 +277,13 @@ std::optional<GPUFence> GPUContext::uploadAsync(Buffers ...buffers) {
         transferBuffer,
         offset
       );
+    } else if constexpr (std::is_same_v<std::remove_cvref_t<decltype(buf)>, UploadTextureRegion>) {
+      return uploadTextureRegion(
+        buf,
+        copyPass,
+        transferBuffer,
+        offset
+      );
     } else {
       return uploadBuffer<std::remove_cvref_t<decltype(buf.data[0])>>(
         buf,
@@ -9,6 +9,17 @@ SDL_GPUBufferUsageFlags getUsageFlags(BufferType type) {
     return SDL_GPU_BUFFERUSAGE_INDEX;
   case BufferType::STORAGE:
     return SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ;
+  case BufferType::COMPUTE_READ:
+    return SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ | SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ;
+  case BufferType::COMPUTE_WRITE:
+    return SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE | SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ;
+  case BufferType::COMPUTE_RW:
+    return
+      SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ |
+      SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE |
+      SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ;
+  case BufferType::INDIRECT:
+    return SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE | SDL_GPU_BUFFERUSAGE_INDIRECT;
   default:
     TODO();
     return 0;
@@ -8,9 +8,13 @@ enum class BufferType {
   INDEX,
   VERTEX,
   STORAGE,
+  // Storage buffers are readable by graphics shaders too,
+  // so compute results can be drawn directly.
   COMPUTE_READ,
   COMPUTE_WRITE,
-  COMPUTE_RW
+  COMPUTE_RW,
+  // Indirect draw/dispatch arguments written by a compute shader.
+  INDIRECT,
 };
 
 // TODO: think of linking these buffers to the device
@@ -28,5 +32,6 @@ public:
   void deinit();
 
   SDL_GPUBuffer* get() const { return buffer; }
+  Uint32 getSize() const { return size; }
   SDL_GPUBuffer* const* getPtr() const { return &buffer; }
 };
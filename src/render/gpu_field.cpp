@@ -0,0 +1,140 @@
+#include "gpu_field.h"
+
+#include "defines.h"
+#include "sim/field.h"
+
+#include <cstring>
+
+bool GPUField::init(GPUContext *gpu, glm::ivec2 size, bool simulate) {
+  assert(gpu != nullptr);
+  assert(size.x > 0 && size.y > 0);
+
+  deinit();
+
+  this->gpu = gpu;
+  params = makeFieldConstData(size);
+
+  if (simulate) {
+    ComputePipelineDesc desc = {
+      .numReadonlyStorageBuffers = 1,
+      .numReadWriteStorageBuffers = 1,
+      .numUniformBuffers = 1,
+      .threadCountX = FIELD_GROUP_SIZE,
+      .threadCountY = FIELD_GROUP_SIZE,
+    };
+    if (!stepPass.init(gpu->device, "field", desc)) {
+      return false;
+    }
+  }
+
+  Field initial;
+  initial.init(size);
+  const std::vector<glm::vec2> &data = initial.getCells();
+
+  current = 0;
+  if (!cells[1].init(gpu->device, static_cast<Uint32>(data.size() * sizeof(glm::vec2)), BufferType::COMPUTE_RW)) {
+    return false;
+  }
+  return gpu->upload(UploadBuffer<glm::vec2>{ data, &cells[0], BufferType::COMPUTE_RW });
+}
+
+void GPUField::deinit() {
+  if (gpu == nullptr) {
+    return;
+  }
+
+  for (int i = 0; i < 2; ++i) {
+    if (uploads[i].has_value()) {
+      gpu->wait(*uploads[i]);
+      uploads[i] = std::nullopt;
+    }
+    cells[i].deinit();
+  }
+  stepPass.deinit();
+
+  gpu = nullptr;
+}
+
+bool GPUField::step(SDL_GPUCommandBuffer *cmdBuf, int steps) {
+  assert(stepPass.pipeline != nullptr);
+
+  // One pass per step, SDL syncs the buffers between passes.
+  for (int s = 0; s < steps; ++s) {
+    int next = 1 - current;
+    if (!stepPass.begin(cmdBuf, {
+      SDL_GPUStorageBufferReadWriteBinding{ .buffer = cells[next].get(), .cycle = false },
+    })) {
+      return false;
+    }
+    stepPass.bind({cells[current].get()});
+    SDL_PushGPUComputeUniformData(cmdBuf, 0, &params, sizeof(FieldConstData));
+    stepPass.dispatchThreads(params.size.x, params.size.y);
+    stepPass.end();
+
+    current = next;
+  }
+
+  return true;
+}
+
+bool GPUField::upload(const std::vector<glm::vec2> &data) {
+  assert(data.size() == size_t(params.size.x) * params.size.y);
+
+  int next = 1 - current;
+  if (uploads[next].has_value()) {
+    gpu->wait(*uploads[next]);
+    uploads[next] = std::nullopt;
+  }
+
+  uploads[next] = gpu->uploadAsync(UploadBuffer<glm::vec2>{ data, &cells[next], BufferType::COMPUTE_RW });
+  if (!uploads[next].has_value()) {
+    return false;
+  }
+  current = next;
+
+  return true;
+}
+
+bool GPUField::download(std::vector<glm::vec2> &data) {
+  Uint32 size = params.size.x * params.size.y * sizeof(glm::vec2);
+
+  SDL_GPUTransferBufferCreateInfo tbInfo = {
+    .usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD,
+    .size = size,
+  };
+  SDL_GPUTransferBuffer *transferBuffer = nullptr;
+  SDL_CHECK((transferBuffer = SDL_CreateGPUTransferBuffer(gpu->device, &tbInfo)));
+
+  bool res = false;
+  SDL_GPUCommandBuffer *cmdBuf = nullptr;
+  SDL_GPUCopyPass *copyPass = nullptr;
+  SDL_GPUFence *fence = nullptr;
+  if ((cmdBuf = SDL_AcquireGPUCommandBuffer(gpu->device)) != nullptr) {
+    if ((copyPass = SDL_BeginGPUCopyPass(cmdBuf)) != nullptr) {
+      SDL_GPUBufferRegion region = { .buffer = cells[current].get(), .offset = 0, .size = size };
+      SDL_GPUTransferBufferLocation location = { .transfer_buffer = transferBuffer, .offset = 0 };
+      SDL_DownloadFromGPUBuffer(copyPass, &region, &location);
+      SDL_EndGPUCopyPass(copyPass);
+    }
+    fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdBuf);
+  }
+
+  if (copyPass != nullptr && fence != nullptr && SDL_WaitForGPUFences(gpu->device, true, &fence, 1)) {
+    if (auto *mapped = SDL_MapGPUTransferBuffer(gpu->device, transferBuffer, false)) {
+      data.resize(size_t(params.size.x) * params.size.y);
+      std::memcpy(data.data(), mapped, size);
+      SDL_UnmapGPUTransferBuffer(gpu->device, transferBuffer);
+      res = true;
+    }
+  }
+  if (!res) {
+    LOG_ERROR("Failed to download the field: %s\n", SDL_GetError());
+  }
+
+  if (fence != nullptr) {
+    SDL_ReleaseGPUFence(gpu->device, fence);
+  }
+  SDL_ReleaseGPUTransferBuffer(gpu->device, transferBuffer);
+
+  return res;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "gpu.h"
+#include "compute_pass.h"
+#include "gpu_shared/cpu_gpu_shared.h"
+
+#include <optional>
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+// The reaction-diffusion field of sim/field.h on the GPU. The state is
+// ping-ponged between two storage buffers, every step reads one and
+// writes the other, and the latest one is drawn straight from there.
+class GPUField {
+private:
+  GPUContext *gpu = nullptr;
+  FieldConstData params = {};
+
+  // Only with the GPU backend
+  ComputePass stepPass;
+
+  GPUBuffer cells[2];
+  std::optional<GPUFence> uploads[2];
+  // The buffer with the latest state
+  int current = 0;
+
+public:
+  // Uploads the initial state of Field::init. With simulate the field
+  // is stepped by step, otherwise it only mirrors what upload is given.
+  bool init(GPUContext *gpu, glm::ivec2 size, bool simulate);
+  void deinit();
+
+  // Records steps compute passes.
+  bool step(SDL_GPUCommandBuffer *cmdBuf, int steps);
+
+  // Replaces the state with the cells of a Field of the same size.
+  // The buffer written was drawn two uploads ago, the caller makes sure
+  // that the GPU is done with it.
+  bool upload(const std::vector<glm::vec2> &data);
+
+  // Reads the state back, blocking until the GPU is done.
+  // Slow, meant for validation.
+  bool download(std::vector<glm::vec2> &data);
+
+  SDL_GPUBuffer *get() const { return cells[current].get(); }
+  // Nothing if the field isn't simulated on the GPU
+  ComputePass *getStepPass() { return stepPass.pipeline != nullptr ? &stepPass : nullptr; }
+  const FieldConstData &getParams() const { return params; }
+};
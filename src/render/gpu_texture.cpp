@@ -23,12 +23,12 @@ SDL_GPUTextureUsageFlags getTextureUsage(TextureType type) {
 SDL_GPUTextureCreateInfo getTextureInfo(
   uint32_t w,
   uint32_t h,
-  SDL_PixelFormat format,
+  SDL_GPUTextureFormat format,
   TextureType type
 ) {
   SDL_GPUTextureCreateInfo res = {
     .type = SDL_GPU_TEXTURETYPE_2D,
-    .format = GPUTexture::getGPUTextureFormat(format),
+    .format = format,
     .usage = getTextureUsage(type),
     .width = w,
     .height = h,
@@ -47,6 +47,17 @@ bool GPUTexture::init(
   SDL_PixelFormat format,
   TextureType type,
   const std::string &name
+) {
+  return init(device, w, h, getGPUTextureFormat(format), type, name);
+}
+
+bool GPUTexture::init(
+  SDL_GPUDevice *device,
+  uint32_t w,
+  uint32_t h,
+  SDL_GPUTextureFormat format,
+  TextureType type,
+  const std::string &name
 ) {
   deinit();
 
@@ -60,11 +71,11 @@ bool GPUTexture::init(
     )
   ));
 
+  this->device = device;
+  this->format = format;
   sz = {w, h};
 
-#ifdef __DEBUG
   this->name = name;
-#endif
   return true;
 }
 
@@ -76,6 +87,7 @@ void GPUTexture::deinit() {
 
   texture = nullptr;
   device = nullptr;
+  format = SDL_GPU_TEXTUREFORMAT_INVALID;
 }
 
 SDL_GPUTextureFormat GPUTexture::getGPUTextureFormat(SDL_PixelFormat format) {
@@ -85,3 +97,24 @@ SDL_GPUTextureFormat GPUTexture::getGPUTextureFormat(SDL_PixelFormat format) {
 
   TODO();
 }
+
+SDL_GPUTextureFormat GPUTexture::getDepthFormat(SDL_GPUDevice *device) {
+  SDL_GPUTextureFormat candidates[] = {
+    SDL_GPU_TEXTUREFORMAT_D32_FLOAT,
+    SDL_GPU_TEXTUREFORMAT_D24_UNORM,
+  };
+
+  for (auto format : candidates) {
+    if (SDL_GPUTextureSupportsFormat(
+      device,
+      format,
+      SDL_GPU_TEXTURETYPE_2D,
+      SDL_GPU_TEXTUREUSAGE_DEPTH_STENCIL_TARGET
+    )) {
+      return format;
+    }
+  }
+
+  // Always supported
+  return SDL_GPU_TEXTUREFORMAT_D16_UNORM;
+}
@@ -15,11 +15,11 @@ struct GPUTexture {
 private:
   SDL_GPUDevice *device = nullptr;
   SDL_GPUTexture *texture = nullptr;
+  SDL_GPUTextureFormat format = SDL_GPU_TEXTUREFORMAT_INVALID;
   glm::ivec2 sz = {};
 
-#ifdef __DEBUG
+  // For the log
   std::string name;
-#endif
 
 public:
   bool init(
@@ -30,10 +30,22 @@ public:
     TextureType type,
     const std::string& name
   );
+  bool init(
+    SDL_GPUDevice *device,
+    uint32_t w,
+    uint32_t h,
+    SDL_GPUTextureFormat format,
+    TextureType type,
+    const std::string& name
+  );
   void deinit();
 
   SDL_GPUTexture* get() const { return texture; }
+  SDL_GPUTextureFormat getFormat() const { return format; }
   glm::ivec2 dim() const { return sz; }
 
   static SDL_GPUTextureFormat getGPUTextureFormat(SDL_PixelFormat format);
+
+  // Best depth format supported by the device.
+  static SDL_GPUTextureFormat getDepthFormat(SDL_GPUDevice *device);
 };
@@ -0,0 +1,269 @@
+#include "perf_hud.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include <SDL3/SDL_timer.h>
+
+namespace {
+
+// Glyphs of ' ' to '_', bit (y * 3 + x) is the pixel at (x, y)
+constexpr uint16_t GLYPHS[] = {
+  0x0000, 0x2092, 0x002d, 0x5f7d, 0x3c9e, 0x52a5, 0x6aaa, 0x0012, //  !"#$%&'
+  0x4494, 0x1491, 0x0aa8, 0x05d0, 0x1400, 0x01c0, 0x2000, 0x12a4, // ()*+,-./
+  0x7b6f, 0x749a, 0x73e7, 0x79a7, 0x49ed, 0x79cf, 0x7bcf, 0x24a7, // 01234567
+  0x7bef, 0x79ef, 0x0410, 0x1410, 0x4454, 0x0e38, 0x1511, 0x21a7, // 89:;<=>?
+  0x63ea, 0x5bea, 0x3aeb, 0x624e, 0x3b6b, 0x72cf, 0x12cf, 0x6b4e, // @ABCDEFG
+  0x5bed, 0x7497, 0x2b24, 0x5aed, 0x7249, 0x5bfd, 0x5b6b, 0x2b6a, // HIJKLMNO
+  0x12eb, 0x676a, 0x5aeb, 0x388e, 0x2497, 0x7b6d, 0x2b6d, 0x5fed, // PQRSTUVW
+  0x5aad, 0x24ad, 0x72a7, 0x6496, 0x4889, 0x3493, 0x002a, 0x7000, // XYZ[\]^_
+};
+constexpr int NUM_GLYPHS = sizeof(GLYPHS) / sizeof(GLYPHS[0]);
+constexpr char FIRST_GLYPH = ' ';
+
+constexpr int GLYPH_W = 3;
+constexpr int GLYPH_H = 5;
+// A glyph and its spacing in the font texture
+constexpr int CELL_W = GLYPH_W + 1;
+constexpr int CELL_H = GLYPH_H + 1;
+constexpr int FONT_COLUMNS = 16;
+// The cell after the glyphs is solid, the rectangles sample it.
+constexpr int SOLID_CELL = NUM_GLYPHS;
+constexpr int FONT_W = FONT_COLUMNS * CELL_W;
+constexpr int FONT_H = (SOLID_CELL / FONT_COLUMNS + 1) * CELL_H;
+
+// Screen pixels per font pixel
+constexpr float SCALE = 2.f;
+constexpr float ADVANCE = CELL_W * SCALE;
+constexpr float LINE_H = CELL_H * SCALE + 2.f;
+constexpr float PADDING = 6.f;
+constexpr float GRAPH_BAR_W = 2.f;
+constexpr float GRAPH_H = 48.f;
+// Wide enough for the graph and 32 characters
+constexpr float PANEL_W = std::max(PerfHud::GRAPH_FRAMES * GRAPH_BAR_W, 32 * ADVANCE) + 2.f * PADDING;
+
+constexpr Uint64 REFRESH_NS = 250 * SDL_NS_PER_MS;
+// The graph's marks, 60 and 30 FPS
+constexpr float TARGET_MS = 1000.f / 60.f;
+constexpr float SLOW_MS = 1000.f / 30.f;
+
+// RGBA8, R in the lowest byte
+constexpr uint32_t BACKGROUND = 0xb0000000;
+constexpr uint32_t WHITE = 0xffffffff;
+constexpr uint32_t GRAY = 0xffa0a0a0;
+constexpr uint32_t GREEN = 0xff40d040;
+constexpr uint32_t YELLOW = 0xff30d0e0;
+constexpr uint32_t RED = 0xff4040e0;
+constexpr uint32_t MARK = 0x80ffffff;
+
+glm::vec4 cellUV(int cell) {
+  float x = float(cell % FONT_COLUMNS * CELL_W);
+  float y = float(cell / FONT_COLUMNS * CELL_H);
+  return { x / FONT_W, y / FONT_H, (x + GLYPH_W) / FONT_W, (y + GLYPH_H) / FONT_H };
+}
+
+uint32_t frameColor(float ms) {
+  return ms <= TARGET_MS * 1.05f ? GREEN : ms <= SLOW_MS * 1.05f ? YELLOW : RED;
+}
+
+}
+
+SDL_Surface *PerfHud::createFont() {
+  SDL_Surface *surface = SDL_CreateSurface(FONT_W, FONT_H, SDL_PIXELFORMAT_RGBA32);
+  if (surface == nullptr) {
+    return nullptr;
+  }
+  SDL_FillSurfaceRect(surface, nullptr, 0);
+
+  auto setPixel = [surface](int x, int y) {
+    auto *row = static_cast<uint8_t*>(surface->pixels) + y * surface->pitch;
+    reinterpret_cast<uint32_t*>(row)[x] = WHITE;
+  };
+
+  for (int i = 0; i < NUM_GLYPHS; ++i) {
+    int x0 = i % FONT_COLUMNS * CELL_W;
+    int y0 = i / FONT_COLUMNS * CELL_H;
+    for (int y = 0; y < GLYPH_H; ++y) {
+      for (int x = 0; x < GLYPH_W; ++x) {
+        if (GLYPHS[i] & (1 << (y * GLYPH_W + x))) {
+          setPixel(x0 + x, y0 + y);
+        }
+      }
+    }
+  }
+
+  int x0 = SOLID_CELL % FONT_COLUMNS * CELL_W;
+  int y0 = SOLID_CELL / FONT_COLUMNS * CELL_H;
+  for (int y = 0; y < CELL_H; ++y) {
+    for (int x = 0; x < CELL_W; ++x) {
+      setPixel(x0 + x, y0 + y);
+    }
+  }
+
+  return surface;
+}
+
+void PerfHud::addFrame(const HudFrame &frame, const std::vector<RecordTiming> &steps) {
+  frameTimes[graphHead] = static_cast<float>(frame.frameMs);
+  graphHead = (graphHead + 1) % GRAPH_FRAMES;
+
+  totals.frame.frameMs += frame.frameMs;
+  totals.frame.gpuWaitMs += frame.gpuWaitMs;
+  totals.frame.presentMs += frame.presentMs;
+  totals.frame.hudMs += frame.hudMs;
+  totals.frame.uploadBytes += frame.uploadBytes;
+  totals.frame.draws += frame.draws;
+  totals.frame.binds += frame.binds;
+  totals.frame.streamBytes = frame.streamBytes;
+  ++totals.frames;
+
+  for (const RecordTiming &timing : steps) {
+    Step *step = std::find_if(totals.steps, totals.steps + totals.numSteps, [&timing](const Step &step) {
+      return timing.step == step.name;
+    });
+    if (step == totals.steps + totals.numSteps) {
+      if (totals.numSteps == MAX_STEPS) {
+        continue;
+      }
+      ++totals.numSteps;
+      SDL_strlcpy(step->name, timing.step.c_str(), sizeof(step->name));
+    }
+
+    step->recordMs += timing.recordMs;
+    step->submitMs += timing.submitMs;
+  }
+
+  Uint64 now = SDL_GetTicksNS();
+  if (now - lastRefreshNS < REFRESH_NS) {
+    return;
+  }
+  lastRefreshNS = now;
+
+  // Recording steps that didn't run lately are dropped
+  shown = totals;
+  totals = {};
+  memory = getProcessMemory();
+}
+
+const std::vector<HudQuad> &PerfHud::build() {
+  quads.clear();
+  quads.reserve(MAX_QUADS);
+
+  // Sized once the rest is laid out
+  rect({ 0.f, 0.f }, { 0.f, 0.f }, BACKGROUND);
+
+  glm::vec2 pos = { PADDING, PADDING };
+  auto newLine = [&pos] {
+    pos = { PADDING, pos.y + LINE_H };
+  };
+
+  double frames = std::max(shown.frames, 1u);
+  double frameMs = shown.frame.frameMs / frames;
+
+  textf(pos, WHITE, "FRAME %6.2f MS %6.1f FPS", frameMs, frameMs > 0. ? 1000. / frameMs : 0.);
+  newLine();
+  textf(pos, WHITE, "GPU WAIT %5.2f MS", shown.frame.gpuWaitMs / frames);
+  newLine();
+
+  for (int i = 0; i < shown.numSteps; ++i) {
+    const Step &step = shown.steps[i];
+    textf(pos, GRAY, "%-8.8s %5.2f MS +%5.2f", step.name, step.recordMs / frames, step.submitMs / frames);
+    newLine();
+  }
+  textf(pos, GRAY, "%-8.8s %5.2f MS", "present", shown.frame.presentMs / frames);
+  newLine();
+  textf(pos, GRAY, "%-8.8s %5.2f MS", "hud", shown.frame.hudMs / frames);
+  newLine();
+
+  textf(pos, WHITE, "UPLOAD %8.1f KB/FRAME", double(shown.frame.uploadBytes) / 1024. / frames);
+  newLine();
+  textf(pos, WHITE, "DRAWS %5.0f BINDS %5.0f", shown.frame.draws / frames, shown.frame.binds / frames);
+  newLine();
+  textf(
+    pos,
+    WHITE,
+    "MEM %6.1f MB STREAM %6.1f MB",
+    double(memory.resident) / (1024. * 1024.),
+    double(shown.frame.streamBytes) / (1024. * 1024.)
+  );
+  newLine();
+
+  // Oldest frame on the left, scaled so that a hitch still fits
+  float maxMs = *std::max_element(frameTimes, frameTimes + GRAPH_FRAMES);
+  float scaleMs = std::max(maxMs, SLOW_MS);
+  textf(pos, GRAY, "FRAME TIME, TOP %.0f MS", scaleMs);
+  newLine();
+
+  float graphBottom = pos.y + GRAPH_H;
+  for (int i = 0; i < GRAPH_FRAMES; ++i) {
+    float ms = frameTimes[(graphHead + i) % GRAPH_FRAMES];
+    float h = std::min(ms / scaleMs, 1.f) * GRAPH_H;
+    rect({ pos.x + i * GRAPH_BAR_W, graphBottom - h }, { GRAPH_BAR_W, h }, frameColor(ms));
+  }
+  for (float markMs : { TARGET_MS, SLOW_MS }) {
+    float y = graphBottom - markMs / scaleMs * GRAPH_H;
+    rect({ pos.x, y }, { GRAPH_FRAMES * GRAPH_BAR_W, 1.f }, MARK);
+  }
+
+  quads[0].size = { PANEL_W, graphBottom + PADDING };
+
+  return quads;
+}
+
+void PerfHud::rect(glm::vec2 pos, glm::vec2 size, uint32_t color) {
+  if (quads.size() == MAX_QUADS) {
+    return;
+  }
+
+  // The middle of the solid cell
+  glm::vec4 uv = cellUV(SOLID_CELL);
+  glm::vec2 center = (glm::vec2(uv.x, uv.y) + glm::vec2(uv.z, uv.w)) * 0.5f;
+
+  quads.push_back({
+    .pos = pos,
+    .size = size,
+    .uv = { center.x, center.y, center.x, center.y },
+    .color = color,
+  });
+}
+
+glm::vec2 PerfHud::text(glm::vec2 pos, std::string_view str, uint32_t color) {
+  for (char c : str) {
+    if (c >= 'a' && c <= 'z') {
+      c = c - 'a' + 'A';
+    }
+
+    int glyph = c - FIRST_GLYPH;
+    if (glyph < 0 || glyph >= NUM_GLYPHS) {
+      glyph = '?' - FIRST_GLYPH;
+    }
+
+    if (glyph != 0 && quads.size() < MAX_QUADS) {
+      quads.push_back({
+        .pos = pos,
+        .size = { GLYPH_W * SCALE, GLYPH_H * SCALE },
+        .uv = cellUV(glyph),
+        .color = color,
+      });
+    }
+    pos.x += ADVANCE;
+  }
+
+  return pos;
+}
+
+glm::vec2 PerfHud::textf(glm::vec2 pos, uint32_t color, const char *format, ...) {
+  char buf[64];
+
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+
+  if (len < 0) {
+    return pos;
+  }
+  return text(pos, { buf, std::min(size_t(len), sizeof(buf) - 1) }, color);
+}
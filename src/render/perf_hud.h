@@ -0,0 +1,86 @@
+#pragma once
+
+#include "process_memory.h"
+#include "render/command_recorder.h"
+#include "gpu_shared/cpu_gpu_shared.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include <SDL3/SDL_surface.h>
+#include <glm/vec2.hpp>
+
+// What the renderer measured during one frame
+struct HudFrame {
+  // Since the previous frame started
+  double frameMs = 0.;
+  // Blocked waiting for the GPU to finish older frames
+  double gpuWaitMs = 0.;
+  // Recording and submitting the swapchain pass on the main thread
+  double presentMs = 0.;
+  // Building and uploading the HUD itself
+  double hudMs = 0.;
+  uint64_t uploadBytes = 0;
+  uint32_t draws = 0;
+  uint32_t binds = 0;
+  // Resident in the world streamer's GPU buffers
+  uint64_t streamBytes = 0;
+};
+
+// On-screen overlay with a frame time graph and the renderer's per-frame
+// counters, see Config::perfHud. It only lays out the quads, the renderer
+// uploads them and draws them all with one instanced draw over the
+// swapchain. Text uses a tiny font texture made by createFont, where
+// every glyph is a 3x5 bitmap, so it's upper case only.
+class PerfHud {
+public:
+  static constexpr uint32_t MAX_QUADS = 1024;
+  // Frames in the graph
+  static constexpr int GRAPH_FRAMES = 120;
+  // Recording steps listed
+  static constexpr int MAX_STEPS = 8;
+
+private:
+  struct Step {
+    char name[16] = {};
+    double recordMs = 0.;
+    double submitMs = 0.;
+  };
+
+  // Sums over the frames since the last refresh
+  struct Totals {
+    HudFrame frame;
+    Step steps[MAX_STEPS];
+    int numSteps = 0;
+    uint32_t frames = 0;
+  };
+
+  float frameTimes[GRAPH_FRAMES] = {};
+  int graphHead = 0;
+
+  // The numbers change every REFRESH_NS so that they're readable
+  Totals totals;
+  Totals shown;
+  Uint64 lastRefreshNS = 0;
+  ProcessMemory memory;
+
+  std::vector<HudQuad> quads;
+
+public:
+  // RGBA32 sheet of the glyphs, the caller destroys it. Upload it as
+  // a sampled texture.
+  static SDL_Surface *createFont();
+
+  void addFrame(const HudFrame &frame, const std::vector<RecordTiming> &steps);
+
+  // Lays out the overlay in the top-left corner, in pixels. At most
+  // MAX_QUADS, it doesn't allocate once warmed up.
+  const std::vector<HudQuad> &build();
+
+private:
+  void rect(glm::vec2 pos, glm::vec2 size, uint32_t color);
+  // Returns the position after the text
+  glm::vec2 text(glm::vec2 pos, std::string_view str, uint32_t color);
+  glm::vec2 textf(glm::vec2 pos, uint32_t color, const char *format, ...);
+};
@@ -4,89 +4,229 @@
 
 #include "SDL3/SDL_stdinc.h"
 
+#include "alloc_tracker.h"
 #include "game_state.h"
+#include "log.h"
 
-void RenderData::init(GPUContext &gpuCtx, GameState &state) {
-  update(state);
+#include <algorithm>
+#include <cstring>
+
+#include <glm/common.hpp>
+
+void RenderData::init(GPUContext &gpuCtx, const GameState &state) {
+  update(state, state);
+  setAlpha(0.f);
+}
+
+void RenderData::update(const GameState &prev, const GameState &curr) {
+  ALLOC_SCOPE("render data");
+  const Config &cfg = getConfig();
+
+  prevViewPos = prev.camera;
+  currViewPos = curr.camera;
+
+  // Anything visible at some point between the two ticks
+  glm::vec2 windowSize = { float(cfg.windowW), float(cfg.windowH) };
+  glm::vec2 viewMin = glm::min(prevViewPos, currViewPos);
+  glm::vec2 viewMax = glm::max(prevViewPos, currViewPos) + windowSize;
+
+  opaque.clear();
+  opaque.reserve(curr.world.size());
+  curr.world.eachChunk<const Position, const Depth, const Size, const Color>([&](
+    uint32_t count,
+    const Entity *entities,
+    const Position *positions,
+    const Depth *depths,
+    const Size *sizes,
+    const Color *colors
+  ) {
+    for (uint32_t i = 0; i < count; ++i) {
+      glm::vec2 to = positions[i].value;
+      // Sprites that just appeared don't move this frame.
+      const Position *prevPos = prev.world.get<Position>(entities[i]);
+      glm::vec2 from = prevPos != nullptr ? prevPos->value : to;
+
+      if (!cfg.gpuCulling) {
+        glm::vec2 halfSize = sizes[i].value * 0.5f;
+        glm::vec2 boundsMin = glm::min(from, to) - halfSize;
+        glm::vec2 boundsMax = glm::max(from, to) + halfSize;
+        if (
+          boundsMax.x < viewMin.x || boundsMin.x > viewMax.x ||
+          boundsMax.y < viewMin.y || boundsMin.y > viewMax.y
+        ) {
+          continue;
+        }
+      }
+
+      opaque.push_back(SpriteInstance {
+        .pos = { to, depths[i].value },
+        .color = colors[i].value,
+        .size = sizes[i].value,
+        .prevPos = from,
+      });
+    }
+  });
+
+  // Front-to-back so that the depth test rejects hidden fragments
+  // before they are shaded.
+  if (cfg.sortOpaque) {
+    std::sort(opaque.begin(), opaque.end(), [](const SpriteInstance &a, const SpriteInstance &b) {
+      return a.pos.z < b.pos.z;
+    });
+  }
+
+  tick = curr.tick;
+  field = curr.field.getCells();
+
+  ++version;
 }
 
-void RenderData::update(GameState &state) {
+void RenderData::setAlpha(float alpha) {
+  this->alpha = alpha;
+  viewPos = glm::mix(prevViewPos, currViewPos, alpha);
 }
 
 void RenderData::deinit() {
+  opaque.clear();
+  field.clear();
 }
 
 bool Renderer::RenderPass::init(
   SDL_GPUDevice *device,
   SDL_Window *window,
-  int targetW,
-  int targetH,
-  SDL_PixelFormat targetFormat,
-  std::string_view shaderName,
-  SDL_GPUVertexInputState inputLayout,
-  uint32_t numVertexStorageBuffers,
-  uint32_t numFragmentStorageBuffers,
-  uint32_t numTextures,
-  bool swapchainTarget
+  const RenderPassDesc &desc
 ) {
   this->device = device;
-  isSwapchainTarget = swapchainTarget;
+  this->window = window;
+  this->desc = desc;
+  targetType = desc.target;
+  loadOp = desc.loadOp;
+  depthMode = desc.depthMode;
 
-  auto shadersInputDir = std::filesystem::path(getConfig().shadersInputDir);
-  auto shadersOutputDir = std::filesystem::path(getConfig().shadersOutputDir);
+  if (targetType == PassTarget::OWN) {
+    target.init(
+      device,
+      desc.targetW,
+      desc.targetH,
+      desc.targetFormat,
+      TextureType::TARGET,
+      desc.shaderName + "_target"
+    );
+  }
+
+  pipeline = createPipeline(false);
+  if (pipeline == nullptr) {
+    deinit();
+    return false;
+  }
+
+  return true;
+}
+
+SDL_GPUGraphicsPipeline *Renderer::RenderPass::createPipeline(bool forceCompile) const {
+  // Also called on the shader watcher thread
+  auto cfg = getConfigSnapshot();
+  auto shadersInputDir = std::filesystem::path(cfg->shadersInputDir);
+  auto shadersOutputDir = std::filesystem::path(cfg->shadersOutputDir);
 
   SDL_GPUShader *vertex = createShader(
     device,
-    (shadersInputDir / shaderName).concat(".vert.hlsl"),
+    (shadersInputDir / desc.shaderName).concat(".vert.hlsl"),
     shadersOutputDir,
+    desc.features,
     0, /* TODO: no vertex samplers for now... */
-    numVertexStorageBuffers
+    desc.numVertexStorageBuffers,
+    forceCompile
   );
   if (!vertex) {
-    deinit();
-    return false;
+    return nullptr;
   }
 
   SDL_GPUShader *fragment = createShader(
     device,
-    (shadersInputDir / shaderName).concat(".frag.hlsl"),
+    (shadersInputDir / desc.shaderName).concat(".frag.hlsl"),
     shadersOutputDir,
-    numTextures,
-    numFragmentStorageBuffers
+    desc.features,
+    desc.numTextures,
+    desc.numFragmentStorageBuffers,
+    forceCompile
   );
   if (!fragment) {
-    deinit();
-    return false;
+    SDL_ReleaseGPUShader(device, vertex);
+    return nullptr;
   }
 
-  if (!isSwapchainTarget) {
-    target.init(device, targetW, targetH, targetFormat, TextureType::TARGET, "render_target");
+  SDL_GPUColorTargetDescription targetDesc = {};
+  if (targetType == PassTarget::SWAPCHAIN) {
+    targetDesc.format = SDL_GetGPUSwapchainTextureFormat(device, window);
+  } else if (targetType != PassTarget::NONE) {
+    targetDesc.format = GPUTexture::getGPUTextureFormat(desc.targetFormat);
+  }
+  if (desc.additiveBlend) {
+    targetDesc.blend_state = SDL_GPUColorTargetBlendState {
+      .src_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE,
+      .dst_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE,
+      .color_blend_op = SDL_GPU_BLENDOP_ADD,
+      .src_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE,
+      .dst_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE,
+      .alpha_blend_op = SDL_GPU_BLENDOP_ADD,
+      .enable_blend = true,
+    };
+  } else if (desc.alphaBlend) {
+    targetDesc.blend_state = SDL_GPUColorTargetBlendState {
+      .src_color_blendfactor = SDL_GPU_BLENDFACTOR_SRC_ALPHA,
+      .dst_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+      .color_blend_op = SDL_GPU_BLENDOP_ADD,
+      .src_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE,
+      .dst_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+      .alpha_blend_op = SDL_GPU_BLENDOP_ADD,
+      .enable_blend = true,
+    };
   }
 
-  SDL_GPUColorTargetDescription targetDesc = {
-    .format = isSwapchainTarget ?
-      SDL_GetGPUSwapchainTextureFormat(device, window) :
-      GPUTexture::getGPUTextureFormat(targetFormat),
-  };
+  bool hasDepth = depthMode != DepthMode::NONE;
+  assert(!hasDepth || desc.depthFormat != SDL_GPU_TEXTUREFORMAT_INVALID);
 
   SDL_GPUGraphicsPipelineTargetInfo targetInfo = {
-    .color_target_descriptions = &targetDesc,
-    .num_color_targets = 1,
-    .has_depth_stencil_target = false,
+    .color_target_descriptions = targetType == PassTarget::NONE ? nullptr : &targetDesc,
+    .num_color_targets = targetType == PassTarget::NONE ? 0u : 1u,
+    .depth_stencil_format = desc.depthFormat,
+    .has_depth_stencil_target = hasDepth,
+  };
+
+  SDL_GPUDepthStencilState depthState = {
+    .compare_op = depthMode == DepthMode::EQUAL ?
+      SDL_GPU_COMPAREOP_EQUAL :
+      SDL_GPU_COMPAREOP_LESS,
+    .enable_depth_test = hasDepth,
+    .enable_depth_write = depthMode == DepthMode::TEST_WRITE,
   };
 
   SDL_GPUGraphicsPipelineCreateInfo info = {
     .vertex_shader = vertex,
     .fragment_shader = fragment,
-    .vertex_input_state = inputLayout,
+    .vertex_input_state = desc.inputLayout,
     .primitive_type = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST,
+    .depth_stencil_state = depthState,
     .target_info = targetInfo,
   };
-  SDL_CHECK_RET((pipeline = SDL_CreateGPUGraphicsPipeline(device, &info)), false);
+  SDL_GPUGraphicsPipeline *result = SDL_CreateGPUGraphicsPipeline(device, &info);
 
   SDL_ReleaseGPUShader(device, vertex);
   SDL_ReleaseGPUShader(device, fragment);
 
+  SDL_CHECK_RET(result != nullptr, nullptr);
+
+  return result;
+}
+
+bool Renderer::RenderPass::dependsOn(const std::filesystem::path &file) const {
+  if (file.extension() == ".hlsl") {
+    auto name = file.filename().string();
+    return name == desc.shaderName + ".vert.hlsl" || name == desc.shaderName + ".frag.hlsl";
+  }
+
+  // Includes and shared headers - we don't know who includes them.
   return true;
 }
 
@@ -100,20 +240,40 @@ void Renderer::RenderPass::deinit() {
   *this = {};
 }
 
-bool Renderer::RenderPass::begin(SDL_GPUCommandBuffer *cmdBuf, SDL_GPUTexture *swapchain) {
+bool Renderer::RenderPass::begin(
+  SDL_GPUCommandBuffer *cmdBuf,
+  SDL_GPUTexture *external,
+  SDL_GPUTexture *depth
+) {
   assert(renderPass == nullptr);
 
   SDL_GPUColorTargetInfo colorTargetInfo = {
-    .texture = isSwapchainTarget ? swapchain : target.get(),
-    .load_op = SDL_GPU_LOADOP_LOAD,
+    .texture = targetType == PassTarget::OWN ? target.get() : external,
+    .clear_color = { 0.f, 0.f, 0.f, 0.f },
+    .load_op = loadOp,
     .store_op = SDL_GPU_STOREOP_STORE,
   };
 
+  SDL_GPUDepthStencilTargetInfo depthTargetInfo = {
+    .texture = depth,
+    .clear_depth = 1.f,
+    // A pass testing for equality uses the depth of the pre-pass
+    .load_op = depthMode == DepthMode::EQUAL ? SDL_GPU_LOADOP_LOAD : SDL_GPU_LOADOP_CLEAR,
+    .store_op = SDL_GPU_STOREOP_STORE,
+    .stencil_load_op = SDL_GPU_LOADOP_DONT_CARE,
+    .stencil_store_op = SDL_GPU_STOREOP_DONT_CARE,
+  };
+
+  bool hasColor = targetType != PassTarget::NONE;
+  bool hasDepth = depthMode != DepthMode::NONE;
+  assert(!hasColor || colorTargetInfo.texture != nullptr);
+  assert(!hasDepth || depth != nullptr);
+
   SDL_CHECK((renderPass = SDL_BeginGPURenderPass(
     cmdBuf,
-    &colorTargetInfo,
-    1,
-    nullptr // TODO: add depth support
+    hasColor ? &colorTargetInfo : nullptr,
+    hasColor ? 1 : 0,
+    hasDepth ? &depthTargetInfo : nullptr
   )));
 
   SDL_BindGPUGraphicsPipeline(
@@ -125,29 +285,32 @@ bool Renderer::RenderPass::begin(SDL_GPUCommandBuffer *cmdBuf, SDL_GPUTexture *s
 }
 
 void Renderer::RenderPass::bind(
-  const std::vector<SDL_GPUTexture*> &textures,
-  const std::vector<SDL_GPUBuffer*> &storageBuffers,
-  const std::vector<SDL_GPUBuffer*> &vertexBuffers,
+  std::initializer_list<SDL_GPUTexture*> textures,
+  std::initializer_list<SDL_GPUBuffer*> vertexStorageBuffers,
+  std::initializer_list<SDL_GPUBuffer*> fragmentStorageBuffers,
+  std::initializer_list<SDL_GPUBuffer*> vertexBuffers,
   SDL_GPUBuffer *indexBuffer,
-  SDL_GPUTexture *depthBuffer,
   SDL_GPUSampler *sampler
 ) {
   assert(renderPass != nullptr);
+  assert(textures.size() <= MAX_BINDINGS && vertexBuffers.size() <= MAX_BINDINGS);
+  ++binds;
 
   // Bind vertex buffers
-  std::vector<SDL_GPUBufferBinding> vertexBindings;
+  SDL_GPUBufferBinding vertexBindings[MAX_BINDINGS];
+  Uint32 numVertexBindings = 0;
   for (SDL_GPUBuffer *buffer : vertexBuffers) {
-    vertexBindings.push_back(SDL_GPUBufferBinding {
+    vertexBindings[numVertexBindings++] = SDL_GPUBufferBinding {
       .buffer = buffer,
       .offset = 0
-    });
+    };
   }
-  if (!vertexBuffers.empty()) {
+  if (numVertexBindings > 0) {
     SDL_BindGPUVertexBuffers(
       renderPass,
       0,
-      vertexBindings.data(),
-      static_cast<Uint32>(vertexBuffers.size())
+      vertexBindings,
+      numVertexBindings
     );
   }
 
@@ -164,39 +327,56 @@ void Renderer::RenderPass::bind(
   );
 
   // Bind storage buffers
-  if (!storageBuffers.empty()) {
+  if (vertexStorageBuffers.size() > 0) {
+    SDL_BindGPUVertexStorageBuffers(
+      renderPass,
+      0,
+      std::data(vertexStorageBuffers),
+      static_cast<Uint32>(vertexStorageBuffers.size())
+    );
+  }
+  if (fragmentStorageBuffers.size() > 0) {
     SDL_BindGPUFragmentStorageBuffers(
       renderPass,
       0,
-      storageBuffers.data(),
-      static_cast<Uint32>(storageBuffers.size())
+      std::data(fragmentStorageBuffers),
+      static_cast<Uint32>(fragmentStorageBuffers.size())
     );
   }
 
   // Bind samplers
-  std::vector<SDL_GPUTextureSamplerBinding> samplerBindings;
+  SDL_GPUTextureSamplerBinding samplerBindings[MAX_BINDINGS];
+  Uint32 numSamplerBindings = 0;
   for (SDL_GPUTexture *texture : textures) {
-    samplerBindings.push_back(SDL_GPUTextureSamplerBinding {
+    samplerBindings[numSamplerBindings++] = SDL_GPUTextureSamplerBinding {
       .texture = texture,
       .sampler = sampler
-    });
+    };
   }
-  if (!samplerBindings.empty()) {
+  if (numSamplerBindings > 0) {
     SDL_BindGPUFragmentSamplers(
       renderPass,
       0,
-      samplerBindings.data(),
-      static_cast<Uint32>(samplerBindings.size())
+      samplerBindings,
+      numSamplerBindings
     );
   }
 }
 
 void Renderer::RenderPass::exec(uint32_t numIndices, uint32_t numInstances) {
   assert(renderPass != nullptr);
+  ++draws;
 
   SDL_DrawGPUIndexedPrimitives(renderPass, numIndices, numInstances, 0, 0, 0);
 }
 
+void Renderer::RenderPass::execIndirect(SDL_GPUBuffer *args, uint32_t offset) {
+  assert(renderPass != nullptr);
+  ++draws;
+
+  SDL_DrawGPUIndexedPrimitivesIndirect(renderPass, args, offset, 1);
+}
+
 void Renderer::RenderPass::end() {
   if (renderPass != nullptr) {
     SDL_EndGPURenderPass(renderPass);
@@ -209,61 +389,195 @@ bool Renderer::init(GPUContext *gpu) {
 
   this->gpu = gpu;
 
-  if (!renderPass.init(
-    gpu->device,
-    gpu->window,
-    getConfig().windowW,
-    getConfig().windowH,
-    SDL_PIXELFORMAT_RGBA32,
-    "screen",
-    {},
-    0,
-    0,
-    0,
-    false
-  )) {
+  const Config &cfg = getConfig();
+  int w = static_cast<int>(cfg.windowW);
+  int h = static_cast<int>(cfg.windowH);
+  depthPrepass = cfg.depthPrepass;
+  gpuCulling = cfg.gpuCulling;
+  overdrawDebug = cfg.overdrawDebug;
+  parallelRecording = cfg.parallelRecording;
+  hudEnabled = cfg.perfHud;
+
+  recorder.init(gpu->device);
+
+  if (!setFramesInFlight(cfg.framesInFlight)) {
     return false;
   }
 
-  if (!postprocessPass.init(
-    gpu->device,
-    gpu->window,
-    getConfig().windowW,
-    getConfig().windowH,
-    SDL_PIXELFORMAT_RGBA32,
-    "post",
-    {},
-    0,
-    0,
-    1,
-    false
-  )) {
+  SDL_GPUTextureFormat depthFormat = GPUTexture::getDepthFormat(gpu->device);
+  if (!depthBuffer.init(gpu->device, w, h, depthFormat, TextureType::DEPTH, "depth")) {
     return false;
   }
 
-  if (!postprocessPass2.init(
-    gpu->device,
-    gpu->window,
-    0,
-    0,
-    SDL_PIXELFORMAT_UNKNOWN,
-    "post2",
-    {},
-    0,
-    0,
-    1,
-    true
-  )) {
-    return false;
+  std::vector<std::pair<RenderPass*, RenderPassDesc>> passes;
+
+  passes.push_back({ &renderPass, {
+    .shaderName = "screen",
+    .target = PassTarget::OWN,
+    .targetW = w,
+    .targetH = h,
+    .targetFormat = SDL_PIXELFORMAT_RGBA32,
+  }});
+
+  if (depthPrepass) {
+    passes.push_back({ &scenePrepass, {
+      .shaderName = "scene",
+      .features = { "DEPTH_ONLY" },
+      .target = PassTarget::NONE,
+      .depthMode = DepthMode::TEST_WRITE,
+      .depthFormat = depthFormat,
+      .numVertexStorageBuffers = 1,
+    }});
+  }
+
+  // In overdraw mode the scene is drawn additively into its own target
+  // with the same depth state, so it counts exactly the shaded fragments.
+  passes.push_back({ &scenePass, {
+    .shaderName = "scene",
+    .features = overdrawDebug ? ShaderFeatures{ "OVERDRAW" } : ShaderFeatures{},
+    .target = overdrawDebug ? PassTarget::OWN : PassTarget::EXTERNAL,
+    .targetW = w,
+    .targetH = h,
+    .targetFormat = SDL_PIXELFORMAT_RGBA32,
+    .loadOp = overdrawDebug ? SDL_GPU_LOADOP_CLEAR : SDL_GPU_LOADOP_LOAD,
+    .additiveBlend = overdrawDebug,
+    .depthMode = depthPrepass ? DepthMode::EQUAL : DepthMode::TEST_WRITE,
+    .depthFormat = depthFormat,
+    .numVertexStorageBuffers = 1,
+  }});
+
+  bool hasField = cfg.fieldSize.x > 0 && cfg.fieldSize.y > 0;
+  fieldBackend = cfg.fieldBackend;
+  fieldStepsPerTick = static_cast<int>(cfg.fieldStepsPerTick);
+  fieldTick = 0;
+  if (hasField) {
+    // Covers the screen pass, reading the field buffer directly.
+    passes.push_back({ &fieldPass, {
+      .shaderName = "field",
+      .target = PassTarget::EXTERNAL,
+      .targetFormat = SDL_PIXELFORMAT_RGBA32,
+      .loadOp = SDL_GPU_LOADOP_DONT_CARE,
+      .numFragmentStorageBuffers = 1,
+    }});
+  }
+
+  passes.push_back({ &postprocessPass, {
+    .shaderName = "post",
+    .target = PassTarget::OWN,
+    .targetW = w,
+    .targetH = h,
+    .targetFormat = SDL_PIXELFORMAT_RGBA32,
+    .numTextures = 1,
+  }});
+
+  passes.push_back({ &postprocessPass2, {
+    .shaderName = "post2",
+    .target = PassTarget::SWAPCHAIN,
+    .numTextures = 1,
+  }});
+
+  // Created even if hidden, it can be toggled while running.
+  passes.push_back({ &hudPass, {
+    .shaderName = "hud",
+    .target = PassTarget::SWAPCHAIN,
+    .alphaBlend = true,
+    .numVertexStorageBuffers = 1,
+    .numTextures = 1,
+  }});
+
+  ComputePipelineDesc cullDesc = {
+    .numReadonlyStorageBuffers = 1,
+    .numReadWriteStorageBuffers = 2,
+    .numUniformBuffers = 1,
+    .threadCountX = CULL_GROUP_SIZE,
+  };
+
+  // Compile whatever is out of date in parallel,
+  // creating the pipelines below only loads the results.
+  auto shadersInputDir = std::filesystem::path(cfg.shadersInputDir);
+  std::vector<ShaderSource> sources;
+  for (const auto &[pass, desc] : passes) {
+    sources.push_back({ (shadersInputDir / desc.shaderName).concat(".vert.hlsl"), desc.features });
+    sources.push_back({ (shadersInputDir / desc.shaderName).concat(".frag.hlsl"), desc.features });
+  }
+  if (gpuCulling) {
+    sources.push_back({ shadersInputDir / "cull.comp.hlsl", cullDesc.features });
+  }
+  if (hasField && fieldBackend == FieldBackend::GPU) {
+    sources.push_back({ shadersInputDir / "field.comp.hlsl", {} });
+  }
+  precompileShaders(gpu->device, sources, cfg.shadersOutputDir);
+
+  for (const auto &[pass, desc] : passes) {
+    if (!pass->init(gpu->device, gpu->window, desc)) {
+      return false;
+    }
   }
 
   std::vector<Uint16> indexDataScreenTri = {0, 1, 2};
+  std::vector<Uint16> indexDataQuad = {0, 1, 2, 2, 1, 3};
   if (!gpu->upload(
-    UploadBuffer<Uint16>{ indexDataScreenTri, &screenTriIndexBuffer, BufferType::INDEX }
+    UploadBuffer<Uint16>{ indexDataScreenTri, &screenTriIndexBuffer, BufferType::INDEX },
+    UploadBuffer<Uint16>{ indexDataQuad, &quadIndexBuffer, BufferType::INDEX }
   )) {
     return false;
   }
 
+  if (gpuCulling) {
+    if (!cullPass.init(gpu->device, "cull", cullDesc)) {
+      return false;
+    }
+
+    // Copied over drawArgs before every cull, the instance count is filled by the shader
+    std::vector<Uint32> initialArgs = { 6, 0, 0, 0, 0 };
+    static_assert(sizeof(Uint32) * 5 == sizeof(SDL_GPUIndexedIndirectDrawCommand));
+    if (!gpu->upload(
+      UploadBuffer<Uint32>{ initialArgs, &drawArgsInit, BufferType::INDIRECT }
+    )) {
+      return false;
+    }
+    if (!drawArgs.init(gpu->device, sizeof(SDL_GPUIndexedIndirectDrawCommand), BufferType::INDIRECT)) {
+      return false;
+    }
+  }
+
+  if (hasField && !field.init(gpu, cfg.fieldSize, fieldBackend == FieldBackend::GPU)) {
+    return false;
+  }
+
+  if (cfg.streamChunkSize > 0) {
+    // The same area GameState spreads its sprites over
+    glm::vec2 worldSize = { float(cfg.worldSize.x), float(cfg.worldSize.y) };
+    if (cfg.worldSize.x <= 0 || cfg.worldSize.y <= 0) {
+      worldSize = { float(w), float(h) };
+    }
+
+    StreamParams streamParams = {
+      .chunkSize = float(cfg.streamChunkSize),
+      .worldSize = worldSize,
+      .spritesPerChunk = cfg.streamSpritesPerChunk,
+      .seed = cfg.worldSeed,
+      .radius = cfg.streamRadius,
+      .memoryBytes = uint64_t(cfg.streamMemoryMB) * 1024 * 1024,
+      .maxLoads = cfg.streamMaxLoads,
+      .maxUploads = cfg.streamUploadsPerFrame,
+      .framesInFlight = FRAMES_IN_FLIGHT,
+    };
+    if (!streamer.init(gpu, streamParams)) {
+      return false;
+    }
+  }
+
+  if (overdrawDebug) {
+    SDL_GPUTransferBufferCreateInfo tbInfo = {
+      .usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD,
+      .size = static_cast<Uint32>(w * h * 4),
+    };
+    for (int i = 0; i < FRAMES_IN_FLIGHT; ++i) {
+      SDL_CHECK((overdrawReadback[i] = SDL_CreateGPUTransferBuffer(gpu->device, &tbInfo)));
+    }
+  }
+
   SDL_GPUSamplerCreateInfo samplerInfo = {
 		.min_filter = SDL_GPU_FILTER_NEAREST,
 		.mag_filter = SDL_GPU_FILTER_NEAREST,
@@ -274,26 +588,110 @@ bool Renderer::init(GPUContext *gpu) {
 	};
   SDL_CHECK((pointSampler = SDL_CreateGPUSampler(gpu->device, &samplerInfo)));
 
+  SDL_Surface *font = nullptr;
+  SDL_CHECK((font = PerfHud::createFont()));
+  bool uploaded = gpu->upload(UploadTexture{
+    .name = "hud_font",
+    .surface = &font,
+    .result = &hudFont,
+    .usage = TextureType::SAMPLER,
+  });
+  SDL_DestroySurface(font);
+  if (!uploaded) {
+    return false;
+  }
+
+  auto hudBytes = static_cast<Uint32>(PerfHud::MAX_QUADS * sizeof(HudQuad));
+  if (!hudQuads.init(gpu->device, hudBytes, BufferType::STORAGE)) {
+    return false;
+  }
+  SDL_GPUTransferBufferCreateInfo hudTransferInfo = {
+    .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+    .size = hudBytes,
+  };
+  SDL_CHECK((hudTransfer = SDL_CreateGPUTransferBuffer(gpu->device, &hudTransferInfo)));
+
+  if (cfg.shaderHotReload) {
+    gatherReloadPasses();
+
+    std::vector<std::filesystem::path> dirs = { cfg.shadersInputDir };
+    if (auto sharedDir = cfg.shadersIncludeDir() / "gpu_shared"; std::filesystem::is_directory(sharedDir)) {
+      dirs.push_back(sharedDir);
+    }
+
+    shaderWatcher.start(
+      dirs,
+      { ".hlsl", ".hlsli", ".h" },
+      [this](const std::vector<std::filesystem::path> &files) { reloadShaders(files); }
+    );
+  }
+
   return true;
 }
 
 void Renderer::deinit() {
+  if (gpu == nullptr) {
+    return;
+  }
+
+  shaderWatcher.stop();
+
   for (int i = 0; i < FRAMES_IN_FLIGHT; ++i) {
-    if (fences[i] != nullptr) {
-      SDL_WaitForGPUFences(gpu->device, true, &fences[i], 1);
-      SDL_ReleaseGPUFence(gpu->device, fences[i]);
-      fences[i] = nullptr;
+    waitFrame(i);
+
+    if (spriteUploads[i].has_value()) {
+      gpu->wait(*spriteUploads[i]);
+      spriteUploads[i] = std::nullopt;
+    }
+    spriteBuffers[i].deinit();
+
+    if (overdrawReadback[i] != nullptr) {
+      SDL_ReleaseGPUTransferBuffer(gpu->device, overdrawReadback[i]);
+      overdrawReadback[i] = nullptr;
     }
   }
 
+  releaseRetiredPipelines(true);
+  for (auto &reloaded : reloadedPipelines) {
+    if (reloaded.pipeline != nullptr) {
+      SDL_ReleaseGPUGraphicsPipeline(gpu->device, reloaded.pipeline);
+    }
+    if (reloaded.computePipeline != nullptr) {
+      SDL_ReleaseGPUComputePipeline(gpu->device, reloaded.computePipeline);
+    }
+  }
+  reloadedPipelines.clear();
+  reloadPasses.clear();
+  reloadComputePasses.clear();
+
   if (pointSampler != nullptr) {
     SDL_ReleaseGPUSampler(gpu->device, pointSampler);
     pointSampler = nullptr;
   }
 
+  if (hudTransfer != nullptr) {
+    SDL_ReleaseGPUTransferBuffer(gpu->device, hudTransfer);
+    hudTransfer = nullptr;
+  }
+  hudFont.deinit();
+  hudQuads.deinit();
+  hudPass.deinit();
+
   screenTriIndexBuffer.deinit();
+  quadIndexBuffer.deinit();
+  visibleSprites.deinit();
+  drawArgs.deinit();
+  drawArgsInit.deinit();
+  cullPass.deinit();
+  field.deinit();
+  streamer.deinit();
+  depthBuffer.deinit();
   renderPass.deinit();
+  fieldPass.deinit();
+  scenePrepass.deinit();
+  scenePass.deinit();
   postprocessPass.deinit();
+  postprocessPass2.deinit();
 
   gpu = nullptr;
 }
@@ -302,86 +700,639 @@ SDL_AppResult Renderer::draw(
   const ShaderConstData &shaderConstData,
   const RenderData &renderData
 ) {
+  ALLOC_SCOPE("draw");
+
+  Uint64 drawStart = SDL_GetTicksNS();
+  hudFrame.frameMs = lastDrawNS != 0 ? double(drawStart - lastDrawNS) / SDL_NS_PER_MS : 0.;
+  lastDrawNS = drawStart;
+
   frameCycle = (frameCycle + 1) % FRAMES_IN_FLIGHT;
+  ++frameIndex;
+
+  // With fewer frames in flight the ones right before it are waited too
+  for (int i = 0; i <= FRAMES_IN_FLIGHT - framesInFlight; ++i) {
+    finishFrame((frameCycle + FRAMES_IN_FLIGHT - i) % FRAMES_IN_FLIGHT);
+  }
+
+  swapReloadedPipelines();
+  releaseRetiredPipelines(false);
+
+  // The sprites only change with a new snapshot, the in-between frames
+  // interpolate them on the GPU. The other buffer was last used at least
+  // two frames ago, so its fence was already waited.
+  bool fresh = renderData.version != spriteVersion;
+  auto numSprites = static_cast<uint32_t>(renderData.opaque.size());
+  if (fresh && numSprites > 0) {
+    spriteSlot = (spriteSlot + 1) % FRAMES_IN_FLIGHT;
+
+    if (spriteUploads[spriteSlot].has_value()) {
+      gpu->wait(*spriteUploads[spriteSlot]);
+      spriteUploads[spriteSlot] = std::nullopt;
+    }
+
+    spriteUploads[spriteSlot] = gpu->uploadAsync(
+      UploadBuffer<SpriteInstance>{
+        renderData.opaque,
+        &spriteBuffers[spriteSlot],
+        gpuCulling ? BufferType::COMPUTE_READ : BufferType::STORAGE
+      }
+    );
+    if (!spriteUploads[spriteSlot].has_value()) {
+      return SDL_APP_FAILURE;
+    }
+    ++spriteUploadCount;
+  }
+  spriteVersion = renderData.version;
+
+  viewSize = { float(getConfig().windowW), float(getConfig().windowH) };
+
+  // Uploads go before any of the frame's command buffers, so the chunks
+  // made resident here can be drawn right away.
+  if (streamer.enabled()) {
+    if (!streamer.update(renderData.viewPos + viewSize * 0.5f)) {
+      return SDL_APP_FAILURE;
+    }
+  }
+
+  // The CPU backend's field is uploaded like the sprites. The GPU one
+  // catches up with the simulation instead, a bounded number of ticks
+  // at a time so that a hitch doesn't snowball.
+  int fieldSteps = 0;
+  if (fieldPass.pipeline != nullptr) {
+    if (fieldBackend == FieldBackend::CPU) {
+      if (fresh && !renderData.field.empty() && !field.upload(renderData.field)) {
+        return SDL_APP_FAILURE;
+      }
+    } else {
+      static constexpr uint64_t MAX_FIELD_TICKS = 4;
+      uint64_t ticks = renderData.tick > fieldTick ? renderData.tick - fieldTick : 0;
+      fieldSteps = static_cast<int>(std::min(ticks, MAX_FIELD_TICKS)) * fieldStepsPerTick;
+      fieldTick = renderData.tick;
+    }
+  }
+
+  // Uniforms are per command buffer, see pushUniforms
+  constData = shaderConstData;
+
+  recorder.add("screen", [&](SDL_GPUCommandBuffer *cmdBuf) {
+    pushUniforms(cmdBuf);
+
+    if (!renderPass.begin(cmdBuf)) {
+      return false;
+    }
+    renderPass.bind(
+      {},
+      {},
+      {},
+      {},
+      screenTriIndexBuffer.get(),
+      pointSampler
+    );
+    renderPass.exec(3, 1);
+    renderPass.end();
+
+    return true;
+  });
 
-  if (fences[frameCycle] != nullptr) {
-    SDL_WaitForGPUFences(gpu->device, true, &fences[frameCycle], 1);
-    SDL_ReleaseGPUFence(gpu->device, fences[frameCycle]);
-    fences[frameCycle] = nullptr;
+  if (fieldPass.pipeline != nullptr) {
+    recorder.add("field", [&, fieldSteps](SDL_GPUCommandBuffer *cmdBuf) {
+      if (fieldSteps > 0 && !field.step(cmdBuf, fieldSteps)) {
+        return false;
+      }
+
+      const FieldConstData &fieldData = field.getParams();
+      SDL_PushGPUFragmentUniformData(cmdBuf, 0, &fieldData, sizeof(FieldConstData));
+
+      if (!fieldPass.begin(cmdBuf, renderPass.target.get())) {
+        return false;
+      }
+      fieldPass.bind(
+        {},
+        {},
+        {field.get()},
+        {},
+        screenTriIndexBuffer.get(),
+        pointSampler
+      );
+      fieldPass.exec(3, 1);
+      fieldPass.end();
+
+      return true;
+    });
+  }
+
+  if (numSprites > 0 && gpuCulling) {
+    // Created before recording as the scene step binds it too. It only
+    // grows, by half again so a slowly growing scene doesn't recreate it
+    // every frame.
+    auto needed = static_cast<Uint32>(numSprites * sizeof(SpriteInstance));
+    if (needed > visibleSprites.getSize() && !visibleSprites.init(
+      gpu->device,
+      std::max(needed, visibleSprites.getSize() + visibleSprites.getSize() / 2),
+      BufferType::COMPUTE_WRITE
+    )) {
+      return SDL_APP_FAILURE;
+    }
+
+    recorder.add("cull", [&](SDL_GPUCommandBuffer *cmdBuf) {
+      return cull(cmdBuf, renderData);
+    });
+  }
+
+  recorder.add("scene", [&](SDL_GPUCommandBuffer *cmdBuf) {
+    pushUniforms(cmdBuf);
+    return drawScene(cmdBuf, renderData);
+  });
+
+  recorder.add("post", [&](SDL_GPUCommandBuffer *cmdBuf) {
+    pushUniforms(cmdBuf);
+
+    if (!postprocessPass.begin(cmdBuf)) {
+      return false;
+    }
+    postprocessPass.bind(
+      {overdrawDebug ? scenePass.target.get() : renderPass.target.get()},
+      {},
+      {},
+      {},
+      screenTriIndexBuffer.get(),
+      pointSampler
+    );
+    postprocessPass.exec(3, 1);
+    postprocessPass.end();
+
+    return true;
+  });
+
+  bool recorded = recorder.run(parallelRecording);
+  fences[frameCycle] = recorder.getFences();
+  gatherRecordStats();
+  if (!recorded) {
+    return SDL_APP_FAILURE;
   }
 
+  // The swapchain has to be acquired and presented on the main thread,
+  // so the last pass is recorded here and submitted after the others.
+  Uint64 presentStart = SDL_GetTicksNS();
   SDL_GPUCommandBuffer *cmdBuf;
   SDL_CHECK_APP((cmdBuf = SDL_AcquireGPUCommandBuffer(gpu->device)));
 
   SDL_GPUTexture *swapchain = nullptr;
-  SDL_CHECK_APP(
-    SDL_AcquireGPUSwapchainTexture(
-      cmdBuf,
-      gpu->window,
-      &swapchain,
-      nullptr,
-      nullptr
-    )
-  );
+  if (!SDL_AcquireGPUSwapchainTexture(cmdBuf, gpu->window, &swapchain, nullptr, nullptr)) {
+    LOG_ERROR("Failed to acquire the swapchain texture: %s\n", SDL_GetError());
+    SDL_CancelGPUCommandBuffer(cmdBuf);
+    return SDL_APP_FAILURE;
+  }
+
+  // Not presenting this frame (e.g. minimized), the command buffer
+  // still has to be submitted.
+  if (swapchain != nullptr) {
+    pushUniforms(cmdBuf);
+
+    // Copied before any render pass begins
+    Uint64 hudStart = SDL_GetTicksNS();
+    uint32_t numHudQuads = hudEnabled ? uploadHud(cmdBuf) : 0;
+    hudFrame.hudMs += double(SDL_GetTicksNS() - hudStart) / SDL_NS_PER_MS;
+
+    postprocessPass2.begin(cmdBuf, swapchain);
+    postprocessPass2.bind(
+      {postprocessPass.target.get()},
+      {},
+      {},
+      {},
+      screenTriIndexBuffer.get(),
+      pointSampler
+    );
+    postprocessPass2.exec(3, 1);
+    postprocessPass2.end();
+
+    // All of it in one draw
+    if (numHudQuads > 0 && hudPass.begin(cmdBuf, swapchain)) {
+      hudPass.bind(
+        {hudFont.get()},
+        {hudQuads.get()},
+        {},
+        {},
+        quadIndexBuffer.get(),
+        pointSampler
+      );
+      hudPass.exec(6, numHudQuads);
+      hudPass.end();
+    }
+  }
+
+  SDL_GPUFence *fence = nullptr;
+  SDL_CHECK_APP((fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdBuf)));
+  fences[frameCycle].push_back(fence);
+
+  hudFrame.presentMs = double(SDL_GetTicksNS() - presentStart) / SDL_NS_PER_MS;
+  finishHudFrame();
+
+  return SDL_APP_CONTINUE;
+}
+
+uint32_t Renderer::uploadHud(SDL_GPUCommandBuffer *cmdBuf) {
+  const std::vector<HudQuad> &quads = hud.build();
+  auto bytes = static_cast<Uint32>(quads.size() * sizeof(HudQuad));
+
+  // Cycled, the previous frames may still read the buffer
+  void *data = nullptr;
+  SDL_CHECK_RET((data = SDL_MapGPUTransferBuffer(gpu->device, hudTransfer, true)), 0);
+  memcpy(data, quads.data(), bytes);
+  SDL_UnmapGPUTransferBuffer(gpu->device, hudTransfer);
+
+  SDL_GPUCopyPass *copyPass = nullptr;
+  SDL_CHECK_RET((copyPass = SDL_BeginGPUCopyPass(cmdBuf)), 0);
+  SDL_GPUTransferBufferLocation source = {
+    .transfer_buffer = hudTransfer,
+    .offset = 0,
+  };
+  SDL_GPUBufferRegion destination = {
+    .buffer = hudQuads.get(),
+    .offset = 0,
+    .size = bytes,
+  };
+  SDL_UploadToGPUBuffer(copyPass, &source, &destination, true);
+  SDL_EndGPUCopyPass(copyPass);
+
+  return static_cast<uint32_t>(quads.size());
+}
+
+void Renderer::finishHudFrame() {
+  hudFrame.uploadBytes = gpu->collectUploadedBytes();
+  hudFrame.streamBytes = streamer.enabled() ? streamer.getResidentBytes() : 0;
+  for (RenderPass *pass : { &renderPass, &fieldPass, &scenePrepass, &scenePass, &postprocessPass, &postprocessPass2, &hudPass }) {
+    hudFrame.draws += std::exchange(pass->draws, 0);
+    hudFrame.binds += std::exchange(pass->binds, 0);
+  }
 
-  if (swapchain == nullptr) {
-    return SDL_APP_CONTINUE;
+  if (hudEnabled) {
+    hud.addFrame(hudFrame, recorder.getTimings());
   }
+  hudFrame = {};
+}
 
+void Renderer::pushUniforms(SDL_GPUCommandBuffer *cmdBuf) const {
   SDL_PushGPUVertexUniformData(
     cmdBuf,
     0,
-    &shaderConstData,
+    &constData,
     sizeof(ShaderConstData)
   );
   SDL_PushGPUFragmentUniformData(
     cmdBuf,
     0,
-    &shaderConstData,
+    &constData,
     sizeof(ShaderConstData)
   );
+}
 
-  renderPass.begin(cmdBuf, swapchain);
-  renderPass.bind(
-    {},
-    {},
-    {},
-    screenTriIndexBuffer.get(),
-    nullptr,
-    pointSampler
-  );
-  renderPass.exec(3, 1);
-  renderPass.end();
-
-  postprocessPass.begin(cmdBuf, swapchain);
-  postprocessPass.bind(
-    {renderPass.target.get()},
-    {},
-    {},
-    screenTriIndexBuffer.get(),
-    nullptr,
-    pointSampler
-  );
-  postprocessPass.exec(3, 1);
-  postprocessPass.end();
-
-  postprocessPass2.begin(cmdBuf, swapchain);
-  postprocessPass2.bind(
-    {postprocessPass.target.get()},
-    {},
-    {},
-    screenTriIndexBuffer.get(),
-    nullptr,
-    pointSampler
+bool Renderer::drawScene(SDL_GPUCommandBuffer *cmdBuf, const RenderData &renderData) {
+  auto numSprites = static_cast<uint32_t>(renderData.opaque.size());
+  bool hasChunks = streamer.getNumResident() > 0;
+
+  glm::vec2 viewMin = renderData.viewPos;
+  glm::vec2 viewMax = viewMin + viewSize;
+
+  // With GPU culling the number of instances is only known by the GPU
+  SDL_GPUBuffer *sprites = gpuCulling ? visibleSprites.get() : spriteBuffers[spriteSlot].get();
+  auto drawSprites = [&](RenderPass &pass) {
+    if (numSprites > 0) {
+      pass.bind(
+        {},
+        {sprites},
+        {},
+        {},
+        quadIndexBuffer.get(),
+        pointSampler
+      );
+      if (gpuCulling) {
+        pass.execIndirect(drawArgs.get());
+      } else {
+        pass.exec(6, numSprites);
+      }
+    }
+
+    // The chunks don't move, they are only culled as a whole.
+    streamer.forEachVisible(viewMin, viewMax, [&pass, this](SDL_GPUBuffer *buffer, uint32_t count, double) {
+      pass.bind(
+        {},
+        {buffer},
+        {},
+        {},
+        quadIndexBuffer.get(),
+        pointSampler
+      );
+      pass.exec(6, count);
+    });
+  };
+
+  if ((numSprites > 0 || hasChunks) && depthPrepass) {
+    if (!scenePrepass.begin(cmdBuf, nullptr, depthBuffer.get())) {
+      return false;
+    }
+    drawSprites(scenePrepass);
+    scenePrepass.end();
+  }
+
+  // The overdraw target has to be cleared even if there is nothing to draw.
+  if (numSprites > 0 || hasChunks || overdrawDebug) {
+    if (!scenePass.begin(cmdBuf, renderPass.target.get(), depthBuffer.get())) {
+      return false;
+    }
+    drawSprites(scenePass);
+    scenePass.end();
+  }
+
+  if (overdrawDebug) {
+    glm::ivec2 dim = scenePass.target.dim();
+
+    SDL_GPUCopyPass *copyPass = nullptr;
+    SDL_CHECK((copyPass = SDL_BeginGPUCopyPass(cmdBuf)));
+    SDL_GPUTextureRegion region = {
+      .texture = scenePass.target.get(),
+      .w = static_cast<Uint32>(dim.x),
+      .h = static_cast<Uint32>(dim.y),
+      .d = 1,
+    };
+    SDL_GPUTextureTransferInfo transferInfo = {
+      .transfer_buffer = overdrawReadback[frameCycle],
+      .offset = 0,
+      .pixels_per_row = static_cast<Uint32>(dim.x),
+      .rows_per_layer = static_cast<Uint32>(dim.y),
+    };
+    SDL_DownloadFromGPUTexture(copyPass, &region, &transferInfo);
+    SDL_EndGPUCopyPass(copyPass);
+
+    double area = 0.;
+    for (const SpriteInstance &sprite : renderData.opaque) {
+      area += double(sprite.size.x) * sprite.size.y;
+    }
+    streamer.forEachVisible(viewMin, viewMax, [&area](SDL_GPUBuffer*, uint32_t, double chunkArea) {
+      area += chunkArea;
+    });
+    overdrawSubmitted[frameCycle] = static_cast<float>(area / (double(dim.x) * dim.y));
+  }
+
+  return true;
+}
+
+bool Renderer::applyConfig(const Config &cfg) {
+  parallelRecording = cfg.parallelRecording;
+  hudEnabled = cfg.perfHud;
+
+  if (streamer.enabled()) {
+    streamer.setBudget(cfg.streamMaxLoads, cfg.streamUploadsPerFrame);
+  }
+
+  if (static_cast<int>(cfg.framesInFlight) != framesInFlight) {
+    // The swapchain can't change it with frames in flight
+    for (int i = 1; i <= FRAMES_IN_FLIGHT; ++i) {
+      finishFrame((frameCycle + i) % FRAMES_IN_FLIGHT);
+    }
+    if (!setFramesInFlight(cfg.framesInFlight)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool Renderer::setFramesInFlight(uint32_t count) {
+  framesInFlight = std::clamp(static_cast<int>(count), 1, FRAMES_IN_FLIGHT);
+  SDL_CHECK(SDL_SetGPUAllowedFramesInFlight(gpu->device, static_cast<Uint32>(framesInFlight)));
+
+  return true;
+}
+
+void Renderer::finishFrame(int frame) {
+  if (fences[frame].empty()) {
+    return;
+  }
+
+  waitFrame(frame);
+
+  if (overdrawDebug) {
+    readOverdraw(frame);
+  }
+}
+
+void Renderer::waitFrame(int frame) {
+  if (fences[frame].empty()) {
+    return;
+  }
+
+  Uint64 start = SDL_GetTicksNS();
+  SDL_WaitForGPUFences(
+    gpu->device,
+    true,
+    fences[frame].data(),
+    static_cast<Uint32>(fences[frame].size())
   );
-  postprocessPass2.exec(3, 1);
-  postprocessPass2.end();
+  hudFrame.gpuWaitMs += double(SDL_GetTicksNS() - start) / SDL_NS_PER_MS;
+  for (SDL_GPUFence *fence : fences[frame]) {
+    SDL_ReleaseGPUFence(gpu->device, fence);
+  }
+  fences[frame].clear();
+}
+
+void Renderer::gatherRecordStats() {
+  for (const auto &timing : recorder.getTimings()) {
+    auto &step = recordStats.steps[timing.step];
+    step.recordMs += timing.recordMs;
+    step.submitMs += timing.submitMs;
+    recordStats.threads[timing.thread] += timing.recordMs;
+  }
+  ++recordStats.frames;
+}
 
+RecordStats Renderer::collectRecordStats() {
+  // Zeroed in place, recreating the maps would allocate in the next frame.
+  RecordStats res = recordStats;
+  for (auto &[name, step] : recordStats.steps) {
+    step = {};
+  }
+  for (auto &[thread, ms] : recordStats.threads) {
+    ms = 0.;
+  }
+  recordStats.frames = 0;
 
+  if (res.frames > 0) {
+    for (auto &[name, step] : res.steps) {
+      step.recordMs /= res.frames;
+      step.submitMs /= res.frames;
+    }
+    for (auto &[thread, ms] : res.threads) {
+      ms /= res.frames;
+    }
+  }
 
-  SDL_CHECK_APP((
-    fences[frameCycle] = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdBuf)
-  ));
+  return res;
+}
+
+void Renderer::gatherReloadPasses() {
+  reloadPasses.clear();
+  for (RenderPass *pass : { &renderPass, &fieldPass, &scenePrepass, &scenePass, &postprocessPass, &postprocessPass2, &hudPass }) {
+    if (pass->pipeline != nullptr) {
+      reloadPasses.push_back(pass);
+    }
+  }
+
+  reloadComputePasses.clear();
+  for (ComputePass *pass : { &cullPass, field.getStepPass() }) {
+    if (pass != nullptr && pass->pipeline != nullptr) {
+      reloadComputePasses.push_back(pass);
+    }
+  }
+}
+
+void Renderer::reloadShaders(const std::vector<std::filesystem::path> &files) {
+  for (RenderPass *pass : reloadPasses) {
+    bool affected = std::any_of(files.begin(), files.end(), [pass](const auto &file) {
+      return pass->dependsOn(file);
+    });
+    if (!affected) {
+      continue;
+    }
+
+    Uint64 start = SDL_GetTicks();
+    SDL_GPUGraphicsPipeline *pipeline = pass->createPipeline(true);
+    if (pipeline == nullptr) {
+      LOG_ERROR("Failed to reload %s, keeping the old pipeline\n", pass->desc.shaderName.c_str());
+      continue;
+    }
+
+    LOG_INFO("Reloaded %s in %" SDL_PRIu64 "ms\n", pass->desc.shaderName.c_str(), SDL_GetTicks() - start);
+
+    std::lock_guard lock(reloadMutex);
+    reloadedPipelines.push_back({ .pass = pass, .pipeline = pipeline });
+  }
+
+  for (ComputePass *pass : reloadComputePasses) {
+    bool affected = std::any_of(files.begin(), files.end(), [pass](const auto &file) {
+      return pass->dependsOn(file);
+    });
+    if (!affected) {
+      continue;
+    }
 
-  return SDL_APP_SUCCESS;
+    Uint64 start = SDL_GetTicks();
+    SDL_GPUComputePipeline *pipeline = pass->createPipeline(true);
+    if (pipeline == nullptr) {
+      LOG_ERROR("Failed to reload %s, keeping the old pipeline\n", pass->shaderName.c_str());
+      continue;
+    }
+
+    LOG_INFO("Reloaded %s in %" SDL_PRIu64 "ms\n", pass->shaderName.c_str(), SDL_GetTicks() - start);
+
+    std::lock_guard lock(reloadMutex);
+    reloadedPipelines.push_back({ .computePass = pass, .computePipeline = pipeline });
+  }
+}
+
+void Renderer::swapReloadedPipelines() {
+  std::lock_guard lock(reloadMutex);
+
+  for (auto &reloaded : reloadedPipelines) {
+    if (reloaded.pass != nullptr) {
+      retiredPipelines.push_back({ .pipeline = reloaded.pass->pipeline, .frame = frameIndex });
+      reloaded.pass->pipeline = reloaded.pipeline;
+    } else {
+      retiredPipelines.push_back({ .computePipeline = reloaded.computePass->pipeline, .frame = frameIndex });
+      reloaded.computePass->pipeline = reloaded.computePipeline;
+    }
+  }
+  reloadedPipelines.clear();
+}
+
+void Renderer::releaseRetiredPipelines(bool all) {
+  // Frames up to frameIndex - FRAMES_IN_FLIGHT are done as their fence was waited.
+  auto isUnused = [this, all](const RetiredPipeline &retired) {
+    return all || retired.frame + FRAMES_IN_FLIGHT <= frameIndex + 1;
+  };
+
+  for (auto &retired : retiredPipelines) {
+    if (!isUnused(retired)) {
+      continue;
+    }
+    if (retired.pipeline != nullptr) {
+      SDL_ReleaseGPUGraphicsPipeline(gpu->device, retired.pipeline);
+    }
+    if (retired.computePipeline != nullptr) {
+      SDL_ReleaseGPUComputePipeline(gpu->device, retired.computePipeline);
+    }
+  }
+  std::erase_if(retiredPipelines, isUnused);
+}
+
+bool Renderer::cull(SDL_GPUCommandBuffer *cmdBuf, const RenderData &renderData) {
+  auto numSprites = static_cast<uint32_t>(renderData.opaque.size());
+
+  // Nothing is cycled here - the scene step may be recorded before this
+  // one and would bind the old buffers.
+
+  // Reset the instance count
+  SDL_GPUCopyPass *copyPass = nullptr;
+  SDL_CHECK((copyPass = SDL_BeginGPUCopyPass(cmdBuf)));
+  SDL_GPUBufferLocation src = { .buffer = drawArgsInit.get(), .offset = 0 };
+  SDL_GPUBufferLocation dst = { .buffer = drawArgs.get(), .offset = 0 };
+  SDL_CopyGPUBufferToBuffer(copyPass, &src, &dst, sizeof(SDL_GPUIndexedIndirectDrawCommand), false);
+  SDL_EndGPUCopyPass(copyPass);
+
+  glm::vec2 viewPos = renderData.viewPos;
+  glm::vec2 viewEnd = viewPos + viewSize;
+  CullConstData cullData = {
+    .planes = {
+      {  1.f,  0.f,  0.f, -viewPos.x },
+      { -1.f,  0.f,  0.f,  viewEnd.x },
+      {  0.f,  1.f,  0.f, -viewPos.y },
+      {  0.f, -1.f,  0.f,  viewEnd.y },
+      {  0.f,  0.f,  1.f,  0.f },
+      {  0.f,  0.f, -1.f,  1.f },
+    },
+    .count = numSprites,
+    .alpha = renderData.alpha,
+  };
+
+  if (!cullPass.begin(cmdBuf, {
+    SDL_GPUStorageBufferReadWriteBinding{ .buffer = visibleSprites.get(), .cycle = false },
+    SDL_GPUStorageBufferReadWriteBinding{ .buffer = drawArgs.get(), .cycle = false },
+  })) {
+    return false;
+  }
+  cullPass.bind({spriteBuffers[spriteSlot].get()});
+  SDL_PushGPUComputeUniformData(cmdBuf, 0, &cullData, sizeof(CullConstData));
+  cullPass.dispatchThreads(numSprites);
+  cullPass.end();
+
+  return true;
+}
+
+void Renderer::readOverdraw(int frame) {
+  glm::ivec2 dim = scenePass.target.dim();
+  auto numPixels = static_cast<std::size_t>(dim.x) * dim.y;
+
+  auto *pixels = reinterpret_cast<const Uint8*>(
+    SDL_MapGPUTransferBuffer(gpu->device, overdrawReadback[frame], false)
+  );
+  if (pixels == nullptr) {
+    return;
+  }
+
+  // R holds the number of shaded fragments of each pixel.
+  uint64_t total = 0;
+  uint32_t maxLayers = 0;
+  for (std::size_t i = 0; i < numPixels; ++i) {
+    uint32_t layers = pixels[i * 4];
+    total += layers;
+    maxLayers = std::max(maxLayers, layers);
+  }
+
+  SDL_UnmapGPUTransferBuffer(gpu->device, overdrawReadback[frame]);
+
+  overdraw = OverdrawStats {
+    .shadedLayers = static_cast<float>(double(total) / numPixels),
+    .submittedLayers = overdrawSubmitted[frame],
+    .maxLayers = maxLayers,
+  };
 }
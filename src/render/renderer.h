@@ -1,79 +1,290 @@
 #pragma once
 
+#include "config/config.h"
 #include "gpu.h"
+#include "command_recorder.h"
+#include "compute_pass.h"
+#include "gpu_field.h"
+#include "perf_hud.h"
+#include "world_streamer.h"
+#include "file_watcher.h"
 #include "gpu_shared/cpu_gpu_shared.h"
 
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
 struct GameState;
 
 struct RenderData {
-  void init(GPUContext &gpuCtx, GameState &state);
-  void update(GameState &state);
+  // Opaque sprites at the current tick with their previous positions,
+  // sorted front-to-back if Config::sortOpaque is set.
+  // Culled against the view unless Config::gpuCulling is set, in which
+  // case the renderer culls them on the GPU.
+  std::vector<SpriteInstance> opaque;
+  // Bumped whenever opaque changes, the renderer re-uploads it only then.
+  Uint64 version = 0;
+
+  // Interpolation factor between the previous and the current tick
+  float alpha = 0.f;
+  // Top-left corner of the view in world pixels, interpolated
+  glm::vec2 viewPos = { 0.f, 0.f };
+  glm::vec2 prevViewPos = { 0.f, 0.f };
+  glm::vec2 currViewPos = { 0.f, 0.f };
+
+  // Simulation tick of the current state
+  uint64_t tick = 0;
+  // The cells of the CPU field backend, empty with the GPU backend
+  std::vector<glm::vec2> field;
+
+  void init(GPUContext &gpuCtx, const GameState &state);
+  // Rebuilds the sprites from two consecutive simulation ticks.
+  // Only needed when a new tick arrives.
+  void update(const GameState &prev, const GameState &curr);
+  // Called every frame, the sprites are interpolated on the GPU.
+  void setAlpha(float alpha);
   void deinit();
 };
 
+struct OverdrawStats {
+  // Fragments that were shaded per screen pixel.
+  float shadedLayers = 0.f;
+  // Fragments that were submitted per screen pixel, i.e. without any
+  // depth rejection.
+  float submittedLayers = 0.f;
+  uint32_t maxLayers = 0;
+};
+
+struct RecordStats {
+  struct Step {
+    double recordMs = 0.;
+    // Waiting for the previous steps and submitting
+    double submitMs = 0.;
+  };
+
+  // Per frame averages
+  std::map<std::string, Step> steps;
+  // Recording time per thread
+  std::map<SDL_ThreadID, double> threads;
+  Uint64 frames = 0;
+};
+
 class Renderer {
-private:
+public:
+  // The passes are public for bench/microbench.cpp, nothing else should
+  // need them.
+  enum class PassTarget {
+    // The pass creates and renders to its own target.
+    OWN,
+    // The pass renders to the swapchain texture passed to begin.
+    SWAPCHAIN,
+    // The pass renders to another pass' target passed to begin.
+    EXTERNAL,
+    // Depth only pass.
+    NONE,
+  };
+
+  enum class DepthMode {
+    NONE,
+    // Clear, test LESS and write.
+    TEST_WRITE,
+    // Test EQUAL against the depth laid down by a pre-pass, no write.
+    EQUAL,
+  };
+
+  struct RenderPassDesc {
+    // Name of the shaders, i.e. shaders_input/<name>.vert.hlsl
+    // and shaders_input/<name>.frag.hlsl
+    std::string shaderName;
+    // Both shaders are compiled with these, see ShaderFeatures.
+    ShaderFeatures features;
+
+    PassTarget target = PassTarget::OWN;
+    int targetW = 0;
+    int targetH = 0;
+    SDL_PixelFormat targetFormat = SDL_PIXELFORMAT_UNKNOWN;
+    SDL_GPULoadOp loadOp = SDL_GPU_LOADOP_LOAD;
+    bool additiveBlend = false;
+    // Blended over the target by the output's alpha
+    bool alphaBlend = false;
+
+    DepthMode depthMode = DepthMode::NONE;
+    SDL_GPUTextureFormat depthFormat = SDL_GPU_TEXTUREFORMAT_INVALID;
+
+    SDL_GPUVertexInputState inputLayout = {};
+    uint32_t numVertexStorageBuffers = 0;
+    uint32_t numFragmentStorageBuffers = 0;
+    uint32_t numTextures = 0;
+  };
+
   // TODO: do we need to decouple pipeline from render pass?
   struct RenderPass {
     GPUTexture target;
 
     SDL_GPUDevice *device = nullptr;
+    SDL_Window *window = nullptr;
+    RenderPassDesc desc;
+
+    // Only replaced between frames, see Renderer::swapReloadedPipelines
     SDL_GPUGraphicsPipeline *pipeline = nullptr;
 
     SDL_GPUCommandBuffer *cmdBuf = nullptr;
     SDL_GPURenderPass *renderPass = nullptr;
-    bool isSwapchainTarget = false;
+    PassTarget targetType = PassTarget::OWN;
+    SDL_GPULoadOp loadOp = SDL_GPU_LOADOP_LOAD;
+    DepthMode depthMode = DepthMode::NONE;
+
+    // Since the renderer last collected them, for the perf HUD
+    uint32_t draws = 0;
+    uint32_t binds = 0;
 
     bool init(
       SDL_GPUDevice *device,
       SDL_Window *window,
-      int targetW,
-      int targetH,
-      SDL_PixelFormat targetFormat,
-      std::string_view shaderName,
-      SDL_GPUVertexInputState inputLayout,
-      uint32_t numVertexStorageBuffers,
-      uint32_t numFragmentStorageBuffers,
-      uint32_t numTextures,
-      bool swapchainTarget
+      const RenderPassDesc &desc
     );
     void deinit();
 
+    // Compiles the pass' shaders and creates a new pipeline from desc.
+    // Doesn't touch the current pipeline, so it's safe to call from another thread.
+    SDL_GPUGraphicsPipeline *createPipeline(bool forceCompile) const;
+
+    // Whether the pipeline has to be recreated if the given shader source changes.
+    bool dependsOn(const std::filesystem::path &file) const;
+
+    // external is the swapchain texture or another pass' target
+    // depending on the pass' PassTarget. It's ignored for the others.
     bool begin(
       SDL_GPUCommandBuffer *cmdBuf,
-      SDL_GPUTexture *swapchain = nullptr
+      SDL_GPUTexture *external = nullptr,
+      SDL_GPUTexture *depth = nullptr
     );
 
+    // At most MAX_BINDINGS textures and vertex buffers. The bindings are
+    // taken as lists so that binding doesn't allocate.
+    static constexpr size_t MAX_BINDINGS = 8;
     void bind(
-      const std::vector<SDL_GPUTexture*> &textures,
-      const std::vector<SDL_GPUBuffer*> &storageBuffers,
-      const std::vector<SDL_GPUBuffer*> &vertexBuffers,
+      std::initializer_list<SDL_GPUTexture*> textures,
+      std::initializer_list<SDL_GPUBuffer*> vertexStorageBuffers,
+      std::initializer_list<SDL_GPUBuffer*> fragmentStorageBuffers,
+      std::initializer_list<SDL_GPUBuffer*> vertexBuffers,
       SDL_GPUBuffer *indexBuffer,
-      SDL_GPUTexture *depthBuffer,
       SDL_GPUSampler *sampler
     );
 
     void exec(uint32_t numIndices, uint32_t numInstances);
 
+    // Draws with the SDL_GPUIndexedIndirectDrawCommand found at offset in args.
+    void execIndirect(SDL_GPUBuffer *args, uint32_t offset = 0);
+
     void end();
   };
 
 
-private:
+public:
   static constexpr int FRAMES_IN_FLIGHT = 2;
 
+private:
   RenderPass renderPass;
+  RenderPass scenePrepass;
+  RenderPass scenePass;
   RenderPass postprocessPass;
   RenderPass postprocessPass2;
 
-  GPUContext *gpu;
+  // Compacts the visible sprites and writes the indirect draw arguments
+  ComputePass cullPass;
+  GPUBuffer visibleSprites;
+  GPUBuffer drawArgs;
+  GPUBuffer drawArgsInit;
+
+  // Reaction-diffusion field drawn behind the sprites, see Config::fieldSize
+  RenderPass fieldPass;
+  GPUField field;
+  FieldBackend fieldBackend = FieldBackend::GPU;
+  int fieldStepsPerTick = 0;
+  // Tick the GPU field was last stepped to
+  uint64_t fieldTick = 0;
+
+  // Scenery streamed in around the view, see Config::streamChunkSize
+  WorldStreamer streamer;
+
+  // Drawn over the swapchain after postprocessPass2, see Config::perfHud
+  RenderPass hudPass;
+  PerfHud hud;
+  bool hudEnabled = false;
+  GPUTexture hudFont;
+  GPUBuffer hudQuads;
+  SDL_GPUTransferBuffer *hudTransfer = nullptr;
+  // Measured during the current frame
+  HudFrame hudFrame;
+  Uint64 lastDrawNS = 0;
+
+  GPUContext *gpu = nullptr;
 
   GPUBuffer screenTriIndexBuffer;
+  GPUBuffer quadIndexBuffer;
+  GPUTexture depthBuffer;
+
+  // The sprites are re-uploaded for every new RenderData::version,
+  // so keep one buffer per frame in flight.
+  GPUBuffer spriteBuffers[FRAMES_IN_FLIGHT];
+  std::optional<GPUFence> spriteUploads[FRAMES_IN_FLIGHT];
+  int spriteSlot = 0;
+  Uint64 spriteVersion = 0;
+  Uint64 spriteUploadCount = 0;
 
   SDL_GPUSampler *pointSampler = nullptr;
 
+  bool depthPrepass = false;
+  bool gpuCulling = false;
+  bool overdrawDebug = false;
+  SDL_GPUTransferBuffer *overdrawReadback[FRAMES_IN_FLIGHT] = { nullptr, nullptr };
+  float overdrawSubmitted[FRAMES_IN_FLIGHT] = { 0.f, 0.f };
+  OverdrawStats overdraw;
+
+  // Records the passes, see Config::parallelRecording
+  CommandRecorder recorder;
+  bool parallelRecording = false;
+  RecordStats recordStats;
+  // The frame's uniforms
+  ShaderConstData constData = {};
+  // The window size of the frame. Set by draw, the recording steps may run
+  // on job workers and can't read the config.
+  glm::vec2 viewSize = {};
+
   int frameCycle = 0;
-  SDL_GPUFence *fences[FRAMES_IN_FLIGHT] = { nullptr, nullptr };
+  Uint64 frameIndex = 0;
+  // At most FRAMES_IN_FLIGHT, see Config::framesInFlight
+  int framesInFlight = FRAMES_IN_FLIGHT;
+  // Every command buffer submitted for the frame
+  std::vector<SDL_GPUFence*> fences[FRAMES_IN_FLIGHT];
+
+  // Either a graphics or a compute pipeline
+  struct ReloadedPipeline {
+    RenderPass *pass = nullptr;
+    SDL_GPUGraphicsPipeline *pipeline = nullptr;
+    ComputePass *computePass = nullptr;
+    SDL_GPUComputePipeline *computePipeline = nullptr;
+  };
+  struct RetiredPipeline {
+    SDL_GPUGraphicsPipeline *pipeline = nullptr;
+    SDL_GPUComputePipeline *computePipeline = nullptr;
+    // The first frame that didn't use the pipeline
+    Uint64 frame = 0;
+  };
+
+  FileWatcher shaderWatcher;
+  // The passes the watcher thread reloads. Gathered once all passes are
+  // created, before it starts, and not changed afterwards, so it reads
+  // them without locking. Only their pipelines change, and those it
+  // doesn't read.
+  std::vector<RenderPass*> reloadPasses;
+  std::vector<ComputePass*> reloadComputePasses;
+  std::mutex reloadMutex;
+  // Filled by the watcher thread, guarded by reloadMutex
+  std::vector<ReloadedPipeline> reloadedPipelines;
+  std::vector<RetiredPipeline> retiredPipelines;
 
 public:
   bool init(GPUContext *gpu);
@@ -83,4 +294,51 @@ public:
     const ShaderConstData &shaderConstData,
     const RenderData &renderData
   );
+
+  // Picks up the settings that can change while running, see
+  // ConfigReloader. Called between frames.
+  bool applyConfig(const Config &cfg);
+
+  // Only gathered if Config::overdrawDebug is set.
+  const OverdrawStats &getOverdrawStats() const { return overdraw; }
+
+  // Averages since the last call
+  RecordStats collectRecordStats();
+
+  // Sprite uploads since the last call
+  Uint64 collectSpriteUploads() { return std::exchange(spriteUploadCount, 0); }
+
+  bool streaming() const { return streamer.enabled(); }
+
+  void toggleHud() { hudEnabled = !hudEnabled; }
+  StreamStats collectStreamStats() { return streamer.collectStats(); }
+
+private:
+  // Fills reloadPasses and reloadComputePasses
+  void gatherReloadPasses();
+
+  // Called on the watcher thread
+  void reloadShaders(const std::vector<std::filesystem::path> &files);
+  // Called at the start of a frame, after its fence is waited.
+  void swapReloadedPipelines();
+  void releaseRetiredPipelines(bool all);
+
+  // Pushes constData, the recording steps only capture this and so fit
+  // std::function without allocating.
+  void pushUniforms(SDL_GPUCommandBuffer *cmdBuf) const;
+  bool cull(SDL_GPUCommandBuffer *cmdBuf, const RenderData &renderData);
+  bool drawScene(SDL_GPUCommandBuffer *cmdBuf, const RenderData &renderData);
+  // Lays out the HUD and copies it to hudQuads, returns the number of quads.
+  uint32_t uploadHud(SDL_GPUCommandBuffer *cmdBuf);
+  // Gathers the frame's counters for the HUD
+  void finishHudFrame();
+
+  // Waits for and releases all fences of the frame
+  void waitFrame(int frame);
+  // Waits for the frame and reads back what it produced
+  void finishFrame(int frame);
+  bool setFramesInFlight(uint32_t count);
+  void gatherRecordStats();
+
+  void readOverdraw(int frame);
 };
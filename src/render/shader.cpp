@@ -1,52 +1,85 @@
 #include "defines.h"
 #include "shader.h"
 #include "config/config.h"
+#include "jobs/job_system.h"
 
 #include <cassert>
 #include <chrono>
 #include <filesystem>
 #include <format>
 #include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <sstream>
+#include <vector>
 
 #include <SDL3_shadercross/SDL_shadercross.h>
 
-SDL_GPUShaderStage getShaderStage(
+SDL_ShaderCross_ShaderStage getShaderStage(
   const std::filesystem::path &in
 ) {
   std::string ext = in.stem().extension().string();
 
   if (ext == ".vert") {
-    return SDL_GPU_SHADERSTAGE_VERTEX;
+    return SDL_SHADERCROSS_SHADERSTAGE_VERTEX;
   } else if (ext == ".frag") {
-    return SDL_GPU_SHADERSTAGE_FRAGMENT;
+    return SDL_SHADERCROSS_SHADERSTAGE_FRAGMENT;
+  } else if (ext == ".comp") {
+    return SDL_SHADERCROSS_SHADERSTAGE_COMPUTE;
   }
 
   assert(false);
+  return SDL_SHADERCROSS_SHADERSTAGE_VERTEX;
 }
 
-std::filesystem::path getTimestamp(
-  const std::filesystem::path &in,
-  const std::filesystem::path &outputDir
-) {
-  auto name = in.stem();
+std::filesystem::path getTimestamp(const std::filesystem::path &out) {
+  auto name = out;
   name += ".timestamp";
-  return outputDir / name;
+  return name;
 }
 
-void invalidateTimestamp(const std::filesystem::path &in) {
-  using namespace std::chrono_literals;
+// Outputs whose compilation failed and the source's write time then.
+// They aren't retried until the source changes, unless forced. Compiled
+// on the watcher thread and the workers too.
+std::mutex failedMutex;
+std::map<std::filesystem::path, std::filesystem::file_time_type> failedCompiles;
+
+// The timestamp is updated before compiling, so without it the stale
+// output would be taken as up to date by the next run.
+void invalidateTimestamp(const std::filesystem::path &in, const std::filesystem::path &out) {
+  std::error_code ec;
+  std::filesystem::remove(getTimestamp(out), ec);
+
+  auto writeTime = std::filesystem::last_write_time(in, ec);
+  if (!ec) {
+    std::lock_guard lock(failedMutex);
+    failedCompiles[out] = writeTime;
+  }
+}
 
-  auto writeTime = std::filesystem::last_write_time(in);
-  std::filesystem::last_write_time(in, writeTime + 1h);
+bool failedBefore(const std::filesystem::path &in, const std::filesystem::path &out) {
+  std::lock_guard lock(failedMutex);
+  auto it = failedCompiles.find(out);
+  if (it == failedCompiles.end()) {
+    return false;
+  }
+
+  std::error_code ec;
+  if (std::filesystem::last_write_time(in, ec) == it->second && !ec) {
+    return true;
+  }
+  failedCompiles.erase(it);
+  return false;
 }
 
 // TODO: if we have includes we should check their timestamp too...
 bool checkAndUpdateTimestamp(
   const std::filesystem::path &in,
-  const std::filesystem::path &outputDir
+  const std::filesystem::path &out
 ) {
-  auto timestampPath = getTimestamp(in, outputDir);
+  auto timestampPath = getTimestamp(out);
   auto currTs = std::format("{}", std::filesystem::last_write_time(in));
 
   if (!std::filesystem::exists(timestampPath)) {
@@ -88,6 +121,7 @@ bool checkAndUpdateTimestamp(
 std::filesystem::path getOutputName(
   const std::filesystem::path &in,
   const std::filesystem::path &outputDir,
+  const ShaderFeatures &features,
   SDL_GPUShaderFormat format
 ) {
   const char *ext = nullptr;
@@ -106,14 +140,20 @@ std::filesystem::path getOutputName(
     break;
   }
 
+  // The set is ordered, so the same keys always map to the same file.
   auto name = in.stem();
+  for (const auto &feature : features) {
+    name += "." + feature;
+  }
+
   return (outputDir / name).concat(ext);
 }
 
 bool compileShader(
   const std::filesystem::path &in,
   const std::filesystem::path &out,
-  SDL_GPUShaderStage gpuStage,
+  const ShaderFeatures &features,
+  SDL_ShaderCross_ShaderStage stage,
   SDL_GPUShaderFormat format
 ) {
   // Source is HLSL
@@ -124,14 +164,9 @@ bool compileShader(
 
   auto name = in.filename();
 
-  SDL_ShaderCross_ShaderStage stage =
-    gpuStage == SDL_GPU_SHADERSTAGE_VERTEX ?
-    SDL_SHADERCROSS_SHADERSTAGE_VERTEX :
-    SDL_SHADERCROSS_SHADERSTAGE_FRAGMENT;
-
   std::ifstream ifs(in.c_str());
   if (!ifs.is_open()) {
-    printf("Failed to open shader file %s\n", in.c_str());
+    LOG_ERROR("Failed to open shader file %s\n", in.c_str());
     return false;
   }
   std::stringstream sourceStream;
@@ -141,21 +176,35 @@ bool compileShader(
   char hlsl[] = { '_', '_', 'H', 'L', 'S', 'L', '_', '_', '\0' };
   char vertex[] = { '_', '_', 'V', 'E', 'R', 'T', 'E', 'X', '_', '_', '\0' };
   char fragment[] = { '_', '_', 'F', 'R', 'A', 'G', 'M', 'E', 'N', 'T', '_', '_', '\0' };
-  SDL_ShaderCross_HLSL_Define defines[] = {
+  char compute[] = { '_', '_', 'C', 'O', 'M', 'P', 'U', 'T', 'E', '_', '_', '\0' };
+  char *stageDefine = vertex;
+  if (stage == SDL_SHADERCROSS_SHADERSTAGE_FRAGMENT) {
+    stageDefine = fragment;
+  } else if (stage == SDL_SHADERCROSS_SHADERSTAGE_COMPUTE) {
+    stageDefine = compute;
+  }
+
+  // shadercross wants mutable strings
+  std::vector<std::string> featureNames(features.begin(), features.end());
+  std::vector<SDL_ShaderCross_HLSL_Define> defines = {
     { hlsl, nullptr },
-    { gpuStage == SDL_GPU_SHADERSTAGE_FRAGMENT ? fragment : vertex, nullptr },
-    { nullptr, nullptr },
+    { stageDefine, nullptr },
   };
+  for (auto &feature : featureNames) {
+    defines.push_back({ feature.data(), nullptr });
+  }
+  defines.push_back({ nullptr, nullptr });
 
   auto cwd = std::filesystem::current_path();
-  auto cfgParentPath = std::filesystem::weakly_canonical(getConfig().dir);
-  auto relResPath = std::filesystem::relative(cfgParentPath, cwd);
+  // Also compiled on the watcher thread and the workers
+  auto includePath = std::filesystem::weakly_canonical(getConfigSnapshot()->shadersIncludeDir());
+  auto relResPath = std::filesystem::relative(includePath, cwd);
 
   SDL_ShaderCross_HLSL_Info hlslInfo = {
     .source = source.c_str(),
     .entrypoint = "main",
     .include_dir = relResPath.c_str(),
-    .defines = defines,
+    .defines = defines.data(),
     .shader_stage = stage,
 #ifdef __DEBUG
     .enable_debug = true,
@@ -219,44 +268,122 @@ bool compileShader(
   return true;
 }
 
-SDL_GPUShader* createShader(
-  SDL_GPUDevice *device,
-  const std::filesystem::path &in,
-  const std::filesystem::path &shadersOutputDir,
-  uint32_t numSamplers,
-  uint32_t numBuffers
-) {
-  std::filesystem::path out;
-  SDL_GPUShaderFormat format;
+SDL_GPUShaderFormat getShaderFormat(SDL_GPUDevice *device) {
   auto supportedFormats = SDL_GetGPUShaderFormats(device);
   if (supportedFormats & SDL_GPU_SHADERFORMAT_DXIL) {
-    format = SDL_GPU_SHADERFORMAT_DXIL;
+    return SDL_GPU_SHADERFORMAT_DXIL;
   } else if (supportedFormats & SDL_GPU_SHADERFORMAT_SPIRV) {
-    format = SDL_GPU_SHADERFORMAT_SPIRV;
+    return SDL_GPU_SHADERFORMAT_SPIRV;
   } else if (supportedFormats & SDL_GPU_SHADERFORMAT_MSL) {
-    format = SDL_GPU_SHADERFORMAT_MSL;
+    return SDL_GPU_SHADERFORMAT_MSL;
+  }
+
+  return SDL_GPU_SHADERFORMAT_INVALID;
+}
+
+// Compiles the variant if its source changed.
+// Returns the compiled file or nullopt if compilation failed.
+std::optional<std::filesystem::path> compileIfNeeded(
+  const std::filesystem::path &in,
+  const std::filesystem::path &shadersOutputDir,
+  ShaderFeatures features,
+  SDL_GPUShaderFormat format,
+  bool forceCompile
+) {
+#ifdef __DEBUG
+  features.insert("DEBUG");
+#endif // __DEBUG
+
+  auto out = getOutputName(in, shadersOutputDir, features, format);
+  if (!forceCompile && failedBefore(in, out)) {
+    return std::nullopt;
   }
-  out = getOutputName(in, shadersOutputDir, format);
 
-  SDL_GPUShaderStage type = getShaderStage(in);
-  if (!std::filesystem::exists(out) || !checkAndUpdateTimestamp(in, shadersOutputDir)) {
+  bool upToDate = std::filesystem::exists(out) && checkAndUpdateTimestamp(in, out);
+  if (!upToDate || forceCompile) {
     DEBUG_PRINT("Compiling shader %s...\n", out.filename().c_str());
-    if (!compileShader(in, out, type, format)) {
-      invalidateTimestamp(in);
-      return nullptr;
+    if (!compileShader(in, out, features, getShaderStage(in), format)) {
+      invalidateTimestamp(in, out);
+      return std::nullopt;
     }
+
+    // A forced compile may succeed after a fixed include
+    std::lock_guard lock(failedMutex);
+    failedCompiles.erase(out);
+  }
+
+  return out;
+}
+
+// Compiles the shader if its source changed and loads the result.
+// The returned code must be freed with SDL_free.
+void *loadShaderCode(
+  const std::filesystem::path &in,
+  const std::filesystem::path &shadersOutputDir,
+  const ShaderFeatures &features,
+  SDL_GPUShaderFormat format,
+  bool forceCompile,
+  std::size_t &codeSize
+) {
+  auto out = compileIfNeeded(in, shadersOutputDir, features, format, forceCompile);
+  if (!out) {
+    return nullptr;
   }
 
-  std::size_t codeSize;
   void *code = nullptr;
-  SDL_CHECK_RET((code = SDL_LoadFile(out.c_str(), &codeSize)), nullptr);
+  SDL_CHECK_RET((code = SDL_LoadFile(out->c_str(), &codeSize)), nullptr);
+
+  return code;
+}
+
+void precompileShaders(
+  SDL_GPUDevice *device,
+  const std::vector<ShaderSource> &sources,
+  const std::filesystem::path &shadersOutputDir
+) {
+  SDL_GPUShaderFormat format = getShaderFormat(device);
+
+  // Passes may share variants, don't compile the same file twice at once.
+  std::vector<ShaderSource> unique;
+  std::set<std::filesystem::path> outputs;
+  for (const auto &source : sources) {
+    if (outputs.insert(getOutputName(source.inputFile, shadersOutputDir, source.features, format)).second) {
+      unique.push_back(source);
+    }
+  }
+
+  getJobSystem().parallelFor(0, unique.size(), 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      compileIfNeeded(unique[i].inputFile, shadersOutputDir, unique[i].features, format, false);
+    }
+  });
+}
+
+SDL_GPUShader* createShader(
+  SDL_GPUDevice *device,
+  const std::filesystem::path &in,
+  const std::filesystem::path &shadersOutputDir,
+  const ShaderFeatures &features,
+  uint32_t numSamplers,
+  uint32_t numBuffers,
+  bool forceCompile
+) {
+  SDL_GPUShaderFormat format = getShaderFormat(device);
+
+  std::size_t codeSize;
+  void *code = loadShaderCode(in, shadersOutputDir, features, format, forceCompile, codeSize);
+  if (code == nullptr) {
+    return nullptr;
+  }
 
   SDL_GPUShaderCreateInfo info = {
     .code_size = codeSize,
     .code = reinterpret_cast<const Uint8*>(code),
     .entrypoint = (format == SDL_GPU_SHADERFORMAT_MSL ? "main0" : "main"),
     .format = format,
-    .stage = type,
+    .stage = getShaderStage(in) == SDL_SHADERCROSS_SHADERSTAGE_VERTEX ?
+      SDL_GPU_SHADERSTAGE_VERTEX :
+      SDL_GPU_SHADERSTAGE_FRAGMENT,
 
     .num_samplers = numSamplers,
     .num_storage_textures = 0,
@@ -264,10 +391,50 @@ SDL_GPUShader* createShader(
     .num_uniform_buffers = 1,
   };
 
-  SDL_GPUShader *shader = nullptr;
-  SDL_CHECK_RET((shader = SDL_CreateGPUShader(device, &info)), nullptr);
-
+  SDL_GPUShader *shader = SDL_CreateGPUShader(device, &info);
   SDL_free(code);
 
+  SDL_CHECK_RET(shader != nullptr, nullptr);
+
   return shader;
 }
+
+SDL_GPUComputePipeline* createComputePipeline(
+  SDL_GPUDevice *device,
+  const std::filesystem::path &in,
+  const std::filesystem::path &shadersOutputDir,
+  const ComputePipelineDesc &desc,
+  bool forceCompile
+) {
+  assert(getShaderStage(in) == SDL_SHADERCROSS_SHADERSTAGE_COMPUTE);
+
+  SDL_GPUShaderFormat format = getShaderFormat(device);
+
+  std::size_t codeSize;
+  void *code = loadShaderCode(in, shadersOutputDir, desc.features, format, forceCompile, codeSize);
+  if (code == nullptr) {
+    return nullptr;
+  }
+
+  SDL_GPUComputePipelineCreateInfo info = {
+    .code_size = codeSize,
+    .code = reinterpret_cast<const Uint8*>(code),
+    .entrypoint = (format == SDL_GPU_SHADERFORMAT_MSL ? "main0" : "main"),
+    .format = format,
+    .num_readonly_storage_textures = desc.numReadonlyStorageTextures,
+    .num_readonly_storage_buffers = desc.numReadonlyStorageBuffers,
+    .num_readwrite_storage_textures = desc.numReadWriteStorageTextures,
+    .num_readwrite_storage_buffers = desc.numReadWriteStorageBuffers,
+    .num_uniform_buffers = desc.numUniformBuffers,
+    .threadcount_x = desc.threadCountX,
+    .threadcount_y = desc.threadCountY,
+    .threadcount_z = desc.threadCountZ,
+  };
+
+  SDL_GPUComputePipeline *pipeline = SDL_CreateGPUComputePipeline(device, &info);
+  SDL_free(code);
+
+  SDL_CHECK_RET(pipeline != nullptr, nullptr);
+
+  return pipeline;
+}
@@ -1,14 +1,71 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
+#include <set>
+#include <string>
+#include <vector>
 
 class SDL_GPUDevice;
 class SDL_GPUShader;
+class SDL_GPUComputePipeline;
 
+// Compile-time specialization of a shader. Every key is defined for the
+// compiler, so shaders can #ifdef on them instead of branching on uniforms.
+// Each set of keys is a separate variant, compiled and cached on its own
+// as shaders_output/<name>.<stage>.<KEY>...<ext>.
+// DEBUG is added to every variant in debug builds.
+using ShaderFeatures = std::set<std::string>;
+
+struct ComputePipelineDesc {
+  ShaderFeatures features;
+
+
+  uint32_t numReadonlyStorageTextures = 0;
+  uint32_t numReadonlyStorageBuffers = 0;
+  uint32_t numReadWriteStorageTextures = 0;
+  uint32_t numReadWriteStorageBuffers = 0;
+  uint32_t numUniformBuffers = 1;
+
+  // MUST match the [numthreads] of the shader.
+  uint32_t threadCountX = 1;
+  uint32_t threadCountY = 1;
+  uint32_t threadCountZ = 1;
+};
+
+// Compiles the variant only if inputFile changed since the variant was last
+// compiled, unless forceCompile is set. Includes are not tracked!
+// A variant that failed to compile isn't retried until inputFile changes,
+// unless forced.
 SDL_GPUShader* createShader(
   SDL_GPUDevice *device,
   const std::filesystem::path &inputFile,
   const std::filesystem::path &shadersOutputDir,
+  const ShaderFeatures &features,
   uint32_t numSamplers,
-  uint32_t numBuffers
+  uint32_t numBuffers,
+  bool forceCompile = false
+);
+
+struct ShaderSource {
+  std::filesystem::path inputFile;
+  ShaderFeatures features;
+};
+
+// Compiles the out of date variants in parallel on the job system,
+// so that creating shaders from them afterwards only loads the results.
+// Failures are reported, but left for createShader to handle.
+void precompileShaders(
+  SDL_GPUDevice *device,
+  const std::vector<ShaderSource> &sources,
+  const std::filesystem::path &shadersOutputDir
+);
+
+// inputFile must be a <name>.comp.hlsl shader.
+SDL_GPUComputePipeline* createComputePipeline(
+  SDL_GPUDevice *device,
+  const std::filesystem::path &inputFile,
+  const std::filesystem::path &shadersOutputDir,
+  const ComputePipelineDesc &desc,
+  bool forceCompile = false
 );
@@ -0,0 +1,405 @@
+#include "texture_atlas.h"
+
+#include "defines.h"
+
+#include <algorithm>
+#include <numeric>
+
+// Shelves are rounded up to this height so that images of similar
+// size end up on the same shelf.
+static constexpr int SHELF_GRANULARITY = 4;
+
+bool TextureAtlas::init(
+  GPUContext *gpu,
+  int pageSize,
+  int maxPages,
+  int padding,
+  std::string_view name
+) {
+  deinit();
+
+  assert(gpu != nullptr);
+  assert(pageSize > 0 && maxPages > 0 && padding >= 0);
+
+  this->gpu = gpu;
+  this->pageSize = pageSize;
+  this->maxPages = maxPages;
+  this->padding = padding;
+  this->name = name;
+
+  return true;
+}
+
+void TextureAtlas::deinit() {
+  if (gpu != nullptr) {
+    flush();
+  }
+
+  for (auto &page : pages) {
+    page.texture.deinit();
+  }
+
+  pages.clear();
+  entries.clear();
+  freeHandles.clear();
+  pendingUploads.clear();
+  gpu = nullptr;
+}
+
+std::optional<AtlasHandle> TextureAtlas::add(SDL_Surface *surface) {
+  assert(gpu != nullptr);
+  assert(surface != nullptr);
+
+  glm::ivec2 size = { surface->w, surface->h };
+  glm::ivec2 slotSize = size + glm::ivec2{ padding, padding };
+  if (slotSize.x > pageSize || slotSize.y > pageSize) {
+    DEBUG_PRINT("Atlas %s: image %dx%d is larger than a page!\n", name.c_str(), size.x, size.y);
+    return std::nullopt;
+  }
+
+  auto slot = allocate(pages, slotSize);
+  if (!slot) {
+    return std::nullopt;
+  }
+
+  SDL_Surface *rgba = surface;
+  if (surface->format != SDL_PIXELFORMAT_RGBA32) {
+    rgba = SDL_ConvertSurface(surface, SDL_PIXELFORMAT_RGBA32);
+    if (rgba == nullptr) {
+      release(*slot, slotSize);
+      SDL_CHECK_RET(rgba != nullptr, std::nullopt);
+    }
+  }
+
+  auto fence = gpu->uploadAsync(
+    UploadTextureRegion{ rgba, &pages[slot->page].texture, slot->pos }
+  );
+
+  // The pixels are already copied in the transfer buffer.
+  if (rgba != surface) {
+    SDL_DestroySurface(rgba);
+  }
+
+  if (!fence) {
+    release(*slot, slotSize);
+    return std::nullopt;
+  }
+  pendingUploads.push_back(*fence);
+
+  AtlasHandle handle;
+  if (freeHandles.empty()) {
+    handle = static_cast<AtlasHandle>(entries.size());
+    entries.emplace_back();
+  } else {
+    handle = freeHandles.back();
+    freeHandles.pop_back();
+  }
+
+  entries[handle] = Entry {
+    .region = makeRegion(*slot, size),
+    .slot = *slot,
+    .slotSize = slotSize,
+    .lastUsed = 0,
+    .alive = true,
+  };
+
+  return handle;
+}
+
+void TextureAtlas::remove(AtlasHandle handle) {
+  assert(handle < entries.size() && entries[handle].alive);
+
+  auto &entry = entries[handle];
+  release(entry.slot, entry.slotSize);
+  entry.alive = false;
+  freeHandles.push_back(handle);
+}
+
+void TextureAtlas::touch(AtlasHandle handle, Uint64 frame) {
+  assert(handle < entries.size() && entries[handle].alive);
+  entries[handle].lastUsed = frame;
+}
+
+uint32_t TextureAtlas::evict(Uint64 olderThan) {
+  uint32_t evicted = 0;
+  for (AtlasHandle handle = 0; handle < entries.size(); ++handle) {
+    if (entries[handle].alive && entries[handle].lastUsed < olderThan) {
+      remove(handle);
+      ++evicted;
+    }
+  }
+
+  return evicted;
+}
+
+bool TextureAtlas::defragment() {
+  assert(gpu != nullptr);
+
+  if (!flush()) {
+    return false;
+  }
+
+  // Tallest first gives the tightest shelves.
+  std::vector<AtlasHandle> live;
+  for (AtlasHandle handle = 0; handle < entries.size(); ++handle) {
+    if (entries[handle].alive) {
+      live.push_back(handle);
+    }
+  }
+  std::sort(live.begin(), live.end(), [this](AtlasHandle a, AtlasHandle b) {
+    auto sa = entries[a].slotSize;
+    auto sb = entries[b].slotSize;
+    return sa.y != sb.y ? sa.y > sb.y : sa.x > sb.x;
+  });
+
+  std::vector<Page> newPages;
+  std::vector<Slot> newSlots(entries.size());
+  for (AtlasHandle handle : live) {
+    auto slot = allocate(newPages, entries[handle].slotSize);
+    if (!slot) {
+      // Should not happen as sorted packing is at least as tight,
+      // but keep the old layout if it does.
+      for (auto &page : newPages) {
+        page.texture.deinit();
+      }
+      return false;
+    }
+    newSlots[handle] = *slot;
+  }
+
+  if (!live.empty()) {
+    SDL_GPUCommandBuffer *cmdBuf = nullptr;
+    SDL_CHECK((cmdBuf = SDL_AcquireGPUCommandBuffer(gpu->device)));
+
+    SDL_GPUCopyPass *copyPass = nullptr;
+    SDL_CHECK((copyPass = SDL_BeginGPUCopyPass(cmdBuf)));
+
+    for (AtlasHandle handle : live) {
+      const auto &entry = entries[handle];
+      const auto &newSlot = newSlots[handle];
+
+      SDL_GPUTextureLocation src = {
+        .texture = pages[entry.slot.page].texture.get(),
+        .x = static_cast<Uint32>(entry.slot.pos.x),
+        .y = static_cast<Uint32>(entry.slot.pos.y),
+      };
+      SDL_GPUTextureLocation dst = {
+        .texture = newPages[newSlot.page].texture.get(),
+        .x = static_cast<Uint32>(newSlot.pos.x),
+        .y = static_cast<Uint32>(newSlot.pos.y),
+      };
+      SDL_CopyGPUTextureToTexture(
+        copyPass,
+        &src,
+        &dst,
+        static_cast<Uint32>(entry.region.size.x),
+        static_cast<Uint32>(entry.region.size.y),
+        1,
+        false
+      );
+    }
+
+    SDL_EndGPUCopyPass(copyPass);
+
+    // Waited for like the uploads, by the next flush or defragment.
+    auto fence = gpu->submit(cmdBuf);
+    if (!fence) {
+      for (auto &page : newPages) {
+        page.texture.deinit();
+      }
+      return false;
+    }
+    pendingUploads.push_back(*fence);
+  }
+
+  // SDL keeps the old pages alive until the copy (and any frame still
+  // sampling them) is done executing.
+  for (auto &page : pages) {
+    page.texture.deinit();
+  }
+  pages = std::move(newPages);
+
+  for (AtlasHandle handle : live) {
+    auto &entry = entries[handle];
+    entry.slot = newSlots[handle];
+    entry.region = makeRegion(entry.slot, entry.region.size);
+  }
+
+  DEBUG_PRINT(
+    "Atlas %s: defragmented %zu images into %zu pages\n",
+    name.c_str(),
+    live.size(),
+    pages.size()
+  );
+
+  return true;
+}
+
+bool TextureAtlas::flush() {
+  bool res = true;
+  for (GPUFence fence : pendingUploads) {
+    res = gpu->wait(fence) && res;
+  }
+  pendingUploads.clear();
+
+  return res;
+}
+
+const AtlasRegion &TextureAtlas::get(AtlasHandle handle) const {
+  assert(handle < entries.size() && entries[handle].alive);
+  return entries[handle].region;
+}
+
+AtlasStats TextureAtlas::stats() const {
+  AtlasStats res;
+  res.pages = numPages();
+  res.totalTexels = uint64_t(pageSize) * pageSize * pages.size();
+
+  for (const auto &entry : entries) {
+    if (!entry.alive) continue;
+
+    ++res.entries;
+    res.usedTexels += uint64_t(entry.slotSize.x) * entry.slotSize.y;
+  }
+
+  for (const auto &page : pages) {
+    res.shelfTexels += uint64_t(pageSize) * page.top;
+  }
+
+  return res;
+}
+
+bool TextureAtlas::addPage(std::vector<Page> &pages) {
+  if (static_cast<int>(pages.size()) >= maxPages) {
+    return false;
+  }
+
+  auto &page = pages.emplace_back();
+  if (!page.texture.init(
+    gpu->device,
+    pageSize,
+    pageSize,
+    SDL_PIXELFORMAT_RGBA32,
+    TextureType::SAMPLER,
+    name + "_page" + std::to_string(pages.size() - 1)
+  )) {
+    pages.pop_back();
+    return false;
+  }
+
+  return true;
+}
+
+std::optional<TextureAtlas::Slot> TextureAtlas::allocate(
+  std::vector<Page> &pages,
+  glm::ivec2 slotSize
+) {
+  // Best fit - the lowest shelf that can hold the image.
+  struct Candidate {
+    uint32_t page;
+    uint32_t shelf;
+    uint32_t span;
+    int waste;
+  };
+  std::optional<Candidate> best;
+
+  for (uint32_t p = 0; p < pages.size(); ++p) {
+    auto &shelves = pages[p].shelves;
+    for (uint32_t s = 0; s < shelves.size(); ++s) {
+      int waste = shelves[s].h - slotSize.y;
+      if (waste < 0 || (best && waste >= best->waste)) {
+        continue;
+      }
+
+      auto &free = shelves[s].free;
+      for (uint32_t i = 0; i < free.size(); ++i) {
+        if (free[i].w >= slotSize.x) {
+          best = Candidate{ p, s, i, waste };
+          break;
+        }
+      }
+    }
+  }
+
+  // Don't waste more than half a shelf if we can open a new one.
+  int shelfH = (slotSize.y + SHELF_GRANULARITY - 1) / SHELF_GRANULARITY * SHELF_GRANULARITY;
+  shelfH = std::min(shelfH, pageSize);
+  if (!best || best->waste > slotSize.y / 2) {
+    std::optional<uint32_t> target;
+    for (uint32_t p = 0; p < pages.size(); ++p) {
+      if (pages[p].top + shelfH <= pageSize) {
+        target = p;
+        break;
+      }
+    }
+    if (!target && !best && addPage(pages)) {
+      target = static_cast<uint32_t>(pages.size() - 1);
+    }
+
+    if (target) {
+      auto &page = pages[*target];
+      page.shelves.push_back(Shelf{ page.top, shelfH, { Span{ 0, pageSize } } });
+      page.top += shelfH;
+      best = Candidate{ *target, static_cast<uint32_t>(page.shelves.size() - 1), 0, shelfH - slotSize.y };
+    }
+  }
+
+  if (!best) {
+    return std::nullopt;
+  }
+
+  auto &shelf = pages[best->page].shelves[best->shelf];
+  auto &span = shelf.free[best->span];
+
+  Slot slot = { best->page, best->shelf, { span.x, shelf.y } };
+
+  span.x += slotSize.x;
+  span.w -= slotSize.x;
+  if (span.w == 0) {
+    shelf.free.erase(shelf.free.begin() + best->span);
+  }
+
+  return slot;
+}
+
+void TextureAtlas::release(const Slot &slot, glm::ivec2 slotSize) {
+  auto &page = pages[slot.page];
+  auto &free = page.shelves[slot.shelf].free;
+
+  auto it = std::lower_bound(free.begin(), free.end(), slot.pos.x, [](const Span &span, int x) {
+    return span.x < x;
+  });
+  it = free.insert(it, Span{ slot.pos.x, slotSize.x });
+
+  // Merge with the neighbours
+  if (it + 1 != free.end() && it->x + it->w == (it + 1)->x) {
+    it->w += (it + 1)->w;
+    free.erase(it + 1);
+  }
+  if (it != free.begin() && (it - 1)->x + (it - 1)->w == it->x) {
+    (it - 1)->w += it->w;
+    free.erase(it);
+  }
+
+  // Give empty shelves at the top of the page back to it.
+  auto isEmpty = [this](const Shelf &shelf) {
+    return shelf.free.size() == 1 && shelf.free[0].w == pageSize;
+  };
+  while (!page.shelves.empty() && isEmpty(page.shelves.back())) {
+    page.top -= page.shelves.back().h;
+    page.shelves.pop_back();
+  }
+}
+
+AtlasRegion TextureAtlas::makeRegion(const Slot &slot, glm::ivec2 size) const {
+  glm::vec2 pos = slot.pos;
+  glm::vec2 end = slot.pos + size;
+  float invSize = 1.f / pageSize;
+
+  return AtlasRegion {
+    .page = slot.page,
+    .pos = slot.pos,
+    .size = size,
+    .uv = { pos.x * invSize, pos.y * invSize, end.x * invSize, end.y * invSize },
+  };
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "render/gpu.h"
+#include "render/gpu_texture.h"
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+using AtlasHandle = uint32_t;
+
+struct AtlasRegion {
+  // Index of the atlas page holding the image.
+  uint32_t page = 0;
+
+  // Position and size in texels inside the page.
+  glm::ivec2 pos = {};
+  glm::ivec2 size = {};
+
+  // Normalized (u0, v0, u1, v1) rectangle inside the page.
+  glm::vec4 uv = {};
+};
+
+struct AtlasStats {
+  uint32_t pages = 0;
+  uint32_t entries = 0;
+
+  // Texels covered by live images, padding included.
+  uint64_t usedTexels = 0;
+  // Texels reserved by shelves. Whatever is above the last shelf is still free.
+  uint64_t shelfTexels = 0;
+  uint64_t totalTexels = 0;
+
+  // Fraction of all pages covered by live images.
+  float occupancy() const {
+    return totalTexels ? float(usedTexels) / float(totalTexels) : 0.f;
+  }
+
+  // Fraction of the shelf area lost to holes left by removed images.
+  // When this gets high it's time to defragment().
+  float fragmentation() const {
+    return shelfTexels ? 1.f - float(usedTexels) / float(shelfTexels) : 0.f;
+  }
+};
+
+// Packs many small images into a few large RGBA32 GPUTexture pages so that
+// draws using them don't have to switch textures.
+// Uses shelf packing - each page is split into horizontal shelves and every
+// shelf keeps a sorted list of free spans, so removed images can be reused.
+class TextureAtlas {
+private:
+  struct Span {
+    int x;
+    int w;
+  };
+
+  struct Shelf {
+    int y;
+    int h;
+    std::vector<Span> free;
+  };
+
+  struct Page {
+    GPUTexture texture;
+    std::vector<Shelf> shelves;
+    int top = 0;
+  };
+
+  struct Slot {
+    uint32_t page;
+    uint32_t shelf;
+    glm::ivec2 pos;
+  };
+
+  struct Entry {
+    AtlasRegion region;
+    Slot slot;
+    // Size including padding.
+    glm::ivec2 slotSize;
+    Uint64 lastUsed = 0;
+    bool alive = false;
+  };
+
+  GPUContext *gpu = nullptr;
+  std::string name;
+  int pageSize = 0;
+  int maxPages = 0;
+  int padding = 0;
+
+  std::vector<Page> pages;
+  std::vector<Entry> entries;
+  std::vector<AtlasHandle> freeHandles;
+  std::vector<GPUFence> pendingUploads;
+
+public:
+  ~TextureAtlas() {
+    deinit();
+  }
+
+  bool init(
+    GPUContext *gpu,
+    int pageSize,
+    int maxPages,
+    int padding,
+    std::string_view name
+  );
+  void deinit();
+
+  // Packs the surface into one of the pages and uploads it.
+  // Converts the surface to RGBA32 if needed, the user still owns it.
+  // Returns nullopt if the image does not fit in any page and no more
+  // pages can be created.
+  std::optional<AtlasHandle> add(SDL_Surface *surface);
+
+  // Frees the region of the image. The handle is invalid afterwards.
+  void remove(AtlasHandle handle);
+
+  // Marks the image as used on the given frame. See evict().
+  void touch(AtlasHandle handle, Uint64 frame);
+
+  // Removes all images not touched since olderThan.
+  // Returns how many images were removed.
+  uint32_t evict(Uint64 olderThan);
+
+  // Repacks all live images tightly into as few pages as possible.
+  // Handles stay valid, but their regions (and UVs) change.
+  bool defragment();
+
+  // Waits for pending uploads and defragment copies and releases their
+  // transfer buffers.
+  bool flush();
+
+  const AtlasRegion &get(AtlasHandle handle) const;
+  const GPUTexture &page(uint32_t idx) const { return pages[idx].texture; }
+  uint32_t numPages() const { return static_cast<uint32_t>(pages.size()); }
+
+  AtlasStats stats() const;
+
+private:
+  bool addPage(std::vector<Page> &pages);
+  std::optional<Slot> allocate(std::vector<Page> &pages, glm::ivec2 slotSize);
+  void release(const Slot &slot, glm::ivec2 slotSize);
+
+  AtlasRegion makeRegion(const Slot &slot, glm::ivec2 size) const;
+};
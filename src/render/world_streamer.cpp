@@ -0,0 +1,346 @@
+#include "world_streamer.h"
+
+#include "alloc_tracker.h"
+#include "defines.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+// Sprites generated between checks for cancellation
+static constexpr uint32_t CANCEL_GRAIN = 1024;
+
+bool WorldStreamer::init(GPUContext *gpu, const StreamParams &params) {
+  assert(gpu != nullptr);
+
+  deinit();
+
+  if (params.chunkSize <= 0.f || params.spritesPerChunk == 0) {
+    LOG_ERROR("Chunk streaming needs a chunk size and sprites per chunk\n");
+    return false;
+  }
+
+  this->params = params;
+  this->params.maxLoads = std::max(params.maxLoads, 1u);
+  this->params.maxUploads = std::max(params.maxUploads, 1u);
+  dims = glm::ivec2(glm::ceil(params.worldSize / params.chunkSize));
+  chunkBytes = uint64_t(params.spritesPerChunk) * sizeof(SpriteInstance);
+  maxChunks = static_cast<uint32_t>(std::min<uint64_t>(params.memoryBytes / chunkBytes, UINT32_MAX));
+  if (maxChunks == 0) {
+    LOG_ERROR("Chunk streaming memory cap is less than one chunk (%" SDL_PRIu64 " bytes)\n", chunkBytes);
+    return false;
+  }
+
+  this->gpu = gpu;
+  stats = {};
+  latencyMs = 0.;
+  avgFrameMs = 0.;
+  lastUpdateNS = 0;
+
+  return true;
+}
+
+void WorldStreamer::deinit() {
+  if (gpu == nullptr) {
+    return;
+  }
+
+  for (auto &[key, chunk] : chunks) {
+    if (chunk.load != nullptr) {
+      chunk.load->cancelled = true;
+    }
+  }
+  getJobSystem().wait(loads);
+  finished.clear();
+
+  for (auto &[key, chunk] : chunks) {
+    if (chunk.upload.has_value()) {
+      gpu->wait(*chunk.upload);
+    }
+    chunk.buffer.deinit();
+  }
+  chunks.clear();
+  releaseRetired(true);
+
+  numResident = 0;
+  numLoading = 0;
+  gpu = nullptr;
+}
+
+bool WorldStreamer::update(glm::vec2 focus) {
+  ALLOC_SCOPE("stream");
+  Uint64 now = SDL_GetTicksNS();
+  ++frame;
+  releaseRetired(false);
+
+  // The chunks in range, closest first, as many as the cap allows
+  wanted.clear();
+  glm::vec2 focusChunk = focus / params.chunkSize;
+  int radius = static_cast<int>(std::ceil(params.radius));
+  glm::ivec2 lo = glm::max(glm::ivec2(glm::floor(focusChunk)) - radius, glm::ivec2(0));
+  glm::ivec2 hi = glm::min(glm::ivec2(glm::floor(focusChunk)) + radius, dims - 1);
+  for (int y = lo.y; y <= hi.y; ++y) {
+    for (int x = lo.x; x <= hi.x; ++x) {
+      float distance = glm::length(glm::vec2(x, y) + 0.5f - focusChunk);
+      if (distance <= params.radius) {
+        wanted.push_back({ distance, chunkKey({ x, y }) });
+      }
+    }
+  }
+  std::sort(wanted.begin(), wanted.end(), [](const Request &a, const Request &b) {
+    return a.distance < b.distance;
+  });
+  if (wanted.size() > maxChunks) {
+    wanted.resize(maxChunks);
+  }
+
+  queue.clear();
+  for (const Request &request : wanted) {
+    auto [it, inserted] = chunks.try_emplace(request.key);
+    Chunk &chunk = it->second;
+    if (inserted) {
+      chunk.coord = { int32_t(request.key & 0xffffffff), int32_t(request.key >> 32) };
+      chunk.requestNS = now;
+    }
+    chunk.lastWanted = frame;
+    if (chunk.state == ChunkState::QUEUED) {
+      queue.push_back(request);
+    }
+  }
+
+  // Whatever went out of range before it was uploaded is cancelled,
+  // the resident chunks stay cached.
+  for (auto it = chunks.begin(); it != chunks.end();) {
+    Chunk &chunk = it->second;
+    if (chunk.lastWanted == frame || chunk.state == ChunkState::RESIDENT) {
+      ++it;
+      continue;
+    }
+
+    if (chunk.load != nullptr) {
+      chunk.load->cancelled = true;
+      --numLoading;
+    }
+    ++stats.cancelled;
+    it = chunks.erase(it);
+  }
+
+  {
+    std::lock_guard lock(finishedMutex);
+    std::swap(drained, finished);
+  }
+  for (auto &load : drained) {
+    // A cancelled chunk may have been requested again meanwhile,
+    // its new load is the one that counts.
+    auto it = chunks.find(chunkKey(load->coord));
+    if (it != chunks.end() && it->second.load == load && !load->cancelled) {
+      it->second.state = ChunkState::LOADED;
+    }
+  }
+  drained.clear();
+
+  // Closest first, a few per frame so that a burst of loads doesn't
+  // turn into a hitch.
+  uint32_t uploads = 0;
+  for (const Request &request : wanted) {
+    if (uploads == params.maxUploads) {
+      break;
+    }
+
+    Chunk &chunk = chunks[request.key];
+    if (chunk.state == ChunkState::LOADED) {
+      if (!uploadChunk(chunk)) {
+        return false;
+      }
+      ++uploads;
+    }
+  }
+
+  for (auto &[key, chunk] : chunks) {
+    if (chunk.upload.has_value() && gpu->done(*chunk.upload)) {
+      chunk.upload = std::nullopt;
+    }
+  }
+
+  // Everything but the queued chunks takes up memory
+  std::make_heap(queue.begin(), queue.end());
+  while (numLoading < params.maxLoads && !queue.empty()) {
+    if (numResident + numLoading >= maxChunks && !evictOne()) {
+      break;
+    }
+
+    std::pop_heap(queue.begin(), queue.end());
+    startLoad(chunks[queue.back().key]);
+    queue.pop_back();
+  }
+
+  // A hitch is measured against the frames before it
+  if (lastUpdateNS != 0) {
+    double frameMs = double(now - lastUpdateNS) / SDL_NS_PER_MS;
+    if (avgFrameMs > 0. && frameMs > HITCH_FACTOR * avgFrameMs) {
+      ++stats.hitchFrames;
+      stats.uploadHitchFrames += uploads > 0 ? 1 : 0;
+    }
+    avgFrameMs = avgFrameMs > 0. ? avgFrameMs * 0.95 + frameMs * 0.05 : frameMs;
+    ++stats.frames;
+  }
+  lastUpdateNS = now;
+
+  double updateMs = double(SDL_GetTicksNS() - now) / SDL_NS_PER_MS;
+  stats.maxUpdateMs = std::max(stats.maxUpdateMs, updateMs);
+
+  return true;
+}
+
+void WorldStreamer::setBudget(uint32_t maxLoads, uint32_t maxUploads) {
+  // The loads over the new limit finish on their own
+  params.maxLoads = std::max(maxLoads, 1u);
+  params.maxUploads = std::max(maxUploads, 1u);
+}
+
+void WorldStreamer::startLoad(Chunk &chunk) {
+  auto load = std::make_shared<Load>();
+  load->coord = chunk.coord;
+  chunk.load = load;
+  chunk.state = ChunkState::LOADING;
+  ++numLoading;
+
+  getJobSystem().run([this, load, params = params] {
+    if (!generateChunk(params, load->coord, load->cancelled, load->sprites)) {
+      return;
+    }
+
+    std::lock_guard lock(finishedMutex);
+    finished.push_back(load);
+  }, &loads);
+}
+
+bool WorldStreamer::uploadChunk(Chunk &chunk) {
+  const std::vector<SpriteInstance> &sprites = chunk.load->sprites;
+
+  chunk.upload = gpu->uploadAsync(
+    UploadBuffer<SpriteInstance>{ sprites, &chunk.buffer, BufferType::STORAGE }
+  );
+  if (!chunk.upload.has_value()) {
+    return false;
+  }
+
+  chunk.count = static_cast<uint32_t>(sprites.size());
+  chunk.area = 0.;
+  for (const SpriteInstance &sprite : sprites) {
+    chunk.area += double(sprite.size.x) * sprite.size.y;
+  }
+  chunk.load = nullptr;
+  chunk.state = ChunkState::RESIDENT;
+  --numLoading;
+  ++numResident;
+
+  double ms = double(SDL_GetTicksNS() - chunk.requestNS) / SDL_NS_PER_MS;
+  latencyMs += ms;
+  stats.maxLatencyMs = std::max(stats.maxLatencyMs, ms);
+  ++stats.loaded;
+
+  return true;
+}
+
+bool WorldStreamer::evictOne() {
+  auto victim = chunks.end();
+  for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+    const Chunk &chunk = it->second;
+    if (chunk.state != ChunkState::RESIDENT || chunk.lastWanted == frame) {
+      continue;
+    }
+    if (victim == chunks.end() || chunk.lastWanted < victim->second.lastWanted) {
+      victim = it;
+    }
+  }
+
+  if (victim == chunks.end()) {
+    return false;
+  }
+
+  // The frames in flight may still draw it
+  Chunk &chunk = victim->second;
+  retired.push_back({ chunk.buffer, chunk.upload, frame });
+  chunks.erase(victim);
+  --numResident;
+  ++stats.evicted;
+
+  return true;
+}
+
+void WorldStreamer::releaseRetired(bool all) {
+  // Same as the renderer's retired pipelines, the frames up to
+  // frame - framesInFlight are done.
+  auto isUnused = [this, all](const RetiredBuffer &buffer) {
+    return all || buffer.frame + params.framesInFlight <= frame + 1;
+  };
+
+  for (RetiredBuffer &buffer : retired) {
+    if (isUnused(buffer)) {
+      if (buffer.upload.has_value()) {
+        gpu->wait(*buffer.upload);
+      }
+      buffer.buffer.deinit();
+    }
+  }
+  std::erase_if(retired, isUnused);
+}
+
+StreamStats WorldStreamer::collectStats() {
+  StreamStats res = stats;
+  stats = {};
+
+  res.resident = numResident;
+  res.loading = numLoading;
+  res.residentBytes = numResident * chunkBytes;
+  for (const auto &[key, chunk] : chunks) {
+    res.queued += chunk.state == ChunkState::QUEUED ? 1 : 0;
+  }
+  if (res.loaded > 0) {
+    res.avgLatencyMs = latencyMs / res.loaded;
+  }
+  latencyMs = 0.;
+
+  return res;
+}
+
+bool WorldStreamer::generateChunk(
+  const StreamParams &params,
+  glm::ivec2 coord,
+  const std::atomic<bool> &cancelled,
+  std::vector<SpriteInstance> &sprites
+) {
+  glm::vec2 chunkMin = glm::vec2(coord) * params.chunkSize;
+  glm::vec2 chunkMax = glm::min(chunkMin + params.chunkSize, params.worldSize);
+
+  std::seed_seq seed = { params.seed, uint32_t(coord.x), uint32_t(coord.y) };
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> x(chunkMin.x, chunkMax.x);
+  std::uniform_real_distribution<float> y(chunkMin.y, chunkMax.y);
+  // Behind most of the moving sprites
+  std::uniform_real_distribution<float> depth(0.5f, 1.f);
+  std::uniform_real_distribution<float> size(MIN_SPRITE_SIZE, MAX_SPRITE_SIZE);
+
+  sprites.resize(params.spritesPerChunk);
+  for (uint32_t i = 0; i < params.spritesPerChunk; ++i) {
+    if (i % CANCEL_GRAIN == 0 && cancelled.load(std::memory_order_relaxed)) {
+      return false;
+    }
+
+    glm::vec2 pos = { x(rng), y(rng) };
+    // Dim, so the scenery doesn't drown the sprites
+    uint32_t color = (static_cast<uint32_t>(rng()) >> 2) & 0x003f3f3fu;
+    sprites[i] = SpriteInstance {
+      .pos = { pos, depth(rng) },
+      .color = color | 0xff000000u,
+      .size = { size(rng), size(rng) },
+      .prevPos = pos,
+    };
+  }
+
+  return true;
+}
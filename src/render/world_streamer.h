@@ -0,0 +1,229 @@
+#pragma once
+
+#include "gpu.h"
+#include "jobs/job_system.h"
+#include "gpu_shared/cpu_gpu_shared.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+#include <SDL3/SDL.h>
+
+struct StreamParams {
+  // The world is divided into square chunks of this many pixels,
+  // starting at the origin.
+  float chunkSize = 0.f;
+  glm::vec2 worldSize = { 0.f, 0.f };
+  // Scenery sprites generated per chunk, seeded by seed and the chunk
+  uint32_t spritesPerChunk = 0;
+  uint32_t seed = 0;
+  // Chunks whose center is within this many chunk sizes of the focus
+  // are loaded, closest first.
+  float radius = 0.f;
+  // Cap on the render data of the chunks that are resident or being
+  // loaded. The least recently wanted chunks are evicted to stay under it.
+  uint64_t memoryBytes = 0;
+  // Loads running on the job system at a time
+  uint32_t maxLoads = 1;
+  // Chunks uploaded per frame, the rest wait for the next ones
+  uint32_t maxUploads = 1;
+  // Frames that may still draw a chunk after it's evicted
+  uint32_t framesInFlight = 1;
+};
+
+struct StreamStats {
+  // At the time of WorldStreamer::collectStats
+  uint32_t resident = 0;
+  uint32_t queued = 0;
+  uint32_t loading = 0;
+  uint64_t residentBytes = 0;
+
+  // Since the last WorldStreamer::collectStats
+  Uint64 loaded = 0;
+  Uint64 evicted = 0;
+  // Requests and loads dropped as their chunk went out of range
+  Uint64 cancelled = 0;
+  // From a chunk being requested to its upload being submitted
+  double avgLatencyMs = 0.;
+  double maxLatencyMs = 0.;
+  Uint64 frames = 0;
+  // Frames that took more than HITCH_FACTOR times the average
+  Uint64 hitchFrames = 0;
+  // Of those, the ones that uploaded chunks
+  Uint64 uploadHitchFrames = 0;
+  // Time spent in WorldStreamer::update on the calling thread
+  double maxUpdateMs = 0.;
+};
+
+// Keeps the chunks of scenery around a focus point resident on the GPU.
+// Every frame the chunks in range are requested closest first; the
+// requests are generated on the job system a few at a time and uploaded
+// from the calling thread. Requests that go out of range before they
+// are uploaded are cancelled. Chunks that go out of range stay resident
+// until the memory cap needs their space, least recently wanted first.
+// Everything but the loads themselves happens on the thread calling
+// update, which has to be the one drawing the chunks.
+class WorldStreamer {
+public:
+  static constexpr double HITCH_FACTOR = 2.;
+  // Of the generated sprites, in pixels
+  static constexpr float MIN_SPRITE_SIZE = 8.f;
+  static constexpr float MAX_SPRITE_SIZE = 48.f;
+
+private:
+  enum class ChunkState {
+    // Waiting for a free load slot
+    QUEUED,
+    LOADING,
+    // Loaded, waiting to be uploaded
+    LOADED,
+    RESIDENT,
+  };
+
+  // Shared with the job generating the chunk
+  struct Load {
+    glm::ivec2 coord = { 0, 0 };
+    std::atomic<bool> cancelled = false;
+    std::vector<SpriteInstance> sprites;
+  };
+
+  struct Chunk {
+    glm::ivec2 coord = { 0, 0 };
+    ChunkState state = ChunkState::QUEUED;
+    Uint64 requestNS = 0;
+    // Last frame the chunk was in range
+    Uint64 lastWanted = 0;
+
+    std::shared_ptr<Load> load;
+
+    GPUBuffer buffer;
+    std::optional<GPUFence> upload;
+    uint32_t count = 0;
+    // Of all sprites, for the overdraw stats
+    double area = 0.;
+  };
+
+  struct RetiredBuffer {
+    GPUBuffer buffer;
+    std::optional<GPUFence> upload;
+    // The first frame that didn't draw the buffer
+    Uint64 frame = 0;
+  };
+
+  struct Request {
+    float distance = 0.f;
+    uint64_t key = 0;
+
+    bool operator<(const Request &other) const {
+      // Closest on top of the heap
+      return distance > other.distance;
+    }
+  };
+
+  GPUContext *gpu = nullptr;
+  StreamParams params;
+  glm::ivec2 dims = { 0, 0 };
+  uint64_t chunkBytes = 0;
+  // Chunks that fit under StreamParams::memoryBytes
+  uint32_t maxChunks = 0;
+
+  std::unordered_map<uint64_t, Chunk> chunks;
+  std::vector<RetiredBuffer> retired;
+  uint32_t numResident = 0;
+  uint32_t numLoading = 0;
+  Uint64 frame = 0;
+
+  // Update scratch
+  std::vector<Request> wanted;
+  std::vector<Request> queue;
+
+  JobCounter loads;
+  std::mutex finishedMutex;
+  // Filled by the jobs, guarded by finishedMutex
+  std::vector<std::shared_ptr<Load>> finished;
+  std::vector<std::shared_ptr<Load>> drained;
+
+  StreamStats stats;
+  double latencyMs = 0.;
+  double avgFrameMs = 0.;
+  Uint64 lastUpdateNS = 0;
+
+public:
+  ~WorldStreamer() {
+    deinit();
+  }
+
+  bool init(GPUContext *gpu, const StreamParams &params);
+  // Cancels the loads in flight and waits for them.
+  void deinit();
+
+  bool enabled() const { return gpu != nullptr; }
+
+  // Called once per frame, after the GPU is done with the frame that
+  // used the same resources before, see StreamParams::framesInFlight.
+  bool update(glm::vec2 focus);
+
+  // Takes effect from the next update, see StreamParams.
+  void setBudget(uint32_t maxLoads, uint32_t maxUploads);
+
+  // Calls fn(buffer, count, area) for the resident chunks overlapping
+  // the given view. The buffers hold count SpriteInstances.
+  template <class Fn>
+  void forEachVisible(glm::vec2 viewMin, glm::vec2 viewMax, Fn &&fn) const;
+
+  uint32_t getNumResident() const { return numResident; }
+  uint64_t getResidentBytes() const { return numResident * chunkBytes; }
+
+  StreamStats collectStats();
+
+  // Deterministic contents of a chunk. Returns false if cancelled
+  // was set meanwhile.
+  static bool generateChunk(
+    const StreamParams &params,
+    glm::ivec2 coord,
+    const std::atomic<bool> &cancelled,
+    std::vector<SpriteInstance> &sprites
+  );
+
+private:
+  static uint64_t chunkKey(glm::ivec2 coord) {
+    return (uint64_t(uint32_t(coord.y)) << 32) | uint32_t(coord.x);
+  }
+
+  void startLoad(Chunk &chunk);
+  bool uploadChunk(Chunk &chunk);
+  // Evicts the least recently wanted resident chunk that isn't wanted
+  // this frame. Returns false if there is none.
+  bool evictOne();
+  void releaseRetired(bool all);
+};
+
+template <class Fn>
+void WorldStreamer::forEachVisible(glm::vec2 viewMin, glm::vec2 viewMax, Fn &&fn) const {
+  // Sprites stick out of their chunk by at most half their size
+  float margin = MAX_SPRITE_SIZE * 0.5f;
+
+  for (const auto &[key, chunk] : chunks) {
+    if (chunk.state != ChunkState::RESIDENT || chunk.count == 0) {
+      continue;
+    }
+
+    glm::vec2 chunkMin = glm::vec2(chunk.coord) * params.chunkSize - margin;
+    glm::vec2 chunkMax = chunkMin + params.chunkSize + 2.f * margin;
+    if (
+      chunkMax.x < viewMin.x || chunkMin.x > viewMax.x ||
+      chunkMax.y < viewMin.y || chunkMin.y > viewMax.y
+    ) {
+      continue;
+    }
+
+    fn(chunk.buffer.get(), chunk.count, chunk.area);
+  }
+}
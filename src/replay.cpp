@@ -0,0 +1,290 @@
+#include "replay.h"
+
+#include "config/config.h"
+#include "defines.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+
+static constexpr uint32_t REPLAY_MAGIC = 0x594c5052; // "RPLY"
+static constexpr uint32_t REPLAY_VERSION = 3;
+static constexpr size_t FLUSH_SIZE = 64 * 1024;
+
+enum class RecordType : uint8_t {
+  EVENT,
+  FRAME,
+};
+
+namespace {
+
+void writeBytes(std::vector<uint8_t> &out, const void *src, size_t size) {
+  auto bytes = static_cast<const uint8_t*>(src);
+  out.insert(out.end(), bytes, bytes + size);
+}
+
+void writeVarint(std::vector<uint8_t> &out, Uint64 value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+bool readBytes(const std::vector<uint8_t> &in, size_t &cursor, void *dst, size_t size) {
+  if (in.size() - cursor < size) {
+    return false;
+  }
+  std::memcpy(dst, in.data() + cursor, size);
+  cursor += size;
+  return true;
+}
+
+bool readVarint(const std::vector<uint8_t> &in, size_t &cursor, Uint64 &value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && cursor < in.size(); shift += 7) {
+    uint8_t byte = in[cursor++];
+    value |= Uint64(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// FNV-1a, only used to tell whether the scene changed
+uint64_t hashFile(const std::string &path) {
+  size_t size = 0;
+  void *bytes = SDL_LoadFile(path.c_str(), &size);
+  if (bytes == nullptr) {
+    return 0;
+  }
+
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ static_cast<const uint8_t*>(bytes)[i]) * 0x100000001b3ull;
+  }
+  SDL_free(bytes);
+
+  return hash;
+}
+
+}
+
+ReplayHeader makeReplayHeader() {
+  const Config &cfg = getConfig();
+
+  return ReplayHeader {
+    .magic = REPLAY_MAGIC,
+    .version = REPLAY_VERSION,
+    .tickRate = cfg.tickRate,
+    .spriteCount = cfg.spriteCount,
+    .worldSeed = cfg.worldSeed,
+    .worldW = cfg.worldSize.x,
+    .worldH = cfg.worldSize.y,
+    .windowW = cfg.windowW,
+    .windowH = cfg.windowH,
+    .gpuCulling = cfg.gpuCulling,
+    .fieldBackend = static_cast<uint32_t>(cfg.fieldBackend),
+    .fieldW = cfg.fieldSize.x,
+    .fieldH = cfg.fieldSize.y,
+    .fieldStepsPerTick = cfg.fieldStepsPerTick,
+    .streamChunkSize = cfg.streamChunkSize,
+    .streamSpritesPerChunk = cfg.streamSpritesPerChunk,
+    .streamRadius = cfg.streamRadius,
+    .streamMemoryMB = cfg.streamMemoryMB,
+    .streamMaxLoads = cfg.streamMaxLoads,
+    .streamUploadsPerFrame = cfg.streamUploadsPerFrame,
+    .sceneHash = cfg.sceneFile.empty() ? 0 : hashFile(cfg.sceneFile),
+  };
+}
+
+bool InputRecorder::init(const std::string &path) {
+  deinit();
+
+  SDL_CHECK((file = SDL_IOFromFile(path.c_str(), "wb")));
+
+  ReplayHeader header = makeReplayHeader();
+  writeBytes(buffer, &header, sizeof(header));
+
+  return true;
+}
+
+void InputRecorder::deinit() {
+  if (file == nullptr) {
+    return;
+  }
+
+  flush();
+  SDL_CloseIO(file);
+  file = nullptr;
+}
+
+void InputRecorder::event(const SDL_Event &event) {
+  buffer.push_back(static_cast<uint8_t>(RecordType::EVENT));
+  writeBytes(buffer, &event, sizeof(event));
+}
+
+void InputRecorder::frame(const ReplayFrame &frame) {
+  buffer.push_back(static_cast<uint8_t>(RecordType::FRAME));
+  writeVarint(buffer, frame.tick);
+  writeBytes(buffer, &frame.alpha, sizeof(frame.alpha));
+  writeVarint(buffer, frame.dtNS);
+
+  if (buffer.size() >= FLUSH_SIZE) {
+    flush();
+  }
+}
+
+void InputRecorder::flush() {
+  if (!buffer.empty() && SDL_WriteIO(file, buffer.data(), buffer.size()) != buffer.size()) {
+    LOG_ERROR("Failed to write the replay: %s\n", SDL_GetError());
+  }
+  buffer.clear();
+}
+
+bool InputReplay::init(const std::string &path) {
+  size_t size = 0;
+  void *bytes = nullptr;
+  SDL_CHECK((bytes = SDL_LoadFile(path.c_str(), &size)));
+
+  data.assign(static_cast<uint8_t*>(bytes), static_cast<uint8_t*>(bytes) + size);
+  SDL_free(bytes);
+  cursor = 0;
+  frameMs.clear();
+
+  ReplayHeader expected = makeReplayHeader();
+  if (!readBytes(data, cursor, &header, sizeof(header)) ||
+    header.magic != expected.magic ||
+    header.version != expected.version
+  ) {
+    LOG_ERROR("%s is not a replay\n", path.c_str());
+    data.clear();
+    return false;
+  }
+
+  // Named by their config keys
+  const std::pair<const char*, bool> settings[] = {
+    { "tick_rate", header.tickRate != expected.tickRate },
+    { "sprite_count", header.spriteCount != expected.spriteCount },
+    { "world_seed", header.worldSeed != expected.worldSeed },
+    { "world_size", header.worldW != expected.worldW || header.worldH != expected.worldH },
+    { "window_width", header.windowW != expected.windowW },
+    { "window_height", header.windowH != expected.windowH },
+    { "gpu_culling", header.gpuCulling != expected.gpuCulling },
+    { "field_backend", header.fieldBackend != expected.fieldBackend },
+    { "field_size", header.fieldW != expected.fieldW || header.fieldH != expected.fieldH },
+    { "field_steps_per_tick", header.fieldStepsPerTick != expected.fieldStepsPerTick },
+    { "stream_chunk_size", header.streamChunkSize != expected.streamChunkSize },
+    { "stream_sprites_per_chunk", header.streamSpritesPerChunk != expected.streamSpritesPerChunk },
+    { "stream_radius", header.streamRadius != expected.streamRadius },
+    { "stream_memory_mb", header.streamMemoryMB != expected.streamMemoryMB },
+    { "stream_max_loads", header.streamMaxLoads != expected.streamMaxLoads },
+    { "stream_uploads_per_frame", header.streamUploadsPerFrame != expected.streamUploadsPerFrame },
+    { "scene_file", header.sceneHash != expected.sceneHash },
+  };
+  std::string differing;
+  for (const auto &[name, differs] : settings) {
+    if (differs) {
+      differing += differing.empty() ? name : std::string(", ") + name;
+    }
+  }
+  if (!differing.empty()) {
+    LOG_ERROR("Replay %s was recorded with a different workload: %s\n", path.c_str(), differing.c_str());
+    data.clear();
+    return false;
+  }
+
+  return true;
+}
+
+std::optional<ReplayFrame> InputReplay::next(std::vector<SDL_Event> &events) {
+  while (cursor < data.size()) {
+    auto type = static_cast<RecordType>(data[cursor++]);
+
+    if (type == RecordType::EVENT) {
+      SDL_Event event;
+      if (!readBytes(data, cursor, &event, sizeof(event))) {
+        break;
+      }
+      events.push_back(event);
+      continue;
+    }
+
+    ReplayFrame frame;
+    if (type != RecordType::FRAME ||
+      !readVarint(data, cursor, frame.tick) ||
+      !readBytes(data, cursor, &frame.alpha, sizeof(frame.alpha)) ||
+      !readVarint(data, cursor, frame.dtNS)
+    ) {
+      break;
+    }
+    return frame;
+  }
+
+  if (cursor < data.size()) {
+    LOG_ERROR("Replay is corrupted at byte %zu\n", cursor);
+  }
+  cursor = data.size();
+
+  return std::nullopt;
+}
+
+FrameTimeStats summarizeFrameTimes(std::vector<double> frameMs) {
+  if (frameMs.empty()) {
+    return {};
+  }
+
+  std::sort(frameMs.begin(), frameMs.end());
+  auto percentile = [&frameMs](double p) {
+    return frameMs[std::min(size_t(p * frameMs.size()), frameMs.size() - 1)];
+  };
+
+  FrameTimeStats stats = {
+    .frames = frameMs.size(),
+    .p50Ms = percentile(0.5),
+    .p95Ms = percentile(0.95),
+    .p99Ms = percentile(0.99),
+    .maxMs = frameMs.back(),
+  };
+  for (double ms : frameMs) {
+    stats.totalMs += ms;
+  }
+  stats.avgMs = stats.totalMs / stats.frames;
+
+  return stats;
+}
+
+void InputReplay::report(const std::string &csvPath) const {
+  if (frameMs.empty()) {
+    return;
+  }
+
+  FrameTimeStats stats = summarizeFrameTimes(frameMs);
+  LOG_INFO(
+    "REPLAY: %zu frames in %.3fms, avg %.3fms p50 %.3fms p95 %.3fms p99 %.3fms max %.3fms\n",
+    stats.frames,
+    stats.totalMs,
+    stats.avgMs,
+    stats.p50Ms,
+    stats.p95Ms,
+    stats.p99Ms,
+    stats.maxMs
+  );
+
+  if (csvPath.empty()) {
+    return;
+  }
+
+  std::ofstream ofs(csvPath);
+  if (!ofs.is_open()) {
+    LOG_ERROR("Failed to open %s\n", csvPath.c_str());
+    return;
+  }
+  ofs << "frame,ms\n";
+  for (size_t i = 0; i < frameMs.size(); ++i) {
+    ofs << i << ',' << frameMs[i] << '\n';
+  }
+}
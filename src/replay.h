@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <SDL3/SDL.h>
+
+// Binary log of a run's events and frame timing, so the same workload
+// can be replayed run to run. Little-endian:
+//   ReplayHeader
+//   records - a type byte followed by
+//     EVENT: SDL_Event, raw
+//     FRAME: LEB128 tick, float alpha, LEB128 dt in ns
+// Events carrying pointers (text input, drops) don't survive a replay.
+
+struct ReplayHeader {
+  uint32_t magic = 0;
+  uint32_t version = 0;
+  // The workload has to match for the replay to mean anything.
+  uint32_t tickRate = 0;
+  uint32_t spriteCount = 0;
+  uint32_t worldSeed = 0;
+  int32_t worldW = 0;
+  int32_t worldH = 0;
+  uint32_t windowW = 0;
+  uint32_t windowH = 0;
+  uint32_t gpuCulling = 0;
+  uint32_t fieldBackend = 0;
+  int32_t fieldW = 0;
+  int32_t fieldH = 0;
+  uint32_t fieldStepsPerTick = 0;
+  uint32_t streamChunkSize = 0;
+  uint32_t streamSpritesPerChunk = 0;
+  float streamRadius = 0.f;
+  uint32_t streamMemoryMB = 0;
+  uint32_t streamMaxLoads = 0;
+  uint32_t streamUploadsPerFrame = 0;
+  uint32_t _pad = 0;
+  // Of the scene file's contents, zero without one
+  uint64_t sceneHash = 0;
+};
+
+struct ReplayFrame {
+  // Simulation tick the frame rendered and how far towards it
+  Uint64 tick = 0;
+  float alpha = 0.f;
+  // Time the frame took, fed back as AppState::dt
+  Uint64 dtNS = 0;
+};
+
+ReplayHeader makeReplayHeader();
+
+struct FrameTimeStats {
+  size_t frames = 0;
+  double totalMs = 0.;
+  double avgMs = 0.;
+  double p50Ms = 0.;
+  double p95Ms = 0.;
+  double p99Ms = 0.;
+  double maxMs = 0.;
+};
+
+// All zero if there are no frames
+FrameTimeStats summarizeFrameTimes(std::vector<double> frameMs);
+
+class InputRecorder {
+private:
+  SDL_IOStream *file = nullptr;
+  // Written out in large blocks and on deinit
+  std::vector<uint8_t> buffer;
+
+public:
+  ~InputRecorder() {
+    deinit();
+  }
+
+  bool init(const std::string &path);
+  void deinit();
+
+  bool recording() const { return file != nullptr; }
+
+  void event(const SDL_Event &event);
+  void frame(const ReplayFrame &frame);
+
+private:
+  void flush();
+};
+
+class InputReplay {
+private:
+  std::vector<uint8_t> data;
+  size_t cursor = 0;
+  ReplayHeader header;
+
+  // CPU time per replayed frame
+  std::vector<double> frameMs;
+
+public:
+  // Fails if the log doesn't match the current config.
+  bool init(const std::string &path);
+
+  bool replaying() const { return !data.empty(); }
+
+  // Appends the events logged before the next frame to events.
+  // Returns nothing once the log is over.
+  std::optional<ReplayFrame> next(std::vector<SDL_Event> &events);
+
+  void addFrameTime(double ms) { frameMs.push_back(ms); }
+
+  // Prints frame time percentiles and, if csvPath isn't empty, writes
+  // the time of every frame there for A/B comparisons.
+  void report(const std::string &csvPath) const;
+};
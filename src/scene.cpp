@@ -0,0 +1,141 @@
+#include "scene.h"
+
+#include "defines.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+
+// Chunks per job when filling the world
+static constexpr size_t CHUNK_GRAIN = 8;
+
+namespace {
+
+// rrggbbaa
+bool parseColor(std::string_view token, uint32_t &val) {
+  uint32_t rgba = 0;
+  auto res = std::from_chars(token.data(), token.data() + token.size(), rgba, 16);
+  if (token.size() != 8 || res.ec != std::errc() || res.ptr != token.data() + token.size()) {
+    return false;
+  }
+
+  // R in the lowest byte
+  val = (rgba >> 24) | ((rgba >> 8) & 0xff00u) | ((rgba << 8) & 0xff0000u) | (rgba << 24);
+  return true;
+}
+
+bool parseSprite(SceneBlock &block, const TextRecord &record) {
+  if (record.numArgs < 8) {
+    return false;
+  }
+
+  float v[7];
+  for (int i = 0; i < 7; ++i) {
+    if (!parseArg(record.args[i], v[i])) {
+      return false;
+    }
+  }
+  uint32_t color = 0;
+  if (!parseColor(record.args[7], color)) {
+    return false;
+  }
+
+  block.positions.push_back({ { v[0], v[1] } });
+  block.depths.push_back({ v[2] });
+  block.sizes.push_back({ { v[3], v[4] } });
+  block.velocities.push_back({ { v[5], v[6] } });
+  block.colors.push_back({ color });
+  return true;
+}
+
+constexpr auto SCENE_SCHEMA = makeSchema<SceneBlock>({
+  { "world_size", [](SceneBlock &block, const TextRecord &record) {
+    glm::vec2 size;
+    if (!parseValue(record, size)) {
+      return false;
+    }
+    block.worldSize = size;
+    return true;
+  }},
+  { "camera", [](SceneBlock &block, const TextRecord &record) {
+    glm::vec2 camera;
+    if (!parseValue(record, camera)) {
+      return false;
+    }
+    block.camera = camera;
+    return true;
+  }},
+  { "sprite", parseSprite },
+});
+
+}
+
+ParseResult parseScene(std::string_view text, size_t blockBytes, std::vector<SceneBlock> &blocks) {
+  return parseBlocks(text, SCENE_SCHEMA, blockBytes, blocks);
+}
+
+bool loadScene(const std::string &path, GameState &state) {
+  MappedFile file;
+  if (!file.open(path)) {
+    LOG_ERROR("Failed to open scene %s\n", path.c_str());
+    return false;
+  }
+
+  std::vector<SceneBlock> blocks;
+  ParseResult res = parseScene(file.text(), SCENE_BLOCK_BYTES, blocks);
+  if (res.firstError != SIZE_MAX) {
+    LOG_ERROR(
+      "Scene %s has %" PRIu64 " unknown and %" PRIu64 " invalid records, the first at line %zu\n",
+      path.c_str(),
+      res.unknown,
+      res.invalid,
+      lineOf(file.text(), res.firstError)
+    );
+    return false;
+  }
+
+  // The last block that has them wins
+  std::vector<size_t> firstSprite = { 0 };
+  for (const SceneBlock &block : blocks) {
+    if (block.worldSize.has_value()) {
+      state.worldSize = *block.worldSize;
+    }
+    if (block.camera.has_value()) {
+      state.camera = *block.camera;
+    }
+    firstSprite.push_back(firstSprite.back() + block.positions.size());
+  }
+
+  state.world.clear();
+  state.world.createMany(firstSprite.back(), Position{}, Depth{}, Size{}, Velocity{}, Color{});
+
+  // Right after a clear the entities are numbered in creation order,
+  // a chunk's sprites are found by the index of its first entity.
+  state.world.parallelEach<Position, Depth, Size, Velocity, Color>(CHUNK_GRAIN, [&](
+    uint32_t count,
+    const Entity *entities,
+    Position *positions,
+    Depth *depths,
+    Size *sizes,
+    Velocity *velocities,
+    Color *colors
+  ) {
+    size_t first = entities[0].index;
+    size_t b = std::upper_bound(firstSprite.begin(), firstSprite.end(), first) - firstSprite.begin() - 1;
+    for (uint32_t done = 0; done < count; ++b) {
+      const SceneBlock &block = blocks[b];
+      size_t offset = first + done - firstSprite[b];
+      auto n = static_cast<uint32_t>(std::min<size_t>(count - done, block.positions.size() - offset));
+
+      std::memcpy(positions + done, block.positions.data() + offset, n * sizeof(Position));
+      std::memcpy(depths + done, block.depths.data() + offset, n * sizeof(Depth));
+      std::memcpy(sizes + done, block.sizes.data() + offset, n * sizeof(Size));
+      std::memcpy(velocities + done, block.velocities.data() + offset, n * sizeof(Velocity));
+      std::memcpy(colors + done, block.colors.data() + offset, n * sizeof(Color));
+      done += n;
+    }
+  });
+
+  return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "config/parser.h"
+#include "game_state.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+// A world described in text, in the config's format (see config/parser.h):
+//   world_size <w> <h>
+//   camera <x> <y>
+//   sprite <x> <y> <depth> <w> <h> <vx> <vy> <rrggbbaa>
+// Meant for large hand-made or exported worlds - the file is mapped and
+// parsed in blocks on the job system.
+
+// The records of one block of a scene file
+struct SceneBlock {
+  std::optional<glm::vec2> worldSize;
+  std::optional<glm::vec2> camera;
+
+  std::vector<Position> positions;
+  std::vector<Depth> depths;
+  std::vector<Size> sizes;
+  std::vector<Velocity> velocities;
+  std::vector<Color> colors;
+};
+
+// Bytes of a scene file parsed by one job
+static constexpr size_t SCENE_BLOCK_BYTES = 4 * 1024 * 1024;
+
+ParseResult parseScene(std::string_view text, size_t blockBytes, std::vector<SceneBlock> &blocks);
+
+// Replaces the sprites, and the world size and camera if the scene has
+// them. Fails if the file can't be read or has invalid records.
+bool loadScene(const std::string &path, GameState &state);
@@ -0,0 +1,101 @@
+#include "field.h"
+
+#include "jobs/job_system.h"
+
+#include <algorithm>
+
+#include <glm/common.hpp>
+
+// Rows per job
+static constexpr size_t ROW_GRAIN = 16;
+
+Field::Field(const Field &other) : size(other.size), cells(other.cells) {}
+
+Field &Field::operator=(const Field &other) {
+  size = other.size;
+  cells = other.cells;
+  return *this;
+}
+
+void Field::init(glm::ivec2 size) {
+  this->size = size;
+  cells.assign(size_t(size.x) * size.y, glm::vec2{ 1.f, 0.f });
+  next.resize(cells.size());
+
+  // A grid of seeds, so the pattern grows everywhere at once. Fixed
+  // rather than random so both backends start from the same state.
+  int spacing = std::max(std::min(size.x, size.y) / 4, 8);
+  int half = std::max(spacing / 16, 2);
+  for (int cy = spacing / 2; cy < size.y; cy += spacing) {
+    for (int cx = spacing / 2; cx < size.x; cx += spacing) {
+      for (int y = std::max(cy - half, 0); y < std::min(cy + half, size.y); ++y) {
+        for (int x = std::max(cx - half, 0); x < std::min(cx + half, size.x); ++x) {
+          cells[size_t(y) * size.x + x] = { 0.5f, 0.25f };
+        }
+      }
+    }
+  }
+}
+
+void Field::assign(glm::ivec2 size, const glm::vec2 *data) {
+  this->size = size;
+  cells.assign(data, data + size_t(size.x) * size.y);
+  next.resize(cells.size());
+}
+
+void Field::clear() {
+  size = { 0, 0 };
+  cells.clear();
+  next.clear();
+}
+
+void Field::step(const FieldConstData &params, int steps) {
+  if (cells.empty()) {
+    return;
+  }
+
+  int w = size.x;
+  int h = size.y;
+  next.resize(cells.size());
+
+  for (int s = 0; s < steps; ++s) {
+    // MUST match field.comp.hlsl
+    getJobSystem().parallelFor(0, size_t(h), ROW_GRAIN, [&](size_t rowBegin, size_t rowEnd) {
+      for (size_t y = rowBegin; y < rowEnd; ++y) {
+        const glm::vec2 *row = &cells[y * w];
+        const glm::vec2 *up = &cells[((y + h - 1) % h) * w];
+        const glm::vec2 *down = &cells[((y + 1) % h) * w];
+        glm::vec2 *out = &next[y * w];
+
+        for (int x = 0; x < w; ++x) {
+          int left = x == 0 ? w - 1 : x - 1;
+          int right = x == w - 1 ? 0 : x + 1;
+
+          glm::vec2 c = row[x];
+          glm::vec2 lap = row[left] + row[right] + up[x] + down[x] - 4.f * c;
+
+          float uvv = c.x * c.y * c.y;
+          glm::vec2 d = {
+            params.diffuseU * lap.x - uvv + params.feed * (1.f - c.x),
+            params.diffuseV * lap.y + uvv - (params.feed + params.kill) * c.y,
+          };
+
+          out[x] = glm::clamp(c + d * params.dt, 0.f, 1.f);
+        }
+      }
+    });
+
+    cells.swap(next);
+  }
+}
+
+FieldConstData makeFieldConstData(glm::ivec2 size) {
+  return FieldConstData {
+    .size = { uint32_t(size.x), uint32_t(size.y) },
+    .feed = 0.0545f,
+    .kill = 0.062f,
+    .diffuseU = 0.2f,
+    .diffuseV = 0.1f,
+    .dt = 1.f,
+  };
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include "gpu_shared/cpu_gpu_shared.h"
+
+// Gray-Scott reaction-diffusion on a grid that wraps around at the edges.
+// Every cell holds the concentrations of two chemicals, u and v, in [0, 1]:
+//   u' = Du * lap(u) - u * v^2 + feed * (1 - u)
+//   v' = Dv * lap(v) + u * v^2 - (feed + kill) * v
+// with a 5-point laplacian and explicit Euler steps, stable while
+// 4 * D * dt <= 1.
+class Field {
+private:
+  glm::ivec2 size = { 0, 0 };
+  // Row major
+  std::vector<glm::vec2> cells;
+  // Step scratch, swapped with cells
+  std::vector<glm::vec2> next;
+
+public:
+  Field() = default;
+  // Only the cells are copied, snapshots don't need the scratch.
+  Field(const Field &other);
+  Field &operator=(const Field &other);
+  Field(Field &&other) = default;
+  Field &operator=(Field &&other) = default;
+
+  // Fills the field with u and a few squares of v in a fixed pattern.
+  void init(glm::ivec2 size);
+  // Replaces the state with size.x * size.y cells, e.g. from a snapshot.
+  void assign(glm::ivec2 size, const glm::vec2 *data);
+  void clear();
+
+  bool empty() const { return cells.empty(); }
+  glm::ivec2 getSize() const { return size; }
+  const std::vector<glm::vec2> &getCells() const { return cells; }
+
+  // Runs on the job system.
+  void step(const FieldConstData &params, int steps);
+};
+
+// Parameters giving the "coral" pattern
+FieldConstData makeFieldConstData(glm::ivec2 size);
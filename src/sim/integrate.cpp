@@ -0,0 +1,176 @@
+#include "integrate.h"
+
+#include <algorithm>
+
+#include <SDL3/SDL.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+// MSVC compiles any intrinsic without it, GCC and Clang need the
+// function to be built for the instruction set.
+#if defined(SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+static_assert(sizeof(glm::vec2) == 2 * sizeof(float), "integrate treats vec2 arrays as float arrays");
+
+namespace {
+
+using Kernel = void(*)(float*, float*, const float*, size_t, float, const float*);
+
+// Handles floats [begin, end). Even indices are x, odd are y.
+void integrateScalar(float *pos, float *vel, const float *accel, size_t begin, size_t end, float dt, const float *bounds) {
+  for (size_t i = begin; i < end; ++i) {
+    float bound = bounds[i & 1];
+    float v = vel[i];
+    if (accel != nullptr) {
+      v += accel[i] * dt;
+    }
+    float p = pos[i] + v * dt;
+
+    if (p < 0.f) {
+      p = -p;
+      v = -v;
+    } else if (p > bound) {
+      p = 2.f * bound - p;
+      v = -v;
+    }
+
+    pos[i] = p;
+    vel[i] = v;
+  }
+}
+
+void kernelScalar(float *pos, float *vel, const float *accel, size_t n, float dt, const float *bounds) {
+  integrateScalar(pos, vel, accel, 0, n, dt, bounds);
+}
+
+#ifdef SIMD_X86
+
+void kernelSSE2(float *pos, float *vel, const float *accel, size_t n, float dt, const float *bounds) {
+  const __m128 vdt = _mm_set1_ps(dt);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 sign = _mm_set1_ps(-0.f);
+  // xy xy, every vector starts at an x
+  const __m128 bound = _mm_setr_ps(bounds[0], bounds[1], bounds[0], bounds[1]);
+  const __m128 bound2 = _mm_add_ps(bound, bound);
+
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 v = _mm_loadu_ps(vel + i);
+    if (accel != nullptr) {
+      v = _mm_add_ps(v, _mm_mul_ps(_mm_loadu_ps(accel + i), vdt));
+    }
+    __m128 p = _mm_add_ps(_mm_loadu_ps(pos + i), _mm_mul_ps(v, vdt));
+
+    __m128 below = _mm_cmplt_ps(p, zero);
+    __m128 above = _mm_cmpgt_ps(p, bound);
+    __m128 reflected = _mm_or_ps(
+      _mm_and_ps(below, _mm_xor_ps(p, sign)),
+      _mm_and_ps(above, _mm_sub_ps(bound2, p))
+    );
+    __m128 out = _mm_or_ps(below, above);
+    p = _mm_or_ps(_mm_andnot_ps(out, p), reflected);
+    v = _mm_xor_ps(v, _mm_and_ps(out, sign));
+
+    _mm_storeu_ps(pos + i, p);
+    _mm_storeu_ps(vel + i, v);
+  }
+
+  integrateScalar(pos, vel, accel, i, n, dt, bounds);
+}
+
+TARGET_AVX2
+void kernelAVX2(float *pos, float *vel, const float *accel, size_t n, float dt, const float *bounds) {
+  const __m256 vdt = _mm256_set1_ps(dt);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 sign = _mm256_set1_ps(-0.f);
+  const __m256 bound = _mm256_setr_ps(
+    bounds[0], bounds[1], bounds[0], bounds[1],
+    bounds[0], bounds[1], bounds[0], bounds[1]
+  );
+  const __m256 bound2 = _mm256_add_ps(bound, bound);
+
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 v = _mm256_loadu_ps(vel + i);
+    if (accel != nullptr) {
+      v = _mm256_add_ps(v, _mm256_mul_ps(_mm256_loadu_ps(accel + i), vdt));
+    }
+    __m256 p = _mm256_add_ps(_mm256_loadu_ps(pos + i), _mm256_mul_ps(v, vdt));
+
+    __m256 below = _mm256_cmp_ps(p, zero, _CMP_LT_OQ);
+    __m256 above = _mm256_cmp_ps(p, bound, _CMP_GT_OQ);
+    p = _mm256_blendv_ps(p, _mm256_xor_ps(p, sign), below);
+    p = _mm256_blendv_ps(p, _mm256_sub_ps(bound2, p), above);
+    v = _mm256_xor_ps(v, _mm256_and_ps(_mm256_or_ps(below, above), sign));
+
+    _mm256_storeu_ps(pos + i, p);
+    _mm256_storeu_ps(vel + i, v);
+  }
+
+  integrateScalar(pos, vel, accel, i, n, dt, bounds);
+}
+
+#endif // SIMD_X86
+
+SimdLevel detectSimdLevel() {
+#ifdef SIMD_X86
+  if (SDL_HasAVX2()) {
+    return SimdLevel::AVX2;
+  }
+  if (SDL_HasSSE2()) {
+    return SimdLevel::SSE2;
+  }
+#endif
+  return SimdLevel::SCALAR;
+}
+
+Kernel getKernel(SimdLevel level) {
+  switch (std::min(level, getSimdLevel())) {
+#ifdef SIMD_X86
+  case SimdLevel::AVX2:
+    return kernelAVX2;
+  case SimdLevel::SSE2:
+    return kernelSSE2;
+#endif
+  default:
+    return kernelScalar;
+  }
+}
+
+}
+
+SimdLevel getSimdLevel() {
+  static const SimdLevel level = detectSimdLevel();
+  return level;
+}
+
+void integrate(
+  glm::vec2 *pos,
+  glm::vec2 *vel,
+  const glm::vec2 *accel,
+  size_t count,
+  float dt,
+  glm::vec2 bounds,
+  SimdLevel level
+) {
+  if (count == 0) {
+    return;
+  }
+
+  const float boundsXY[2] = { bounds.x, bounds.y };
+  getKernel(level)(
+    &pos->x,
+    &vel->x,
+    accel != nullptr ? &accel->x : nullptr,
+    count * 2,
+    dt,
+    boundsXY
+  );
+}
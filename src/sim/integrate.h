@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glm/vec2.hpp>
+
+enum class SimdLevel {
+  SCALAR,
+  SSE2,
+  AVX2,
+};
+
+// Best level the CPU supports, detected on first call.
+SimdLevel getSimdLevel();
+
+// Semi-implicit Euler step over count agents, in place:
+//   vel += accel * dt (accel may be nullptr), pos += vel * dt
+// Agents leaving [0, bounds] are reflected back with their velocity flipped.
+// The arrays are treated as flat streams of floats, so they can come
+// straight from ECS columns. levels above getSimdLevel() fall back to it.
+void integrate(
+  glm::vec2 *pos,
+  glm::vec2 *vel,
+  const glm::vec2 *accel,
+  size_t count,
+  float dt,
+  glm::vec2 bounds,
+  SimdLevel level = getSimdLevel()
+);
@@ -0,0 +1,177 @@
+#include "spatial_grid.h"
+
+#include "jobs/job_system.h"
+
+#include <cassert>
+#include <utility>
+
+// Points per job
+static constexpr size_t POINT_GRAIN = 16 * 1024;
+// The rows of cells are split into this many bands, sorted independently.
+// Fixed rather than per thread so the result never depends on the machine.
+static constexpr int NUM_BANDS = 64;
+
+void SpatialGrid::build(const glm::vec2 *pos, size_t count, glm::vec2 origin, glm::vec2 size, float cellSize) {
+  assert(cellSize > 0.f);
+
+  this->origin = origin;
+  this->cellSize = cellSize;
+  invCellSize = 1.f / cellSize;
+  dims = glm::max(glm::ivec2(glm::ceil(size * invCellSize)), glm::ivec2(1));
+
+  size_t numCells = size_t(dims.x) * dims.y;
+  JobSystem &jobs = getJobSystem();
+
+  // A stable counting sort in two levels, so that no two jobs ever write
+  // the same counter - first the points go to their band of rows, then
+  // each band sorts its points into its cells.
+  int rowsPerBand = (dims.y + NUM_BANDS - 1) / NUM_BANDS;
+  int numBands = (dims.y + rowsPerBand - 1) / rowsPerBand;
+  size_t cellsPerBand = size_t(rowsPerBand) * dims.x;
+  size_t numChunks = (count + POINT_GRAIN - 1) / POINT_GRAIN;
+
+  // Points of every chunk per band
+  std::vector<uint32_t> bandOffsets(numChunks * numBands, 0);
+  cellOf.resize(count);
+  jobs.parallelFor(0, numChunks, 1, [&](size_t chunkBegin, size_t chunkEnd) {
+    for (size_t chunk = chunkBegin; chunk < chunkEnd; ++chunk) {
+      uint32_t *counts = &bandOffsets[chunk * numBands];
+      size_t end = std::min((chunk + 1) * POINT_GRAIN, count);
+      for (size_t i = chunk * POINT_GRAIN; i < end; ++i) {
+        glm::ivec2 c = cellCoord(pos[i]);
+        cellOf[i] = uint32_t(c.y * dims.x + c.x);
+        ++counts[c.y / rowsPerBand];
+      }
+    }
+  });
+
+  // Band major, so each band's points end up contiguous and, within
+  // the band, in chunk and therefore input order.
+  std::vector<uint32_t> bandStart(numBands + 1, 0);
+  uint32_t offset = 0;
+  for (int band = 0; band < numBands; ++band) {
+    bandStart[band] = offset;
+    for (size_t chunk = 0; chunk < numChunks; ++chunk) {
+      uint32_t n = bandOffsets[chunk * numBands + band];
+      bandOffsets[chunk * numBands + band] = offset;
+      offset += n;
+    }
+  }
+  bandStart[numBands] = offset;
+
+  byBand.resize(count);
+  jobs.parallelFor(0, numChunks, 1, [&](size_t chunkBegin, size_t chunkEnd) {
+    for (size_t chunk = chunkBegin; chunk < chunkEnd; ++chunk) {
+      uint32_t *cursor = &bandOffsets[chunk * numBands];
+      size_t end = std::min((chunk + 1) * POINT_GRAIN, count);
+      for (size_t i = chunk * POINT_GRAIN; i < end; ++i) {
+        byBand[cursor[cellOf[i] / cellsPerBand]++] = static_cast<uint32_t>(i);
+      }
+    }
+  });
+
+  // Each band owns the starts of its cells, cellStart[c + 1] for its c.
+  cellStart.resize(numCells + 1);
+  cellStart[0] = 0;
+  indices.resize(count);
+  points.resize(count);
+  jobs.parallelFor(0, numBands, 1, [&](size_t bandBegin, size_t bandEnd) {
+    std::vector<uint32_t> cursor;
+    for (size_t band = bandBegin; band < bandEnd; ++band) {
+      size_t firstCell = band * cellsPerBand;
+      size_t numBandCells = std::min(cellsPerBand, numCells - firstCell);
+      uint32_t *starts = &cellStart[firstCell + 1];
+
+      std::fill(starts, starts + numBandCells, 0);
+      for (uint32_t j = bandStart[band]; j < bandStart[band + 1]; ++j) {
+        ++starts[cellOf[byBand[j]] - firstCell];
+      }
+
+      cursor.resize(numBandCells);
+      uint32_t running = bandStart[band];
+      for (size_t c = 0; c < numBandCells; ++c) {
+        cursor[c] = running;
+        running += starts[c];
+        starts[c] = running;
+      }
+
+      for (uint32_t j = bandStart[band]; j < bandStart[band + 1]; ++j) {
+        uint32_t idx = byBand[j];
+        uint32_t slot = cursor[cellOf[idx] - firstCell]++;
+        indices[slot] = idx;
+        points[slot] = pos[idx];
+      }
+    }
+  });
+}
+
+void SpatialGrid::queryRadius(glm::vec2 center, float radius, std::vector<uint32_t> &out) const {
+  forEachInRadius(center, radius, [&out](uint32_t index, glm::vec2) {
+    out.push_back(index);
+  });
+}
+
+void SpatialGrid::queryNearest(glm::vec2 center, size_t k, std::vector<uint32_t> &out) const {
+  out.clear();
+  if (k == 0 || points.empty()) {
+    return;
+  }
+
+  // Max-heap of the best k so far, ties broken by index to stay deterministic.
+  using Candidate = std::pair<float, uint32_t>;
+  std::vector<Candidate> best;
+  best.reserve(k + 1);
+
+  auto scan = [&](int y, int x0, int x1) {
+    uint32_t begin = cellStart[y * dims.x + x0];
+    uint32_t end = cellStart[y * dims.x + x1 + 1];
+    for (uint32_t i = begin; i < end; ++i) {
+      glm::vec2 d = points[i] - center;
+      Candidate candidate = { glm::dot(d, d), indices[i] };
+      if (best.size() < k) {
+        best.push_back(candidate);
+        std::push_heap(best.begin(), best.end());
+      } else if (candidate < best.front()) {
+        std::pop_heap(best.begin(), best.end());
+        best.back() = candidate;
+        std::push_heap(best.begin(), best.end());
+      }
+    }
+  };
+
+  // Search rings of cells around the center's cell. Points outside ring r
+  // are at least r cells away, so once the k-th best is closer than that
+  // the search is over.
+  glm::ivec2 c = cellCoord(center);
+  int maxRing = std::max(std::max(c.x, dims.x - 1 - c.x), std::max(c.y, dims.y - 1 - c.y));
+  for (int r = 0; r <= maxRing; ++r) {
+    int x0 = std::max(c.x - r, 0);
+    int x1 = std::min(c.x + r, dims.x - 1);
+
+    if (c.y - r >= 0) {
+      scan(c.y - r, x0, x1);
+    }
+    if (r > 0 && c.y + r < dims.y) {
+      scan(c.y + r, x0, x1);
+    }
+    for (int y = std::max(c.y - r + 1, 0); y <= std::min(c.y + r - 1, dims.y - 1); ++y) {
+      if (c.x - r >= 0) {
+        scan(y, c.x - r, c.x - r);
+      }
+      if (r > 0 && c.x + r < dims.x) {
+        scan(y, c.x + r, c.x + r);
+      }
+    }
+
+    float reach = r * cellSize;
+    if (best.size() == k && best.front().first <= reach * reach) {
+      break;
+    }
+  }
+
+  std::sort_heap(best.begin(), best.end());
+  out.reserve(best.size());
+  for (const Candidate &candidate : best) {
+    out.push_back(candidate.second);
+  }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
+
+// Uniform grid over a fixed area for neighbor queries, rebuilt from scratch
+// every tick. The build is a counting sort of the points by cell, so the
+// points of a cell, and of a whole row of cells, end up next to each
+// other in memory and a query scans a few contiguous ranges.
+// Points outside the area are clamped into the border cells.
+class SpatialGrid {
+private:
+  glm::vec2 origin = { 0.f, 0.f };
+  float cellSize = 1.f;
+  float invCellSize = 1.f;
+  glm::ivec2 dims = { 0, 0 };
+
+  // Points of cell c are [cellStart[c], cellStart[c + 1]) in the arrays below
+  std::vector<uint32_t> cellStart;
+  // Index of the point in the array passed to build
+  std::vector<uint32_t> indices;
+  std::vector<glm::vec2> points;
+
+  // Build scratch
+  std::vector<uint32_t> cellOf;
+  std::vector<uint32_t> byBand;
+
+public:
+  // Sorts count points into cells of cellSize covering [origin, origin + size].
+  // Runs on the job system. Within a cell the points keep their input order,
+  // so queries are deterministic.
+  void build(const glm::vec2 *pos, size_t count, glm::vec2 origin, glm::vec2 size, float cellSize);
+
+  size_t size() const { return points.size(); }
+  glm::ivec2 getDims() const { return dims; }
+
+  // Calls fn(index, pos) for every point within radius of center.
+  template <class Fn>
+  void forEachInRadius(glm::vec2 center, float radius, Fn &&fn) const {
+    if (points.empty()) {
+      return;
+    }
+
+    glm::ivec2 lo = cellCoord(center - radius);
+    glm::ivec2 hi = cellCoord(center + radius);
+    float radius2 = radius * radius;
+
+    for (int y = lo.y; y <= hi.y; ++y) {
+      // A row of cells is one contiguous range.
+      uint32_t begin = cellStart[y * dims.x + lo.x];
+      uint32_t end = cellStart[y * dims.x + hi.x + 1];
+      for (uint32_t i = begin; i < end; ++i) {
+        glm::vec2 d = points[i] - center;
+        if (glm::dot(d, d) <= radius2) {
+          fn(indices[i], points[i]);
+        }
+      }
+    }
+  }
+
+  // Appends the indices of the points within radius of center to out.
+  void queryRadius(glm::vec2 center, float radius, std::vector<uint32_t> &out) const;
+
+  // Replaces out with the indices of the k points nearest to center,
+  // nearest first. Fewer if there are less than k points.
+  void queryNearest(glm::vec2 center, size_t k, std::vector<uint32_t> &out) const;
+
+private:
+  glm::ivec2 cellCoord(glm::vec2 p) const {
+    glm::ivec2 c = glm::ivec2(glm::floor((p - origin) * invCellSize));
+    return glm::clamp(c, glm::ivec2(0), dims - 1);
+  }
+};
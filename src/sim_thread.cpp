@@ -0,0 +1,170 @@
+#include "sim_thread.h"
+
+#include "defines.h"
+
+#include <algorithm>
+
+// If the simulation falls further behind than this it drops the missed
+// ticks (slows down) instead of trying to catch up with even longer frames.
+static constexpr Uint64 MAX_CATCH_UP_TICKS = 5;
+
+bool SimThread::start(GameState *state, uint tickRate) {
+  stop();
+  reset(state, tickRate);
+
+  running = true;
+  thread = std::thread(&SimThread::run, this);
+
+  return true;
+}
+
+void SimThread::startLockstep(GameState *state, uint tickRate) {
+  stop();
+  reset(state, tickRate);
+}
+
+void SimThread::reset(GameState *state, uint tickRate) {
+  assert(state != nullptr);
+  assert(tickRate > 0);
+
+  this->state = state;
+  tickNS = SDL_NS_PER_SECOND / tickRate;
+
+  // Start from the initial state so there is always something to draw.
+  GameSnapshot initial = {
+    .state = *state,
+    .tick = 0,
+    .timeNS = SDL_GetTicksNS(),
+  };
+  initial.publishedNS = initial.timeNS;
+  snapshots.reset(initial);
+  tick = 0;
+  lastTick = 0;
+}
+
+void SimThread::stop() {
+  running = false;
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
+
+SimThread::Frame SimThread::acquire() {
+  Frame frame = take();
+
+  Uint64 renderTime = SDL_GetTicksNS() - tickNS;
+  Uint64 from = frame.prev->timeNS;
+  Uint64 to = frame.curr->timeNS;
+  if (to > from && renderTime > from) {
+    frame.alpha = std::min(float(double(renderTime - from) / double(to - from)), 1.f);
+  }
+
+  return frame;
+}
+
+SimThread::Frame SimThread::stepTo(Uint64 target, float alpha) {
+  assert(!thread.joinable());
+
+  double tickDt = double(tickNS) / SDL_NS_PER_SECOND;
+  while (tick < target) {
+    Uint64 start = SDL_GetTicksNS();
+    state->update(tickDt);
+    // Simulation time as if it had started at zero
+    publish((tick + 1) * tickNS, SDL_GetTicksNS() - start);
+  }
+
+  Frame frame = take();
+  frame.alpha = alpha;
+
+  return frame;
+}
+
+SimThread::Frame SimThread::take() {
+  Frame frame;
+  frame.fresh = snapshots.acquire();
+  frame.prev = &snapshots.previous();
+  frame.curr = &snapshots.latest();
+
+  Uint64 now = SDL_GetTicksNS();
+  ++frames;
+  if (frame.fresh) {
+    consumedTicks += frame.curr->tick - lastTick;
+    lastTick = frame.curr->tick;
+    latencyNS += now - frame.curr->publishedNS;
+  } else {
+    ++duplicated;
+  }
+
+  return frame;
+}
+
+SimStats SimThread::collectStats() {
+  SimStats stats;
+
+  Uint64 numTicks = ticks.exchange(0);
+  Uint64 tickTime = tickTimeNS.exchange(0);
+  if (numTicks > 0) {
+    stats.tickMs = double(tickTime) / numTicks / SDL_NS_PER_MS;
+  }
+  stats.maxTickMs = double(maxTickTimeNS.exchange(0)) / SDL_NS_PER_MS;
+  stats.droppedSnapshots = dropped.exchange(0);
+
+  if (frames > 0) {
+    stats.ticksPerFrame = double(consumedTicks) / frames;
+  }
+  if (frames > duplicated) {
+    stats.snapshotLatencyMs = double(latencyNS) / (frames - duplicated) / SDL_NS_PER_MS;
+  }
+  stats.duplicatedSnapshots = duplicated;
+  frames = 0;
+  consumedTicks = 0;
+  latencyNS = 0;
+  duplicated = 0;
+
+  return stats;
+}
+
+void SimThread::run() {
+  double tickDt = double(tickNS) / SDL_NS_PER_SECOND;
+  Uint64 nextTick = SDL_GetTicksNS() + tickNS;
+
+  while (running) {
+    Uint64 now = SDL_GetTicksNS();
+    if (now < nextTick) {
+      SDL_DelayNS(nextTick - now);
+      continue;
+    }
+
+    if (now - nextTick > MAX_CATCH_UP_TICKS * tickNS) {
+      DEBUG_PRINT("Simulation is %" SDL_PRIu64 " ticks behind, skipping them\n", (now - nextTick) / tickNS);
+      nextTick = now;
+    }
+
+    state->update(tickDt);
+    publish(nextTick, SDL_GetTicksNS() - now);
+    if (snapshotWriter != nullptr) {
+      snapshotWriter->tick(*state);
+    }
+
+    nextTick += tickNS;
+  }
+}
+
+void SimThread::publish(Uint64 timeNS, Uint64 tickDurationNS) {
+  // The slot holds an old snapshot, copying over it reuses its memory.
+  GameSnapshot &snapshot = snapshots.writeSlot();
+  snapshot.state = *state;
+  snapshot.tick = ++tick;
+  snapshot.timeNS = timeNS;
+  snapshot.publishedNS = SDL_GetTicksNS();
+
+  if (snapshots.publish()) {
+    ++dropped;
+  }
+
+  tickTimeNS += tickDurationNS;
+  if (tickDurationNS > maxTickTimeNS) {
+    maxTickTimeNS = tickDurationNS;
+  }
+  ++ticks;
+}
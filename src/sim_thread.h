@@ -0,0 +1,109 @@
+#pragma once
+
+#include "game_state.h"
+#include "snapshot.h"
+#include "triple_buffer.h"
+
+#include <atomic>
+#include <thread>
+
+#include <SDL3/SDL.h>
+
+// Immutable copy of the GameState published after every tick.
+struct GameSnapshot {
+  GameState state;
+
+  Uint64 tick = 0;
+  // Simulation time the state corresponds to, in the SDL_GetTicksNS clock.
+  Uint64 timeNS = 0;
+  // When the tick actually finished.
+  Uint64 publishedNS = 0;
+};
+
+struct SimStats {
+  // Averages since the last SimThread::collectStats
+  double tickMs = 0.;
+  double maxTickMs = 0.;
+  double ticksPerFrame = 0.;
+  // Age of the newest snapshot when the render thread picked it up.
+  double snapshotLatencyMs = 0.;
+
+  // Snapshots overwritten before the render thread saw them
+  Uint64 droppedSnapshots = 0;
+  // Frames that found no new snapshot
+  Uint64 duplicatedSnapshots = 0;
+};
+
+// Runs GameState::update on its own thread at a fixed tick rate and
+// publishes a snapshot after every tick through a TripleBuffer, so neither
+// side ever waits for the other. The render thread interpolates between
+// the last two snapshots, see SimThread::acquire.
+class SimThread {
+public:
+  struct Frame {
+    // Valid until the next acquire
+    const GameSnapshot *prev = nullptr;
+    const GameSnapshot *curr = nullptr;
+    // Interpolation factor between prev and curr
+    float alpha = 0.f;
+    // Whether curr wasn't seen by the previous acquire
+    bool fresh = false;
+  };
+
+private:
+  GameState *state = nullptr;
+  Uint64 tickNS = 0;
+  SnapshotWriter *snapshotWriter = nullptr;
+
+  std::thread thread;
+  std::atomic<bool> running = false;
+
+  TripleBuffer<GameSnapshot> snapshots;
+  Uint64 tick = 0;
+
+  // Sim thread side stats
+  std::atomic<Uint64> tickTimeNS = 0;
+  std::atomic<Uint64> maxTickTimeNS = 0;
+  std::atomic<Uint64> ticks = 0;
+  std::atomic<Uint64> dropped = 0;
+
+  // Render thread side stats
+  Uint64 lastTick = 0;
+  Uint64 frames = 0;
+  Uint64 consumedTicks = 0;
+  Uint64 latencyNS = 0;
+  Uint64 duplicated = 0;
+
+public:
+  ~SimThread() {
+    stop();
+  }
+
+  // The sim thread owns state until stop() returns.
+  bool start(GameState *state, uint tickRate);
+  void stop();
+
+  // Hands the state to writer after every tick. Set before starting.
+  void setSnapshotWriter(SnapshotWriter *writer) { snapshotWriter = writer; }
+
+  // No thread, the simulation only advances in stepTo. For replays.
+  void startLockstep(GameState *state, uint tickRate);
+
+  // Latest two snapshots and where the current frame lies between them.
+  // The view is rendered one tick behind the simulation, so that there
+  // is always a newer snapshot to interpolate to.
+  Frame acquire();
+
+  // Lockstep mode: runs the ticks up to tick on the calling thread, then
+  // acquires like acquire() but with the given alpha.
+  Frame stepTo(Uint64 tick, float alpha);
+
+  SimStats collectStats();
+
+private:
+  void reset(GameState *state, uint tickRate);
+  void run();
+  // Acquires the newest snapshot and counts the render side stats.
+  Frame take();
+  void publish(Uint64 timeNS, Uint64 tickDurationNS);
+};
@@ -0,0 +1,411 @@
+#include "snapshot.h"
+
+#include "config/config.h"
+#include "defines.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <utility>
+
+static constexpr uint32_t SNAPSHOT_MAGIC = 0x50414e53; // "SNAP"
+static constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+namespace {
+
+// The sprite components in the order of the header's columns
+World::ChunkLayout spriteLayout(World &world) {
+  return world.chunkLayout<Position, Depth, Size, Velocity, Color>();
+}
+
+std::vector<World::ChunkImage> spriteChunks(const World &world) {
+  return world.chunkImages<Position, Depth, Size, Velocity, Color>();
+}
+
+constexpr uint32_t SPRITE_COLUMN_SIZES[] = {
+  sizeof(Position),
+  sizeof(Depth),
+  sizeof(Size),
+  sizeof(Velocity),
+  sizeof(Color),
+};
+static_assert(std::size(SPRITE_COLUMN_SIZES) <= MAX_SNAPSHOT_COLUMNS);
+
+uint64_t alignUp(uint64_t value) {
+  return (value + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+}
+
+// Word at a time, only used to tell whether a chunk changed.
+uint64_t hashBytes(const void *data, size_t size) {
+  auto bytes = static_cast<const std::byte*>(data);
+  uint64_t hash = 0xcbf29ce484222325ull ^ size;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, bytes + i, 8);
+    hash = (hash ^ word) * 0x100000001b3ull;
+    hash ^= hash >> 29;
+  }
+  for (; i < size; ++i) {
+    hash = (hash ^ uint64_t(bytes[i])) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+std::string snapshotPath(const std::string &dir, int file) {
+  return (std::filesystem::path(dir) / ("snapshot." + std::to_string(file) + ".bin")).string();
+}
+
+bool writeAt(SDL_IOStream *io, uint64_t offset, const void *data, size_t size) {
+  return SDL_SeekIO(io, static_cast<Sint64>(offset), SDL_IO_SEEK_SET) >= 0 &&
+    SDL_WriteIO(io, data, size) == size;
+}
+
+}
+
+bool SnapshotView::open(const std::string &path) {
+  close();
+
+  if (!file.open(path) || file.size() < sizeof(SnapshotHeader)) {
+    close();
+    return false;
+  }
+  data = file.data();
+  size = file.size();
+
+  const SnapshotHeader &header = getHeader();
+  if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION || header.complete == 0) {
+    close();
+    return false;
+  }
+
+  // The header comes from the disk, none of the sizes can be trusted not to overflow.
+  auto sectionBytes = [](uint64_t count, uint64_t elementBytes, uint64_t &bytes) {
+    if (elementBytes != 0 && count > UINT64_MAX / elementBytes) {
+      return false;
+    }
+    bytes = count * elementBytes;
+    return true;
+  };
+  auto fits = [this](uint64_t offset, uint64_t bytes) {
+    return bytes == 0 || (offset % SNAPSHOT_ALIGN == 0 && bytes <= size && offset <= size - bytes);
+  };
+  uint64_t tableBytes = 0;
+  uint64_t chunksBytes = 0;
+  uint64_t fieldCells = 0;
+  uint64_t fieldBytes = 0;
+  if (!sectionBytes(header.numChunks, sizeof(SnapshotChunk), tableBytes) ||
+    !sectionBytes(header.numChunks, header.chunkBytes, chunksBytes) ||
+    !sectionBytes(uint64_t(std::max(header.fieldW, 0)), uint64_t(std::max(header.fieldH, 0)), fieldCells) ||
+    !sectionBytes(fieldCells, sizeof(glm::vec2), fieldBytes) ||
+    !fits(header.chunkTableOffset, tableBytes) ||
+    !fits(header.chunksOffset, chunksBytes) ||
+    !fits(header.fieldOffset, fieldBytes)
+  ) {
+    close();
+    return false;
+  }
+
+  // A chunk can't hold more rows than it has room for.
+  auto table = reinterpret_cast<const SnapshotChunk*>(data + header.chunkTableOffset);
+  for (uint64_t c = 0; c < header.numChunks; ++c) {
+    if (table[c].count > header.chunkCapacity) {
+      close();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void SnapshotView::close() {
+  file.close();
+  data = nullptr;
+  size = 0;
+}
+
+bool SnapshotView::matchesLayout() const {
+  World world;
+  World::ChunkLayout layout = spriteLayout(world);
+  const SnapshotHeader &header = getHeader();
+
+  if (header.chunkBytes != World::CHUNK_BYTES ||
+    header.chunkCapacity != layout.capacity ||
+    header.numColumns != layout.offsets.size()
+  ) {
+    return false;
+  }
+  for (uint32_t c = 0; c < header.numColumns; ++c) {
+    if (header.columnOffsets[c] != layout.offsets[c] || header.columnSizes[c] != SPRITE_COLUMN_SIZES[c]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+std::vector<World::ChunkImage> SnapshotView::chunkImages() const {
+  const SnapshotHeader &header = getHeader();
+  auto table = reinterpret_cast<const SnapshotChunk*>(data + header.chunkTableOffset);
+
+  std::vector<World::ChunkImage> images(header.numChunks);
+  for (uint64_t c = 0; c < header.numChunks; ++c) {
+    images[c] = {
+      .data = data + header.chunksOffset + c * header.chunkBytes,
+      .count = table[c].count,
+    };
+  }
+
+  return images;
+}
+
+const glm::vec2 *SnapshotView::fieldCells() const {
+  const SnapshotHeader &header = getHeader();
+  if (header.fieldW <= 0 || header.fieldH <= 0) {
+    return nullptr;
+  }
+  return reinterpret_cast<const glm::vec2*>(data + header.fieldOffset);
+}
+
+bool loadSnapshot(const std::string &dir, const Config &cfg, GameState &state) {
+  Uint64 start = SDL_GetTicksNS();
+
+  // Newest first, falls back to the other file if it can't be loaded.
+  SnapshotView views[2];
+  SnapshotView *order[2] = {};
+  for (int i = 0; i < 2; ++i) {
+    if (!views[i].open(snapshotPath(dir, i))) {
+      continue;
+    }
+    if (!views[i].matchesLayout()) {
+      LOG_WARN("Snapshot %s was written with a different chunk layout\n", snapshotPath(dir, i).c_str());
+      views[i].close();
+      continue;
+    }
+    order[i] = &views[i];
+  }
+  if (order[0] == nullptr || (order[1] != nullptr && order[1]->getHeader().sequence > order[0]->getHeader().sequence)) {
+    std::swap(order[0], order[1]);
+  }
+
+  SnapshotView *newest = order[0];
+  if (newest == nullptr) {
+    LOG_ERROR("No usable snapshot in %s\n", dir.c_str());
+    return false;
+  }
+
+  const SnapshotHeader &header = newest->getHeader();
+  state.world.loadChunkImages<Position, Depth, Size, Velocity, Color>(newest->chunkImages());
+  state.worldSize = { header.worldSize[0], header.worldSize[1] };
+  state.camera = { header.camera[0], header.camera[1] };
+  state.tick = header.tick;
+
+  // The field only moves on with the CPU backend.
+  state.field.clear();
+  if (const glm::vec2 *cells = newest->fieldCells(); cells != nullptr && cfg.fieldBackend == FieldBackend::CPU) {
+    glm::ivec2 size = { header.fieldW, header.fieldH };
+    state.field.assign(size, cells);
+    state.fieldParams = makeFieldConstData(size);
+    state.fieldSteps = static_cast<int>(cfg.fieldStepsPerTick);
+  }
+
+  LOG_INFO(
+    "SNAPSHOT: restored tick %" SDL_PRIu64 ", %zu sprites in %.3fms\n",
+    header.tick,
+    state.world.size(),
+    double(SDL_GetTicksNS() - start) / SDL_NS_PER_MS
+  );
+
+  return true;
+}
+
+bool SnapshotWriter::init(const std::string &dir, Uint64 intervalTicks) {
+  deinit();
+
+  this->dir = dir;
+  interval = intervalTicks;
+  if (interval == 0) {
+    return true;
+  }
+
+  SDL_CHECK(SDL_CreateDirectory(dir.c_str()));
+
+  // Carry on after the snapshots of a previous run, overwriting the older one first.
+  sequence = 0;
+  nextFile = 0;
+  for (int i = 0; i < 2; ++i) {
+    files[i] = {};
+
+    SnapshotView view;
+    if (view.open(snapshotPath(dir, i)) && view.getHeader().sequence > sequence) {
+      sequence = view.getHeader().sequence;
+      nextFile = 1 - i;
+    }
+  }
+
+  quit = false;
+  pending = false;
+  thread = std::thread(&SnapshotWriter::run, this);
+
+  return true;
+}
+
+void SnapshotWriter::deinit() {
+  {
+    std::lock_guard lock(mutex);
+    quit = true;
+  }
+  cv.notify_one();
+  if (thread.joinable()) {
+    thread.join();
+  }
+
+  interval = 0;
+  busy = false;
+}
+
+void SnapshotWriter::tick(const GameState &state) {
+  if (interval == 0 || state.tick % interval != 0) {
+    return;
+  }
+  if (busy) {
+    ++skipped;
+    return;
+  }
+
+  Uint64 start = SDL_GetTicksNS();
+  this->state = state;
+  copyNS += SDL_GetTicksNS() - start;
+
+  busy = true;
+  {
+    std::lock_guard lock(mutex);
+    pending = true;
+  }
+  cv.notify_one();
+}
+
+SnapshotStats SnapshotWriter::collectStats() {
+  SnapshotStats stats;
+
+  stats.written = written.exchange(0);
+  stats.skipped = skipped.exchange(0);
+  stats.chunksWritten = chunksWritten.exchange(0);
+  stats.chunksTotal = chunksTotal.exchange(0);
+  Uint64 copy = copyNS.exchange(0);
+  Uint64 write = writeNS.exchange(0);
+  if (stats.written > 0) {
+    stats.copyMs = double(copy) / stats.written / SDL_NS_PER_MS;
+    stats.writeMs = double(write) / stats.written / SDL_NS_PER_MS;
+  }
+
+  return stats;
+}
+
+void SnapshotWriter::run() {
+  while (true) {
+    {
+      std::unique_lock lock(mutex);
+      cv.wait(lock, [this] { return pending || quit; });
+      if (!pending) {
+        return;
+      }
+      pending = false;
+    }
+
+    Uint64 start = SDL_GetTicksNS();
+    File &file = files[nextFile];
+    if (write(snapshotPath(dir, nextFile), file)) {
+      nextFile = 1 - nextFile;
+      ++written;
+      writeNS += SDL_GetTicksNS() - start;
+    } else {
+      LOG_ERROR("Failed to write a snapshot to %s: %s\n", dir.c_str(), SDL_GetError());
+      // Whatever is in the file now, the next write rewrites it in full.
+      file = {};
+    }
+
+    busy = false;
+  }
+}
+
+bool SnapshotWriter::write(const std::string &path, File &file) {
+  World::ChunkLayout layout = spriteLayout(state.world);
+  std::vector<World::ChunkImage> chunks = spriteChunks(state.world);
+  const std::vector<glm::vec2> &cells = state.field.getCells();
+  glm::ivec2 fieldSize = state.field.getSize();
+
+  SnapshotHeader header = {
+    .magic = SNAPSHOT_MAGIC,
+    .version = SNAPSHOT_VERSION,
+    .sequence = sequence + 1,
+    .complete = 0,
+    .tick = state.tick,
+    .worldSize = { state.worldSize.x, state.worldSize.y },
+    .camera = { state.camera.x, state.camera.y },
+    .chunkBytes = World::CHUNK_BYTES,
+    .chunkCapacity = layout.capacity,
+    .numColumns = static_cast<uint32_t>(layout.offsets.size()),
+    .numChunks = chunks.size(),
+    .numSprites = state.world.size(),
+    .fieldW = cells.empty() ? 0 : fieldSize.x,
+    .fieldH = cells.empty() ? 0 : fieldSize.y,
+  };
+  for (uint32_t c = 0; c < header.numColumns; ++c) {
+    header.columnOffsets[c] = layout.offsets[c];
+    header.columnSizes[c] = SPRITE_COLUMN_SIZES[c];
+  }
+  header.chunkTableOffset = alignUp(sizeof(SnapshotHeader));
+  header.chunksOffset = alignUp(header.chunkTableOffset + chunks.size() * sizeof(SnapshotChunk));
+  header.fieldOffset = alignUp(header.chunksOffset + chunks.size() * World::CHUNK_BYTES);
+
+  std::vector<SnapshotChunk> table(chunks.size());
+  std::vector<uint64_t> hashes(chunks.size());
+  for (size_t c = 0; c < chunks.size(); ++c) {
+    table[c].count = chunks[c].count;
+    hashes[c] = hashBytes(chunks[c].data, World::CHUNK_BYTES) ^ chunks[c].count;
+  }
+  uint64_t fieldHash = hashBytes(cells.data(), cells.size() * sizeof(glm::vec2));
+
+  // Only update the file in place if it has the same sections as before.
+  bool incremental = !file.hashes.empty() && file.hashes.size() == chunks.size();
+  SDL_IOStream *io = SDL_IOFromFile(path.c_str(), incremental ? "r+b" : "w+b");
+  if (io == nullptr) {
+    return false;
+  }
+
+  // Marked incomplete until everything else is on the disk. Synced before
+  // and after the sections so the disk never has a complete header with
+  // only some of them.
+  bool res = writeAt(io, 0, &header, sizeof(header)) && SDL_FlushIO(io) && syncFile(path);
+  res = res && writeAt(io, header.chunkTableOffset, table.data(), table.size() * sizeof(SnapshotChunk));
+
+  Uint64 numWritten = 0;
+  for (size_t c = 0; c < chunks.size() && res; ++c) {
+    if (incremental && file.hashes[c] == hashes[c]) {
+      continue;
+    }
+    res = writeAt(io, header.chunksOffset + c * World::CHUNK_BYTES, chunks[c].data, World::CHUNK_BYTES);
+    ++numWritten;
+  }
+  if (res && !cells.empty() && (!incremental || fieldHash != file.fieldHash)) {
+    res = writeAt(io, header.fieldOffset, cells.data(), cells.size() * sizeof(glm::vec2));
+  }
+
+  header.complete = 1;
+  res = res && SDL_FlushIO(io) && syncFile(path) && writeAt(io, 0, &header, sizeof(header));
+  // The other file is overwritten next, this one has to be complete on
+  // the disk by then.
+  res = SDL_CloseIO(io) && res && syncFile(path);
+  if (!res) {
+    return false;
+  }
+
+  file.hashes = std::move(hashes);
+  file.fieldHash = fieldHash;
+  sequence = header.sequence;
+  chunksWritten += numWritten;
+  chunksTotal += chunks.size();
+
+  return true;
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "game_state.h"
+#include "mapped_file.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <SDL3/SDL.h>
+
+struct Config;
+
+// Versioned binary checkpoint of a GameState, laid out so that a mapped
+// file can be used in place. Every section starts at a multiple of
+// SNAPSHOT_ALIGN and is found by its offset from the start of the file:
+//   SnapshotHeader
+//   chunk table - SnapshotChunk per chunk
+//   chunks      - World::CHUNK_BYTES images of the sprite chunks,
+//                 see World::ChunkImage
+//   field cells - if the CPU field backend is used
+// Snapshots are written alternately to two files in a directory, so there
+// is always a complete one even if the process dies in the middle of a
+// write. The newer complete one wins on load.
+
+static constexpr uint32_t SNAPSHOT_ALIGN = 4096;
+static constexpr uint32_t MAX_SNAPSHOT_COLUMNS = 8;
+
+struct SnapshotHeader {
+  uint32_t magic = 0;
+  uint32_t version = 0;
+  // Increases with every snapshot written to the directory
+  uint64_t sequence = 0;
+  // Cleared while the file is being written
+  uint32_t complete = 0;
+  uint32_t _pad0 = 0;
+
+  uint64_t tick = 0;
+  float worldSize[2] = {};
+  float camera[2] = {};
+
+  // Chunk layout of the build that wrote the snapshot. The chunks can
+  // only be loaded as they are if it matches.
+  uint32_t chunkBytes = 0;
+  uint32_t chunkCapacity = 0;
+  uint32_t numColumns = 0;
+  uint32_t columnOffsets[MAX_SNAPSHOT_COLUMNS] = {};
+  uint32_t columnSizes[MAX_SNAPSHOT_COLUMNS] = {};
+  uint32_t _pad1 = 0;
+
+  uint64_t numChunks = 0;
+  uint64_t numSprites = 0;
+  uint64_t chunkTableOffset = 0;
+  uint64_t chunksOffset = 0;
+
+  int32_t fieldW = 0;
+  int32_t fieldH = 0;
+  uint64_t fieldOffset = 0;
+};
+
+struct SnapshotChunk {
+  uint32_t count = 0;
+  uint32_t _pad = 0;
+};
+
+// A snapshot file mapped into memory. The chunks are used straight from
+// the mapping, nothing is read up front.
+class SnapshotView {
+private:
+  MappedFile file;
+  const std::byte *data = nullptr;
+  size_t size = 0;
+
+public:
+  ~SnapshotView() {
+    close();
+  }
+
+  // Fails if the file isn't a complete snapshot of this version.
+  bool open(const std::string &path);
+  void close();
+
+  const SnapshotHeader &getHeader() const { return *reinterpret_cast<const SnapshotHeader*>(data); }
+
+  // Whether the chunks can be loaded into this build's World as they are
+  bool matchesLayout() const;
+
+  std::vector<World::ChunkImage> chunkImages() const;
+
+  // nullptr without a field
+  const glm::vec2 *fieldCells() const;
+};
+
+// Restores state from the newest complete snapshot in dir.
+bool loadSnapshot(const std::string &dir, const Config &cfg, GameState &state);
+
+struct SnapshotStats {
+  // Since the last SnapshotWriter::collectStats
+  Uint64 written = 0;
+  // Snapshots that were due while the previous one was still being written
+  Uint64 skipped = 0;
+  Uint64 chunksWritten = 0;
+  Uint64 chunksTotal = 0;
+  // Averages, the copy is done on the sim thread, the write isn't
+  double copyMs = 0.;
+  double writeMs = 0.;
+};
+
+// Writes snapshots on its own thread. The sim thread only pays for copying
+// the state, which reuses the memory of the previous copy. The files are
+// updated in place, only the chunks that changed since the last snapshot
+// written to the same file are rewritten.
+class SnapshotWriter {
+private:
+  std::string dir;
+  Uint64 interval = 0;
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable cv;
+  // Guarded by mutex
+  bool pending = false;
+  bool quit = false;
+  // Set by the sim thread when it hands over a state, cleared once written
+  std::atomic<bool> busy = false;
+
+  // Copy of the state being written
+  GameState state;
+
+  struct File {
+    // Of the chunks in the file, empty if it has to be written in full
+    std::vector<uint64_t> hashes;
+    uint64_t fieldHash = 0;
+  };
+  File files[2];
+  int nextFile = 0;
+  uint64_t sequence = 0;
+
+  std::atomic<Uint64> written = 0;
+  std::atomic<Uint64> skipped = 0;
+  std::atomic<Uint64> chunksWritten = 0;
+  std::atomic<Uint64> chunksTotal = 0;
+  std::atomic<Uint64> copyNS = 0;
+  std::atomic<Uint64> writeNS = 0;
+
+public:
+  ~SnapshotWriter() {
+    deinit();
+  }
+
+  // Snapshots every intervalTicks ticks, zero disables it.
+  bool init(const std::string &dir, Uint64 intervalTicks);
+  void deinit();
+
+  bool enabled() const { return interval > 0; }
+
+  // Called by the sim thread after every tick. Never waits - if the
+  // previous snapshot is still being written this one is skipped.
+  void tick(const GameState &state);
+
+  SnapshotStats collectStats();
+
+private:
+  void run();
+  bool write(const std::string &path, File &file);
+};
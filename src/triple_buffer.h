@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free handoff of the latest T from one producer thread to one
+// consumer thread.
+// The producer fills its own slot and publishes it by swapping it with the
+// shared one, so it never waits for the consumer. The consumer swaps the
+// shared slot with one of its own whenever the shared one is newer.
+// On top of the classic three slots the consumer keeps the one it consumed
+// before, so it always has the last two values, e.g. for interpolation.
+template <class T>
+class TripleBuffer {
+private:
+  // Set on the shared index while it holds a value the consumer hasn't seen.
+  static constexpr uint8_t FRESH = 0x80;
+
+  T slots[4];
+
+  // Producer side
+  uint8_t back = 0;
+  // Index of the shared slot, FRESH if it was published since the last acquire
+  std::atomic<uint8_t> shared = 1;
+  // Consumer side
+  uint8_t front = 2;
+  uint8_t prev = 3;
+
+public:
+  // Fills every slot. NOT thread-safe, call before the threads start.
+  void reset(const T &value) {
+    for (T &slot : slots) {
+      slot = value;
+    }
+    back = 0;
+    shared = 1;
+    front = 2;
+    prev = 3;
+  }
+
+  // Producer: the slot to fill before publish().
+  // Holds an old value, which is handy for reusing allocations.
+  T &writeSlot() {
+    return slots[back];
+  }
+
+  // Producer: hands over the write slot.
+  // Returns true if the previously published value was never acquired.
+  bool publish() {
+    uint8_t old = shared.exchange(back | FRESH, std::memory_order_acq_rel);
+    back = old & ~FRESH;
+    return (old & FRESH) != 0;
+  }
+
+  // Consumer: takes the newest published value, if there is one.
+  // Returns false if nothing was published since the last call.
+  bool acquire() {
+    if ((shared.load(std::memory_order_relaxed) & FRESH) == 0) {
+      return false;
+    }
+
+    // The oldest slot goes back to the producer.
+    uint8_t newest = shared.exchange(prev, std::memory_order_acq_rel);
+    prev = front;
+    front = newest & ~FRESH;
+
+    return true;
+  }
+
+  // Consumer: the last two acquired values
+  const T &latest() const {
+    return slots[front];
+  }
+  const T &previous() const {
+    return slots[prev];
+  }
+};